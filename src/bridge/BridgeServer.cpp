@@ -88,19 +88,8 @@ bool BridgeServer::setupWebSocket(quint16 port){
 
 //Server Blacklist / DDOS mitigator
 bool BridgeServer::allowConnection(QHostAddress addr){
-  //Check if this addr is on the blacklist
-  QString key = "blacklist/"+addr.toString();
-  if(!CONFIG->contains(key) ){ return true; } //not in the list
-  //Address on the list - see if the timeout has expired 
-  QDateTime dt = CONFIG->value(key,QDateTime()).toDateTime();
-  if(dt.addSecs(CONFIG->value("blacklist_settings/block_minutes",60).toInt()*60) < QDateTime::currentDateTime()){
-    //This entry has timed out - go ahead and allow it
-    CONFIG->remove(key); //make the next connection check for this IP faster again
-    return true;
-  }else{
-    return false; //blacklist block is still in effect
-  }
-  
+  //Check the blacklist and connection rate for this addr (in memory - no settings file lookups)
+  return HOSTLIMITS->allowConnection(addr.toString());
 }
 
 QString BridgeServer::generateID(QString name){
@@ -142,7 +131,7 @@ void BridgeServer::BlackListConnection(QHostAddress addr){
   if(addr!=QHostAddress(QHostAddress::LocalHost) && addr!=QHostAddress(QHostAddress::LocalHostIPv6)  && addr.toString()!="::ffff:127.0.0.1" ){
     //Block this remote host
     qDebug() << "Blacklisting IP Temporarily: " << addr.toString();
-    CONFIG->setValue("blacklist/"+addr.toString(), QDateTime::currentDateTime());
+    HOSTLIMITS->block(addr.toString()); //gets saved to the settings file in the background
   }
 }
 
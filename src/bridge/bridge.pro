@@ -2,17 +2,19 @@ TEMPLATE	= app
 LANGUAGE	= C++
 
 CONFIG	+= qt warn_off release
-QT = core network websockets
+QT = core network websockets concurrent
 
 HEADERS	+= globals.h \
 		BridgeServer.h \
 		BridgeConnection.h \
-		AuthorizationManager.h
+		AuthorizationManager.h \
+		../server/HostLimiter.h
 		
 SOURCES	+= main.cpp \
 		BridgeServer.cpp \
 		BridgeConnection.cpp \
-		AuthorizationManager.cpp
+		AuthorizationManager.cpp \
+		../server/HostLimiter.cpp
 
 
 TARGET=sysadm-bridge
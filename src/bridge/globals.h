@@ -42,4 +42,6 @@
 
 extern QSettings* CONFIG;
 extern AuthorizationManager* AUTHSYSTEM;
+#include "../server/HostLimiter.h"
+extern HostLimiter* HOSTLIMITS;
 extern QString SSLFILEDIR;
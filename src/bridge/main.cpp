@@ -16,6 +16,7 @@
 //Create any global classes/settings
 QSettings *CONFIG = 0;
 AuthorizationManager *AUTHSYSTEM = new AuthorizationManager();
+HostLimiter *HOSTLIMITS = new HostLimiter();
 QString SSLFILEDIR;
 
 //Create the default logfile
@@ -58,6 +59,8 @@ qDebug() << "  \"set <variable>=<value>\": Used for adjusting individual setting
 qDebug() << "  - Possible variables:";
 qDebug() << "    \"blacklist/block_minutes\" (integer): Number of minutes a system remains on the automatic blacklist";
 qDebug() << "    \"blacklist/fails_to_block\" (integer): Number of times a system must fail authentication to be placed on blacklist";
+qDebug() << "    \"blacklist/connection_rate\" (number): Number of new connections per second allowed from a single system (0 = no limit)";
+qDebug() << "    \"blacklist/connection_burst\" (integer): Number of new connections from a single system which may arrive at once";
 }
 
 int main( int argc, char ** argv )
@@ -86,6 +89,8 @@ int main( int argc, char ** argv )
 	qDebug() << "Changing bridge setting:" << info;
         if(var=="blacklist/block_minutes"){ CONFIG->setValue("blacklist_settings/block_minutes",val.toInt()); }
         else if(var=="blacklist/fails_to_block"){ CONFIG->setValue("blacklist_settings/fails_to_block",val.toInt()); }
+        else if(var=="blacklist/connection_rate"){ CONFIG->setValue("blacklist_settings/connection_rate",val.toDouble()); }
+        else if(var=="blacklist/connection_burst"){ CONFIG->setValue("blacklist_settings/connection_burst",val.toInt()); }
       }
  // -------------------------
       else if( QString(argv[i])=="-h" || QString(argv[i]).contains("help") ){ showUsage(); return 0; }
@@ -168,6 +173,10 @@ int main( int argc, char ** argv )
       logfile.open(QIODevice::WriteOnly | QIODevice::Append);
       qInstallMessageHandler(MessageOutput);
     }
+    //Setup the connection limits (in memory - the blacklist gets saved in the background)
+    HOSTLIMITS->setBlockMinutes( CONFIG->value("blacklist_settings/block_minutes",60).toInt() );
+    HOSTLIMITS->setConnectionRate( CONFIG->value("blacklist_settings/connection_rate",10).toDouble(), CONFIG->value("blacklist_settings/connection_burst",30).toInt() );
+    HOSTLIMITS->load(CONFIG);
     //Create the server
     qDebug() << "Starting the PC-BSD sysadm bridge....";
     BridgeServer server;
@@ -183,6 +192,7 @@ int main( int argc, char ** argv )
     }
 
     //Cleanup any globals
+    delete HOSTLIMITS; //writes out any pending blacklist changes
     delete CONFIG;
     if(USELOG){ logfile.close(); }
     
@@ -8,17 +8,21 @@
 #include "globals.h"
 
 #include <QCryptographicHash>
+#include <QRandomGenerator>
 #include "library/sysadm-general.h" //simplification functions
+#include "library/sysadm-process.h"
 
 // Stuff for PAM to work
 #include <sys/types.h>
+#if defined(__FreeBSD__)
 #include <security/pam_appl.h>
 #include <security/openpam.h>
-#include <sys/types.h>
+#include <login_cap.h>
+#endif
 #include <sys/wait.h>
 #include <unistd.h>
 #include <pwd.h>
-#include <login_cap.h>
+#include <sys/socket.h> //peer credentials on local sockets
 
 //Stuff for OpenSSL to work
 #include <openssl/pem.h>
@@ -34,11 +38,25 @@
 #define AUTHCHARS QString("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789")
 #define TOKENLENGTH 20
 
-AuthorizationManager::AuthorizationManager() : QObject(){
+//Random string for tokens and login challenges
+//QRandomGenerator::system() is the OS random source (arc4random/getrandom): unpredictable and safe to use from any thread
+inline QString randomAuthString(){
+  QString str;
+  QRandomGenerator *rng = QRandomGenerator::system();
+  for(int i=0; i<TOKENLENGTH; i++){
+    str.append( AUTHCHARS.at( rng->bounded(AUTHCHARS.length()) ) );
+  }
+  return str;
+}
+
+AuthorizationManager::AuthorizationManager() : QObject(), SESSIONS(TIMEOUTSECS){
   HASH.clear();
   IPFAIL.clear();
-  //initialize the random number generator (need to generate auth tokens)
-  qsrand(QDateTime::currentMSecsSinceEpoch());
+  //Periodically sweep out any expired tokens
+  expireTimer = new QTimer(this);
+    expireTimer->setInterval(SESSIONS.tickMSecs());
+    connect(expireTimer, SIGNAL(timeout()), this, SLOT(expireSessions()) );
+  expireTimer->start();
 }
 
 AuthorizationManager::~AuthorizationManager(){
@@ -49,48 +67,31 @@ AuthorizationManager::~AuthorizationManager(){
 void AuthorizationManager::clearAuth(QString token){
   if(token.isEmpty() || token.length() < TOKENLENGTH){ return; } //not a valid token
   //clear an authorization token
-  QString id = hashID(token);
-  //qDebug() << "Clear Auth:" << id;
-  if(!id.isEmpty()){ HASH.remove(id); }
+  SESSIONS.remove(token);
 }
 
 bool AuthorizationManager::checkAuth(QString token){
-	//see if the given token is valid
-  bool ok = false;
-  QString id = hashID(token);
-  if(!id.isEmpty()){
-    //Also verify that the token has not timed out
-    ok = (HASH[id] > QDateTime::currentDateTime());
-    if(ok){ HASH.insert(id, QDateTime::currentDateTime().addSecs(TIMEOUTSECS)); } //valid - bump the timestamp
-  }
-  return ok;
+  //see if the given token is valid (and bump the timeout if it is)
+  if(token.isEmpty()){ return false; }
+  return SESSIONS.touch(token);
 }
 
 bool AuthorizationManager::hasFullAccess(QString token){
-  bool ok = false;
-  QString id = hashID(token);
-  if(!id.isEmpty()){
-    //Also verify that the token has not timed out
-    if( HASH[id] > QDateTime::currentDateTime() ){  
-      ok = id.section("::::",1,1)=="operator";
-    }
-  }
-  return ok;
+  AuthSession session;
+  if( !SESSIONS.lookup(token, &session) ){ return false; }
+  return session.isOperator;
 }
 
 QString AuthorizationManager::userForToken(QString token){
-  QString id = hashID(token);
-  if(!id.isEmpty()){
-    return id.section("::::",2,2);
-  }else{
-    return "";
-  }
+  AuthSession session;
+  if( !SESSIONS.lookup(token, &session) ){ return ""; }
+  return session.user;
 }
 
 //SSL Certificate register/revoke/list
 bool AuthorizationManager::RegisterCertificate(QString token, QString pubkey, QString nickname, QString email){
   if(!checkAuth(token)){ return false; }
-  QString user = hashID(token).section("::::",2,2); //get the user name from the currently-valid token
+  QString user = userForToken(token); //get the user name from the currently-valid token
   //NOTE: The public key should be a base64 encoded string
   CONFIG->setValue("RegisteredCerts/"+user+"/"+pubkey, "Nickname: "+nickname+"\nEmail: "+email+"\nDate Registered: "+QDateTime::currentDateTime().toString(Qt::ISODate) );
   return true;
@@ -105,7 +106,7 @@ bool AuthorizationManager::RegisterCertificateInternal(QString user, QByteArray
 
 bool AuthorizationManager::RevokeCertificate(QString token, QString key, QString user){
   //user will be the current user if not empty - cannot touch other user's certs without full perms on current session
-  QString cuser = hashID(token).section("::::",2,2);
+  QString cuser = userForToken(token);
   if(user.isEmpty()){ user = cuser; } //only probe current user
   if(user !=cuser){
     //Check permissions for this cross-user action
@@ -125,7 +126,7 @@ void AuthorizationManager::ListCertificates(QString token, QJsonObject *out){
     //qDebug() << "Found SSL Keys to List:" << keys;
   }else{
     //Only list certs for current user
-    QString cuser = hashID(token).section("::::",2,2);
+    QString cuser = userForToken(token);
     keys = CONFIG->allKeys().filter("RegisteredCerts/"+cuser+"/");
     //qDebug() << "Found SSL Keys to List:" << keys;
   }
@@ -169,8 +170,7 @@ void AuthorizationManager::ListCertificateChecksums(QJsonObject *out){
 //Generic functions
 int AuthorizationManager::checkAuthTimeoutSecs(QString token){
 	//Return the number of seconds that a token is valid for
-  if(!HASH.contains(token)){ return 0; } //invalid token
-  return QDateTime::currentDateTime().secsTo( HASH[token] );
+  return SESSIONS.secondsLeft(token);
 }
 
 
@@ -181,7 +181,9 @@ QString AuthorizationManager::LoginUP(QHostAddress host, QString user, QString p
   bool ok = false;
   bool isOperator = false;
   //First check that the user is valid on the system and part of the operator group
-  if( CONFIG->value("auth/allowUserPassAuth",true).toBool() ){
+  if(STUB_BACKEND && localhost){
+    ok = isOperator = true; //benchmark mode: no PAM/group lookups for local clients
+  }else if( CONFIG->value("auth/allowUserPassAuth",true).toBool() ){
     if(user!="root" && user!="toor"){
       QStringList groups = getUserGroups(user);
       if(groups.contains("wheel")){ isOperator = true; } //full-access user
@@ -239,16 +241,49 @@ QString AuthorizationManager::LoginService(QHostAddress host, QString service){
   }else{ return generateNewToken(false, service); }//services are never given operator privileges
 }
 
+QString AuthorizationManager::peerUser(qintptr socketdescriptor){
+  uid_t uid;
+#ifdef __linux__
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if(getsockopt(socketdescriptor, SOL_SOCKET, SO_PEERCRED, &cred, &len)!=0){ return ""; }
+  uid = cred.uid;
+#else
+  gid_t gid;
+  if(getpeereid(socketdescriptor, &uid, &gid)!=0){ return ""; }
+#endif
+  //Turn the user ID into the user name
+  struct passwd pwd, *result = 0;
+  char buf[1024];
+  if(getpwuid_r(uid, &pwd, buf, sizeof(buf), &result)!=0 || result==0){ return ""; }
+  return QString::fromLocal8Bit(pwd.pw_name);
+}
+
+QString AuthorizationManager::LoginLocal(QString user){
+  //The kernel already vouches for the user on the other end of the socket - just check the groups
+  //NOTE: runs on a request thread - only thread-safe calls in here (SESSIONS, ProcessRunner, randomAuthString())
+  if(user.isEmpty()){ return ""; }
+  bool ok = true;
+  bool isOperator = false;
+  if(user!="root" && user!="toor"){
+    QStringList groups = getUserGroups(user);
+    if(groups.contains("wheel")){ isOperator = true; } //full-access user
+    else if(!groups.contains("operator")){ ok = false; } //user not allowed access if not in either of the wheel/operator groups
+  }else{ isOperator = true; }
+  LogManager::log(LogManager::HOST, QString("Local User Login: ")+user+"   Success: "+(ok?"true":"false") );
+  if(!ok){ return ""; }
+  return generateNewToken(isOperator, user);
+}
+
 //Stage 1 SSL Login Check: Generation of random string for this user
 QString AuthorizationManager::GenerateEncCheckString(){
-  QString key;
-  for(int i=0; i<TOKENLENGTH; i++){
-    key.append( AUTHCHARS.at( qrand() % AUTHCHARS.length() ) );
-  }
-  if(HASH.contains("SSL_CHECK_STRING/"+key)){ key = GenerateEncCheckString(); } //get a different one
+  QString key = randomAuthString();
+  hashMutex.lock();
+  if(HASH.contains("SSL_CHECK_STRING/"+key)){ hashMutex.unlock(); key = GenerateEncCheckString(); } //get a different one
   else{
     //insert this new key into the hash for later
     HASH.insert("SSL_CHECK_STRING/"+key, QDateTime::currentDateTime().addSecs(30) ); //only keep a key "alive" for 30 seconds
+    hashMutex.unlock();
   }
   //qDebug() << "New SSL test string:" << key;
   return key;
@@ -292,6 +327,7 @@ QString AuthorizationManager::LoginUC(QHostAddress host, QString encstring){
   bool ok = false;
   //qDebug() << "SSL Auth Attempt";
     //First clean out any old strings/keys
+    QMutexLocker lock(&hashMutex);
     QStringList pubkeys = QStringList(HASH.keys()).filter("SSL_CHECK_STRING/"); //temporary, re-use variable below
     for(int i=0; i<pubkeys.length(); i++){ 
       //Check expiration time on each initial string
@@ -318,6 +354,7 @@ QString AuthorizationManager::LoginUC(QHostAddress host, QString encstring){
         user = pubkeys[i].section("/",1,1);
       }
     }
+    lock.unlock();
   bool isOperator = false;    
   if(ok){
     //qDebug() << "Check user groups";
@@ -589,37 +626,21 @@ QStringList keys; //Format: "RegisteredCerts/<user>/<key>" (value is full text)
 //               PRIVATE
 // =========================
 QString AuthorizationManager::generateNewToken(bool isOp, QString user){
-  QString tok;
-  for(int i=0; i<TOKENLENGTH; i++){
-    tok.append( AUTHCHARS.at( qrand() % AUTHCHARS.length() ) );
-  }
-  
-  if( !hashID(tok).isEmpty() ){ 
+  QString tok = randomAuthString();
+  if( !SESSIONS.insert(tok, user, isOp) ){
     //Just in case the randomizer came up with something identical - re-run it
     tok = generateNewToken(isOp, user);
-  }else{ 
-    //unique token created - add it to the hash with the current time (+timeout)
-    QString id = tok + "::::"+(isOp ? "operator" : "user")+"::::"+user; //append operator status to auth key
-    HASH.insert(id, QDateTime::currentDateTime().addSecs(TIMEOUTSECS) );
-    //qDebug() << "Current HASH Contents:" << HASH.keys();
   }
   return tok;
 }
 
 QStringList AuthorizationManager::getUserGroups(QString user){
-  QProcess proc;
-  QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-  env.insert("LANG", "C");
-  env.insert("LC_All", "C");
-  proc.setProcessEnvironment(env);
-  proc.setProcessChannelMode(QProcess::MergedChannels);
-  proc.start("id", QStringList() << "-nG" << user);
-  if(!proc.waitForStarted(30000)){ return QStringList(); } //process never started - max wait of 30 seconds
-  while(!proc.waitForFinished(500)){
-    if(proc.state() != QProcess::Running){ break; } //somehow missed the finished signal
-    QCoreApplication::processEvents();
-  }
-  QStringList out = QString(proc.readAllStandardOutput()).remove("\n").split(" ");
+  sysadm::CommandOptions opts;
+    opts.env << "LANG=C" << "LC_All=C";
+    opts.timeoutMSecs = 30000; //max wait of 30 seconds
+  sysadm::CommandResult res = sysadm::ProcessRunner::run("id", QStringList() << "-nG" << user, opts);
+  if(!res.started || res.timedOut){ return QStringList(); }
+  QStringList out = QString(res.output).remove("\n").split(" ");
   //qDebug() << "Found Groups for user:" << user << out;
   return out;	
 }
@@ -644,6 +665,7 @@ bool AuthorizationManager::local_checkActive(QString user){
 bool AuthorizationManager::BumpFailCount(QString host){
   //Returns: true if the failure count is over the limit
   //key: "<IP>::::<failnum>"
+  QMutexLocker lock(&hashMutex);
   QStringList keys = QStringList(IPFAIL.keys()).filter(host+"::::");
   int fails = 0;
   if(!keys.isEmpty()){
@@ -659,10 +681,15 @@ bool AuthorizationManager::BumpFailCount(QString host){
 }
 
 void AuthorizationManager::ClearHostFail(QString host){
+  QMutexLocker lock(&hashMutex);
   QStringList keys = QStringList(IPFAIL.keys()).filter(host+"::::");
   for(int i=0; i<keys.length(); i++){ IPFAIL.remove(keys[i]); }
 }
 
+void AuthorizationManager::expireSessions(){
+  SESSIONS.expire();
+}
+
 QString AuthorizationManager::DecryptSSLString(QString encstring, QString pubkey){
   //Convert from the base64 string back into byte array
   QByteArray enc;
@@ -694,6 +721,7 @@ QString AuthorizationManager::DecryptSSLString(QString encstring, QString pubkey
 /*
  ========== PAM FUNCTIONS ==========
 */
+#if defined(__FreeBSD__)
 static struct pam_conv pamc = { openpam_nullconv, NULL };
 pam_handle_t *pamh;
 
@@ -773,3 +801,16 @@ void AuthorizationManager::pam_logFailure(int ret){
   }
 	
 }
+
+#else
+//No OpenPAM outside of FreeBSD (development/benchmark builds): password logins always fail
+// - a server started with "-stub" still accepts local logins
+bool AuthorizationManager::pam_checkPW(QString user, QString){
+  qWarning() << "PAM is not available on this system - password login refused for:" << user;
+  return false;
+}
+
+void AuthorizationManager::pam_logFailure(int ret){
+  qWarning() << "PAM Error: " << ret;
+}
+#endif
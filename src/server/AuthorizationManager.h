@@ -7,6 +7,7 @@
 #define _PCBSD_REST_AUTHORIZATION_MANAGER_H
 
 #include "globals-qt.h"
+#include "SessionTable.h"
 
 class AuthorizationManager : public QObject{
 	Q_OBJECT
@@ -32,6 +33,9 @@ public:
 	// == Token Generation functions
 	QString LoginUP(QHostAddress host, QString user, QString pass); //Login w/ username & password
 	QString LoginService(QHostAddress host, QString service); //Login a particular automated service
+	//Local (unix domain socket) connections: authorized by the user ID of the connecting process (no PAM)
+	static QString peerUser(qintptr socketdescriptor); //user which owns the other end of the socket (empty on failure)
+	QString LoginLocal(QString user); //thread-safe (called on the request threads)
 
 	//Stage 1 SSL Login Check: Generation of random string for this user
 	QString GenerateEncCheckString();  //generate random string (server is receiver w/ pub key)
@@ -49,8 +53,11 @@ public:
 	QByteArray pubkeyForMd5(QString md5_base64);
 	
 private:
-	QHash<QString, QDateTime> HASH;
+	SessionTable SESSIONS; //token -> user session
+	QTimer *expireTimer;
+	QHash<QString, QDateTime> HASH; //SSL check strings
 	QHash <QString, QDateTime> IPFAIL;
+	QMutex hashMutex; //protects HASH and IPFAIL (used from request threads)
 
 	QString generateNewToken(bool isOperator, QString name);
 	QStringList getUserGroups(QString user);
@@ -60,20 +67,16 @@ private:
 	bool BumpFailCount(QString host);
 	void ClearHostFail(QString host);
 
-	//token->hashID filter simplification
-	QString hashID(QString token){
-	  QStringList tmp = QStringList(HASH.keys()).filter(token+"::::");
-	  if(tmp.isEmpty()){ return ""; }
-	  else{ return tmp.first(); }
-	}
-	
 	//SSL Decrypt function
 	QString DecryptSSLString(QString encstring, QString pubkey);
 
 	//PAM login/check files
 	bool pam_checkPW(QString user, QString pass);
 	void pam_logFailure(int ret);
-	
+
+private slots:
+	void expireSessions();
+
 signals:
 	void BlockHost(QHostAddress); //block a host address temporarily
 	
@@ -0,0 +1,159 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "BackendTable.h"
+#include "globals.h"
+
+#define DEBUG 0
+
+BackendTable::BackendTable(){
+
+}
+
+BackendTable::~BackendTable(){
+  for(int i=0; i<SUBSYSTEMS.length(); i++){
+    if(SUBSYSTEMS[i]->main!=0){ delete SUBSYSTEMS[i]->main; }
+    qDeleteAll(SUBSYSTEMS[i]->actions);
+    delete SUBSYSTEMS[i];
+  }
+}
+
+BackendSubsystem* BackendTable::addSubsystem(QString namesp, QString name, QString fullaccess, QString useraccess, QStringList files, BackendHandler handler){
+  BackendSubsystem *sub = new BackendSubsystem();
+    sub->namesp = namesp;
+    sub->name = name;
+    sub->key = namesp+"/"+name;
+    sub->fullAccess = fullaccess;
+    sub->userAccess = useraccess;
+    sub->files = files;
+    sub->main = 0;
+  if(handler){
+    sub->main = new BackendAction();
+    sub->main->name = "*";
+    sub->main->fullAccessOnly = false;
+    sub->main->handler = handler;
+  }
+  TABLE[namesp].insert(name, sub);
+  SUBSYSTEMS << sub;
+  return sub;
+}
+
+void BackendTable::addAction(BackendSubsystem *sub, QString action, bool fullonly, QStringList required, BackendHandler handler){
+  BackendAction *act = new BackendAction();
+    act->name = action;
+    act->fullAccessOnly = fullonly;
+    act->required = required;
+    act->handler = handler;
+  sub->actions.insert(action, act);
+}
+
+void BackendTable::addCall(BackendSubsystem *sub, QString action, bool fullonly, QStringList required, BackendFunction fn, RESULT_TYPE type){
+  addAction(sub, action, fullonly, required, [action, fn, type](WebSocket*, const RestInputStruct &IN, QJsonObject *out){
+    QJsonObject result = fn(IN.args.toObject());
+    if(result.isEmpty()){
+      if(type==RESULT_REQUIRED){ return RestOutputStruct::BADREQUEST; }
+      else if(type==RESULT_SKIP_EMPTY){ return RestOutputStruct::OK; }
+    }
+    out->insert(action, result);
+    return RestOutputStruct::OK;
+  });
+}
+
+void BackendTable::setCache(BackendSubsystem *sub, QString action, int secs, QStringList invalidatedby){
+  sub->cacheSecs.insert(action, secs);
+  for(int i=0; i<invalidatedby.length(); i++){
+    if(!sub->invalidators.contains(invalidatedby[i])){ sub->invalidators << invalidatedby[i]; }
+  }
+}
+
+void BackendTable::registerCapabilities(CapabilityRegistry *reg){
+  for(int i=0; i<SUBSYSTEMS.length(); i++){
+    reg->addSubsystem(SUBSYSTEMS[i]->key, SUBSYSTEMS[i]->fullAccess, SUBSYSTEMS[i]->userAccess, SUBSYSTEMS[i]->files);
+  }
+}
+
+BackendSubsystem* BackendTable::find(const QString &namesp, const QString &name){
+  //Fast path: clients almost always send lowercase names
+  QHash<QString, QHash<QString, BackendSubsystem*> >::const_iterator it = TABLE.constFind(namesp);
+  if(it==TABLE.constEnd()){ it = TABLE.constFind(namesp.toLower()); }
+  if(it==TABLE.constEnd()){ return 0; }
+  BackendSubsystem *sub = it.value().value(name, 0);
+  if(sub==0){ sub = it.value().value(name.toLower(), 0); }
+  return sub;
+}
+
+RestOutputStruct::ExitCode BackendTable::evaluate(BackendSubsystem *sub, WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+  QString action = IN.args.toObject().value("action").toString();
+  BackendAction *act = sub->main; //subsystem parses the arguments itself
+  if(act==0){
+    //Find the action
+    if(!IN.args.isObject()){ return RestOutputStruct::BADREQUEST; }
+    act = sub->actions.value(action, 0);
+    if(act==0){ act = sub->actions.value(action.toLower(), 0); }
+    if(act==0){ return RestOutputStruct::BADREQUEST; }
+    //Check the access level and arguments
+    //Note: FORBIDDEN is reserved for authorization failures (closes a WebSocket connection) - access denials are bad requests
+    if(act->fullAccessOnly && !IN.fullaccess){ return RestOutputStruct::BADREQUEST; }
+    for(int i=0; i<act->required.length(); i++){
+      if(!IN.args.toObject().contains(act->required[i])){ return RestOutputStruct::BADREQUEST; }
+    }
+  }
+  if(sub->cacheSecs.isEmpty()){ return run(act, sock, IN, out); } //nothing cached for this subsystem
+  //Cached (read-only) action?
+  action = action.toLower();
+  int secs = sub->cacheSecs.value(action, 0);
+  if(secs>0){
+    //Key: access level + action + arguments (object keys are always sorted in the compact JSON form)
+    //A result built for a full-access session must never be handed to a restricted one (or the other way around)
+    QJsonArray key; key.append(IN.fullaccess ? "full" : "user"); key.append(IN.args);
+    return RESPONSECACHE->fetch(sub->key, QJsonDocument(key).toJson(QJsonDocument::Compact), secs, [this, act, sock, &IN](QJsonObject *result){
+      return this->run(act, sock, IN, result);
+    }, out);
+  }
+  RestOutputStruct::ExitCode code = run(act, sock, IN, out);
+  if(code==RestOutputStruct::OK && sub->invalidators.contains(action)){ RESPONSECACHE->invalidate(sub->key); }
+  return code;
+}
+
+QJsonObject BackendTable::stats(){
+  QJsonObject out;
+  for(int i=0; i<SUBSYSTEMS.length(); i++){
+    QJsonObject obj;
+    if(SUBSYSTEMS[i]->main!=0 && SUBSYSTEMS[i]->main->calls.load()>0){
+      obj.insert(SUBSYSTEMS[i]->main->name, actionStats(SUBSYSTEMS[i]->main));
+    }
+    QHash<QString, BackendAction*>::const_iterator it = SUBSYSTEMS[i]->actions.constBegin();
+    for( ; it!=SUBSYSTEMS[i]->actions.constEnd(); ++it){
+      if(it.value()->calls.load()==0){ continue; } //never used
+      obj.insert(it.key(), actionStats(it.value()));
+    }
+    if(!obj.isEmpty()){ out.insert(SUBSYSTEMS[i]->key, obj); }
+  }
+  return out;
+}
+
+// === PRIVATE ===
+RestOutputStruct::ExitCode BackendTable::run(BackendAction *act, WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+  QElapsedTimer timer;
+  timer.start();
+  RestOutputStruct::ExitCode code = act->handler(sock, IN, out);
+  act->calls.fetchAndAddRelaxed(1);
+  act->usecs.fetchAndAddRelaxed(timer.nsecsElapsed()/1000);
+  if(code!=RestOutputStruct::OK){ act->errors.fetchAndAddRelaxed(1); }
+  if(DEBUG){ qDebug() << "Backend call:" << IN.namesp << IN.name << act->name << code << timer.elapsed() << "ms"; }
+  return code;
+}
+
+QJsonObject BackendTable::actionStats(BackendAction *act){
+  qint64 calls = act->calls.load();
+  qint64 usecs = act->usecs.load();
+  QJsonObject obj;
+  obj.insert("calls", QString::number(calls));
+  obj.insert("errors", QString::number(act->errors.load()));
+  obj.insert("total_ms", QString::number(usecs/1000));
+  obj.insert("avg_ms", QString::number( calls>0 ? (usecs/1000.0)/calls : 0, 'f', 3) );
+  obj.insert("access", act->fullAccessOnly ? "full" : "user");
+  return obj;
+}
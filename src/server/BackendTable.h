@@ -0,0 +1,86 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_BACKEND_TABLE_H
+#define _PCBSD_SYSADM_BACKEND_TABLE_H
+
+#include "globals-qt.h"
+#include "RestStructs.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+
+#include <functional>
+
+class WebSocket;
+class CapabilityRegistry;
+
+//Generic handler: gets the connection, the request, and the output arguments object to fill
+typedef std::function<RestOutputStruct::ExitCode(WebSocket*, const RestInputStruct&, QJsonObject*)> BackendHandler;
+//Simple handler: library call which turns the input arguments into a result object
+typedef QJsonObject (*BackendFunction)(QJsonObject);
+
+struct BackendAction{
+	QString name;
+	bool fullAccessOnly; //only available for sessions with full (operator) access
+	QStringList required; //argument fields which need to be present
+	BackendHandler handler;
+	//Per-action metrics
+	QAtomicInteger<qint64> calls, errors, usecs;
+};
+
+struct BackendSubsystem{
+	QString namesp, name, key; //key: "<namespace>/<name>"
+	QString fullAccess, userAccess; //access level listed through rpc/query
+	QStringList files; //files needed for the subsystem to be available
+	BackendAction *main; //handler for the whole subsystem (if it parses the "action" itself)
+	QHash<QString, BackendAction*> actions; //table of individual actions
+	//Response caching
+	QHash<QString, int> cacheSecs; //action -> seconds a successful result stays valid
+	QStringList invalidators; //actions which clear the cached results for this subsystem when they succeed
+};
+
+// == Registration-based routing table for the backend subsystems ==
+// Requests are routed by namespace -> name -> "action" argument with hash lookups.
+// Each action is declared with its access level and required arguments, and carries
+// its own call/error/time counters (exported through rpc/stats).
+class BackendTable{
+public:
+	//How the result of a simple BackendFunction is treated
+	enum RESULT_TYPE{ RESULT_ALWAYS, //always insert into the output (even if empty)
+		RESULT_SKIP_EMPTY, //only insert non-empty results (but still a valid call)
+		RESULT_REQUIRED //empty result means the request was invalid
+	};
+
+	BackendTable();
+	~BackendTable();
+
+	BackendSubsystem* addSubsystem(QString namesp, QString name, QString fullaccess, QString useraccess, QStringList files = QStringList(), BackendHandler handler = BackendHandler());
+	void addAction(BackendSubsystem *sub, QString action, bool fullonly, QStringList required, BackendHandler handler);
+	void addCall(BackendSubsystem *sub, QString action, bool fullonly, QStringList required, BackendFunction fn, RESULT_TYPE type = RESULT_ALWAYS);
+	//Cache the results of a read-only action (also works for subsystems which parse the "action" themselves)
+	// "invalidatedby" : actions within the same subsystem which change what the cached action returns
+	void setCache(BackendSubsystem *sub, QString action, int secs, QStringList invalidatedby = QStringList());
+
+	//Register all the subsystems (and their availability probes) with the capability registry
+	void registerCapabilities(CapabilityRegistry *reg);
+
+	//Find the subsystem for a request (returns 0 if unknown)
+	BackendSubsystem* find(const QString &namesp, const QString &name);
+	//Route a request to the proper handler within the subsystem
+	RestOutputStruct::ExitCode evaluate(BackendSubsystem *sub, WebSocket *sock, const RestInputStruct &IN, QJsonObject *out);
+
+	//Per-action metrics
+	QJsonObject stats();
+
+private:
+	QHash<QString, QHash<QString, BackendSubsystem*> > TABLE; //namespace -> name -> subsystem
+	QList<BackendSubsystem*> SUBSYSTEMS; //registration order
+
+	RestOutputStruct::ExitCode run(BackendAction *act, WebSocket *sock, const RestInputStruct &IN, QJsonObject *out);
+	QJsonObject actionStats(BackendAction *act);
+};
+
+#endif
@@ -0,0 +1,134 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "CapabilityRegistry.h"
+
+#define DEBUG 0
+#define REFRESHMINS 15 //periodic re-probe (in case a watched directory event is missed)
+#define CHANGEDELAYMS 5000 //wait for package installs/removals to settle before re-probing
+#define RETIRESECS 60 //keep a replaced snapshot around this long (any lookup using it is long done)
+
+CapabilityRegistry::CapabilityRegistry() : QObject(){
+  current.storeRelease(new Snapshot());
+  clock.start();
+  watcher = 0;
+  refreshTimer = delayTimer = 0;
+}
+
+CapabilityRegistry::~CapabilityRegistry(){
+  freeRetired(true);
+  delete current.loadAcquire();
+}
+
+void CapabilityRegistry::addSubsystem(QString name, QString fullaccess, QString useraccess, QStringList files){
+  Subsystem sub;
+    sub.name = name;
+    sub.full = fullaccess;
+    sub.user = useraccess;
+    sub.files = files;
+  SUBSYSTEMS << sub;
+}
+
+QString CapabilityRegistry::access(QString name, bool fullaccess){
+  const Snapshot *snap = snapshot();
+  return (fullaccess ? snap->full.value(name) : snap->user.value(name));
+}
+
+QJsonObject CapabilityRegistry::subsystems(bool fullaccess){
+  const Snapshot *snap = snapshot();
+  return (fullaccess ? snap->fullObj : snap->userObj);
+}
+
+QByteArray CapabilityRegistry::subsystemsJson(bool fullaccess){
+  const Snapshot *snap = snapshot();
+  return (fullaccess ? snap->fullJson : snap->userJson);
+}
+
+// === PUBLIC SLOTS ===
+void CapabilityRegistry::start(){
+  refresh();
+  watcher = new QFileSystemWatcher(this);
+    connect(watcher, SIGNAL(directoryChanged(const QString&)), this, SLOT(dirChanged(const QString&)) );
+  QStringList dirs = watchDirs();
+  if(!dirs.isEmpty()){ watcher->addPaths(dirs); }
+  delayTimer = new QTimer(this);
+    delayTimer->setSingleShot(true);
+    delayTimer->setInterval(CHANGEDELAYMS);
+    connect(delayTimer, SIGNAL(timeout()), this, SLOT(refresh()) );
+  refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(REFRESHMINS*60000);
+    connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()) );
+  refreshTimer->start();
+}
+
+void CapabilityRegistry::refresh(){
+  freeRetired();
+  const Snapshot *snap = probe();
+  const Snapshot *old = snapshot();
+  if(old->fullJson == snap->fullJson && old->userJson == snap->userJson){ delete snap; return; } //nothing changed
+  if(DEBUG){ qDebug() << "Subsystems changed:" << snap->fullObj.keys(); }
+  //Swap in the new snapshot - readers may still be using the old one for a moment
+  old = current.fetchAndStoreOrdered(snap);
+  retired << qMakePair(clock.elapsed(), old);
+  //Make sure any newly-created directories get watched too
+  if(watcher!=0){
+    QStringList dirs = watchDirs();
+    for(int i=0; i<dirs.length(); i++){
+      if(!watcher->directories().contains(dirs[i])){ watcher->addPath(dirs[i]); }
+    }
+  }
+}
+
+// === PRIVATE ===
+const CapabilityRegistry::Snapshot* CapabilityRegistry::snapshot(){
+  return current.loadAcquire();
+}
+
+void CapabilityRegistry::freeRetired(bool all){
+  //Lookups only hold on to a snapshot long enough to copy a value out of it
+  qint64 now = clock.elapsed();
+  while(!retired.isEmpty() && (all || now - retired.first().first > RETIRESECS*1000) ){
+    delete retired.takeFirst().second;
+  }
+}
+
+CapabilityRegistry::Snapshot* CapabilityRegistry::probe(){
+  Snapshot *snap = new Snapshot();
+  for(int i=0; i<SUBSYSTEMS.length(); i++){
+    bool ok = true;
+    for(int j=0; j<SUBSYSTEMS[i].files.length() && ok; j++){
+      QStringList opts = SUBSYSTEMS[i].files[j].split("|");
+      ok = false;
+      for(int k=0; k<opts.length() && !ok; k++){ ok = QFile::exists(opts[k]); }
+    }
+    if(!ok){ continue; }
+    snap->full.insert(SUBSYSTEMS[i].name, SUBSYSTEMS[i].full);
+    snap->user.insert(SUBSYSTEMS[i].name, SUBSYSTEMS[i].user);
+    snap->fullObj.insert(SUBSYSTEMS[i].name, SUBSYSTEMS[i].full);
+    snap->userObj.insert(SUBSYSTEMS[i].name, SUBSYSTEMS[i].user);
+  }
+  snap->fullJson = QJsonDocument(snap->fullObj).toJson(QJsonDocument::Compact);
+  snap->userJson = QJsonDocument(snap->userObj).toJson(QJsonDocument::Compact);
+  return snap;
+}
+
+QStringList CapabilityRegistry::watchDirs(){
+  //Watch the parent directories of all the probe files (catches installs/removals)
+  QStringList dirs;
+  for(int i=0; i<SUBSYSTEMS.length(); i++){
+    QStringList files = SUBSYSTEMS[i].files.join("|").split("|", QString::SkipEmptyParts);
+    for(int j=0; j<files.length(); j++){
+      QString dir = files[j].section("/",0,-2);
+      if(!dir.isEmpty() && !dirs.contains(dir) && QFile::exists(dir)){ dirs << dir; }
+    }
+  }
+  return dirs;
+}
+
+// === PRIVATE SLOTS ===
+void CapabilityRegistry::dirChanged(const QString&){
+  //Package installs touch a directory many times - wait for things to settle
+  if(delayTimer!=0){ delayTimer->start(); }
+}
@@ -0,0 +1,65 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_CAPABILITY_REGISTRY_H
+#define _PCBSD_SYSADM_CAPABILITY_REGISTRY_H
+
+#include "globals-qt.h"
+
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+
+// == Cached list of the subsystems available on this system ==
+// The subsystems are probed once at startup, and then again whenever one of the watched
+// directories changes (or the periodic timer fires). Request threads just load the current
+// snapshot pointer (no lock) and copy the value out. A replaced snapshot is only freed once it
+// has been retired for a while, so a refresh never frees a snapshot some reader is still using.
+class CapabilityRegistry : public QObject{
+	Q_OBJECT
+public:
+	CapabilityRegistry();
+	~CapabilityRegistry();
+
+	//Register a subsystem (call before start())
+	// "files" : list of files which must exist for the subsystem to be available
+	//    (use "<file1>|<file2>" for entries where any one of the files is enough)
+	void addSubsystem(QString name, QString fullaccess, QString useraccess, QStringList files = QStringList());
+
+	//Lookups (safe to use from any thread)
+	QString access(QString name, bool fullaccess); //returns an empty string if the subsystem is not available
+	QJsonObject subsystems(bool fullaccess);
+	QByteArray subsystemsJson(bool fullaccess); //pre-serialized (compact) version of subsystems()
+
+public slots:
+	void start(); //initial probe and watcher setup
+	void refresh(); //re-probe all the subsystems
+
+private:
+	struct Subsystem{
+	  QString name, full, user;
+	  QStringList files;
+	};
+	struct Snapshot{
+	  QHash<QString, QString> full, user;
+	  QJsonObject fullObj, userObj;
+	  QByteArray fullJson, userJson;
+	};
+	QList<Subsystem> SUBSYSTEMS;
+	QAtomicPointer<const Snapshot> current; //snapshots are never changed once published
+	QList< QPair<qint64, const Snapshot*> > retired; //replaced snapshots waiting to be freed (retire time, snapshot)
+	QElapsedTimer clock;
+	QFileSystemWatcher *watcher;
+	QTimer *refreshTimer, *delayTimer;
+
+	const Snapshot* snapshot(); //current snapshot (only valid for the duration of a lookup)
+	void freeRetired(bool all = false);
+	Snapshot* probe();
+	QStringList watchDirs();
+
+private slots:
+	void dirChanged(const QString&);
+};
+
+#endif
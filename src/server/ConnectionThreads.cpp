@@ -0,0 +1,121 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "ConnectionThreads.h"
+#include "WebSocket.h"
+#include "AuthorizationManager.h"
+
+#define DEBUG 0
+
+// === CONNECTION HOST ===
+ConnectionHost::ConnectionHost(AuthorizationManager *auth) : QObject(){
+  AUTH = auth;
+}
+
+ConnectionHost::~ConnectionHost(){
+
+}
+
+WebSocket* ConnectionHost::addWebSocket(QWebSocket *ws, QString ID){
+  //Runs in the I/O thread: the new connection (and all its timers) belong to this thread
+  ws->setParent(this);
+  return new WebSocket(this, ws, ID, AUTH);
+}
+
+WebSocket* ConnectionHost::addTcpSocket(QSslSocket *ss, QString ID){
+  //Runs in the I/O thread: the TLS handshake gets started from here
+  ss->setParent(this);
+  return new WebSocket(this, ss, ID, AUTH);
+}
+
+WebSocket* ConnectionHost::addLocalSocket(QLocalSocket *ls, QString ID){
+  //Runs in the I/O thread: the peer credentials get read from here (the login itself runs on the request lane)
+  ls->setParent(this);
+  return new WebSocket(this, ls, ID, AUTH);
+}
+
+// === THREAD POOL ===
+ConnectionThreads::ConnectionThreads(AuthorizationManager *auth, int num){
+  qRegisterMetaType<QWebSocket*>("QWebSocket*");
+  qRegisterMetaType<QSslSocket*>("QSslSocket*");
+  qRegisterMetaType<QLocalSocket*>("QLocalSocket*");
+  qRegisterMetaType<WebSocket*>("WebSocket*");
+  if(num<=0){ num = QThread::idealThreadCount(); }
+  if(num<1){ num = 1; }
+  picked = -1;
+  for(int i=0; i<num; i++){
+    QThread *thread = new QThread();
+      thread->setObjectName("sysadm-io-"+QString::number(i));
+    ConnectionHost *host = new ConnectionHost(auth);
+      host->moveToThread(thread);
+    QObject::connect(thread, SIGNAL(finished()), host, SLOT(deleteLater()) );
+    thread->start();
+    THREADS << thread;
+    HOSTS << host;
+    LOAD << 0;
+  }
+  if(DEBUG){ qDebug() << "Started I/O threads:" << num; }
+}
+
+ConnectionThreads::~ConnectionThreads(){
+  for(int i=0; i<THREADS.length(); i++){
+    THREADS[i]->quit();
+    THREADS[i]->wait();
+    delete THREADS[i];
+  }
+}
+
+int ConnectionThreads::count(){
+  return THREADS.length();
+}
+
+WebSocket* ConnectionThreads::addWebSocket(QWebSocket *ws, QString ID){
+  int num = pickThread();
+  ws->setParent(0);
+  ws->moveToThread(THREADS[num]);
+  WebSocket *sock = 0;
+  //Wait for the host to create the connection (quick - just sets up the signals/timers)
+  QMetaObject::invokeMethod(HOSTS[num], "addWebSocket", Qt::BlockingQueuedConnection, Q_RETURN_ARG(WebSocket*, sock), Q_ARG(QWebSocket*, ws), Q_ARG(QString, ID) );
+  if(sock!=0){ LOAD[num]++; ASSIGNED.insert(sock, num); }
+  return sock;
+}
+
+WebSocket* ConnectionThreads::addTcpSocket(QSslSocket *ss, QString ID){
+  int num = pickThread();
+  ss->setParent(0);
+  ss->moveToThread(THREADS[num]);
+  WebSocket *sock = 0;
+  QMetaObject::invokeMethod(HOSTS[num], "addTcpSocket", Qt::BlockingQueuedConnection, Q_RETURN_ARG(WebSocket*, sock), Q_ARG(QSslSocket*, ss), Q_ARG(QString, ID) );
+  if(sock!=0){ LOAD[num]++; ASSIGNED.insert(sock, num); }
+  return sock;
+}
+
+WebSocket* ConnectionThreads::addLocalSocket(QLocalSocket *ls, QString ID){
+  int num = pickThread();
+  ls->setParent(0);
+  ls->moveToThread(THREADS[num]);
+  WebSocket *sock = 0;
+  QMetaObject::invokeMethod(HOSTS[num], "addLocalSocket", Qt::BlockingQueuedConnection, Q_RETURN_ARG(WebSocket*, sock), Q_ARG(QLocalSocket*, ls), Q_ARG(QString, ID) );
+  if(sock!=0){ LOAD[num]++; ASSIGNED.insert(sock, num); }
+  return sock;
+}
+
+void ConnectionThreads::socketClosed(WebSocket *sock){
+  if(!ASSIGNED.contains(sock)){ return; } //not one of ours (bridge connection)
+  int num = ASSIGNED.take(sock);
+  if(LOAD[num]>0){ LOAD[num]--; }
+}
+
+// === PRIVATE ===
+int ConnectionThreads::pickThread(){
+  //Least-loaded thread, starting the search after the last one used (round-robin between equal loads)
+  int best = -1;
+  for(int i=1; i<=THREADS.length(); i++){
+    int num = (picked+i) % THREADS.length();
+    if(best<0 || LOAD[num]<LOAD[best]){ best = num; }
+  }
+  picked = best;
+  return best;
+}
@@ -0,0 +1,57 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_REST_SERVER_CONNECTION_THREADS_H
+#define _PCBSD_REST_SERVER_CONNECTION_THREADS_H
+
+#include "globals-qt.h"
+
+class WebSocket;
+class AuthorizationManager;
+
+// == Per-thread connection host ==
+// Lives in one I/O thread and creates the WebSocket wrappers there,
+//  so all the socket/timer handling for the connection runs in that thread's event loop
+class ConnectionHost : public QObject{
+	Q_OBJECT
+public:
+	ConnectionHost(AuthorizationManager *auth);
+	~ConnectionHost();
+
+public slots:
+	WebSocket* addWebSocket(QWebSocket *ws, QString ID);
+	WebSocket* addTcpSocket(QSslSocket *ss, QString ID);
+	WebSocket* addLocalSocket(QLocalSocket *ls, QString ID);
+
+private:
+	AuthorizationManager *AUTH;
+};
+
+// == I/O thread pool ==
+// Spreads the accepted connections across a number of event-loop threads (least-loaded first)
+// NOTE: Only used from the main (server) thread - the thread loads are updated as connections are added/closed
+class ConnectionThreads{
+public:
+	ConnectionThreads(AuthorizationManager *auth, int num); //num: number of threads (0 or less: one per CPU)
+	~ConnectionThreads();
+
+	int count(); //number of I/O threads
+	//Hand a new connection over to one of the I/O threads (the socket must not have a parent)
+	WebSocket* addWebSocket(QWebSocket *ws, QString ID);
+	WebSocket* addTcpSocket(QSslSocket *ss, QString ID);
+	WebSocket* addLocalSocket(QLocalSocket *ls, QString ID);
+	void socketClosed(WebSocket *sock); //connection is going away - update the thread load
+
+private:
+	QList<QThread*> THREADS;
+	QList<ConnectionHost*> HOSTS;
+	QList<int> LOAD; //number of open connections per thread
+	QHash<WebSocket*, int> ASSIGNED; //connection -> thread index
+	int picked; //last thread used (ties go round-robin)
+
+	int pickThread();
+};
+
+#endif
@@ -0,0 +1,92 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "CursorTable.h"
+
+// === RESULT CURSOR ===
+ResultCursor::ResultCursor(sysadm::RowSource *src){
+  SOURCE = src;
+  havenext = SOURCE->next(&nextkey, &nextrow);
+  lastused = 0;
+}
+
+ResultCursor::~ResultCursor(){
+  delete SOURCE;
+}
+
+bool ResultCursor::fetch(int limit, QJsonObject *page){
+  for(int i=0; i<limit && havenext; i++){
+    page->insert(nextkey, nextrow);
+    havenext = SOURCE->next(&nextkey, &nextrow);
+  }
+  return havenext;
+}
+
+// === CURSOR TABLE ===
+CursorTable::CursorTable(){
+  clock.start();
+}
+
+CursorTable::~CursorTable(){
+  qDeleteAll(CURSORS);
+}
+
+QString CursorTable::open(QString owner, ResultCursor *cursor){
+  QMutexLocker lock(&mutex);
+  expire();
+  int count = 0;
+  QHash<QString, ResultCursor*>::const_iterator it = CURSORS.constBegin();
+  for( ; it!=CURSORS.constEnd(); ++it){
+    if(it.value()->owner==owner){ count++; }
+  }
+  if(count>=CURSOR_MAX_PER_OWNER){ return ""; }
+  QString token = QUuid::createUuid().toString().remove("{").remove("}");
+  cursor->owner = owner;
+  cursor->lastused = clock.elapsed();
+  CURSORS.insert(token, cursor);
+  return token;
+}
+
+ResultCursor* CursorTable::take(QString token, QString owner){
+  QMutexLocker lock(&mutex);
+  expire();
+  ResultCursor *cursor = CURSORS.value(token, 0);
+  if(cursor==0 || cursor->owner!=owner){ return 0; }
+  CURSORS.remove(token);
+  return cursor;
+}
+
+void CursorTable::putBack(QString token, ResultCursor *cursor){
+  QMutexLocker lock(&mutex);
+  cursor->lastused = clock.elapsed();
+  CURSORS.insert(token, cursor);
+}
+
+void CursorTable::dropOwner(QString owner){
+  QMutexLocker lock(&mutex);
+  QHash<QString, ResultCursor*>::iterator it = CURSORS.begin();
+  while(it!=CURSORS.end()){
+    if(it.value()->owner==owner || it.value()->owner.startsWith(owner+"::::")){
+      delete it.value();
+      it = CURSORS.erase(it);
+    }else{
+      ++it;
+    }
+  }
+}
+
+// === PRIVATE ===
+void CursorTable::expire(){
+  qint64 cutoff = clock.elapsed() - CURSOR_IDLE_SECS*1000;
+  QHash<QString, ResultCursor*>::iterator it = CURSORS.begin();
+  while(it!=CURSORS.end()){
+    if(it.value()->lastused < cutoff){
+      delete it.value();
+      it = CURSORS.erase(it);
+    }else{
+      ++it;
+    }
+  }
+}
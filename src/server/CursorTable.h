@@ -0,0 +1,68 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_CURSOR_TABLE_H
+#define _PCBSD_SYSADM_CURSOR_TABLE_H
+
+#include "globals-qt.h"
+#include "library/sysadm-rowsource.h"
+
+#include <QMutex>
+#include <QElapsedTimer>
+
+#define CURSOR_IDLE_SECS 300 //open cursors which are not read for this long get discarded
+#define CURSOR_MAX_PER_OWNER 8 //max number of open cursors for a single client
+#define CURSOR_DEFAULT_PAGE 100 //rows per page if the client does not give a (valid) limit
+#define CURSOR_MAX_PAGE 5000 //max rows per page
+
+//Function which starts up a (paged) listing for the given request arguments (0: invalid arguments)
+typedef sysadm::RowSource* (*RowFactory)(QJsonObject);
+
+// == Open result cursor ==
+// Wraps a row source with a single-row lookahead (so a page knows if anything comes after it)
+class ResultCursor{
+public:
+	ResultCursor(sysadm::RowSource *src);
+	~ResultCursor();
+
+	//Read the next page of rows into the object - returns true if there are more rows after this page
+	bool fetch(int limit, QJsonObject *page);
+
+private:
+	sysadm::RowSource *SOURCE;
+	bool havenext;
+	QString nextkey;
+	QJsonValue nextrow;
+
+	friend class CursorTable;
+	QString owner;
+	qint64 lastused; //msecs on the table clock
+};
+
+// == Thread-safe table of open cursors (token -> cursor) ==
+// A cursor is taken out of the table while a page is read, so it is only ever used by one thread at a time.
+class CursorTable{
+public:
+	CursorTable();
+	~CursorTable();
+
+	//Store a new cursor - returns the token (empty if the owner has too many cursors open already)
+	QString open(QString owner, ResultCursor *cursor);
+	//Take the cursor out of the table for reading (0: invalid token or wrong owner)
+	ResultCursor* take(QString token, QString owner);
+	//Put a cursor back after reading a page
+	void putBack(QString token, ResultCursor *cursor);
+	//Close all the cursors for an owner and any of its sub-owners ("<owner>::::<sub>")
+	void dropOwner(QString owner);
+
+private:
+	QMutex mutex;
+	QHash<QString, ResultCursor*> CURSORS;
+	QElapsedTimer clock;
+
+	void expire(); //NOTE: mutex needs to be locked when calling this
+};
+
+#endif
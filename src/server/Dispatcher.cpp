@@ -14,6 +14,7 @@
 DProcess::DProcess(QObject *parent) : QProcess(parent){
     //Setup the process
     bool notify = false;
+    journalSeq = -1;
     uptimer = new QTimer(this);
     connect(uptimer, SIGNAL(timeout()), this, SLOT(emitUpdate()) );
     this->setProcessEnvironment(QProcessEnvironment::systemEnvironment());
@@ -123,6 +124,10 @@ void DProcess::emitUpdate(){
 // Dispatcher Class
 // ================================
 Dispatcher::Dispatcher(){
+  jobCount = 0;
+  syncTimer = new QTimer(this);
+    syncTimer->setSingleShot(true);
+  connect(syncTimer, SIGNAL(timeout()), this, SLOT(syncJournal()) );
   qRegisterMetaType<Dispatcher::PROC_QUEUE>("Dispatcher::PROC_QUEUE");
   connect(this, SIGNAL(mkprocs(Dispatcher::PROC_QUEUE, DProcess*)), this, SLOT(mkProcs(Dispatcher::PROC_QUEUE, DProcess*)) );
   connect(this, SIGNAL(checkProcs()), this, SLOT(CheckQueues()) );
@@ -205,12 +210,46 @@ void Dispatcher::start(QString queuefile){
   //connect(this, SIGNAL(mkprocs(Dispatcher::PROC_QUEUE, DProcess*)), this, SLOT(mkProcs(Dispatcher::PROC_QUEUE, DProcess*)) );
   //connect(this, SIGNAL(checkProcs()), this, SLOT(checkQueues()) );
   //load any previously-unrun processes
-  // TO DO
+  queue_file = queuefile;
+  if(queue_file.isEmpty()){ return; }
+  syncTimer->setInterval(Dispatch_SyncMSecs);
+  journal.setSyncBatch(Dispatch_SyncMSecs>0 ? 256 : 1); //0: sync every record right away
+  QList<DispatcherJournal::Job> pending;
+  if(!journal.open(queue_file, &pending)){
+    qDebug() << "[WARNING] Dispatcher queue could not be loaded - queued jobs will not survive a restart:" << queue_file;
+    return;
+  }
+  int restored = 0;
+  for(int i=0; i<pending.length(); i++){
+    if(pending[i].started){
+      //Was already running when the server went down - never run a command twice, just log it
+      QJsonObject log;
+        log.insert("process_id", pending[i].id);
+        log.insert("cmd_list", QJsonArray::fromStringList(pending[i].cmds));
+        log.insert("state", "interrupted");
+        log.insert("time_finished", QDateTime::currentDateTime().toString(Qt::ISODate));
+      LogManager::log(LogManager::DISPATCH, log);
+      journal.finished(pending[i].seq);
+      continue;
+    }
+    PROC_QUEUE queue = NO_QUEUE;
+    if(pending[i].queue>0 && pending[i].queue<enum_length){ queue = static_cast<PROC_QUEUE>(pending[i].queue); }
+    DProcess *P = createProcess(pending[i].id, pending[i].cmds, pending[i].workdir);
+    P->journalSeq = pending[i].seq; //already in the journal
+    mkProcs(queue, P);
+    restored++;
+  }
+  journal.sync();
+  if(!pending.isEmpty()){ qDebug() << "Dispatcher: restored" << restored << "queued jobs," << pending.length()-restored << "interrupted"; }
 }
 
 void Dispatcher::stop(){
   //save any currently-unrun processes for next time the server starts
-  // TO DO
+  // (they are already in the journal - just leave a compact, synced file behind)
+  if(!journal.isOpen()){ return; }
+  syncTimer->stop();
+  journal.compact();
+  journal.close();
 }
 
 //Overloaded Main Calling Functions (single command, or multiple in-order commands)
@@ -243,6 +282,10 @@ DProcess* Dispatcher::createProcess(QString ID, QStringList cmds, QString workdi
   return P;
 }
 
+void Dispatcher::journalWritten(){
+  if(journal.unsynced()>0 && !syncTimer->isActive()){ syncTimer->start(); }
+}
+
 // === PRIVATE SLOTS ===
 void Dispatcher::mkProcs(Dispatcher::PROC_QUEUE queue, DProcess *P){
   //qDebug() << "mkProcs()";
@@ -250,6 +293,11 @@ void Dispatcher::mkProcs(Dispatcher::PROC_QUEUE queue, DProcess *P){
   list << P;
   //qDebug() << " - add to queue:" << queue;
   HASH.insert(queue,list);
+  jobCount.ref();
+  if(P->journalSeq<0){
+    P->journalSeq = journal.queued(queue, P->ID, P->cmds, P->workingDirectory());
+    journalWritten();
+  }
   connect(P, SIGNAL(ProcFinished(QString, QJsonObject)), this, SLOT(ProcFinished(QString, QJsonObject)) );
   connect(P, SIGNAL(ProcUpdate(QString, QJsonObject)), this, SLOT(ProcUpdated(QString, QJsonObject)) );
   P->procReady();
@@ -293,12 +341,15 @@ for(int i=0; i<enum_length; i++){
 	if( !list[j]->isRunning() ){
 	  if(list[j]->isDone() ){
 	    //qDebug() << "Remove Finished Proc:" << list[j]->ID;
+	    journal.finished(list[j]->journalSeq);
 	    list.takeAt(j)->deleteLater();
+	    jobCount.deref();
 	    HASH.insert(queue, list); //replace the list in the hash since it changed
 	    j--;
 	  }else{
 	    //Need to start this one - has not run yet
 	    //qDebug() << "Call Start Proc:" << list[j]->ID;
+	    journal.started(list[j]->journalSeq);
 	    emit DispatchStarting(list[j]->ID);
 	    list[j]->startProc();
 	  }
@@ -307,4 +358,10 @@ for(int i=0; i<enum_length; i++){
     }
 
   } //end loop over queue types
+  journalWritten();
 }
+
+void Dispatcher::syncJournal(){
+  journal.sync();
+}
+
@@ -8,6 +8,10 @@
 
 #include "globals-qt.h"
 
+#include <QAtomicInteger>
+
+#include "DispatcherJournal.h"
+
 
 // == Simple Process class for running sequential commands ==
 class DProcess : public QProcess{
@@ -23,6 +27,7 @@ public:
 	bool success;
 	//QDateTime t_started, t_finished;
 	QStringList rawcmds; //copy of cmds at start of process
+	qint64 journalSeq; //sequence number in the dispatcher journal (-1: not journaled)
 
 	//Get the current process log (can be run during/after the process runs)
 	QJsonObject getProcLog();
@@ -64,6 +69,7 @@ public:
 	QJsonObject listJobs();
 	QJsonObject killJobs(QStringList ids);
 	bool isJobActive(QString ID); //returns true if a job with this ID is running/pending
+	int queueDepth(){ return jobCount.load(); } //number of queued jobs (pending/running) - safe from any thread
 
 public slots:
 	//Main start/stop
@@ -80,8 +86,14 @@ private:
 	// Queue file
 	QString queue_file;
 
+	DispatcherJournal journal; //write-ahead journal of the queues (only open between start() and stop())
+	QTimer *syncTimer; //batches the journal fsync() calls
+
 	//Internal lists
 	QHash<PROC_QUEUE, QList<DProcess*> > HASH;
+	QAtomicInteger<int> jobCount; //total number of processes in HASH
+
+	void journalWritten(); //schedule the next journal sync
 
 	//Simplification routine for setting up a process
 	DProcess* createProcess(QString ID, QStringList cmds, QString workdir = "");
@@ -96,6 +108,7 @@ private slots:
 	void ProcFinished(QString ID, QJsonObject log);
 	void ProcUpdated(QString ID, QJsonObject log);
 	void CheckQueues();
+	void syncJournal();
 
 signals:
 	//Main signals
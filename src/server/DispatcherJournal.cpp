@@ -0,0 +1,206 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "DispatcherJournal.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDebug>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEBUG 0
+
+DispatcherJournal::DispatcherJournal(){
+  fd = -1;
+  nextSeq = 1;
+  syncBatch = 256;
+  compactThreshold = 4096;
+  unsyncedRecords = fileRecords = dropped = 0;
+}
+
+DispatcherJournal::~DispatcherJournal(){
+  close();
+}
+
+bool DispatcherJournal::open(QString path, QList<Job> *pending){
+  close();
+  filepath = path;
+  LIVE.clear();
+  nextSeq = 1;
+  dropped = 0;
+  //Replay the existing journal (if any)
+  QFile file(path);
+  if(file.exists()){
+    if(!file.open(QIODevice::ReadOnly)){ qDebug() << "[WARNING] Could not read the dispatcher journal:" << path; return false; }
+    QList<QByteArray> lines = file.readAll().split('\n');
+    file.close();
+    for(int i=0; i<lines.length(); i++){
+      if(lines[i].isEmpty()){ continue; }
+      QJsonDocument doc = QJsonDocument::fromJson(lines[i]);
+      QJsonObject rec = doc.object();
+      qint64 seq = (qint64) rec.value("seq").toDouble(-1);
+      QString op = rec.value("op").toString();
+      if(!doc.isObject() || seq<0){ dropped++; continue; } //torn/garbage record (crash in the middle of a write)
+      if(seq>=nextSeq){ nextSeq = seq+1; }
+      if(op=="queued"){
+        Job job;
+          job.seq = seq;
+          job.queue = rec.value("queue").toInt();
+          job.id = rec.value("id").toString();
+          job.workdir = rec.value("dir").toString();
+          job.started = false;
+        QJsonArray cmds = rec.value("cmds").toArray();
+        for(int j=0; j<cmds.count(); j++){ job.cmds << cmds[j].toString(); }
+        LIVE.insert(seq, job);
+      }else if(op=="started"){
+        if(LIVE.contains(seq)){ LIVE[seq].started = true; }
+      }else if(op=="finished"){
+        LIVE.remove(seq);
+      }else{
+        dropped++;
+      }
+    }
+    if(DEBUG){ qDebug() << "Dispatcher journal replayed:" << path << "records:" << lines.length() << "unfinished:" << LIVE.count() << "dropped:" << dropped; }
+  }else{
+    QDir dir;
+    dir.mkpath(QFileInfo(path).absolutePath());
+  }
+  if(pending!=0){ *pending = LIVE.values(); }
+  //Start over with a clean file (this also gets rid of any torn record at the end)
+  return compact();
+}
+
+void DispatcherJournal::close(){
+  if(fd<0){ return; }
+  sync();
+  ::close(fd);
+  fd = -1;
+}
+
+void DispatcherJournal::setSyncBatch(int records){
+  syncBatch = qMax(1, records);
+}
+
+void DispatcherJournal::setCompactThreshold(int records){
+  compactThreshold = qMax(16, records);
+}
+
+qint64 DispatcherJournal::queued(int queue, QString id, QStringList cmds, QString workdir){
+  if(fd<0){ return -1; }
+  Job job;
+    job.seq = nextSeq;
+    job.queue = queue;
+    job.id = id;
+    job.cmds = cmds;
+    job.workdir = workdir;
+    job.started = false;
+  nextSeq++;
+  LIVE.insert(job.seq, job);
+  append(queuedRecord(job));
+  return job.seq;
+}
+
+void DispatcherJournal::started(qint64 seq){
+  if(fd<0 || !LIVE.contains(seq) || LIVE[seq].started){ return; }
+  LIVE[seq].started = true;
+  append(stateRecord("started", seq));
+}
+
+void DispatcherJournal::finished(qint64 seq){
+  if(fd<0 || !LIVE.contains(seq)){ return; }
+  LIVE.remove(seq);
+  append(stateRecord("finished", seq));
+  if(fileRecords - LIVE.count() >= compactThreshold){ compact(); }
+}
+
+bool DispatcherJournal::sync(){
+  if(fd<0 || unsyncedRecords==0){ return true; }
+  bool ok = (0==::fsync(fd));
+  unsyncedRecords = 0;
+  if(!ok){ qDebug() << "[WARNING] Could not sync the dispatcher journal:" << filepath << strerror(errno); }
+  return ok;
+}
+
+bool DispatcherJournal::compact(){
+  if(filepath.isEmpty()){ return false; }
+  //Write the live jobs into a new file, then move it over the old one
+  QByteArray tmppath = QFile::encodeName(filepath+".new");
+  int nfd = ::open(tmppath.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+  if(nfd<0){ qDebug() << "[WARNING] Could not write the dispatcher journal:" << filepath+".new" << strerror(errno); return false; }
+  QByteArray data;
+  int records = 0;
+  for(QMap<qint64, Job>::const_iterator it = LIVE.constBegin(); it!=LIVE.constEnd(); ++it){
+    data.append(queuedRecord(it.value()));
+    records++;
+    if(it.value().started){ data.append(stateRecord("started", it.key())); records++; }
+  }
+  if(!writeAll(nfd, data) || 0!=::fsync(nfd) || 0!=::rename(tmppath.constData(), QFile::encodeName(filepath).constData()) ){
+    qDebug() << "[WARNING] Could not compact the dispatcher journal:" << filepath << strerror(errno);
+    ::close(nfd);
+    ::unlink(tmppath.constData());
+    return false;
+  }
+  //Make the rename itself durable
+  int dirfd = ::open(QFile::encodeName(QFileInfo(filepath).absolutePath()).constData(), O_RDONLY | O_CLOEXEC);
+  if(dirfd>=0){ ::fsync(dirfd); ::close(dirfd); }
+  if(fd>=0){ ::close(fd); }
+  fd = nfd; //already points at the renamed file (append mode)
+  fileRecords = records;
+  unsyncedRecords = 0;
+  if(DEBUG){ qDebug() << "Dispatcher journal compacted:" << filepath << "live jobs:" << LIVE.count(); }
+  return true;
+}
+
+// === PRIVATE ===
+bool DispatcherJournal::append(const QByteArray &line){
+  if(!writeAll(fd, line)){
+    //Failed/partial write - rewrite the file from the current state so no record gets glued onto a torn one
+    qDebug() << "[WARNING] Could not write to the dispatcher journal:" << filepath << strerror(errno);
+    return compact();
+  }
+  fileRecords++;
+  unsyncedRecords++;
+  if(unsyncedRecords>=syncBatch){ sync(); }
+  return true;
+}
+
+bool DispatcherJournal::writeAll(int fildes, const QByteArray &data){
+  const char *ptr = data.constData();
+  qint64 left = data.size();
+  while(left>0){
+    ssize_t num = ::write(fildes, ptr, left);
+    if(num<0){
+      if(errno==EINTR){ continue; }
+      return false;
+    }
+    ptr += num;
+    left -= num;
+  }
+  return true;
+}
+
+QByteArray DispatcherJournal::queuedRecord(const Job &job){
+  QJsonObject rec;
+    rec.insert("op", "queued");
+    rec.insert("seq", (double) job.seq);
+    rec.insert("queue", job.queue);
+    rec.insert("id", job.id);
+    rec.insert("cmds", QJsonArray::fromStringList(job.cmds));
+    if(!job.workdir.isEmpty()){ rec.insert("dir", job.workdir); }
+  return QJsonDocument(rec).toJson(QJsonDocument::Compact).append('\n');
+}
+
+QByteArray DispatcherJournal::stateRecord(QString op, qint64 seq){
+  //Fixed layout - no need to go through QJsonDocument for these
+  return QString("{\"op\":\"%1\",\"seq\":%2}\n").arg(op).arg(seq).toUtf8();
+}
@@ -0,0 +1,76 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_DISPATCH_JOURNAL_H
+#define _PCBSD_SYSADM_DISPATCH_JOURNAL_H
+
+//Plain Qt core/POSIX only (no server globals) so the tests/dispatcher-journal tool can build it
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QByteArray>
+
+// == Write-ahead journal for the dispatcher queues ==
+// Append-only file with one JSON record per line:
+//   {"op":"queued","seq":<N>,"queue":<PROC_QUEUE>,"id":<job ID>,"cmds":[...],"dir":<working dir>}
+//   {"op":"started","seq":<N>}
+//   {"op":"finished","seq":<N>}
+// Every record goes to the file right away (a crash of the server does not lose it), but the fsync()
+//  is batched: sync() gets called on a timer by the dispatcher, or automatically once too many records are waiting.
+// Opening the journal replays it and rewrites it with only the unfinished jobs (a torn record at the end
+//  from a crash/power loss is dropped), and it gets compacted the same way whenever the dead records pile up.
+// Not thread-safe: the dispatcher only uses it from its own thread.
+class DispatcherJournal{
+public:
+	struct Job{
+	  qint64 seq; //journal sequence number (unique for every job queued)
+	  int queue;
+	  QString id, workdir;
+	  QStringList cmds;
+	  bool started; //job was already running when the journal was last written
+	};
+
+	DispatcherJournal();
+	~DispatcherJournal(); //syncs and closes the file
+
+	//Open (or create) the journal file and replay it
+	// - pending: all the unfinished jobs in the order they were queued
+	bool open(QString path, QList<Job> *pending = 0);
+	void close();
+	bool isOpen(){ return (fd>=0); }
+	QString path(){ return filepath; }
+
+	//fsync() automatically once this many records are waiting (1: every record, default: 256)
+	void setSyncBatch(int records);
+	//Compact once the file holds this many more records than live jobs (default: 4096)
+	void setCompactThreshold(int records);
+
+	//Job transitions (the "queued" one returns the new sequence number, -1 if the journal is not open)
+	qint64 queued(int queue, QString id, QStringList cmds, QString workdir = "");
+	void started(qint64 seq);
+	void finished(qint64 seq);
+
+	bool sync(); //fsync() any waiting records
+	int unsynced(){ return unsyncedRecords; }
+	bool compact(); //rewrite the file with only the live jobs
+	int liveJobs(){ return LIVE.count(); }
+	int droppedRecords(){ return dropped; } //unreadable records skipped by the last open()
+
+private:
+	int fd;
+	QString filepath;
+	QMap<qint64, Job> LIVE; //seq -> unfinished job (sorted = queue order)
+	qint64 nextSeq;
+	int syncBatch, compactThreshold;
+	int unsyncedRecords, fileRecords, dropped;
+
+	bool append(const QByteArray &line);
+	bool writeAll(int fildes, const QByteArray &data);
+	QByteArray queuedRecord(const Job &job);
+	QByteArray stateRecord(QString op, qint64 seq);
+};
+
+#endif
@@ -6,11 +6,13 @@
 #include "EventWatcher.h"
 
 #include "globals.h"
+#include "RestStructs.h"
 #include "library/sysadm-general.h"
 #include "library/sysadm-zfs.h"
 #include "library/sysadm-update.h"
 #include "library/sysadm-systemmanager.h"
 #include "library/sysadm-pkg.h"
+#include "library/sysadm-systemprobe.h"
 
 // === PUBLIC ===
 EventWatcher::EventWatcher(){
@@ -67,8 +69,60 @@ QJsonValue EventWatcher::lastEvent(EVENT_TYPE type){
   else{ return QJsonValue(); }
 }
 
+void EventWatcher::subscribe(EVENT_TYPE type, QObject *sub, bool cbor){
+  if(type==BADEVENT || sub==0){ return; }
+  QMutexLocker lock(&subMutex);
+  if(!SUBSCRIBERS[type].contains(sub)){ SUBSCRIBERS[type] << sub; }
+  if(cbor && !CBORSUBS.contains(sub)){ CBORSUBS << sub; }
+  else if(!cbor){ CBORSUBS.removeAll(sub); }
+}
+
+void EventWatcher::unsubscribe(EVENT_TYPE type, QObject *sub){
+  QMutexLocker lock(&subMutex);
+  if(SUBSCRIBERS.contains(type)){ SUBSCRIBERS[type].removeAll(sub); }
+}
+
+void EventWatcher::unsubscribeAll(QObject *sub){
+  QMutexLocker lock(&subMutex);
+  QHash<unsigned int, QList<QObject*> >::iterator it = SUBSCRIBERS.begin();
+  for( ; it!=SUBSCRIBERS.end(); ++it){ it.value().removeAll(sub); }
+  CBORSUBS.removeAll(sub);
+}
+
+int EventWatcher::subscriberCount(EVENT_TYPE type){
+  QMutexLocker lock(&subMutex);
+  return SUBSCRIBERS.value(type).length();
+}
+
+QByteArray EventWatcher::eventMessage(EVENT_TYPE type, QJsonValue msg, bool cbor){
+  RestOutputStruct out;
+    out.CODE = RestOutputStruct::OK;
+    out.in_struct.cbor = cbor;
+    out.in_struct.namesp = "events";
+    out.in_struct.name = typeToString(type);
+    out.out_args = msg;
+  return out.assembleMessage();
+}
+
 // === PRIVATE ===
 
+void EventWatcher::sendEvent(EVENT_TYPE type, QJsonValue msg){
+  emit NewEvent(type, msg);
+  //Only assemble the message once - all the subscribers share the same (read-only) buffer
+  QMutexLocker lock(&subMutex);
+  const QList<QObject*> subs = SUBSCRIBERS.value(type);
+  if(subs.isEmpty()){ return; } //nobody listening
+  QByteArray raw, rawcbor; //assembled on first use (once per encoding)
+  //qDebug() << "Send Event:" << typeToString(type) << subs.length() << "subscribers";
+  //NOTE: the lock is held until all the messages are queued up (a subscriber cannot be destroyed in the meantime)
+  for(int i=0; i<subs.length(); i++){
+    bool cbor = CBORSUBS.contains(subs[i]);
+    if(cbor && rawcbor.isEmpty()){ rawcbor = eventMessage(type, msg, true); }
+    else if(!cbor && raw.isEmpty()){ raw = eventMessage(type, msg); }
+    QMetaObject::invokeMethod(subs[i], "EventMessage", Qt::QueuedConnection, Q_ARG(EventWatcher::EVENT_TYPE, type), Q_ARG(QByteArray, cbor ? rawcbor : raw) );
+  }
+}
+
 void EventWatcher::sendLPEvent(QString system, int priority, QString msg){
   QJsonObject obj;
   obj.insert("message",msg);
@@ -77,7 +131,7 @@ void EventWatcher::sendLPEvent(QString system, int priority, QString msg){
   HASH.insert(LIFEPRESERVER, obj);
   //qDebug() << "New LP Event Object:" << obj;
   LogManager::log(LogManager::EV_LP, obj);
-  if(!starting){ emit NewEvent(LIFEPRESERVER, obj); }
+  if(!starting){ sendEvent(LIFEPRESERVER, obj); }
 }
 
 // === General Purpose Functions
@@ -116,13 +170,13 @@ void EventWatcher::DispatchStarting(QString ID){
   obj.insert("state", "running");
   LogManager::log(LogManager::EV_DISPATCH, obj);
   //qDebug() << "Got Dispatch starting: sending event...";
-  emit NewEvent(DISPATCHER, obj);
+  sendEvent(DISPATCHER, obj);
 }
 
 void EventWatcher::DispatchEvent(QJsonObject obj){
   LogManager::log(LogManager::EV_DISPATCH, obj);
   //qDebug() << "Got Dispatch Finished: sending event...";
-  emit NewEvent(DISPATCHER, obj);
+  sendEvent(DISPATCHER, obj);
 }
 
 // === PRIVATE SLOTS ===
@@ -333,7 +387,9 @@ void EventWatcher::CheckSystemState(){
   // Query the system, check how things are running
 
   // First up, get the hostname
-  QString newhostname = sysadm::General::RunCommand("hostname").simplified();
+  sysadm::SystemInfo sysinfo;
+  sysadm::SystemProbe::instance()->system(&sysinfo);
+  QString newhostname = sysinfo.hostname;
   if ( newhostname != oldhostname )
   {
     // Interesting, hostname changed, lets notify
@@ -344,8 +400,15 @@ void EventWatcher::CheckSystemState(){
   }
   obj.insert("hostname",oldhostname);
 
-  //Next Check zpools
-  QJsonObject zpools = sysadm::ZFS::zpool_list();
+  //CPU/memory load: the CPU sampler history (busy % per CPU plus the 1/10/60 second averages) and the in-process memory probe
+  QJsonObject cpu = sysadm::SysMgmt::cpuPercentage();
+  if(!cpu.isEmpty()){ obj.insert("cpu", cpu); }
+  QJsonObject mem = sysadm::SysMgmt::memoryStats();
+  if(!mem.isEmpty()){ obj.insert("memory", mem); }
+
+  //Next Check zpools (the metrics history samples these every minute - only run "zpool list" if it has nothing)
+  QJsonObject zpools = METRICS->zpools();
+  if(zpools.isEmpty()){ zpools = sysadm::ZFS::zpool_list(); }
   if(!zpools.isEmpty()){
     //Scan each pool for any bad indicators
     QStringList pools = zpools.keys();
@@ -421,5 +484,5 @@ void EventWatcher::CheckSystemState(){
   // Log and send out event
   LogManager::log(LogManager::EV_STATE, obj);
   HASH.insert(SYSSTATE, obj);
-  emit NewEvent(SYSSTATE, obj);
+  sendEvent(SYSSTATE, obj);
 }
@@ -8,6 +8,8 @@
 
 #include "globals-qt.h"
 
+#include <QMutex>
+
 //#define DISPATCHWORKING QString("/var/tmp/appcafe/dispatch-queue.working")
 #define LPLOG QString("/var/log/lpreserver/lpreserver.log")
 #define LPERRLOG QString("/var/log/lpreserver/error.log")
@@ -28,6 +30,18 @@ public:
 
 	//Retrieve the most recent event message for a particular type of event
 	QJsonValue lastEvent(EVENT_TYPE type);
+
+	//Subscription index (thread-safe)
+	// - subscribers get the serialized event through a queued "EventMessage(EventWatcher::EVENT_TYPE, QByteArray)" slot
+	// - the subscriber must call unsubscribeAll() before it is destroyed
+	// - "cbor": the subscriber wants the binary (CBOR) version of the message (applies to all of its subscriptions)
+	void subscribe(EVENT_TYPE type, QObject *sub, bool cbor = false);
+	void unsubscribe(EVENT_TYPE type, QObject *sub);
+	void unsubscribeAll(QObject *sub);
+	int subscriberCount(EVENT_TYPE type);
+
+	//Assemble the JSON "events" message for a particular event (UTF-8)
+	static QByteArray eventMessage(EVENT_TYPE type, QJsonValue msg, bool cbor = false);
 	
 private:
 	QFileSystemWatcher *watcher;
@@ -43,6 +57,12 @@ private:
 
 	void sendLPEvent(QString system, int priority, QString msg);
 
+	//Event subscribers
+	QMutex subMutex;
+	QHash<unsigned int, QList<QObject*> > SUBSCRIBERS;
+	QList<QObject*> CBORSUBS; //subscribers which use the binary encoding
+	void sendEvent(EVENT_TYPE type, QJsonValue msg); //serialize once and send to all subscribers
+
 	//General purpose functions
 	QString readFile(QString path);
 	double displayToDoubleK(QString);
@@ -0,0 +1,205 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#include "HostLimiter.h"
+
+#include <QStringList>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+#define DEBUG 0
+
+HostLimiter::HostLimiter() : QObject(){
+  clock.start();
+  connRate = reqRate = 0; //no limits until they get set
+  connBurst = reqBurst = 1;
+  blockMSecs = 60*60000; //1 hour
+  refusedConns = refusedReqs = 0;
+  settingsFormat = QSettings::IniFormat;
+  maintTimer = 0;
+}
+
+HostLimiter::~HostLimiter(){
+  saving.waitForFinished();
+  //Write out any changes which are still waiting
+  if(!settingsFile.isEmpty() && (!toSave.isEmpty() || !toRemove.isEmpty()) ){
+    saveChanges(settingsFile, settingsFormat, toSave, toRemove);
+  }
+}
+
+void HostLimiter::setConnectionRate(double persec, int burst){
+  connRate = qMax(0.0, persec);
+  connBurst = qMax(1, burst);
+}
+
+void HostLimiter::setRequestRate(double persec, int burst){
+  reqRate = qMax(0.0, persec);
+  reqBurst = qMax(1, burst);
+}
+
+void HostLimiter::setBlockMinutes(int minutes){
+  if(minutes>0){ blockMSecs = minutes*60000LL; }
+}
+
+void HostLimiter::load(QSettings *settings){
+  settingsFile = settings->fileName();
+  settingsFormat = settings->format();
+  //Read the blacklist entries which are still in effect
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  QStringList keys = settings->allKeys().filter("blacklist/");
+  for(int i=0; i<keys.length(); i++){
+    if(!keys[i].startsWith("blacklist/")){ continue; } //some other group which happens to match
+    QString host = keys[i].section("/",1,-1);
+    qint64 start = settings->value(keys[i]).toDateTime().toMSecsSinceEpoch();
+    if(start + blockMSecs < now){ toRemove << host; continue; } //expired while the server was down
+    Shard &S = shardFor(host);
+    QMutexLocker lock(&S.mutex);
+    entryFor(S, host, clock.elapsed())->blocked = start;
+  }
+  if(maintTimer==0){
+    maintTimer = new QTimer(this);
+      maintTimer->setInterval(HOST_SAVE_SECS*1000);
+    connect(maintTimer, SIGNAL(timeout()), this, SLOT(maintenance()) );
+    maintTimer->start();
+  }
+}
+
+bool HostLimiter::allowConnection(const QString &host){
+  if(isLocalhost(host)){ return true; } //never limit/block the local system
+  Shard &S = shardFor(host);
+  QMutexLocker lock(&S.mutex);
+  qint64 now = clock.elapsed();
+  HostEntry *entry = entryFor(S, host, now);
+  bool ok = true;
+  if(entry->blocked>0){
+    if(entry->blocked + blockMSecs < QDateTime::currentMSecsSinceEpoch()){
+      //Block has timed out - go ahead and allow it
+      entry->blocked = 0;
+      QMutexLocker slock(&saveMutex);
+      toSave.remove(host);
+      toRemove << host;
+    }else{
+      ok = false; //blacklist block is still in effect
+    }
+  }
+  if(ok){ ok = takeToken(&entry->conn, connRate, connBurst, now); }
+  if(!ok){ refusedConns.fetchAndAddRelaxed(1); }
+  return ok;
+}
+
+bool HostLimiter::allowRequest(const QString &host){
+  if(reqRate<=0 || isLocalhost(host)){ return true; }
+  Shard &S = shardFor(host);
+  QMutexLocker lock(&S.mutex);
+  qint64 now = clock.elapsed();
+  bool ok = takeToken(&entryFor(S, host, now)->req, reqRate, reqBurst, now);
+  if(!ok){ refusedReqs.fetchAndAddRelaxed(1); }
+  return ok;
+}
+
+void HostLimiter::block(const QString &host){
+  if(isLocalhost(host)){ return; }
+  QDateTime start = QDateTime::currentDateTime();
+  Shard &S = shardFor(host);
+  QMutexLocker lock(&S.mutex);
+  entryFor(S, host, clock.elapsed())->blocked = start.toMSecsSinceEpoch();
+  QMutexLocker slock(&saveMutex);
+  toRemove.remove(host);
+  toSave.insert(host, start);
+}
+
+bool HostLimiter::isBlocked(const QString &host){
+  Shard &S = shardFor(host);
+  QMutexLocker lock(&S.mutex);
+  QHash<QString, HostEntry>::const_iterator it = S.hosts.constFind(host);
+  if(it==S.hosts.constEnd() || it->blocked==0){ return false; }
+  return (it->blocked + blockMSecs >= QDateTime::currentMSecsSinceEpoch());
+}
+
+QJsonObject HostLimiter::stats(){
+  int hosts = 0, blocked = 0;
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  for(int i=0; i<HOST_SHARDS; i++){
+    QMutexLocker lock(&shards[i].mutex);
+    hosts += shards[i].hosts.count();
+    QHash<QString, HostEntry>::const_iterator it = shards[i].hosts.constBegin();
+    for( ; it!=shards[i].hosts.constEnd(); ++it){
+      if(it->blocked>0 && it->blocked+blockMSecs >= now){ blocked++; }
+    }
+  }
+  QJsonObject out;
+  out.insert("hosts", QString::number(hosts));
+  out.insert("blacklisted", QString::number(blocked));
+  out.insert("refused_connections", QString::number(refusedConns.load()));
+  out.insert("refused_requests", QString::number(refusedReqs.load()));
+  return out;
+}
+
+// === PRIVATE ===
+HostLimiter::HostEntry* HostLimiter::entryFor(Shard &S, const QString &host, qint64 now){
+  QHash<QString, HostEntry>::iterator it = S.hosts.find(host);
+  if(it==S.hosts.end()){
+    //New host: start with full buckets
+    HostEntry entry;
+      entry.conn.tokens = connBurst;
+      entry.conn.last = now;
+      entry.req.tokens = reqBurst;
+      entry.req.last = now;
+      entry.blocked = 0;
+    it = S.hosts.insert(host, entry);
+  }
+  it->lastSeen = now;
+  return &(it.value());
+}
+
+bool HostLimiter::takeToken(RateBucket *bucket, double rate, int burst, qint64 now){
+  if(rate<=0){ return true; } //no limit
+  //Refill the bucket for the time which has passed, then take one token out
+  bucket->tokens = qMin((double) burst, bucket->tokens + (now - bucket->last)*rate/1000.0);
+  bucket->last = now;
+  if(bucket->tokens < 1){ return false; }
+  bucket->tokens -= 1;
+  return true;
+}
+
+bool HostLimiter::isLocalhost(const QString &host){
+  //"local:<user>" - connected through the local (unix domain) socket
+  return (host=="127.0.0.1" || host=="::1" || host=="::ffff:127.0.0.1" || host.startsWith("local:") );
+}
+
+void HostLimiter::saveChanges(QString file, QSettings::Format format, QHash<QString, QDateTime> save, QSet<QString> remove){
+  //Runs in a background thread with a separate settings instance (changes get merged into the file on sync)
+  QSettings settings(file, format);
+  QHash<QString, QDateTime>::const_iterator it = save.constBegin();
+  for( ; it!=save.constEnd(); ++it){ settings.setValue("blacklist/"+it.key(), it.value()); }
+  foreach(const QString &host, remove){ settings.remove("blacklist/"+host); }
+  settings.sync();
+  if(DEBUG){ qDebug() << "Saved blacklist changes:" << save.count() << remove.count(); }
+}
+
+// === PRIVATE SLOTS ===
+void HostLimiter::maintenance(){
+  //Forget about idle hosts and expired blacklist entries
+  qint64 now = clock.elapsed();
+  qint64 epoch = QDateTime::currentMSecsSinceEpoch();
+  QStringList expired;
+  for(int i=0; i<HOST_SHARDS; i++){
+    QMutexLocker lock(&shards[i].mutex);
+    QHash<QString, HostEntry>::iterator it = shards[i].hosts.begin();
+    while(it!=shards[i].hosts.end()){
+      if(it->blocked>0 && it->blocked+blockMSecs < epoch){ expired << it.key(); it->blocked = 0; }
+      if(it->blocked==0 && (now - it->lastSeen) > HOST_IDLE_SECS*1000LL){ it = shards[i].hosts.erase(it); }
+      else{ ++it; }
+    }
+  }
+  //Now hand any blacklist changes over to a background job
+  QMutexLocker slock(&saveMutex);
+  for(int i=0; i<expired.length(); i++){ toSave.remove(expired[i]); toRemove << expired[i]; }
+  if(settingsFile.isEmpty() || saving.isRunning()){ return; } //try again next time
+  if(toSave.isEmpty() && toRemove.isEmpty()){ return; }
+  saving = QtConcurrent::run(&HostLimiter::saveChanges, settingsFile, settingsFormat, toSave, toRemove);
+  toSave.clear();
+  toRemove.clear();
+}
@@ -0,0 +1,94 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#ifndef _PCBSD_REST_HOST_LIMITER_H
+#define _PCBSD_REST_HOST_LIMITER_H
+
+//NOTE: Only uses Qt classes - this is shared with the sysadm-bridge
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QTimer>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <QSettings>
+#include <QFuture>
+#include <QJsonObject>
+
+#define HOST_SHARDS 16 //number of independently-locked pieces of the table
+#define HOST_IDLE_SECS 600 //forget about hosts which have not been seen for this long
+#define HOST_SAVE_SECS 30 //how often the blacklist changes get written to disk
+
+// == Per-IP connection/request rate limiter and blacklist ==
+// Everything on the connection/request path is in memory (no settings file lookups):
+//   - token buckets for the connection rate and request rate of each address
+//   - blacklist entries with their block time
+// Blacklist changes get written to the settings file by a background job every few seconds,
+//   so a flood of connections never causes any disk I/O on the accept path.
+class HostLimiter : public QObject{
+	Q_OBJECT
+public:
+	HostLimiter();
+	~HostLimiter();
+
+	//Limits (rate: tokens per second, burst: bucket size) - a rate of 0 turns off that limit
+	void setConnectionRate(double persec, int burst);
+	void setRequestRate(double persec, int burst);
+	void setBlockMinutes(int minutes);
+
+	//Read the saved blacklist and start the background maintenance (call once the event loop exists)
+	void load(QSettings *settings);
+
+	bool allowConnection(const QString &host); //not blacklisted and under the connection rate
+	bool allowRequest(const QString &host); //under the request rate
+	void block(const QString &host); //add to the blacklist
+	bool isBlocked(const QString &host);
+
+	QJsonObject stats();
+
+private:
+	struct RateBucket{
+	  double tokens;
+	  qint64 last; //msecs on the table clock
+	};
+	struct HostEntry{
+	  RateBucket conn, req;
+	  qint64 blocked; //block start time (msecs since epoch - 0 if not blocked)
+	  qint64 lastSeen; //msecs on the table clock
+	};
+	struct Shard{
+	  QMutex mutex;
+	  QHash<QString, HostEntry> hosts;
+	};
+	Shard shards[HOST_SHARDS];
+	QElapsedTimer clock;
+	double connRate, reqRate;
+	int connBurst, reqBurst;
+	qint64 blockMSecs;
+	QAtomicInteger<qint64> refusedConns, refusedReqs;
+
+	//Background saving of the blacklist
+	QString settingsFile;
+	QSettings::Format settingsFormat;
+	QMutex saveMutex;
+	QHash<QString, QDateTime> toSave;
+	QSet<QString> toRemove;
+	QFuture<void> saving;
+	QTimer *maintTimer;
+
+	Shard& shardFor(const QString &host){ return shards[qHash(host) % HOST_SHARDS]; }
+	HostEntry* entryFor(Shard &S, const QString &host, qint64 now); //shard must be locked
+	bool takeToken(RateBucket *bucket, double rate, int burst, qint64 now);
+	static bool isLocalhost(const QString &host);
+	static void saveChanges(QString file, QSettings::Format format, QHash<QString, QDateTime> save, QSet<QString> remove);
+
+private slots:
+	void maintenance(); //expire old entries and save the blacklist changes
+};
+
+#endif
@@ -0,0 +1,183 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#include "JsonFramer.h"
+
+#include <ctype.h>
+#include <limits>
+
+JsonFramer::JsonFramer(int maxbytes){
+  maxFrame = maxbytes;
+  maxBuffer = 0;
+  start = pos = 0;
+  resetState();
+}
+
+JsonFramer::~JsonFramer(){
+
+}
+
+void JsonFramer::setMaxFrameSize(int maxbytes){
+  maxFrame = maxbytes;
+}
+
+void JsonFramer::setMaxBufferSize(int maxbytes){
+  maxBuffer = maxbytes;
+}
+
+qint64 JsonFramer::room(){
+  qint64 limit = bufferLimit();
+  if(limit<=0){ return -1; }
+  return qMax((qint64) 0, limit - buffered());
+}
+
+void JsonFramer::append(const QByteArray &data){
+  if(buffer.isEmpty()){ buffer = data; } //implicitly shared - no copy
+  else{ buffer.append(data); }
+}
+
+JsonFramer::STATUS JsonFramer::nextFrame(QByteArray *frame){
+  if(bodyStart<0 && !inHeaders){
+    //Start of a new message - skip any whitespace between messages
+    while(start<buffer.size() && isspace( (unsigned char) buffer.at(start)) ){ start++; }
+    if(start>=buffer.size()){ clear(); return NEEDMORE; }
+    pos = start;
+    if(buffer.at(start)=='{'){ bodyStart = start; } //plain JSON message
+    else{ inHeaders = true; } //REST message
+  }
+  if(inHeaders && !scanHeaders()){
+    if(maxFrame>0 && (buffer.size()-start) > maxFrame){ return TOOLARGE; }
+    return needMore();
+  }
+  if(contentLength>=0){
+    //Known body size (refuse it before any of the body gets buffered)
+    qint64 total = (qint64) (bodyStart-start) + contentLength;
+    if(maxFrame>0 && total > maxFrame){ return TOOLARGE; }
+    if(total > std::numeric_limits<int>::max()-start){ return TOOLARGE; } //can never fit in the buffer
+    if(buffer.size()-bodyStart < contentLength){ return needMore(); }
+    *frame = takeFrame(bodyStart + (int) contentLength);
+    return FRAME;
+  }
+  //Scan for the end of the JSON object (continues from where the last read left off)
+  const char *data = buffer.constData();
+  const int size = buffer.size();
+  for( ; pos<size; pos++){
+    const char c = data[pos];
+    if(inString){
+      if(escaped){ escaped = false; }
+      else if(c=='\\'){ escaped = true; }
+      else if(c=='"'){ inString = false; }
+    }else if(c=='"'){
+      inString = true;
+    }else if(c=='{'){
+      depth++;
+    }else if(c=='}' && depth>0){
+      depth--;
+      if(depth==0){
+        *frame = takeFrame(pos+1);
+        return FRAME;
+      }
+    }
+  }
+  if(maxFrame>0 && (size-start) > maxFrame){ return TOOLARGE; }
+  return needMore();
+}
+
+void JsonFramer::clear(){
+  buffer.clear();
+  start = pos = 0;
+  resetState();
+}
+
+int JsonFramer::buffered(){
+  return buffer.size()-start;
+}
+
+bool JsonFramer::isRest(){
+  return (start<buffer.size() && buffer.at(start)!='{');
+}
+
+// === PRIVATE ===
+qint64 JsonFramer::bufferLimit(){
+  return (maxBuffer>0 ? maxBuffer : qMax(maxFrame, 0));
+}
+
+JsonFramer::STATUS JsonFramer::needMore(){
+  qint64 limit = bufferLimit();
+  if(limit>0 && buffered() > limit){ return TOOLARGE; }
+  return NEEDMORE;
+}
+
+void JsonFramer::resetState(){
+  inHeaders = inString = escaped = false;
+  depth = 0;
+  bodyStart = contentLength = -1;
+}
+
+bool JsonFramer::scanHeaders(){
+  //Read the header block one line at a time (pos is always at the start of a line)
+  while(pos<buffer.size()){
+    if(buffer.at(pos)=='{'){
+      //No blank line between the headers and the body - the body starts here
+      bodyStart = pos;
+      inHeaders = false;
+      return true;
+    }
+    int nl = buffer.indexOf('\n', pos);
+    if(nl<0){ return false; } //partial line
+    int len = nl-pos;
+    if(len>0 && buffer.at(nl-1)=='\r'){ len--; }
+    if(len==0){
+      //Blank line: end of the header block
+      inHeaders = false;
+      bodyStart = pos = nl+1;
+      if(contentLength<0){
+        //No body size given: JSON body (brace scan) or no body at all
+        if(bodyStart<buffer.size()){
+          if(buffer.at(bodyStart)!='{'){ contentLength = 0; }
+        }else{
+          QByteArray verb = buffer.mid(start, buffer.indexOf(' ', start)-start);
+          if(verb=="HEAD" || verb=="OPTIONS"){ contentLength = 0; }
+          else{ inHeaders = true; pos = bodyStart-1; bodyStart = -1; return false; } //wait for the body (or the next message)
+        }
+      }
+      return true;
+    }
+    if(len>15 && qstrnicmp(buffer.constData()+pos, "content-length:", 15)==0){
+      QByteArray val = buffer.mid(pos+15, len-15).trimmed();
+      bool ok = false;
+      qint64 num = val.toLongLong(&ok);
+      if(ok && num>=0){ contentLength = num; }
+      else if(!ok && !val.isEmpty()){
+        //More digits than fit in 64 bits - treat it as "too large" instead of ignoring the header
+        bool digits = true;
+        for(int i=0; i<val.size() && digits; i++){ digits = isdigit( (unsigned char) val.at(i)); }
+        if(digits){ contentLength = std::numeric_limits<qint64>::max(); }
+      }
+    }
+    pos = nl+1;
+  }
+  return false;
+}
+
+QByteArray JsonFramer::takeFrame(int end){
+  QByteArray frame;
+  if(start==0 && end==buffer.size()){
+    //Whole buffer is the message (most common case) - hand it over without a copy
+    frame = buffer;
+    buffer.clear();
+    end = 0;
+  }else{
+    frame = buffer.mid(start, end-start);
+  }
+  start = pos = end;
+  resetState();
+  //Drop the consumed bytes once they make up most of the buffer
+  if(start>0 && start >= buffer.size()/2){
+    buffer.remove(0, start);
+    start = pos = 0;
+  }
+  return frame;
+}
@@ -0,0 +1,54 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#ifndef _PCBSD_REST_JSON_FRAMER_H
+#define _PCBSD_REST_JSON_FRAMER_H
+
+#include "globals-qt.h"
+
+// == Incremental message framer for the raw TCP/REST stream ==
+// Splits the incoming byte stream into complete messages in a single pass:
+//  - plain JSON messages: tracks the brace depth (skipping over strings/escapes)
+//  - REST messages: reads the header block, then uses the "Content-Length" header if present
+//       (falls back to the brace scan for the body when the header is missing)
+// The scan position is kept between reads, so every byte is only looked at once.
+// Messages over the frame size limit get refused as soon as that is known (for REST messages
+// with a "Content-Length" header: before the body gets buffered), and the total number of
+// bytes held in the buffer is capped as well (read the socket in chunks of at most room() bytes).
+class JsonFramer{
+public:
+	enum STATUS{ NEEDMORE, FRAME, TOOLARGE };
+
+	JsonFramer(int maxbytes = 0);
+	~JsonFramer();
+
+	void setMaxFrameSize(int maxbytes); //0 or less: no limit
+	void setMaxBufferSize(int maxbytes); //0 or less: same as the max frame size
+	qint64 room(); //number of bytes which may still be appended (-1: no limit)
+	void append(const QByteArray &data);
+	//Pull the next complete message out of the buffer (call in a loop until it does not return FRAME)
+	STATUS nextFrame(QByteArray *frame);
+	void clear();
+	int buffered(); //number of bytes waiting in the buffer
+	bool isRest(); //current message is a REST message (has a header block)
+
+private:
+	QByteArray buffer;
+	int maxFrame, maxBuffer;
+	int start; //start of the current message within the buffer
+	int pos; //scan position within the buffer
+	//Parsing state for the current message
+	bool inHeaders, inString, escaped;
+	int depth, bodyStart;
+	qint64 contentLength; //64-bit: the header value comes straight from the client
+
+	void resetState();
+	qint64 bufferLimit(); //cap on the buffered bytes (0: no limit)
+	STATUS needMore(); //NEEDMORE, or TOOLARGE once the buffer is over the cap
+	bool scanHeaders(); //returns true when the end of the header block was found
+	QByteArray takeFrame(int end); //end: one past the last byte of the message
+};
+
+#endif
@@ -0,0 +1,303 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "MetricsStore.h"
+#include "globals.h"
+
+#include <QtNumeric>
+
+#include "library/sysadm-cpusampler.h"
+#include "library/sysadm-zfs.h"
+
+#define DEBUG 0
+#define ZPOOL_SAMPLE_SECS 60 //"zpool list" is an external command - only run it once a minute
+#define MAX_POINTS 5000 //max number of points per series in one query reply
+
+//Resolutions: 1 second for an hour, 1 minute for a day, 15 minutes for a week
+static const int TIER_STEPS[METRICS_TIERS] = {1, 60, 900};
+static const int TIER_SIZES[METRICS_TIERS] = {3600, 1440, 672};
+
+MetricsStore::MetricsStore() : QThread(){
+  for(int i=0; i<METRICS_TIERS; i++){
+    tiers[i].step = TIER_STEPS[i];
+    tiers[i].size = TIER_SIZES[i];
+    tiers[i].stamps.fill(-1, TIER_SIZES[i]);
+    lastBucket[i] = -1;
+  }
+  enabled = true;
+  stopping = false;
+  probe = 0;
+  lastNetMSecs = lastZpoolSecs = 0;
+}
+
+MetricsStore::~MetricsStore(){
+  stopSampling();
+}
+
+void MetricsStore::setEnabled(bool enable){
+  enabled = enable;
+}
+
+void MetricsStore::startSampling(){
+  if(!enabled || isRunning()){ return; }
+  stopping = false;
+  probe = sysadm::SystemProbe::instance();
+  sysadm::CpuSampler::instance(); //make sure the CPU history is running too
+  setObjectName("sysadm-metrics");
+  start(QThread::LowPriority);
+}
+
+void MetricsStore::stopSampling(){
+  stopMutex.lock();
+  stopping = true;
+  stopCond.wakeAll();
+  stopMutex.unlock();
+  wait();
+}
+
+void MetricsStore::addSample(qint64 secs, const QHash<QString, double> &values){
+  QWriteLocker locker(&lock);
+  //A bucket of a coarser tier is complete once the time moves past it - average it down first
+  for(int k=1; k<METRICS_TIERS; k++){
+    qint64 bucket = secs / tiers[k].step;
+    if(lastBucket[k]>=0 && bucket!=lastBucket[k]){
+      downsample(k, lastBucket[k]);
+      if(k==1){ expire(secs); } //once a minute is plenty
+    }
+    lastBucket[k] = bucket;
+  }
+  //Now store the new values (finest tier)
+  QHash<QString, int> cols;
+  for(QHash<QString, double>::const_iterator it = values.constBegin(); it!=values.constEnd(); ++it){
+    cols.insert(it.key(), column(it.key()));
+  }
+  int slot = claimSlot(tiers[0], secs);
+  for(QHash<QString, double>::const_iterator it = values.constBegin(); it!=values.constEnd(); ++it){
+    int col = cols.value(it.key());
+    tiers[0].columns[col][slot] = it.value();
+    lastSeen[col] = secs;
+  }
+}
+
+QJsonObject MetricsStore::query(QStringList series, qint64 start, qint64 end, int step){
+  qint64 now = QDateTime::currentMSecsSinceEpoch()/1000;
+  if(start<=0){ start = now + start; }
+  if(end<=0){ end = now + end; }
+  if(end<start){ qint64 tmp = start; start = end; end = tmp; }
+  //Pick the finest resolution which still reaches back to the start (or the coarsest one)
+  int k = 0;
+  while(k+1<METRICS_TIERS && start < now - TIER_SIZES[k]*TIER_STEPS[k]){ k++; }
+  //Coarser resolutions which are still fine enough for the requested step are already averaged
+  while(k+1<METRICS_TIERS && step>=TIER_STEPS[k+1]){ k++; }
+  int tstep = TIER_STEPS[k];
+  //Output step: a multiple of the resolution, and not too many points
+  qint64 ostep = qMax(step, tstep);
+  if( (end-start)/ostep > MAX_POINTS ){ ostep = (end-start)/MAX_POINTS + 1; }
+  ostep = ((ostep + tstep - 1)/tstep)*tstep;
+  start = (start/ostep)*ostep;
+
+  QJsonObject out;
+  QJsonArray times;
+  QJsonObject values;
+  QReadLocker locker(&lock);
+  const Tier &T = tiers[k];
+  //Find the matching series
+  QList<int> cols;
+  QStringList names;
+  for(int i=0; i<NAMES.length(); i++){
+    bool match = series.isEmpty();
+    for(int j=0; j<series.length() && !match; j++){
+      match = QRegExp(series[j], Qt::CaseSensitive, QRegExp::Wildcard).exactMatch(NAMES[i]);
+    }
+    if(match){ cols << SERIES.value(NAMES[i]); names << NAMES[i]; }
+  }
+  QVector<QJsonArray> arrays(cols.length());
+  for(qint64 t=start; t<=end; t+=ostep){
+    times.append(t);
+    qint64 first = t/tstep;
+    qint64 last = (t+ostep)/tstep;
+    for(int c=0; c<cols.length(); c++){
+      //Average of the values in this span
+      const QVector<float> &col = T.columns[cols[c]];
+      double sum = 0;
+      int num = 0;
+      for(qint64 b=first; b<last; b++){
+        int slot = b % T.size;
+        if(T.stamps[slot]!=b || qIsNaN(col[slot])){ continue; }
+        sum += col[slot];
+        num++;
+      }
+      if(num>0){ arrays[c].append( qRound64(sum/num*100)/100.0 ); }
+      else{ arrays[c].append(QJsonValue()); }
+    }
+  }
+  for(int c=0; c<cols.length(); c++){ values.insert(names[c], arrays[c]); }
+  out.insert("start", start);
+  out.insert("end", end);
+  out.insert("step", ostep);
+  out.insert("times", times);
+  out.insert("series", values);
+  return out;
+}
+
+QJsonObject MetricsStore::info(){
+  QJsonObject out;
+  QJsonArray res;
+  for(int i=0; i<METRICS_TIERS; i++){
+    QJsonObject tier;
+      tier.insert("step", TIER_STEPS[i]);
+      tier.insert("retention", TIER_STEPS[i]*TIER_SIZES[i]);
+    res.append(tier);
+  }
+  QReadLocker locker(&lock);
+  QStringList names = NAMES;
+  names.sort();
+  out.insert("enabled", enabled);
+  out.insert("series", QJsonArray::fromStringList(names));
+  out.insert("resolutions", res);
+  return out;
+}
+
+QJsonObject MetricsStore::zpools(){
+  QReadLocker locker(&lock);
+  return lastZpools;
+}
+
+// === PROTECTED ===
+void MetricsStore::run(){
+  qint64 lastsecs = -1;
+  stopMutex.lock();
+  while(!stopping){
+    //One sample at the start of every second
+    qint64 msecs = QDateTime::currentMSecsSinceEpoch();
+    if(msecs/1000 == lastsecs){
+      stopCond.wait(&stopMutex, 1000 - (msecs%1000) + 1);
+      continue;
+    }
+    lastsecs = msecs/1000;
+    stopMutex.unlock();
+    sample(lastsecs);
+    stopMutex.lock();
+  }
+  stopMutex.unlock();
+}
+
+// === PRIVATE ===
+int MetricsStore::column(QString name){
+  int col = SERIES.value(name, -1);
+  if(col>=0){ return col; }
+  col = NAMES.length();
+  NAMES << name;
+  SERIES.insert(name, col);
+  lastSeen.append(-1);
+  for(int i=0; i<METRICS_TIERS; i++){
+    tiers[i].columns.append( QVector<float>(tiers[i].size, qQNaN()) );
+  }
+  return col;
+}
+
+int MetricsStore::claimSlot(Tier &tier, qint64 bucket){
+  int slot = bucket % tier.size;
+  if(tier.stamps[slot]!=bucket){
+    //Slot still holds an older bucket (one full ring ago) - clear it
+    tier.stamps[slot] = bucket;
+    for(int c=0; c<tier.columns.size(); c++){ tier.columns[c][slot] = qQNaN(); }
+  }
+  return slot;
+}
+
+void MetricsStore::downsample(int k, qint64 bucket){
+  Tier &src = tiers[k-1];
+  Tier &dst = tiers[k];
+  qint64 ratio = dst.step / src.step;
+  qint64 first = bucket*ratio;
+  int dslot = claimSlot(dst, bucket);
+  for(int c=0; c<src.columns.size(); c++){
+    double sum = 0;
+    int num = 0;
+    for(qint64 b=first; b<first+ratio; b++){
+      int slot = b % src.size;
+      if(src.stamps[slot]!=b || qIsNaN(src.columns[c][slot])){ continue; }
+      sum += src.columns[c][slot];
+      num++;
+    }
+    dst.columns[c][dslot] = (num>0) ? float(sum/num) : qQNaN();
+  }
+}
+
+void MetricsStore::expire(qint64 secs){
+  //Oldest time still kept in any resolution
+  qint64 oldest = secs - TIER_STEPS[METRICS_TIERS-1]*TIER_SIZES[METRICS_TIERS-1];
+  bool removed = false;
+  for(int c=NAMES.length()-1; c>=0; c--){
+    if(lastSeen[c]<0 || lastSeen[c]>=oldest){ continue; }
+    if(DEBUG){ qDebug() << "Metrics series expired:" << NAMES[c]; }
+    NAMES.removeAt(c);
+    lastSeen.remove(c);
+    for(int k=0; k<METRICS_TIERS; k++){ tiers[k].columns.remove(c); }
+    removed = true;
+  }
+  if(!removed){ return; }
+  //Columns moved - renumber the lookup
+  SERIES.clear();
+  for(int c=0; c<NAMES.length(); c++){ SERIES.insert(NAMES[c], c); }
+}
+
+void MetricsStore::sample(qint64 secs){
+  QHash<QString, double> vals;
+  //CPU (from the CPU sampler history)
+  double busy = 0;
+  if(sysadm::CpuSampler::instance()->busy(1000, 0, &busy)){ vals.insert("cpu.busy", busy); }
+  //Memory
+  sysadm::MemoryInfo mem;
+  if(probe->memory(&mem)){
+    if(mem.free>=0){ vals.insert("mem.free", mem.free/1048576.0); }
+    if(mem.active>=0){ vals.insert("mem.active", mem.active/1048576.0); }
+    if(mem.inactive>=0){ vals.insert("mem.inactive", mem.inactive/1048576.0); }
+    if(mem.wired>=0){ vals.insert("mem.wired", mem.wired/1048576.0); }
+    if(mem.cache>=0){ vals.insert("mem.cache", mem.cache/1048576.0); }
+  }
+  //Network traffic (rates from the counter differences)
+  QList<sysadm::NetCounters> ifaces;
+  qint64 msecs = QDateTime::currentMSecsSinceEpoch();
+  if(probe->interfaces(&ifaces)){
+    double elapsed = (msecs - lastNetMSecs)/1000.0;
+    QHash<QString, sysadm::NetCounters> current; //only the interfaces which still exist (jail/VM interfaces come and go)
+    for(int i=0; i<ifaces.length(); i++){
+      if(lastNet.contains(ifaces[i].name) && elapsed>0){
+        const sysadm::NetCounters &L = lastNet[ifaces[i].name];
+        if(ifaces[i].rxBytes>=L.rxBytes){ vals.insert("net."+ifaces[i].name+".rx", (ifaces[i].rxBytes-L.rxBytes)/elapsed); }
+        if(ifaces[i].txBytes>=L.txBytes){ vals.insert("net."+ifaces[i].name+".tx", (ifaces[i].txBytes-L.txBytes)/elapsed); }
+      }
+      current.insert(ifaces[i].name, ifaces[i]);
+    }
+    lastNet = current;
+    lastNetMSecs = msecs;
+  }
+  //Dispatcher
+  vals.insert("dispatcher.queue", DISPATCHER->queueDepth());
+  //ZFS pools
+  QJsonObject pools;
+  bool gotpools = false;
+  if(secs - lastZpoolSecs >= ZPOOL_SAMPLE_SECS){
+    lastZpoolSecs = secs;
+    pools = sysadm::ZFS::zpool_list();
+    gotpools = true;
+    QStringList names = pools.keys();
+    for(int i=0; i<names.length(); i++){
+      QJsonObject pool = pools.value(names[i]).toObject();
+      bool ok = false;
+      int cap = pool.value("capacity").toString().remove("%").toInt(&ok);
+      if(ok){ vals.insert("zpool."+names[i]+".capacity", cap); }
+      vals.insert("zpool."+names[i]+".healthy", pool.value("health").toString()=="ONLINE" ? 1 : 0);
+    }
+  }
+  if(DEBUG){ qDebug() << "Metrics Sample:" << secs << vals; }
+  addSample(secs, vals);
+  if(gotpools){
+    QWriteLocker locker(&lock);
+    lastZpools = pools;
+  }
+}
@@ -0,0 +1,87 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_METRICS_STORE_H
+#define _PCBSD_SYSADM_METRICS_STORE_H
+
+#include "globals-qt.h"
+
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QWaitCondition>
+#include <QVector>
+
+#include "library/sysadm-systemprobe.h"
+
+#define METRICS_TIERS 3
+
+// == In-memory metrics history ==
+// A background thread samples the system once per second and keeps the values in three resolutions:
+//   1 second for the last hour, 1 minute for the last day, 15 minutes for the last week.
+// Each resolution is a ring of time slots with one value column per series. Whenever a minute (or
+//  15 minutes) is complete, the finer values get averaged down into the next resolution.
+// Series (units):
+//   cpu.busy (%), mem.free/active/inactive/wired/cache (MB), net.<iface>.rx/tx (bytes/sec),
+//   zpool.<pool>.capacity (%), zpool.<pool>.healthy (1/0, every minute), dispatcher.queue (jobs)
+// Series which stop getting values (interface/pool gone) are dropped once their last value is older
+//  than the longest retention (nothing left to query by then).
+class MetricsStore : public QThread{
+public:
+	MetricsStore();
+	~MetricsStore();
+
+	void setEnabled(bool enable);
+	bool isEnabled(){ return enabled; }
+	void startSampling(); //start the sampler thread (if enabled)
+	void stopSampling();
+
+	//Add a set of values for the given time (epoch seconds)
+	void addSample(qint64 secs, const QHash<QString, double> &values);
+
+	//History between two times (epoch seconds, 0 or less: relative to now)
+	// - series: names or wildcard patterns ("net.*") - empty: everything
+	// - step: seconds per point (0: finest resolution still available for that range)
+	// Output (columnar): {"start", "end", "step", "times":[...], "series":{<name>:[<value or null>, ...]}}
+	QJsonObject query(QStringList series, qint64 start, qint64 end, int step);
+	//Available series and resolutions
+	QJsonObject info();
+	//Last "zpool list" results (the same format as sysadm::ZFS::zpool_list(), empty if not sampled yet)
+	QJsonObject zpools();
+
+protected:
+	void run();
+
+private:
+	struct Tier{
+	  int step; //seconds per slot
+	  int size; //number of slots
+	  QVector<qint64> stamps; //slot -> time bucket (time/step), -1: empty
+	  QVector< QVector<float> > columns; //series column -> slot -> value (NaN: no value)
+	};
+	QReadWriteLock lock;
+	Tier tiers[METRICS_TIERS];
+	qint64 lastBucket[METRICS_TIERS]; //last bucket written to the finer tier (-1: none yet)
+	QHash<QString, int> SERIES; //name -> column
+	QStringList NAMES;
+	QVector<qint64> lastSeen; //column -> time of the last value (epoch seconds)
+	QJsonObject lastZpools;
+	bool enabled;
+
+	//Sampler thread
+	QMutex stopMutex;
+	QWaitCondition stopCond;
+	bool stopping;
+	sysadm::SystemProbe *probe;
+	QHash<QString, sysadm::NetCounters> lastNet;
+	qint64 lastNetMSecs, lastZpoolSecs;
+
+	int column(QString name); //find or create the column for a series (write lock held)
+	int claimSlot(Tier &tier, qint64 bucket); //slot for a bucket, cleared if it held an older one (write lock held)
+	void downsample(int tier, qint64 bucket); //average one bucket of tier-1 into tier (write lock held)
+	void expire(qint64 secs); //drop the series without any values left (write lock held)
+	void sample(qint64 secs);
+};
+
+#endif
@@ -0,0 +1,78 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "ReplyCompressor.h"
+
+#define DEBUG 0
+
+ReplyCompressor::ReplyCompressor(){
+  threshold = 4096;
+  level = 6;
+}
+
+ReplyCompressor::~ReplyCompressor(){
+
+}
+
+void ReplyCompressor::setThreshold(int bytes){
+  threshold = bytes;
+}
+
+void ReplyCompressor::setLevel(int lev){
+  if(lev<1){ lev = 1; }
+  else if(lev>9){ lev = 9; }
+  level = lev;
+}
+
+bool ReplyCompressor::enabled(){
+  return (threshold>0);
+}
+
+bool ReplyCompressor::compress(const QString &namesp, QByteArray *msg){
+  if(threshold<=0 || msg->size()<threshold){ return false; }
+  QElapsedTimer timer;
+  timer.start();
+  QByteArray comp = qCompress(*msg, level);
+  qint64 usecs = timer.nsecsElapsed()/1000;
+  bool smaller = (!comp.isEmpty() && comp.size() < msg->size());
+  if(DEBUG){ qDebug() << "Compress Reply:" << namesp << msg->size() << "->" << comp.size() << usecs << "us"; }
+  statMutex.lock();
+    Counter &C = STATS[namesp];
+    C.usecs += usecs;
+    if(smaller){
+      C.messages++;
+      C.bytes_in += msg->size();
+      C.bytes_out += comp.size();
+    }else{
+      C.skipped++; //did not shrink - sent as-is
+    }
+  statMutex.unlock();
+  if(!smaller){ return false; }
+  *msg = comp;
+  return true;
+}
+
+QJsonObject ReplyCompressor::stats(){
+  QJsonObject out;
+  out.insert("threshold_bytes", threshold);
+  out.insert("level", level);
+  QJsonObject spaces;
+  statMutex.lock();
+    QHash<QString, Counter>::const_iterator it = STATS.constBegin();
+    for( ; it!=STATS.constEnd(); ++it){
+      const Counter &C = it.value();
+      QJsonObject obj;
+      obj.insert("messages", QString::number(C.messages));
+      obj.insert("skipped", QString::number(C.skipped));
+      obj.insert("bytes_in", QString::number(C.bytes_in));
+      obj.insert("bytes_out", QString::number(C.bytes_out));
+      obj.insert("ratio", C.bytes_out>0 ? QString::number( ((double) C.bytes_in)/C.bytes_out, 'f', 2) : QString("0") );
+      obj.insert("cpu_ms", QString::number(C.usecs/1000.0, 'f', 3));
+      spaces.insert(it.key(), obj);
+    }
+  statMutex.unlock();
+  out.insert("namespaces", spaces);
+  return out;
+}
@@ -0,0 +1,46 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_REPLY_COMPRESSOR_H
+#define _PCBSD_SYSADM_REPLY_COMPRESSOR_H
+
+#include "globals-qt.h"
+
+#include <QMutex>
+#include <QElapsedTimer>
+
+// == Compression for large WebSocket replies ==
+// Clients opt in through the "rpc/identify" call ("compression":"zlib").
+// Replies at or above the size threshold are then sent as binary frames containing the
+//   zlib-compressed message (qCompress() format: 4-byte big-endian uncompressed size + zlib stream).
+// Smaller replies (or ones which do not shrink) are still sent as plain text frames.
+class ReplyCompressor{
+public:
+	ReplyCompressor();
+	~ReplyCompressor();
+
+	//Configuration (usually loaded from the config file at startup)
+	void setThreshold(int bytes); //smallest reply to compress (<=0: compression disabled)
+	void setLevel(int level); //zlib compression level (1-9)
+	bool enabled();
+
+	//Compress the message if it is worth it (thread-safe)
+	// Returns false (and leaves "msg" untouched) if the message should go out uncompressed
+	bool compress(const QString &namesp, QByteArray *msg);
+
+	//Per-namespace counters (sizes, compression ratio, CPU time)
+	QJsonObject stats();
+
+private:
+	struct Counter{
+	  quint64 messages, skipped, bytes_in, bytes_out, usecs;
+	  Counter(){ messages = skipped = bytes_in = bytes_out = usecs = 0; }
+	};
+	QMutex statMutex;
+	QHash<QString, Counter> STATS; //namespace/counters
+	int threshold, level;
+};
+
+#endif
@@ -0,0 +1,156 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "RequestExecutor.h"
+
+#define DEBUG 0
+
+// ================================
+//  RequestJob Class (Internal)
+// ================================
+class RequestJob : public QRunnable{
+public:
+  RequestJob(RequestExecutor *ex, QString lane, std::function<void()> job, qint64 queued) : QRunnable(){
+    EXEC = ex; LANE = lane; JOB = job; QUEUED = queued;
+    this->setAutoDelete(true);
+  }
+  void run(){
+    EXEC->jobStarted(QUEUED);
+    JOB();
+    EXEC->jobFinished(LANE);
+  }
+private:
+  RequestExecutor *EXEC;
+  QString LANE;
+  std::function<void()> JOB;
+  qint64 QUEUED;
+};
+
+// ================================
+//  RequestExecutor Class
+// ================================
+RequestExecutor::RequestExecutor() : QObject(){
+  POOL = new QThreadPool(this);
+  maxQueued = 32;
+  maxParallel = 4;
+  stat_started = stat_rejected = stat_wait_total = stat_wait_max = 0;
+  clock.start();
+}
+
+RequestExecutor::~RequestExecutor(){
+  POOL->clear(); //don't start anything else
+  POOL->waitForDone();
+}
+
+void RequestExecutor::setWorkers(int num){
+  if(num<=0){ num = QThread::idealThreadCount(); }
+  if(num<1){ num = 1; }
+  POOL->setMaxThreadCount(num);
+}
+
+void RequestExecutor::setLaneLimits(int maxqueued, int maxparallel){
+  if(maxqueued>0){ maxQueued = maxqueued; }
+  if(maxparallel>0){ maxParallel = maxparallel; }
+}
+
+bool RequestExecutor::submit(QString lane, std::function<void()> job, bool ordered){
+  QMutexLocker lock(&laneMutex);
+  Lane &L = LANES[lane];
+  if(L.pending.length() >= maxQueued){
+    lock.unlock();
+    statMutex.lock();
+      stat_rejected++;
+    statMutex.unlock();
+    if(DEBUG){ qDebug() << "Request lane full:" << lane; }
+    return false;
+  }
+  L.ordered = ordered;
+  Job J;
+    J.run = job;
+    J.queued = clock.elapsed();
+  L.pending.enqueue(J);
+  schedule(lane);
+  return true;
+}
+
+void RequestExecutor::dropLane(QString lane){
+  QMutexLocker lock(&laneMutex);
+  QStringList lanes = LANES.keys();
+  for(int i=0; i<lanes.length(); i++){
+    if(lanes[i]!=lane && !lanes[i].startsWith(lane+"::::")){ continue; }
+    LANES[lanes[i]].pending.clear();
+    if(LANES[lanes[i]].running==0){ LANES.remove(lanes[i]); }
+  }
+}
+
+bool RequestExecutor::isBusy(QString lane, bool sublanes){
+  QMutexLocker lock(&laneMutex);
+  if(!sublanes){
+    QHash<QString, Lane>::const_iterator it = LANES.constFind(lane);
+    return (it!=LANES.constEnd() && (it->running>0 || !it->pending.isEmpty()) );
+  }
+  QHash<QString, Lane>::const_iterator it = LANES.constBegin();
+  for( ; it!=LANES.constEnd(); ++it){
+    if(it.key()!=lane && !it.key().startsWith(lane+"::::")){ continue; }
+    if(it->running>0 || !it->pending.isEmpty()){ return true; }
+  }
+  return false;
+}
+
+QJsonObject RequestExecutor::stats(){
+  QJsonObject out;
+  int waiting = 0;
+  int running = 0;
+  laneMutex.lock();
+    QList<QString> lanes = LANES.keys();
+    for(int i=0; i<lanes.length(); i++){
+      waiting += LANES[lanes[i]].pending.length();
+      running += LANES[lanes[i]].running;
+    }
+    out.insert("lanes", lanes.length());
+  laneMutex.unlock();
+  out.insert("waiting", waiting);
+  out.insert("running", running);
+  out.insert("workers", POOL->maxThreadCount());
+  out.insert("lane_queue_limit", maxQueued);
+  out.insert("lane_parallel_limit", maxParallel);
+  statMutex.lock();
+    out.insert("started", QString::number(stat_started));
+    out.insert("rejected_busy", QString::number(stat_rejected));
+    out.insert("wait_total_ms", QString::number(stat_wait_total));
+    out.insert("wait_max_ms", QString::number(stat_wait_max));
+    out.insert("wait_avg_ms", stat_started>0 ? QString::number( ((double) stat_wait_total)/stat_started, 'f', 2) : QString("0") );
+  statMutex.unlock();
+  return out;
+}
+
+// === PRIVATE ===
+void RequestExecutor::schedule(QString lane){
+  Lane &L = LANES[lane];
+  int max = (L.ordered ? 1 : maxParallel);
+  while(L.running < max && !L.pending.isEmpty()){
+    Job J = L.pending.dequeue();
+    L.running++;
+    POOL->start(new RequestJob(this, lane, J.run, J.queued));
+  }
+}
+
+void RequestExecutor::jobStarted(qint64 queued){
+  qint64 wait = clock.elapsed() - queued;
+  if(wait<0){ wait = 0; }
+  QMutexLocker lock(&statMutex);
+  stat_started++;
+  stat_wait_total += wait;
+  if(wait > (qint64) stat_wait_max){ stat_wait_max = wait; }
+}
+
+void RequestExecutor::jobFinished(QString lane){
+  QMutexLocker lock(&laneMutex);
+  if(!LANES.contains(lane)){ return; }
+  Lane &L = LANES[lane];
+  L.running--;
+  if(L.running<=0 && L.pending.isEmpty()){ LANES.remove(lane); } //lane is idle now
+  else{ schedule(lane); }
+}
@@ -0,0 +1,73 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_REQUEST_EXECUTOR_H
+#define _PCBSD_SYSADM_REQUEST_EXECUTOR_H
+
+#include "globals-qt.h"
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <functional>
+
+// == Bounded worker pool for API requests ==
+// Every connection gets its own "lane" (FIFO queue of pending requests).
+// A lane may only have a limited number of requests waiting/running at once, so a single
+// chatty client cannot fill up the pool and starve all the other connections.
+class RequestExecutor : public QObject{
+	Q_OBJECT
+public:
+	RequestExecutor();
+	~RequestExecutor();
+
+	//Configuration (usually loaded from the config file at startup)
+	void setWorkers(int num); //number of worker threads (<=0: one per CPU)
+	void setLaneLimits(int maxqueued, int maxparallel);
+
+	//Queue up a job for the given lane (connection ID)
+	// "ordered" : run the jobs for this lane one at a time (replies stay in request order)
+	// Returns false if the lane is already full (job not queued - client should get a "busy" reply)
+	bool submit(QString lane, std::function<void()> job, bool ordered = false);
+	//Discard any pending (not yet started) jobs for a lane and all of its sub-lanes ("<lane>::::<sub>")
+	void dropLane(QString lane);
+	//Check whether a lane still has jobs waiting or running
+	// "sublanes" : also check all of the "<lane>::::<sub>" lanes
+	bool isBusy(QString lane, bool sublanes = false);
+
+	//Current counters/settings
+	QJsonObject stats();
+
+private:
+	struct Job{
+	  std::function<void()> run;
+	  qint64 queued; //msecs on the executor clock
+	};
+	struct Lane{
+	  QQueue<Job> pending;
+	  int running;
+	  bool ordered;
+	  Lane(){ running = 0; ordered = false; }
+	};
+
+	QThreadPool *POOL;
+	QMutex laneMutex, statMutex;
+	QHash<QString, Lane> LANES;
+	QElapsedTimer clock;
+	int maxQueued, maxParallel;
+
+	//Counters
+	quint64 stat_started, stat_rejected, stat_wait_total, stat_wait_max;
+
+	void schedule(QString lane); //NOTE: laneMutex needs to be locked when calling this
+	void jobStarted(qint64 queued);
+	void jobFinished(QString lane);
+
+	friend class RequestJob;
+};
+
+#endif
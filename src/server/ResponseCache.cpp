@@ -0,0 +1,120 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "ResponseCache.h"
+
+#define DEBUG 0
+
+ResponseCache::ResponseCache() : QObject(){
+  clock.start();
+  enabled = true;
+  stat_hits = stat_misses = stat_coalesced = stat_invalidations = 0;
+}
+
+ResponseCache::~ResponseCache(){
+
+}
+
+void ResponseCache::setEnabled(bool enable){
+  enabled = enable;
+}
+
+RestOutputStruct::ExitCode ResponseCache::fetch(QString group, QString key, int ttlsecs, std::function<RestOutputStruct::ExitCode(QJsonObject*)> run, QJsonObject *out){
+  if(!enabled || ttlsecs<=0){ return run(out); }
+  QString fkey = group+"|"+key;
+  mutex.lock();
+  //Valid cached result?
+  QHash<QString, Entry>::const_iterator it = CACHE.value(group).constFind(key);
+  if(it!=CACHE.value(group).constEnd() && it.value().expires > clock.elapsed()){
+    *out = it.value().result;
+    stat_hits++;
+    mutex.unlock();
+    if(DEBUG){ qDebug() << "Cache Hit:" << fkey; }
+    return RestOutputStruct::OK;
+  }
+  //Same request already running?
+  Flight *flight = FLIGHTS.value(fkey, 0);
+  if(flight!=0){
+    stat_coalesced++;
+    flight->waiting++;
+    while(!flight->finished){ flight->done.wait(&mutex); }
+    RestOutputStruct::ExitCode code = flight->code;
+    *out = flight->result;
+    flight->waiting--;
+    if(flight->waiting==0){ delete flight; } //last one out cleans up
+    mutex.unlock();
+    if(DEBUG){ qDebug() << "Cache Coalesced:" << fkey; }
+    return code;
+  }
+  //Run the action in this thread
+  stat_misses++;
+  flight = new Flight();
+    flight->finished = false;
+    flight->waiting = 0;
+  FLIGHTS.insert(fkey, flight);
+  quint64 gen = GENERATION.value(group, 0);
+  mutex.unlock();
+
+  QJsonObject result;
+  RestOutputStruct::ExitCode code = run(&result);
+
+  mutex.lock();
+  if(code==RestOutputStruct::OK && gen==GENERATION.value(group, 0)){
+    Entry entry;
+      entry.result = result;
+      entry.expires = clock.elapsed() + ttlsecs*1000;
+    CACHE[group].insert(key, entry);
+  }
+  FLIGHTS.remove(fkey);
+  flight->finished = true;
+  flight->code = code;
+  flight->result = result;
+  if(flight->waiting>0){ flight->done.wakeAll(); }
+  else{ delete flight; }
+  mutex.unlock();
+  *out = result;
+  return code;
+}
+
+void ResponseCache::invalidate(QString group){
+  QMutexLocker lock(&mutex);
+  GENERATION[group]++;
+  if(CACHE.remove(group)>0){ stat_invalidations++; }
+}
+
+QJsonObject ResponseCache::stats(){
+  QJsonObject out;
+  QMutexLocker lock(&mutex);
+  int entries = 0;
+  QHash<QString, QHash<QString, Entry> >::const_iterator it = CACHE.constBegin();
+  for( ; it!=CACHE.constEnd(); ++it){ entries += it.value().count(); }
+  out.insert("entries", entries);
+  out.insert("running", FLIGHTS.count());
+  out.insert("hits", QString::number(stat_hits));
+  out.insert("misses", QString::number(stat_misses));
+  out.insert("coalesced", QString::number(stat_coalesced));
+  out.insert("invalidations", QString::number(stat_invalidations));
+  quint64 total = stat_hits + stat_misses + stat_coalesced;
+  out.insert("hit_ratio", total>0 ? QString::number( ((double) (stat_hits+stat_coalesced))/total, 'f', 3) : QString("0") );
+  return out;
+}
+
+// === PUBLIC SLOTS ===
+void ResponseCache::invalidateAll(){
+  QMutexLocker lock(&mutex);
+  QStringList groups = CACHE.keys();
+  for(int i=0; i<groups.length(); i++){ GENERATION[groups[i]]++; }
+  //Also stop any results which are still being generated from getting saved
+  QHash<QString, Flight*>::const_iterator it = FLIGHTS.constBegin();
+  for( ; it!=FLIGHTS.constEnd(); ++it){ GENERATION[it.key().section("|",0,0)]++; }
+  if(!CACHE.isEmpty()){ stat_invalidations++; }
+  CACHE.clear();
+}
+
+void ResponseCache::jobFinished(QJsonObject obj){
+  //Note: The dispatcher also sends progress updates through the same signal - only clear the cache once a job is done
+  if(obj.value("state").toString()!="finished"){ return; }
+  invalidateAll();
+}
@@ -0,0 +1,65 @@
+// ===============================
+//  PC-BSD REST API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_RESPONSE_CACHE_H
+#define _PCBSD_SYSADM_RESPONSE_CACHE_H
+
+#include "globals-qt.h"
+#include "RestStructs.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+#include <functional>
+
+// == Read-through cache for idempotent backend actions ==
+// Results are stored per group (subsystem) and key (access level + action + arguments) for a short time.
+// If the same request is already running in another thread, the caller waits for that
+//  result instead of running the action again ("single-flight").
+class ResponseCache : public QObject{
+	Q_OBJECT
+public:
+	ResponseCache();
+	~ResponseCache();
+
+	void setEnabled(bool enabled); //disabled: every request runs the action directly
+
+	//Return the cached result if there is one, otherwise run the action (only successful results get cached)
+	RestOutputStruct::ExitCode fetch(QString group, QString key, int ttlsecs, std::function<RestOutputStruct::ExitCode(QJsonObject*)> run, QJsonObject *out);
+	//Throw away the cached results for a group (the next request runs the action again)
+	void invalidate(QString group);
+
+	//Counters (hits, misses, coalesced requests, invalidations)
+	QJsonObject stats();
+
+public slots:
+	void invalidateAll();
+	void jobFinished(QJsonObject); //Dispatcher process finished (jobs may change anything on the system)
+
+private:
+	struct Entry{
+	  QJsonObject result;
+	  qint64 expires; //msecs on the cache clock
+	};
+	struct Flight{
+	  QWaitCondition done;
+	  bool finished;
+	  RestOutputStruct::ExitCode code;
+	  QJsonObject result;
+	  int waiting; //number of other threads waiting on this result
+	};
+	QMutex mutex;
+	QHash<QString, QHash<QString, Entry> > CACHE; //group -> key -> entry
+	QHash<QString, Flight*> FLIGHTS; //"<group>|<key>" -> running request
+	QHash<QString, quint64> GENERATION; //group -> invalidation counter (results started before an invalidation are not stored)
+	QElapsedTimer clock;
+	bool enabled;
+
+	//Counters
+	quint64 stat_hits, stat_misses, stat_coalesced, stat_invalidations;
+};
+
+#endif
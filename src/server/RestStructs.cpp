@@ -5,41 +5,68 @@
 // =================================
 #include "RestStructs.h"
 
+#include <QThreadStorage>
+
 // === INPUT STRUCTURE ===
-RestInputStruct::RestInputStruct(QString message, bool isRest){
+RestInputStruct::RestInputStruct(QByteArray message, bool isRest, bool isCbor){
   HTTPVERSION = CurHttpVersion; //default value
   fullaccess = false;
+  keepAlive = false;
+  cbor = isCbor;
   if(message.isEmpty()){ return; }
+  if(cbor){
+    //Binary message - no headers (WebSocket only)
+    Body = message;
+    ParseBodyIntoJson();
+    return;
+  }
   //Pull out any REST headers
   //qDebug() << "Raw Message:" << message;
-  if(!message.startsWith("{")){ //TO-DO
+  if(!message.startsWith('{')){ //TO-DO
     if(isRest){
-      Header = message.section("{",0,0).split("\n");
-      Body = "{"+message.section("{",1, -1);
+      int brace = message.indexOf('{');
+      Header = QString::fromUtf8( brace<0 ? message : message.left(brace) ).split("\n");
+      if(brace>=0){ Body = message.mid(brace); }
     }else{
       //Encrypted message body (via sysadm-bridge?)
-      bridgeID = message.section("\n",0,0);
+      int nl = message.indexOf('\n');
+      bridgeID = QString::fromUtf8( message.left(nl) );
       Header << bridgeID;
-      Body = message.section("\n",1,-1);
+      if(nl>=0){ Body = message.mid(nl+1); }
     }
   }else{
-    Body = message;
+    Body = message; //implicitly shared - no copy
   }
   if(!Header.isEmpty() && isRest){
     QString line = Header.takeFirst(); //The first line is special (not a generic header)
-    VERB = line.section(" ",0,0);
-    URI = line.section(" ",1,1);
-    HTTPVERSION = line.section(" ",2,2);
-    //Body = message.remove(Header.join("\n")+"\n"); //chop the headers off the front
-    if(!Header.filter("Authorization:").isEmpty()){
-      line = Header.filter("Authorization:").takeFirst().section("Authorization: ",1,50).simplified();
-      if(line.section(" ",0,0).toLower()=="basic"){
-        //Convert the base64-encoded string to the plain "user:pass" string
-	QByteArray ba;
-	ba.append(line.section(" ",1,1));
-	auth = QByteArray::fromBase64(ba);
+    //"<VERB> <URI> <HTTPVERSION>"
+    int sp1 = line.indexOf(' ');
+    int sp2 = (sp1<0) ? -1 : line.indexOf(' ', sp1+1);
+    int sp3 = (sp2<0) ? -1 : line.indexOf(' ', sp2+1);
+    VERB = line.left(sp1);
+    URI = (sp1<0) ? QString() : line.mid(sp1+1, (sp2<0) ? -1 : sp2-sp1-1);
+    HTTPVERSION = (sp2<0) ? QString() : line.mid(sp2+1, (sp3<0) ? -1 : sp3-sp2-1);
+    //Single pass over the rest of the headers (only the first of each kind counts)
+    QString connval, authline;
+    bool hasConn = false, hasAuth = false;
+    for(int i=0; i<Header.length(); i++){
+      const QString &H = Header[i];
+      if(!hasConn && H.startsWith("Connection:", Qt::CaseInsensitive)){
+        connval = H.mid(11).simplified().toLower();
+        hasConn = true;
+      }else if(!hasAuth && H.contains("Authorization:")){
+        int index = H.indexOf("Authorization: ");
+        if(index>=0){ authline = H.mid(index+15).simplified(); }
+        hasAuth = true;
       }
     }
+    //Persistent connections: default for HTTP/1.1, opt-in for HTTP/1.0
+    if(HTTPVERSION.simplified()=="HTTP/1.1"){ keepAlive = !connval.contains("close"); }
+    else{ keepAlive = connval.contains("keep-alive"); }
+    if(authline.section(" ",0,0).toLower()=="basic"){
+      //Convert the base64-encoded string to the plain "user:pass" string
+      auth = QByteArray::fromBase64( authline.section(" ",1,1).toLatin1() );
+    }
   }
   //Now Parse out the Body into the JSON fields and/or arguments structure
   //NOTE: if the body of the message is encrypted, then it needs to be decrypted outside the struct first,
@@ -54,23 +81,38 @@ RestInputStruct::~RestInputStruct(){}
 
 void RestInputStruct::ParseBodyIntoJson(){
   //qDebug() << "Parse Body Into JSON";
-  while(Body.endsWith("\n")){ Body.chop(1); }
-  if(Body.startsWith("{") && Body.endsWith("}") ){
-    QJsonDocument doc = QJsonDocument::fromJson(Body.toUtf8());
-    if(!doc.isNull() && doc.isObject() ){
-      //Valid JSON found
-      if(doc.object().contains("namespace") ){ namesp = doc.object().value("namespace").toString(); }
-      if(doc.object().contains("name") ){ name = doc.object().value("name").toString(); }
-      if(doc.object().contains("id") ){ id = doc.object().value("id").toString(); }
-      if(doc.object().contains("args") ){ args = doc.object().value("args"); }
-      else{
-        //no args structure - treat the entire body as the arguments struct
-	args = doc.object();
-      }
-    }
+  QJsonObject obj;
+  bool valid = false;
+  if(cbor){
+    //Binary CBOR message: needs to be a map at the top level
+    QCborParserError err;
+    QCborValue val = QCborValue::fromCbor(Body, &err);
+    if(err.error==QCborError::NoError && val.isMap()){ obj = val.toMap().toJsonObject(); valid = true; }
+    else{ qDebug() << " -Could not read CBOR message:" << err.errorString(); }
   }else{
-    qDebug() << " -Could not find JSON!!";
-    qDebug() << " - Body:" << Body;
+    while(Body.endsWith('\n') || Body.endsWith('\r')){ Body.chop(1); }
+    if(Body.startsWith('{') && Body.endsWith('}') ){
+      QJsonDocument doc = QJsonDocument::fromJson(Body); //UTF-8 bytes straight into the parser
+      if(!doc.isNull() && doc.isObject() ){ obj = doc.object(); valid = true; }
+    }else{
+      qDebug() << " -Could not find JSON!!";
+      qDebug() << " - Body:" << Body;
+    }
+  }
+  if(valid){
+    //Valid JSON found (one lookup per field)
+    QJsonObject::const_iterator it = obj.constFind("namespace");
+    if(it!=obj.constEnd()){ namesp = it.value().toString(); }
+    it = obj.constFind("name");
+    if(it!=obj.constEnd()){ name = it.value().toString(); }
+    it = obj.constFind("id");
+    if(it!=obj.constEnd()){ id = it.value().toString(); }
+    it = obj.constFind("args");
+    if(it!=obj.constEnd()){ args = it.value(); }
+    else{
+      //no args structure - treat the entire body as the arguments struct
+      args = obj;
+    }
   }
   //Now do any REST -> JSON conversions if necessary
   if(!URI.isEmpty()){
@@ -81,53 +123,80 @@ void RestInputStruct::ParseBodyIntoJson(){
 }
 
 // === OUTPUT STRUCTURE ===
-QString RestOutputStruct::assembleMessage(){
+//REST status line for each exit code (fixed strings - nothing gets built per reply)
+static const char* RestStatusText(RestOutputStruct::ExitCode code){
+  switch(code){
+    case RestOutputStruct::PROCESSING: return " 102 Processing";
+    case RestOutputStruct::OK: return " 200 OK";
+    case RestOutputStruct::CREATED: return " 201 Created";
+    case RestOutputStruct::ACCEPTED: return " 202 Accepted";
+    case RestOutputStruct::NOCONTENT: return " 204 No Content";
+    case RestOutputStruct::RESETCONTENT: return " 205 Reset Content";
+    case RestOutputStruct::PARTIALCONTENT: return " 206 Partial Content";
+    case RestOutputStruct::BADREQUEST: return " 400 Bad Request";
+    case RestOutputStruct::UNAUTHORIZED: return " 401 Unauthorized";
+    case RestOutputStruct::FORBIDDEN: return " 403 Forbidden";
+    case RestOutputStruct::NOTFOUND: return " 404 Not Found";
+    case RestOutputStruct::SERVICEUNAVAILABLE: return " 503 Service Unavailable";
+    case RestOutputStruct::PAYLOADTOOLARGE: return " 413 Payload Too Large";
+    case RestOutputStruct::TOOMANYREQUESTS: return " 429 Too Many Requests";
+  }
+  return "";
+}
+
+//"Date:" header line - formatting the time is slow, so only do it once a second (per thread)
+struct RestDateCache{
+  qint64 secs;
+  QByteArray line;
+  RestDateCache(){ secs = -1; }
+};
+
+static const QByteArray& RestDateHeader(){
+  static QThreadStorage<RestDateCache> cache;
+  RestDateCache &C = cache.localData();
+  qint64 now = QDateTime::currentMSecsSinceEpoch()/1000;
+  if(now!=C.secs){
+    C.secs = now;
+    C.line = "Date: "+QDateTime::currentDateTime().toString(Qt::ISODate).simplified().toUtf8();
+  }
+  return C.line;
+}
+
+QByteArray RestOutputStruct::assembleMessage(){
   if( !in_struct.VERB.isEmpty() ){
     //REST output syntax
-    QStringList headers;
-    QString firstline = in_struct.HTTPVERSION.simplified();
-    if(firstline.isEmpty()){ firstline = CurHttpVersion.simplified(); }//default value
-    QString Body;
-    if(!out_args.isNull()){ 
+    QByteArray Body;
+    if(!raw_args.isEmpty()){
+      Body.reserve(raw_args.size()+10);
+      Body.append("{\"args\":");
+      Body.append(raw_args);
+      Body.append("}");
+    }else if(!out_args.isNull()){ 
       QJsonObject obj; obj.insert("args", out_args);
-      Body = QJsonDocument(obj).toJson();
+      Body = QJsonDocument(obj).toJson(QJsonDocument::Compact); //only serialized once (the size comes from the bytes)
     }
-    switch(CODE){
-      case PROCESSING:
-        firstline.append(" 102 Processing"); break;
-      case OK:
-        firstline.append(" 200 OK"); break;
-      case CREATED:
-        firstline.append(" 201 Created"); break;
-      case ACCEPTED:
-        firstline.append(" 202 Accepted"); break;
-      case NOCONTENT:
-        firstline.append(" 204 No Content"); break;
-      case RESETCONTENT:
-        firstline.append(" 205 Reset Content"); break;
-      case PARTIALCONTENT:
-        firstline.append(" 206 Partial Content"); break;
-      case BADREQUEST:
-        firstline.append(" 400 Bad Request"); break;
-      case UNAUTHORIZED:
-        firstline.append(" 401 Unauthorized"); break;
-      case FORBIDDEN:
-        firstline.append(" 403 Forbidden"); break;
-      case NOTFOUND:
-        firstline.append(" 404 Not Found"); break;
-    }
-    headers << firstline;
-    headers << "Server: SysAdm/1.0";
-    headers << "Date: "+QDateTime::currentDateTime().toString(Qt::ISODate).simplified();
-    if(!Header.isEmpty()) {
-      for (int i = 0; i < Header.size(); ++i)
-               headers << Header.at(i).simplified();
+    //Write the headers straight into the output buffer
+    QByteArray msg;
+    msg.reserve(256 + Body.size());
+    QString version = in_struct.HTTPVERSION.simplified();
+    msg.append( (version.isEmpty() ? CurHttpVersion : version).toLatin1() ); //default value
+    msg.append(RestStatusText(CODE));
+    msg.append("\r\nServer: SysAdm/1.0\r\n");
+    msg.append(RestDateHeader());
+    msg.append("\r\n");
+    for(int i=0; i<Header.size(); i++){
+      msg.append(Header.at(i).simplified().toUtf8());
+      msg.append("\r\n");
     }
     //Now add the body of the return
-    if(!Body.isEmpty()){ headers << "Content-Length: "+QString::number(Body.toUtf8().size()); } //number of bytes for the body
-    headers << "";
-    headers << Body;
-    return headers.join("\r\n");
+    if(!Body.isEmpty()){
+      msg.append("Content-Length: "); //number of bytes for the body
+      msg.append(QByteArray::number(Body.size()));
+      msg.append("\r\n");
+    }
+    msg.append("\r\n");
+    msg.append(Body);
+    return msg;
     
   }else{
     //JSON output (load all the input fields for the moment)
@@ -169,6 +238,15 @@ QString RestOutputStruct::assembleMessage(){
       case NOTFOUND:
 	oname = onamesp = "error";
 	out_err.insert("code","404"); out_err.insert("message", "Not Found"); break;
+      case SERVICEUNAVAILABLE:
+	oname = onamesp = "error";
+	out_err.insert("code","503"); out_err.insert("message", "Service Unavailable"); break;
+      case PAYLOADTOOLARGE:
+	oname = onamesp = "error";
+	out_err.insert("code","413"); out_err.insert("message", "Payload Too Large"); break;
+      case TOOMANYREQUESTS:
+	oname = onamesp = "error";
+	out_err.insert("code","429"); out_err.insert("message", "Too Many Requests"); break;
       default:
 	break;
       }
@@ -179,6 +257,26 @@ QString RestOutputStruct::assembleMessage(){
     obj.insert("namespace",onamesp);
     obj.insert("name",oname);
     obj.insert("id",oid);
+    if(in_struct.cbor){
+      //Binary CBOR output (same structure as the JSON message)
+      QCborMap map = QCborMap::fromJsonObject(obj);
+      if(CODE==OK && !raw_args.isEmpty()){
+        QJsonDocument doc = QJsonDocument::fromJson(raw_args);
+        map.insert(QStringLiteral("args"), doc.isArray() ? QCborValue::fromJsonValue(doc.array()) : QCborValue::fromJsonValue(doc.object()) );
+      }else{
+        map.insert(QStringLiteral("args"), QCborValue::fromJsonValue(out_args) );
+      }
+      return QCborValue(map).toCbor();
+    }
+    if(CODE==OK && !raw_args.isEmpty()){
+      //Splice the pre-serialized arguments onto the end of the message
+      QByteArray msg = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+      msg.chop(1); //closing bracket
+      msg.append(",\"args\":");
+      msg.append(raw_args);
+      msg.append("}");
+      return msg;
+    }
     obj.insert("args", out_args);
     //Convert the JSON to string form
     QJsonDocument doc(obj);
@@ -7,6 +7,9 @@
 #define _PCBSD_REST_SERVER_REST_STRUCTS_H
 #include "globals-qt.h"
 
+#include <QCborValue>
+#include <QCborMap>
+
 #define CurHttpVersion QString("HTTP/1.1")
 
 //NOTE: The input structure parsing assumes a JSON input body
@@ -29,11 +32,15 @@ public:
 
 	//Raw Text
 	QStringList Header; //REST Headers
-	QString Body; //Everything else
+	QByteArray Body; //Everything else (UTF-8)
 	//User Permissions level
 	bool fullaccess;
+	//REST connection handling: keep the connection open after the reply
+	bool keepAlive;
+	//Binary encoding: the body is CBOR instead of JSON text (the reply uses the same encoding)
+	bool cbor;
 
-	RestInputStruct(QString message = "", bool isRest = false);
+	RestInputStruct(QByteArray message = QByteArray(), bool isRest = false, bool isCbor = false);
 	~RestInputStruct();
 		
 	void ParseBodyIntoJson();
@@ -42,18 +49,19 @@ public:
 
 class RestOutputStruct{
 public:
-	enum ExitCode{OK, CREATED, ACCEPTED, NOCONTENT, RESETCONTENT, PARTIALCONTENT, PROCESSING, BADREQUEST, UNAUTHORIZED, FORBIDDEN, NOTFOUND };
+	enum ExitCode{OK, CREATED, ACCEPTED, NOCONTENT, RESETCONTENT, PARTIALCONTENT, PROCESSING, BADREQUEST, UNAUTHORIZED, FORBIDDEN, NOTFOUND, SERVICEUNAVAILABLE, PAYLOADTOOLARGE, TOOMANYREQUESTS };
 	RestInputStruct in_struct;
 	ExitCode CODE;
 	QStringList Header; //REST output header lines
 	QJsonValue out_args;
+	QByteArray raw_args; //pre-serialized JSON for the "args" field (used instead of out_args when set)
 	
 	RestOutputStruct(){
 	  CODE = BADREQUEST; //default exit code
 	}
 	~RestOutputStruct(){}
 		
-	QString assembleMessage(); //normal operation - no special processing needed
+	QByteArray assembleMessage(); //normal operation - no special processing needed (UTF-8, or CBOR if the input was CBOR)
 };
 
 #endif
@@ -0,0 +1,120 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#include "SessionTable.h"
+
+SessionTable::SessionTable(int timeoutsecs){
+  timeout = timeoutsecs*1000;
+  //Make sure the whole timeout period fits within the wheel (with a couple spare buckets)
+  tick = timeout / (SESSION_WHEEL_SLOTS-2) + 1;
+  clock.start();
+  lastTick = clock.elapsed()/tick;
+}
+
+SessionTable::~SessionTable(){
+
+}
+
+bool SessionTable::insert(QString token, QString user, bool isOperator){
+  Shard &S = shardFor(token);
+  QMutexLocker lock(&S.mutex);
+  if(S.sessions.contains(token)){ return false; }
+  AuthSession session;
+    session.user = user;
+    session.isOperator = isOperator;
+    session.expires = clock.elapsed() + timeout;
+    session.slot = slotFor(session.expires);
+  S.sessions.insert(token, session);
+  S.wheel[session.slot].insert(token);
+  return true;
+}
+
+void SessionTable::remove(QString token){
+  Shard &S = shardFor(token);
+  QMutexLocker lock(&S.mutex);
+  QHash<QString, AuthSession>::iterator it = S.sessions.find(token);
+  if(it==S.sessions.end()){ return; }
+  S.wheel[it->slot].remove(token);
+  S.sessions.erase(it);
+}
+
+bool SessionTable::touch(QString token){
+  Shard &S = shardFor(token);
+  QMutexLocker lock(&S.mutex);
+  QHash<QString, AuthSession>::iterator it = S.sessions.find(token);
+  if(it==S.sessions.end()){ return false; }
+  qint64 now = clock.elapsed();
+  if(it->expires <= now){ return false; } //timed out (the wheel just has not swept it out yet)
+  it->expires = now + timeout;
+  int slot = slotFor(it->expires);
+  if(slot != it->slot){
+    //Move the token over to the new bucket
+    S.wheel[it->slot].remove(token);
+    S.wheel[slot].insert(token);
+    it->slot = slot;
+  }
+  return true;
+}
+
+bool SessionTable::lookup(QString token, AuthSession *session){
+  Shard &S = shardFor(token);
+  QMutexLocker lock(&S.mutex);
+  QHash<QString, AuthSession>::const_iterator it = S.sessions.constFind(token);
+  if(it==S.sessions.constEnd() || it->expires <= clock.elapsed()){ return false; }
+  if(session!=0){ *session = it.value(); }
+  return true;
+}
+
+int SessionTable::secondsLeft(QString token){
+  AuthSession session;
+  if(!lookup(token, &session)){ return 0; }
+  return (int) ((session.expires - clock.elapsed())/1000);
+}
+
+int SessionTable::tickMSecs(){
+  return (int) tick;
+}
+
+int SessionTable::expire(){
+  QMutexLocker elock(&expireMutex);
+  qint64 now = clock.elapsed();
+  qint64 curTick = now/tick;
+  int removed = 0;
+  if(curTick - lastTick > SESSION_WHEEL_SLOTS){ lastTick = curTick - SESSION_WHEEL_SLOTS; } //one full turn covers everything
+  //Sweep every bucket which has completely passed since the last run
+  for(qint64 t = lastTick; t<curTick; t++){
+    int slot = (int) (t % SESSION_WHEEL_SLOTS);
+    for(int i=0; i<SESSION_SHARDS; i++){
+      Shard &S = shards[i];
+      QMutexLocker lock(&S.mutex);
+      QSet<QString> tokens = S.wheel[slot];
+      S.wheel[slot].clear();
+      QSet<QString>::const_iterator it = tokens.constBegin();
+      for( ; it!=tokens.constEnd(); ++it){
+        QHash<QString, AuthSession>::iterator sit = S.sessions.find(*it);
+        if(sit==S.sessions.end()){ continue; }
+        if(sit->expires <= now){
+          S.sessions.erase(sit);
+          removed++;
+        }else{
+          //Should not happen (touched sessions get moved) - re-file it just in case
+          sit->slot = slotFor(sit->expires);
+          S.wheel[sit->slot].insert(*it);
+        }
+      }
+    }
+  }
+  lastTick = curTick;
+  return removed;
+}
+
+int SessionTable::count(){
+  int num = 0;
+  for(int i=0; i<SESSION_SHARDS; i++){
+    QMutexLocker lock(&shards[i].mutex);
+    num += shards[i].sessions.count();
+  }
+  return num;
+}
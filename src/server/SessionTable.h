@@ -0,0 +1,65 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#ifndef _PCBSD_REST_SESSION_TABLE_H
+#define _PCBSD_REST_SESSION_TABLE_H
+
+#include "globals-qt.h"
+
+#include <QMutex>
+#include <QSet>
+#include <QElapsedTimer>
+
+#define SESSION_SHARDS 16 //number of independently-locked pieces of the table
+#define SESSION_WHEEL_SLOTS 64 //number of expiration buckets in the timer wheel
+
+struct AuthSession{
+  QString user;
+  bool isOperator;
+  qint64 expires; //msecs on the table clock
+  int slot; //timer wheel bucket this session is currently filed under
+};
+
+// == Thread-safe token -> session lookup table ==
+// Tokens are spread over multiple shards (each with their own lock) so that concurrent
+// request threads rarely wait on each other. Expired sessions are swept out by a timer
+// wheel (call expire() every tickMSecs()) instead of comparing timestamps on every lookup.
+class SessionTable{
+public:
+	SessionTable(int timeoutsecs);
+	~SessionTable();
+
+	//Returns false if the token is already in use
+	bool insert(QString token, QString user, bool isOperator);
+	void remove(QString token);
+
+	//Check that the token is valid and bump the expiration time
+	bool touch(QString token);
+	//Get the session info for a valid token (no expiration bump)
+	bool lookup(QString token, AuthSession *session);
+	//Number of seconds before the token expires (0 for invalid tokens)
+	int secondsLeft(QString token);
+
+	//Timer wheel handling
+	int tickMSecs();
+	int expire(); //remove all sessions in the buckets which have passed (returns number removed)
+	int count();
+
+private:
+	struct Shard{
+	  QMutex mutex;
+	  QHash<QString, AuthSession> sessions;
+	  QSet<QString> wheel[SESSION_WHEEL_SLOTS];
+	};
+	Shard shards[SESSION_SHARDS];
+	QElapsedTimer clock;
+	qint64 timeout, tick, lastTick;
+	QMutex expireMutex;
+
+	Shard& shardFor(const QString &token){ return shards[qHash(token) % SESSION_SHARDS]; }
+	int slotFor(qint64 expires){ return (int) ((expires/tick) % SESSION_WHEEL_SLOTS); }
+};
+
+#endif
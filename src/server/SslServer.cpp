@@ -0,0 +1,69 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#include "SslServer.h"
+
+#define DEBUG 0
+
+SslServer::SslServer(QObject *parent, QString certfile, QString keyfile) : QTcpServer(parent){
+  certFile = certfile;
+  keyFile = keyfile;
+  watcher = new QFileSystemWatcher(this);
+  connect(watcher, SIGNAL(fileChanged(const QString&)), this, SLOT(loadConfiguration()) );
+  loadConfiguration();
+}
+
+// === PRIVATE SLOTS ===
+void SslServer::loadConfiguration(){
+  //Files which get replaced (instead of modified) drop out of the watcher - add them again
+  QStringList files; files << certFile << keyFile;
+  for(int i=0; i<files.length(); i++){
+    if(!watcher->files().contains(files[i]) && QFile::exists(files[i]) ){ watcher->addPath(files[i]); }
+  }
+  QSslConfiguration config = QSslConfiguration::defaultConfiguration();
+  config.setProtocol(SSLVERSION);
+  //Note: Qt builds a new TLS context for every socket (own session cache and ticket keys),
+  //  so sessions can not be resumed across connections - every connection does a full handshake
+  QFile CF(certFile);
+  if(CF.open(QIODevice::ReadOnly) ){
+    config.setLocalCertificate( QSslCertificate(&CF, QSsl::Pem) );
+    CF.close();
+  }else{
+    qWarning() << "Could not read TCP certificate file:" << CF.fileName();
+  }
+  QFile KF(keyFile);
+  if(KF.open(QIODevice::ReadOnly) ){
+    config.setPrivateKey( QSslKey(&KF, QSsl::Rsa, QSsl::Pem) );
+    KF.close();
+  }else{
+    qWarning() << "Could not read TCP key file:" << KF.fileName();
+  }
+  if(!config.localCertificate().isNull() && !config.privateKey().isNull()){
+    sslConfig = config;
+    if(DEBUG){ qDebug() << "Loaded TCP certificate:" << sslConfig.localCertificate().subjectInfo(QSslCertificate::CommonName); }
+  }else if(!sslConfig.localCertificate().isNull()){
+    //Files are probably in the middle of being replaced - keep using the last good pair
+    qWarning() << "Could not load the new TCP certificate/key - keeping the previous one";
+  }else{
+    sslConfig = config;
+  }
+}
+
+// === PROTECTED ===
+void SslServer::incomingConnection(qintptr socketDescriptor){
+  QSslSocket *serverSocket = new QSslSocket(this);
+  //qDebug() << "New Ssl Connection:";
+  serverSocket->setSslConfiguration(sslConfig); //pre-parsed certificate/key (implicitly shared)
+  //qDebug() << " - Supported Protocols:" << serverSocket->sslConfiguration().protocol();
+
+  if (serverSocket->setSocketDescriptor(socketDescriptor)) {
+    pendingConnections.enqueue(serverSocket);
+    //connect(serverSocket, SIGNAL(encrypted()), this, SLOT(ready()));
+    //qDebug() << " - Starting Server Encryption Handshake";
+    //serverSocket->startServerEncryption();
+  }else{
+    delete serverSocket;
+  }
+}
@@ -12,42 +12,29 @@
 
 class SslServer : public QTcpServer{
 	Q_OBJECT
-private: 
+private:
 	QQueue<QSslSocket*> pendingConnections;
+	QString certFile, keyFile;
+	QSslConfiguration sslConfig; //shared by all the connections (certificate/key only read from disk once)
+	QFileSystemWatcher *watcher;
+
+private slots:
+	void loadConfiguration(); //(re)read the certificate and key files
 
 public:
-	SslServer(QObject *parent=0) : QTcpServer(parent){}
+	SslServer(QObject *parent=0, QString certfile = SSLCERTFILE, QString keyfile = SSLKEYFILE);
 	~SslServer(){}
-	
+
 	bool hasPendingConnections() const{
 	  return !pendingConnections.isEmpty();
 	}
-	
+
 	QSslSocket* nextPendingConnection(){
 	  if( pendingConnections.isEmpty() ){ return 0; }
 	  else{ return pendingConnections.dequeue(); }
 	}
 protected:
-	void incomingConnection(qintptr socketDescriptor){
-	  QSslSocket *serverSocket = new QSslSocket(this);
-	  //qDebug() << "New Ssl Connection:";
-	  //setup any supported encruption types here
-	  serverSocket->setSslConfiguration(QSslConfiguration::defaultConfiguration());
-	  serverSocket->setProtocol(SSLVERSION);
-	  serverSocket->setPrivateKey(SSLKEYFILE);
-	  serverSocket->setLocalCertificate(SSLCERTFILE);
-	  //qDebug() << " - Supported Protocols:" << serverSocket->sslConfiguration().protocol();
-
-	  if (serverSocket->setSocketDescriptor(socketDescriptor)) {
-	    pendingConnections.enqueue(serverSocket);
-	    //connect(serverSocket, SIGNAL(encrypted()), this, SLOT(ready()));
-	    //qDebug() << " - Starting Server Encryption Handshake";
-            //serverSocket->startServerEncryption();
-	  }else{
-            delete serverSocket;
-	  }		
-	}
-	
+	void incomingConnection(qintptr socketDescriptor);
 
 };
 #endif
@@ -0,0 +1,163 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#include "TimerWheel.h"
+
+#include <QThreadStorage>
+
+#define SLOT_MASK (WHEEL_SLOTS-1)
+#define MAX_TICKS ( ((qint64) 1) << (WHEEL_SLOT_BITS*WHEEL_LEVELS) )
+
+// === SINGLE TIMER ===
+WheelTimer::WheelTimer(){
+  wheel = 0;
+  prev = next = 0;
+  bucket = 0;
+  expires = 0;
+}
+
+WheelTimer::~WheelTimer(){
+  stop();
+}
+
+void WheelTimer::setCallback(std::function<void()> fn){
+  callback = fn;
+}
+
+void WheelTimer::start(int msecs){
+  if(wheel==0){ wheel = TimerWheel::local(); }
+  if(bucket!=0){ wheel->remove(this); }
+  wheel->add(this, msecs);
+}
+
+void WheelTimer::stop(){
+  if(wheel!=0 && bucket!=0){ wheel->remove(this); }
+}
+
+bool WheelTimer::isActive(){
+  return (bucket!=0);
+}
+
+// === TIMER WHEEL ===
+TimerWheel* TimerWheel::local(){
+  static QThreadStorage<TimerWheel*> wheels; //deleted automatically when the thread exits
+  if(!wheels.hasLocalData()){ wheels.setLocalData(new TimerWheel()); }
+  return wheels.localData();
+}
+
+TimerWheel::TimerWheel() : QObject(){
+  for(int l=0; l<WHEEL_LEVELS; l++){
+    for(int s=0; s<WHEEL_SLOTS; s++){ buckets[l][s] = 0; }
+  }
+  running = 0;
+  clock.start();
+  current = 0;
+  tickTimer = new QTimer(this);
+    tickTimer->setInterval(WHEEL_TICK_MSECS);
+  connect(tickTimer, SIGNAL(timeout()), this, SLOT(advance()) );
+}
+
+TimerWheel::~TimerWheel(){
+  //Detach any timers which are still filed (their owners might outlive the thread's wheel)
+  for(int l=0; l<WHEEL_LEVELS; l++){
+    for(int s=0; s<WHEEL_SLOTS; s++){
+      WheelTimer *timer = buckets[l][s];
+      while(timer!=0){
+        WheelTimer *next = timer->next;
+        timer->prev = timer->next = 0;
+        timer->bucket = 0;
+        timer->wheel = 0;
+        timer = next;
+      }
+    }
+  }
+}
+
+int TimerWheel::count(){
+  return running;
+}
+
+// === PRIVATE ===
+void TimerWheel::add(WheelTimer *timer, int msecs){
+  qint64 now = clock.elapsed()/WHEEL_TICK_MSECS;
+  if(running==0){ current = now; } //nothing filed - skip straight to the current time
+  qint64 ticks = (msecs + WHEEL_TICK_MSECS - 1)/WHEEL_TICK_MSECS;
+  if(ticks<1){ ticks = 1; } //never run in the tick which is being processed right now
+  timer->expires = qMax(now, current) + ticks;
+  file(timer);
+  running++;
+  if(!tickTimer->isActive()){ tickTimer->start(); }
+}
+
+void TimerWheel::remove(WheelTimer *timer){
+  unlink(timer);
+  running--;
+  if(running==0){ tickTimer->stop(); }
+}
+
+void TimerWheel::file(WheelTimer *timer){
+  qint64 delta = timer->expires - current;
+  WheelTimer **list = 0;
+  if(delta<=0){
+    list = &buckets[0][current & SLOT_MASK]; //overdue - runs with the current tick
+  }else if(delta < WHEEL_SLOTS){
+    list = &buckets[0][timer->expires & SLOT_MASK];
+  }else{
+    if(delta >= MAX_TICKS){ timer->expires = current + MAX_TICKS - 1; } //past the end of the wheel
+    int level = 1;
+    while(level < WHEEL_LEVELS-1 && (delta >> (WHEEL_SLOT_BITS*(level+1)))>0 ){ level++; }
+    list = &buckets[level][(timer->expires >> (WHEEL_SLOT_BITS*level)) & SLOT_MASK];
+  }
+  timer->prev = 0;
+  timer->next = *list;
+  if(*list!=0){ (*list)->prev = timer; }
+  *list = timer;
+  timer->bucket = list;
+}
+
+void TimerWheel::unlink(WheelTimer *timer){
+  if(timer->bucket==0){ return; }
+  if(timer->prev!=0){ timer->prev->next = timer->next; }
+  else{ *(timer->bucket) = timer->next; }
+  if(timer->next!=0){ timer->next->prev = timer->prev; }
+  timer->prev = timer->next = 0;
+  timer->bucket = 0;
+}
+
+void TimerWheel::cascade(int level){
+  WheelTimer **list = &buckets[level][(current >> (WHEEL_SLOT_BITS*level)) & SLOT_MASK];
+  WheelTimer *timer = *list;
+  *list = 0;
+  while(timer!=0){
+    WheelTimer *next = timer->next;
+    timer->prev = timer->next = 0;
+    timer->bucket = 0;
+    file(timer); //lands in a finer level now
+    timer = next;
+  }
+}
+
+// === PRIVATE SLOTS ===
+void TimerWheel::advance(){
+  //Catch up on every tick which has passed (the event loop might have been busy)
+  qint64 now = clock.elapsed()/WHEEL_TICK_MSECS;
+  while(current < now && running>0){
+    current++;
+    if( (current & SLOT_MASK)==0 ){
+      //Start of a new round on level 0: pull the next group of timers down from the higher levels
+      int level = 1;
+      while(level < WHEEL_LEVELS-1 && ((current >> (WHEEL_SLOT_BITS*level)) & SLOT_MASK)==0 ){ level++; }
+      for( ; level>0; level--){ cascade(level); }
+    }
+    //Run all the timers in this bucket (a callback may stop/start/delete other timers)
+    WheelTimer **list = &buckets[0][current & SLOT_MASK];
+    while(*list!=0){
+      WheelTimer *timer = *list;
+      remove(timer);
+      if(timer->callback){ timer->callback(); }
+    }
+  }
+  if(running==0){ current = now; tickTimer->stop(); }
+}
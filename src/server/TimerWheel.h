@@ -0,0 +1,74 @@
+// ===============================
+//  PC-BSD REST/JSON API Server
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> July 2015
+// =================================
+#ifndef _PCBSD_REST_TIMER_WHEEL_H
+#define _PCBSD_REST_TIMER_WHEEL_H
+
+#include "globals-qt.h"
+
+#include <QElapsedTimer>
+#include <functional>
+
+#define WHEEL_TICK_MSECS 500 //timer resolution
+#define WHEEL_LEVELS 3 //levels in the wheel hierarchy
+#define WHEEL_SLOT_BITS 6 //64 slots per level (3 levels: up to ~36 hours)
+#define WHEEL_SLOTS (1<<WHEEL_SLOT_BITS)
+
+class TimerWheel;
+
+// == Single timer filed in the wheel of the current thread ==
+// Meant to be used as a plain member (no allocation/QObject per timer). (Re)starting or stopping
+//  a timer just moves it between two bucket lists (O(1)) - nothing gets registered with the event loop.
+// NOTE: Only use a timer from the thread which owns the object it belongs to.
+class WheelTimer{
+public:
+	WheelTimer();
+	~WheelTimer();
+
+	void setCallback(std::function<void()> fn);
+	void start(int msecs); //(re)start the countdown
+	void stop();
+	bool isActive();
+
+private:
+	friend class TimerWheel;
+	std::function<void()> callback;
+	TimerWheel *wheel; //wheel of the thread this timer was first started in
+	WheelTimer *prev, *next; //bucket list
+	WheelTimer **bucket; //list this timer is currently filed under (0: not running)
+	qint64 expires; //wheel tick this timer runs out on
+};
+
+// == Hierarchical timer wheel (one per thread) ==
+// A single tick timer drives all the WheelTimers of one thread. Timers far in the future sit in
+//  the coarse levels and get cascaded down to the finer levels as their time approaches.
+class TimerWheel : public QObject{
+	Q_OBJECT
+public:
+	static TimerWheel* local(); //wheel for the current thread (created on first use)
+
+	~TimerWheel();
+	int count(); //number of running timers
+
+private:
+	TimerWheel();
+	WheelTimer *buckets[WHEEL_LEVELS][WHEEL_SLOTS]; //bucket lists for each level
+	QTimer *tickTimer;
+	QElapsedTimer clock;
+	qint64 current; //last tick which was processed
+	int running;
+
+	void add(WheelTimer *timer, int msecs);
+	void remove(WheelTimer *timer);
+	void file(WheelTimer *timer); //put a timer into the right bucket for its expiration tick
+	void unlink(WheelTimer *timer);
+	void cascade(int level); //move the timers of the current bucket in this level down
+	friend class WheelTimer;
+
+private slots:
+	void advance();
+};
+
+#endif
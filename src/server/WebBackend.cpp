@@ -3,10 +3,11 @@
 // Available under the 3-clause BSD License
 // Written by: Ken Moore <ken@pcbsd.org> DEC 2015
 // =================================
-//  Note: Don't forget to run "AUTHSYSTEM->hasFullAccess(SockAuthToken)"
-//    To restrict user access to some systems as needed!
+//  Note: Access levels are declared along with each action in RegisterSubsystems()
+//    (actions flagged as "full access" are rejected for normal users automatically)
 // =================================
 #include <WebSocket.h>
+#include "BackendTable.h"
 
 //sysadm library interface classes
 #include "library/sysadm-beadm.h"
@@ -29,86 +30,388 @@
 
 #define DEBUG 0
 //#define SCLISTDELIM QString("::::") //SysCache List Delimiter
-RestOutputStruct::ExitCode WebSocket::AvailableSubsystems(bool allaccess, QJsonObject *out){
-  //Probe the various subsystems to see what is available through this server
-  //Output format:
+
+//Routing table for all the backend subsystems (built once in RegisterSubsystems)
+static BackendTable *BACKEND = 0;
+
+void WebSocket::RegisterSubsystems(CapabilityRegistry *reg){
+  //Register the various subsystems/actions which might be available through this server
+  //  (the registry probes for the listed files and caches the results)
+  //Output format (rpc/query):
   /*<out>{
 	<namespace1/name1> : <read/write/other>,
 	<namespace2/name2> : <read/write/other>,
       }
   */
-  // - server settings (always available)
-  out->insert("rpc/settings","read/write");
-  out->insert("rpc/logs", allaccess ? "read/write" : "read");
+  if(BACKEND!=0){ BACKEND->registerCapabilities(reg); return; } //table already built
+  BACKEND = new BackendTable();
+  BackendSubsystem *sub = 0;
+  const bool FULL = true; //action restricted to full-access sessions
+  const bool ANY = false; //action available to any authenticated session
+  //Large listings: same as addCall() unless the client asks for pages ("limit"/"cursor" arguments)
+  auto addCursor = [](BackendSubsystem *sub, QString action, bool fullonly, QStringList required, BackendFunction fn, RowFactory rows){
+    BACKEND->addAction(sub, action, fullonly, required, [action, fn, rows](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+      QJsonObject args = IN.args.toObject();
+      if(args.contains("limit") || args.contains("cursor")){ return sock->EvaluateCursorRequest(action, rows, IN, out); }
+      out->insert(action, fn(args));
+      return RestOutputStruct::OK;
+    });
+  };
 
-  // - beadm
-  if(QFile::exists("/usr/local/sbin/beadm") || QFile::exists("/sbin/beadm") ){
-    out->insert("sysadm/beadm", "read/write");
-  }
+  // - server settings (always available)
+  BACKEND->addSubsystem("rpc", "settings", "read/write", "read/write", QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    return sock->EvaluateSysadmSettingsRequest(IN.args, out);
+  });
+  BACKEND->addSubsystem("rpc", "logs", "read/write", "read", QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    return sock->EvaluateSysadmLogsRequest(IN.fullaccess, IN.args, out);
+  });
+
+  // - server statistics (always available)
+  sub = BACKEND->addSubsystem("rpc", "stats", "read", "read");
+  BACKEND->addAction(sub, "executor", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    //Request worker pool counters (queue depth, busy rejections, queue wait times)
+    out->insert("executor", EXECUTOR->stats());
+    return RestOutputStruct::OK;
+  });
+  BACKEND->addAction(sub, "backend", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    //Per-action call counters and timings
+    out->insert("backend", BACKEND->stats());
+    return RestOutputStruct::OK;
+  });
+  BACKEND->addAction(sub, "compression", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    //Reply compression counters per namespace (size ratio, CPU time)
+    out->insert("compression", COMPRESSOR->stats());
+    return RestOutputStruct::OK;
+  });
+  BACKEND->addAction(sub, "cache", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    //Response cache counters (hits, misses, coalesced requests, invalidations)
+    out->insert("cache", RESPONSECACHE->stats());
+    return RestOutputStruct::OK;
+  });
+  BACKEND->addAction(sub, "limits", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    //Per-IP rate limiter counters (tracked hosts, blacklisted hosts, refused connections/requests)
+    out->insert("limits", HOSTLIMITS->stats());
+    return RestOutputStruct::OK;
+  });
 
   // - dispatcher (Internal to server - always available)
   //"read" is the event notifications, "write" is the ability to queue up jobs
-  out->insert("rpc/dispatcher", allaccess ? "read/write" : "read");
+  sub = BACKEND->addSubsystem("rpc", "dispatcher", "read/write", "read");
+  BACKEND->addAction(sub, "run", FULL, QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    QJsonObject args = IN.args.toObject();
+    QStringList ids = args.keys();
+    ids.removeAll("action"); //already handled the action
+    for(int i=0; i<ids.length(); i++){
+      //Get the list of commands for this id
+      QStringList cmds;
+      QJsonValue val = args.value(ids[i]);
+      if(val.isArray()){ cmds = sock->JsonArrayToStringList(val.toArray()); }
+      else if(val.isString()){ cmds << val.toString(); }
+      else{
+	ids.removeAt(i);
+	i--;
+	continue;
+      }
+      //queue up this process
+      DISPATCHER->queueProcess(ids[i], cmds);
+    }
+    //Return the PENDING result
+    LogManager::log(LogManager::HOST, "Client Launched Processes["+sock->SockPeerIP+"]: "+ids.join(",") );
+    out->insert("started", QJsonArray::fromStringList(ids));
+    return RestOutputStruct::OK;
+  });
+  BACKEND->addAction(sub, "list", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    out->insert("jobs", DISPATCHER->listJobs());
+    return RestOutputStruct::OK;
+  });
+  BACKEND->addAction(sub, "kill", FULL, QStringList() << "job_id", [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    QStringList ids;
+    QJsonValue val = IN.args.toObject().value("job_id");
+    if(val.isArray()){ ids = sock->JsonArrayToStringList(val.toArray()); }
+    else if(val.isString()){ ids << val.toString(); }
+    else{ return RestOutputStruct::BADREQUEST; }
+    out->insert("killed", DISPATCHER->killJobs(ids));
+    return RestOutputStruct::OK;
+  });
+
+  // - beadm
+  sub = BACKEND->addSubsystem("sysadm", "beadm", "read/write", "read/write", QStringList() << "/usr/local/sbin/beadm|/sbin/beadm");
+  BACKEND->addCall(sub, "listbes", ANY, QStringList(), [](QJsonObject){ return sysadm::BEADM::listBEs(); });
+  BACKEND->addCall(sub, "renamebe", ANY, QStringList(), sysadm::BEADM::renameBE);
+  BACKEND->addCall(sub, "activatebe", ANY, QStringList(), sysadm::BEADM::activateBE);
+  BACKEND->addCall(sub, "createbe", ANY, QStringList(), sysadm::BEADM::createBE);
+  BACKEND->addCall(sub, "destroybe", ANY, QStringList(), sysadm::BEADM::destroyBE);
+  BACKEND->addCall(sub, "mountbe", ANY, QStringList(), sysadm::BEADM::mountBE);
+  BACKEND->addCall(sub, "umountbe", ANY, QStringList(), sysadm::BEADM::umountBE);
+  BACKEND->setCache(sub, "listbes", 10, QStringList() << "renamebe" << "activatebe" << "createbe" << "destroybe" << "mountbe" << "umountbe");
 
   // - filesystem
-  out->insert("sysadm/fs","read/write");
+  sub = BACKEND->addSubsystem("sysadm", "fs", "read/write", "read/write");
+  BACKEND->addCall(sub, "dirlist", ANY, QStringList(), sysadm::FS::list_dir);
 
   // - network
-  out->insert("sysadm/network","read/write");
+  BACKEND->addSubsystem("sysadm", "network", "read/write", "read/write", QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    return sock->EvaluateSysadmNetworkRequest(IN.args, out);
+  });
 
   // - lifepreserver
-  if(QFile::exists("/usr/local/bin/lpreserver")){
-    out->insert("sysadm/lifepreserver", "read/write");
-  }
+  sub = BACKEND->addSubsystem("sysadm", "lifepreserver", "read/write", "read/write", QStringList() << "/usr/local/bin/lpreserver");
+  BACKEND->addCall(sub, "addreplication", ANY, QStringList(), sysadm::LifePreserver::addReplication);
+  BACKEND->addCall(sub, "createsnap", ANY, QStringList(), sysadm::LifePreserver::createSnapshot);
+  BACKEND->addCall(sub, "cronscrub", ANY, QStringList(), sysadm::LifePreserver::scheduleScrub);
+  BACKEND->addCall(sub, "cronsnap", ANY, QStringList(), sysadm::LifePreserver::scheduleSnapshot);
+  BACKEND->addCall(sub, "initreplication", ANY, QStringList(), sysadm::LifePreserver::initReplication);
+  BACKEND->addCall(sub, "listcron", ANY, QStringList(), [](QJsonObject){ return sysadm::LifePreserver::listCron(); });
+  BACKEND->addCall(sub, "listreplication", ANY, QStringList(), [](QJsonObject){ return sysadm::LifePreserver::listReplication(); });
+  addCursor(sub, "listsnap", ANY, QStringList(), sysadm::LifePreserver::listSnap, sysadm::LifePreserver::listSnapRows);
+  BACKEND->addCall(sub, "removereplication", ANY, QStringList(), sysadm::LifePreserver::removeReplication);
+  BACKEND->addCall(sub, "removesnap", ANY, QStringList(), sysadm::LifePreserver::removeSnapshot);
+  BACKEND->addCall(sub, "revertsnap", ANY, QStringList(), sysadm::LifePreserver::revertSnapshot);
+  BACKEND->addCall(sub, "runreplication", ANY, QStringList(), sysadm::LifePreserver::runReplication);
+  BACKEND->addCall(sub, "savesettings", ANY, QStringList(), sysadm::LifePreserver::saveSettings);
+  BACKEND->addCall(sub, "settings", ANY, QStringList(), [](QJsonObject){ return sysadm::LifePreserver::settings(); });
+  BACKEND->setCache(sub, "listcron", 30, QStringList() << "cronscrub" << "cronsnap");
 
   // - iocage
-  if(QFile::exists("/usr/local/bin/iocage")){
-    out->insert("sysadm/iocage", "read/write");
-  }
+  sub = BACKEND->addSubsystem("sysadm", "iocage", "read/write", "read/write", QStringList() << "/usr/local/bin/iocage");
+  BACKEND->addCall(sub, "activatepool", ANY, QStringList(), sysadm::Iocage::activatePool, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "deactivatepool", ANY, QStringList(), sysadm::Iocage::deactivatePool, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "activatestatus", ANY, QStringList(), [](QJsonObject){ return sysadm::Iocage::activateStatus(); }, BackendTable::RESULT_REQUIRED);
+  //JAILS (GENERIC)
+  BACKEND->addCall(sub, "listjails", ANY, QStringList(), [](QJsonObject){ return sysadm::Iocage::listJails(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->setCache(sub, "listjails", 10, QStringList() << "activatepool" << "deactivatepool");
+  //TEMPLATES
+  BACKEND->addCall(sub, "listtemplates", ANY, QStringList(), [](QJsonObject){ return sysadm::Iocage::listTemplates(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "cleantemplates", ANY, QStringList(), [](QJsonObject){ return sysadm::Iocage::cleanTemplates(); }, BackendTable::RESULT_REQUIRED);
+  //RELEASES
+  BACKEND->addCall(sub, "listreleases", ANY, QStringList(), [](QJsonObject){ return sysadm::Iocage::listReleases(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "fetchreleases", ANY, QStringList(), sysadm::Iocage::fetchReleases, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "cleanreleases", ANY, QStringList(), [](QJsonObject){ return sysadm::Iocage::cleanReleases(); }, BackendTable::RESULT_REQUIRED);
+  //PLUGINS
+  BACKEND->addCall(sub, "listplugins", ANY, QStringList(), [](QJsonObject){ return sysadm::Iocage::listPlugins(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "createplugin", ANY, QStringList(), sysadm::Iocage::fetchPlugin, BackendTable::RESULT_REQUIRED);
 
   // - iohyve
-  if(QFile::exists("/usr/local/sbin/iohyve")){
-    out->insert("sysadm/iohyve", "read/write");
-  }
+  sub = BACKEND->addSubsystem("sysadm", "iohyve", "read/write", "read/write", QStringList() << "/usr/local/sbin/iohyve");
+  BACKEND->addCall(sub, "adddisk", ANY, QStringList(), sysadm::Iohyve::addDisk);
+  BACKEND->addCall(sub, "create", ANY, QStringList(), sysadm::Iohyve::createGuest);
+  BACKEND->addCall(sub, "delete", ANY, QStringList(), sysadm::Iohyve::deleteGuest);
+  BACKEND->addCall(sub, "deletedisk", ANY, QStringList(), sysadm::Iohyve::deleteDisk);
+  BACKEND->addCall(sub, "listdisks", ANY, QStringList(), sysadm::Iohyve::listDisks);
+  BACKEND->addCall(sub, "listvms", ANY, QStringList(), [](QJsonObject){ return sysadm::Iohyve::listVMs(); });
+  BACKEND->addAction(sub, "listisos", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    out->insert("listisos", sysadm::Iohyve::listISOs()); //array output
+    return RestOutputStruct::OK;
+  });
+  BACKEND->addCall(sub, "fetchiso", ANY, QStringList(), sysadm::Iohyve::fetchISO);
+  BACKEND->addCall(sub, "install", ANY, QStringList(), sysadm::Iohyve::installGuest);
+  BACKEND->addCall(sub, "issetup", ANY, QStringList(), [](QJsonObject){ return sysadm::Iohyve::isSetup(); });
+  BACKEND->addCall(sub, "renameiso", ANY, QStringList(), sysadm::Iohyve::renameISO);
+  BACKEND->addCall(sub, "rmiso", ANY, QStringList(), sysadm::Iohyve::rmISO);
+  BACKEND->addCall(sub, "resizedisk", ANY, QStringList(), sysadm::Iohyve::resizeDisk);
+  BACKEND->addCall(sub, "setup", ANY, QStringList(), sysadm::Iohyve::setupIohyve);
+  BACKEND->addCall(sub, "start", ANY, QStringList(), sysadm::Iohyve::startGuest);
+  BACKEND->addCall(sub, "stop", ANY, QStringList(), sysadm::Iohyve::stopGuest);
+  BACKEND->addCall(sub, "version", ANY, QStringList(), [](QJsonObject){ return sysadm::Iohyve::version(); });
 
   // - zfs
-  if(QFile::exists("/sbin/zfs") && QFile::exists("/sbin/zpool")){
-    out->insert("sysadm/zfs", allaccess ? "read/write" : "read");
-  }
+  sub = BACKEND->addSubsystem("sysadm", "zfs", "read/write", "read", QStringList() << "/sbin/zfs" << "/sbin/zpool");
+  BACKEND->addCall(sub, "list_pools", ANY, QStringList(), [](QJsonObject){ return sysadm::ZFS::zpool_list(); }, BackendTable::RESULT_SKIP_EMPTY);
+  BACKEND->addCall(sub, "datasets", ANY, QStringList(), sysadm::ZFS::zfs_list);
+  BACKEND->setCache(sub, "list_pools", 10);
 
   // - pkg
-  if(QFile::exists("/usr/local/sbin/pkg") || QFile::exists("/usr/sbin/pkg")){
-    out->insert("sysadm/pkg", "read/write");
-  }
+  BACKEND->addSubsystem("sysadm", "pkg", "read/write", "read/write", QStringList() << "/usr/local/sbin/pkg|/usr/sbin/pkg", [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    //pkg_info listings can be paged (a full repository is thousands of packages)
+    QJsonObject args = IN.args.toObject();
+    if(args.value("action").toString()=="pkg_info" && (args.contains("limit") || args.contains("cursor")) ){
+      return sock->EvaluateCursorRequest("pkg_info", sysadm::PKG::pkg_info_rows, IN, out);
+    }
+    return sock->EvaluateSysadmPkgRequest(IN.args, out);
+  });
 
   // - Generic system information
-  out->insert("sysadm/systemmanager","read/write");
+  sub = BACKEND->addSubsystem("sysadm", "systemmanager", "read/write", "read/write");
+  BACKEND->addCall(sub, "batteryinfo", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::batteryInfo(); });
+  BACKEND->addCall(sub, "cpupercentage", ANY, QStringList(), sysadm::SysMgmt::cpuPercentage);
+  BACKEND->addCall(sub, "cputemps", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::cpuTemps(); });
+  BACKEND->addCall(sub, "externalmounts", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::externalDevicePaths(); });
+  BACKEND->addCall(sub, "halt", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::systemHalt(); });
+  BACKEND->addCall(sub, "killproc", ANY, QStringList(), sysadm::SysMgmt::killProc);
+  BACKEND->addCall(sub, "memorystats", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::memoryStats(); });
+  addCursor(sub, "procinfo", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::procInfo(); }, [](QJsonObject){ return sysadm::SysMgmt::procInfoRows(); });
+  BACKEND->addCall(sub, "reboot", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::systemReboot(); });
+  BACKEND->addCall(sub, "getsysctl", ANY, QStringList(), sysadm::SysMgmt::getSysctl);
+  BACKEND->addCall(sub, "setsysctl", ANY, QStringList(), sysadm::SysMgmt::setSysctl);
+  addCursor(sub, "sysctllist", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::sysctlList(); }, [](QJsonObject){ return sysadm::SysMgmt::sysctlListRows(); });
+  BACKEND->addCall(sub, "systeminfo", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::systemInfo(); });
+  BACKEND->addCall(sub, "deviceinfo", ANY, QStringList(), [](QJsonObject){ return sysadm::SysMgmt::systemDevices(); });
+  BACKEND->setCache(sub, "systeminfo", 10);
+
+  // - System statistics history (internal to the server - always available)
+  sub = BACKEND->addSubsystem("sysadm", "metrics", "read", "read");
+  BACKEND->addAction(sub, "list", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    //Available series and resolutions
+    out->insert("list", METRICS->info());
+    return RestOutputStruct::OK;
+  });
+  BACKEND->addAction(sub, "query", ANY, QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    //Inputs (all optional): "series" (name/pattern or array of them), "start"/"end" (epoch seconds, 0 or negative: relative to now), "step" (seconds)
+    QJsonObject args = IN.args.toObject();
+    QStringList series;
+    QJsonValue val = args.value("series");
+    if(val.isArray()){ series = sock->JsonArrayToStringList(val.toArray()); }
+    else if(val.isString()){ series << val.toString(); }
+    //Numbers may come in as JSON numbers or strings
+    auto num = [&args](QString key, qint64 def, bool *ok) -> qint64{
+      QJsonValue v = args.value(key);
+      if(v.isUndefined()){ *ok = true; return def; }
+      if(v.isDouble()){ *ok = true; return qint64(v.toDouble()); }
+      return v.toString().toLongLong(ok);
+    };
+    bool ok1 = false, ok2 = false, ok3 = false;
+    qint64 start = num("start", -3600, &ok1);
+    qint64 end = num("end", 0, &ok2);
+    qint64 step = num("step", 0, &ok3);
+    if(!ok1 || !ok2 || !ok3 || step<0){ return RestOutputStruct::BADREQUEST; }
+    out->insert("query", METRICS->query(series, start, end, step));
+    return RestOutputStruct::OK;
+  });
 
   // - Legacy PC-BSD/TrueOS Updater
-  if( QFile::exists("/usr/local/bin/pc-updatemanager") ){
-    out->insert("sysadm/update", "read/write");
-  }
+  sub = BACKEND->addSubsystem("sysadm", "update", "read/write", "read/write", QStringList() << "/usr/local/bin/pc-updatemanager");
+  BACKEND->addCall(sub, "checkupdates", ANY, QStringList(), [](QJsonObject args){
+    bool fastcheck = args.value("force").toString().toLower()!="true";
+    return sysadm::Update::checkUpdates(fastcheck);
+  });
+  BACKEND->addCall(sub, "listbranches", ANY, QStringList(), [](QJsonObject){ return sysadm::Update::listBranches(); });
+  BACKEND->addCall(sub, "startupdate", ANY, QStringList(), sysadm::Update::startUpdate);
+  BACKEND->addCall(sub, "stopupdate", ANY, QStringList(), [](QJsonObject){ return sysadm::Update::stopUpdate(); });
+  BACKEND->addCall(sub, "applyupdate", ANY, QStringList(), [](QJsonObject){ return sysadm::Update::applyUpdates(); });
+  BACKEND->addCall(sub, "listsettings", ANY, QStringList(), [](QJsonObject){ return sysadm::Update::readSettings(); });
+  BACKEND->addCall(sub, "changesettings", ANY, QStringList(), sysadm::Update::writeSettings);
+  BACKEND->addCall(sub, "listlogs", ANY, QStringList(), [](QJsonObject){ return sysadm::Update::listLogs(); });
+  BACKEND->addCall(sub, "readlogs", ANY, QStringList() << "logs", sysadm::Update::readLog);
 
   // - User Manager
-  out->insert("sysadm/users","read/write");
+  sub = BACKEND->addSubsystem("sysadm", "users", "read/write", "read/write");
+  BACKEND->addAction(sub, "usershow", ANY, QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    bool ok = sysadm::UserManager::listUsers(out, IN.fullaccess, sock->AUTHSYSTEM->userForToken(sock->authToken()));
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "useradd", FULL, QStringList(), [](WebSocket*, const RestInputStruct &IN, QJsonObject *out){
+    bool ok = sysadm::UserManager::addUser(out, IN.args.toObject());
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "userdelete", FULL, QStringList() << "name", [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    //OPTIONAL: "clean_home"="false" (true by default)
+    QString deluser = IN.args.toObject().value("name").toString();
+    if(deluser == sock->AUTHSYSTEM->userForToken(sock->authToken())){ //cannot delete the currently-used user
+      out->insert("error","Cannot delete the current user");
+      return RestOutputStruct::BADREQUEST;
+    }
+    bool clean = true;
+    if(IN.args.toObject().contains("clean_home")){ clean = (IN.args.toObject().value("clean_home").toString().toLower() != "false"); }
+    bool ok = sysadm::UserManager::removeUser(deluser, clean);
+    if(ok){ out->insert("result","success"); }
+    else{ out->insert("error","Could not delete user"); }
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "usermod", ANY, QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    //ensure that the user being acted on is the current user - otherwise deny access
+    if(!IN.fullaccess && IN.args.toObject().value("name").toString() != sock->AUTHSYSTEM->userForToken(sock->authToken())){ return RestOutputStruct::BADREQUEST; }
+    bool ok = sysadm::UserManager::modifyUser(out, IN.args.toObject() );
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "groupshow", ANY, QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    bool ok = sysadm::UserManager::listGroups(out, (IN.fullaccess ? "" : sock->AUTHSYSTEM->userForToken(sock->authToken())) );
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "groupadd", FULL, QStringList(), [](WebSocket*, const RestInputStruct &IN, QJsonObject *out){
+    bool ok = sysadm::UserManager::addGroup(out, IN.args.toObject() );
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "groupdelete", FULL, QStringList() << "name", [](WebSocket*, const RestInputStruct &IN, QJsonObject *out){
+    QString name = IN.args.toObject().value("name").toString();
+    bool ok = false;
+    if(!name.isEmpty()){ ok = sysadm::UserManager::removeGroup(name); }
+    if(ok){ out->insert("result","success"); }
+    else{ out->insert("error","Could not delete group"); }
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "groupmod", FULL, QStringList(), [](WebSocket*, const RestInputStruct &IN, QJsonObject *out){
+    bool ok = sysadm::UserManager::modifyGroup(out, IN.args.toObject() );
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "personacrypt_init", ANY, QStringList() << "name" << "password" << "device", [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    QJsonObject obj = IN.args.toObject();
+    //ensure that the user being acted on is the current user - otherwise deny access
+    if(!IN.fullaccess && obj.value("name").toString() != sock->AUTHSYSTEM->userForToken(sock->authToken())){ return RestOutputStruct::BADREQUEST; }
+    bool ok = sysadm::UserManager::InitializePersonaCryptDevice(obj.value("name").toString(), obj.value("password").toString(), obj.value("device").toString() );
+    if(ok){ out->insert("result","success"); }
+    else{ out->insert("error","Could not initialize Personacrypt device"); }
+    return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
+  });
+  BACKEND->addAction(sub, "personacrypt_listdevs", ANY, QStringList(), [](WebSocket*, const RestInputStruct&, QJsonObject *out){
+    QStringList devs = sysadm::UserManager::getAvailablePersonaCryptDevices();
+    for(int i=0; i<devs.length(); i++){
+      out->insert(devs[i].section(":",0,0), devs[i].section(":",1,-1).simplified()); //<device>:<info>
+    }
+    return RestOutputStruct::OK;
+  });
+
   //- Service Manager
-  out->insert("sysadm/services","read/write");
+  sub = BACKEND->addSubsystem("sysadm", "services", "read/write", "read/write", QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    return sock->EvaluateSysadmServiceRequest(IN.args, out);
+  });
+  BACKEND->setCache(sub, "list_services", 10, QStringList() << "start" << "stop" << "restart" << "enable" << "disable");
   // - Firewall Manager
-  out->insert("sysadm/firewall","read/write");
+  BACKEND->addSubsystem("sysadm", "firewall", "read/write", "read/write", QStringList(), [](WebSocket *sock, const RestInputStruct &IN, QJsonObject *out){
+    return sock->EvaluateSysadmFirewallRequest(IN.args, out);
+  });
 
   // - moused
-  if(QFile::exists("/usr/sbin/moused")){
-    out->insert("sysadm/moused", "read/write");
-  }
+  sub = BACKEND->addSubsystem("sysadm", "moused", "read/write", "read/write", QStringList() << "/usr/sbin/moused");
+  BACKEND->addCall(sub, "list_devices", ANY, QStringList(), [](QJsonObject){ return sysadm::moused::listDevices(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "list_devices_active", ANY, QStringList(), [](QJsonObject){ return sysadm::moused::listActiveDevices(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "list_device_options", ANY, QStringList(), [](QJsonObject){ return sysadm::moused::listOptions(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "read_device_options", ANY, QStringList(), sysadm::moused::readOptions, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "set_device_options", ANY, QStringList(), sysadm::moused::setOptions, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "set_device_active", ANY, QStringList(), sysadm::moused::enableDevice, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "set_device_inactive", ANY, QStringList(), sysadm::moused::disableDevice, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "get_tap_to_click", ANY, QStringList(), [](QJsonObject){ return sysadm::moused::tapToClick(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "set_tap_to_click", ANY, QStringList(), sysadm::moused::setTapToClick, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "get_synaptics_options", ANY, QStringList(), [](QJsonObject){ return sysadm::moused::synapticsSettings(); }, BackendTable::RESULT_REQUIRED);
+
   // - powerd
-  if(QFile::exists("/usr/sbin/powerd")){
-    out->insert("sysadm/powerd", "read/write");
-  }
+  sub = BACKEND->addSubsystem("sysadm", "powerd", "read/write", "read/write", QStringList() << "/usr/sbin/powerd");
+  BACKEND->addCall(sub, "list_options", ANY, QStringList(), [](QJsonObject){ return sysadm::powerd::listOptions(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "read_options", ANY, QStringList(), [](QJsonObject){ return sysadm::powerd::readOptions(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "set_options", ANY, QStringList(), sysadm::powerd::setOptions, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "list_status", ANY, QStringList(), [](QJsonObject){ return sysadm::powerd::listStatus(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "set_active", ANY, QStringList(), [](QJsonObject){ return sysadm::powerd::enableService(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "set_inactive", ANY, QStringList(), [](QJsonObject){ return sysadm::powerd::disableService(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "start", ANY, QStringList(), [](QJsonObject){ return sysadm::powerd::startService(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "stop", ANY, QStringList(), [](QJsonObject){ return sysadm::powerd::stopService(); }, BackendTable::RESULT_REQUIRED);
+
   // - sourcectl
-  if(QFile::exists("/usr/local/bin/git")){
-    out->insert("sysadm/sourcectl", "read/write");
-  }
+  sub = BACKEND->addSubsystem("sysadm", "sourcectl", "read/write", "read/write", QStringList() << "/usr/local/bin/git");
+  BACKEND->addCall(sub, "downloadports", ANY, QStringList(), [](QJsonObject){ return sysadm::sourcectl::downloadports(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "updateports", ANY, QStringList(), [](QJsonObject){ return sysadm::sourcectl::updateports(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "deleteports", ANY, QStringList(), [](QJsonObject){ return sysadm::sourcectl::deleteports(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "stopports", ANY, QStringList(), [](QJsonObject){ return sysadm::sourcectl::stopports(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "downloadsource", ANY, QStringList(), [](QJsonObject){ return sysadm::sourcectl::downloadsource(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "updatesource", ANY, QStringList(), [](QJsonObject){ return sysadm::sourcectl::updatesource(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "deletesource", ANY, QStringList(), [](QJsonObject){ return sysadm::sourcectl::deletesource(); }, BackendTable::RESULT_REQUIRED);
+  BACKEND->addCall(sub, "stopsource", ANY, QStringList(), [](QJsonObject){ return sysadm::sourcectl::stopsource(); }, BackendTable::RESULT_REQUIRED);
+
+  //Now hand the subsystem list over to the capability registry
+  BACKEND->registerCapabilities(reg);
+}
 
+RestOutputStruct::ExitCode WebSocket::AvailableSubsystems(bool allaccess, QJsonObject *out){
+  //List the subsystems which are available through this server (cached)
+  *out = CAPABILITIES->subsystems(allaccess);
   return RestOutputStruct::OK;
 }
 
@@ -120,60 +423,71 @@ RestOutputStruct::ExitCode WebSocket::EvaluateBackendRequest(const RestInputStru
 	"out" - JSON output arguments structure
   */
   //qDebug() << "Evaluate Backend Request:" << IN.namesp << IN.name << IN.id << IN.args << IN.fullaccess;
-  QString namesp = IN.namesp.toLower(); QString name = IN.name.toLower();
-
   //Get/Verify subsystems
-  if(namesp=="rpc" && name=="query"){
+  if(IN.namesp.compare("rpc", Qt::CaseInsensitive)==0 && IN.name.compare("query", Qt::CaseInsensitive)==0){
     return AvailableSubsystems(IN.fullaccess, out);
-  }else{
-    QJsonObject avail;
-    AvailableSubsystems(IN.fullaccess, &avail);
-    if(!avail.contains(namesp+"/"+name)){ return RestOutputStruct::NOTFOUND; }
   }
-  //qDebug() << "Evaluate Backend Request:" << namesp << name;
-  //Go through and forward this request to the appropriate sub-system
-  if(namesp=="rpc" && name=="settings"){
-    return EvaluateSysadmSettingsRequest(IN.args, out);
-  }else if(namesp=="rpc" && name=="logs"){
-    return EvaluateSysadmLogsRequest(IN.fullaccess, IN.args, out);
-  }else if(namesp=="rpc" && name=="dispatcher"){
-    return EvaluateDispatcherRequest(IN.fullaccess, IN.args, out);
-  }else if(namesp=="sysadm" && name=="beadm"){
-    return EvaluateSysadmBEADMRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="fs"){
-    return EvaluateSysadmFSRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="iocage"){
-    return EvaluateSysadmIocageRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="iohyve"){
-    return EvaluateSysadmIohyveRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="lifepreserver"){
-    return EvaluateSysadmLifePreserverRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="network"){
-    return EvaluateSysadmNetworkRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="systemmanager"){
-    return EvaluateSysadmSystemMgmtRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="update"){
-    return EvaluateSysadmUpdateRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="zfs"){
-    return EvaluateSysadmZfsRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="pkg"){
-    return EvaluateSysadmPkgRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="users"){
-    return EvaluateSysadmUserRequest(IN.fullaccess, AUTHSYSTEM->userForToken(SockAuthToken), IN.args, out);
-  }else if(namesp=="sysadm" && name=="services"){
-    return EvaluateSysadmServiceRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="firewall"){
-    return EvaluateSysadmFirewallRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="moused"){
-    return EvaluateSysadmMousedRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="powerd"){
-    return EvaluateSysadmPowerdRequest(IN.args, out);
-  }else if(namesp=="sysadm" && name=="sourcectl"){
-    return EvaluateSysadmSourceCTLRequest(IN.args, out);
-  }else{
-    return RestOutputStruct::BADREQUEST;
+  if(STUB_BACKEND){
+    //Benchmark mode: echo the arguments back without touching the system (transport/dispatch overhead only)
+    out->insert(IN.name, IN.args);
+    return RestOutputStruct::OK;
   }
+  BackendSubsystem *sub = (BACKEND==0) ? 0 : BACKEND->find(IN.namesp, IN.name);
+  if(sub==0 || CAPABILITIES->access(sub->key, IN.fullaccess).isEmpty() ){
+    return RestOutputStruct::NOTFOUND;
+  }
+  //Forward this request to the appropriate action (also checks access levels and required arguments)
+  return BACKEND->evaluate(sub, this, IN, out);
+}
 
+// === PAGED LISTINGS ===
+RestOutputStruct::ExitCode WebSocket::EvaluateCursorRequest(QString action, RowFactory rows, const RestInputStruct &IN, QJsonObject *out){
+  /*Inputs (in addition to the normal arguments for the action):
+	"limit" - max number of rows per page (a request without a cursor opens a new one)
+	"cursor" - token from the previous page (read the next page)
+	"close" - ["true"/"false"] discard the cursor without reading any more rows
+    Output:
+	<action> : { rows for this page }
+	"more" : ["true"/"false"]
+	"cursor" : <token> (only if there are more rows)
+  */
+  QJsonObject args = IN.args.toObject();
+  QString owner = SockID;
+  if(!IN.bridgeID.isEmpty()){ owner.append("::::"+IN.bridgeID); }
+  int limit = JsonValueToString(args.value("limit")).toInt();
+  if(limit<=0){ limit = CURSOR_DEFAULT_PAGE; }
+  else if(limit>CURSOR_MAX_PAGE){ limit = CURSOR_MAX_PAGE; }
+  //Find/create the cursor
+  ResultCursor *cursor = 0;
+  QString token = JsonValueToString(args.value("cursor"));
+  if(!token.isEmpty()){
+    cursor = CURSORS->take(token, owner);
+    if(cursor==0){ return RestOutputStruct::NOTFOUND; } //expired or invalid token
+    if(JsonValueToString(args.value("close")).toLower()=="true"){
+      delete cursor;
+      out->insert("more", "false");
+      return RestOutputStruct::OK;
+    }
+  }else{
+    sysadm::RowSource *src = rows(args);
+    if(src==0){ return RestOutputStruct::BADREQUEST; }
+    cursor = new ResultCursor(src);
+  }
+  //Read the page (the client asks for the next one when it is ready for it)
+  QJsonObject page;
+  bool more = cursor->fetch(limit, &page);
+  out->insert(action, page);
+  out->insert("more", more ? "true" : "false");
+  if(!more){ delete cursor; return RestOutputStruct::OK; }
+  //Save the cursor for the next page
+  if(token.isEmpty()){
+    token = CURSORS->open(owner, cursor);
+    if(token.isEmpty()){ delete cursor; return RestOutputStruct::SERVICEUNAVAILABLE; } //too many open cursors
+  }else{
+    CURSORS->putBack(token, cursor);
+  }
+  out->insert("cursor", token);
+  return RestOutputStruct::OK;
 }
 
 // === SYSADM SSL SETTINGS ===
@@ -195,11 +509,11 @@ RestOutputStruct::ExitCode WebSocket::EvaluateSysadmSettingsRequest(const QJsonV
     if(keys.contains("email")){ email = argsO.value("email").toString(); }
 
     if(!pub_key.isEmpty()){
-      ok = AUTHSYSTEM->RegisterCertificate(SockAuthToken, pub_key, nickname, email);
+      ok = AUTHSYSTEM->RegisterCertificate(authToken(), pub_key, nickname, email);
 	    if(!ok){ return RestOutputStruct::FORBIDDEN; }
     }
   }else if(act=="list_ssl_certs"){
-    AUTHSYSTEM->ListCertificates(SockAuthToken, out);
+    AUTHSYSTEM->ListCertificates(authToken(), out);
     ok = true; //always works for current user (even if nothing found)
   }else if(act=="list_ssl_checksums"){
     AUTHSYSTEM->ListCertificateChecksums(out);
@@ -207,7 +521,7 @@ RestOutputStruct::ExitCode WebSocket::EvaluateSysadmSettingsRequest(const QJsonV
   }else if(act=="revoke_ssl_cert" && keys.contains("pub_key") ){
     //Additional arguments: "user" (optional), "pub_key" (String)
     QString user; if(keys.contains("user")){ user = argsO.value("user").toString(); }
-    ok = AUTHSYSTEM->RevokeCertificate(SockAuthToken,argsO.value("pub_key").toString(), user);
+    ok = AUTHSYSTEM->RevokeCertificate(authToken(),argsO.value("pub_key").toString(), user);
   }
 
   if(ok){ return RestOutputStruct::OK; }
@@ -296,118 +610,6 @@ RestOutputStruct::ExitCode WebSocket::EvaluateSysadmLogsRequest(bool allaccess,
   return RestOutputStruct::OK;
 }
 
-//==== DISPATCHER ====
-RestOutputStruct::ExitCode WebSocket::EvaluateDispatcherRequest(bool allaccess, const QJsonValue in_args, QJsonObject *out){
-  //dispatcher only needs a list of sub-commands at the moment (might change later)
-  if(!in_args.isObject() || !in_args.toObject().contains("action") ){ return RestOutputStruct::BADREQUEST; }
-  QString act = in_args.toObject().value("action").toString().toLower();
-
-  //Determine the type of action to perform
-  if(act=="run"){
-    if(!allaccess){ return RestOutputStruct::FORBIDDEN; } //this user does not have permission to queue jobs
-    QStringList ids = in_args.toObject().keys();
-    ids.removeAll("action"); //already handled the action
-    for(int i=0; i<ids.length(); i++){
-      //Get the list of commands for this id
-      QStringList cmds;
-      QJsonValue val = in_args.toObject().value(ids[i]);
-      if(val.isArray()){ cmds = JsonArrayToStringList(val.toArray()); }
-      else if(val.isString()){ cmds << val.toString(); }
-      else{
-	ids.removeAt(i);
-	i--;
-	continue;
-      }
-      //queue up this process
-
-      DISPATCHER->queueProcess(ids[i], cmds);
-    }
-    //Return the PENDING result
-    LogManager::log(LogManager::HOST, "Client Launched Processes["+SockPeerIP+"]: "+ids.join(",") );
-    out->insert("started", QJsonArray::fromStringList(ids));
-  }else if(act=="list"){
-    QJsonObject info = DISPATCHER->listJobs();
-    out->insert("jobs", info);
-  }else if(act=="kill" && in_args.toObject().contains("job_id") ){
-    if(!allaccess){ return RestOutputStruct::FORBIDDEN; } //this user does not have permission to modify jobs
-    QStringList ids;
-    QJsonValue val = in_args.toObject().value("job_id");
-    if(val.isArray()){ ids = JsonArrayToStringList(val.toArray()); }
-    else if(val.isString()){ ids << val.toString(); }
-    else{ return RestOutputStruct::BADREQUEST; }
-    out->insert("killed", DISPATCHER->killJobs(ids));
-  }else{
-    return RestOutputStruct::BADREQUEST;
-  }
-
-  //Return Success
-  return RestOutputStruct::OK;
-}
-
-//==== SYSADM -- BEADM ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmBEADMRequest(const QJsonValue in_args, QJsonObject *out){
-  if(in_args.isObject()){
-    QStringList keys = in_args.toObject().keys();
-    bool ok = false;
-    if(keys.contains("action")){
-      QString act = JsonValueToString(in_args.toObject().value("action")).toLower();
-      if(act=="listbes"){
-	ok = true;
-        out->insert("listbes", sysadm::BEADM::listBEs());
-      }else if(act=="renamebe"){
-	ok = true;
-        out->insert("renamebe", sysadm::BEADM::renameBE(in_args.toObject()));
-      }else if(act=="activatebe"){
-	ok = true;
-        out->insert("activatebe", sysadm::BEADM::activateBE(in_args.toObject()));
-      }else if(act=="createbe"){
-	ok = true;
-        out->insert("createbe", sysadm::BEADM::createBE(in_args.toObject()));
-      }else if(act=="destroybe"){
-	ok = true;
-        out->insert("destroybe", sysadm::BEADM::destroyBE(in_args.toObject()));
-      }else if(act=="mountbe"){
-	ok = true;
-        out->insert("mountbe", sysadm::BEADM::mountBE(in_args.toObject()));
-     }else if(act=="umountbe"){
-	ok = true;
-        out->insert("umountbe", sysadm::BEADM::umountBE(in_args.toObject()));
-      }
-    } //end of "action" key usage
-
-    //If nothing done - return the proper code
-    if(!ok){
-      return RestOutputStruct::BADREQUEST;
-    }
-  }else{  // if(in_args.isArray()){
-    return RestOutputStruct::BADREQUEST;
-  }
-  return RestOutputStruct::OK;
-}
-
-//==== SYSADM -- FS ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmFSRequest(const QJsonValue in_args, QJsonObject *out){
-  if(in_args.isObject()){
-    QStringList keys = in_args.toObject().keys();
-    bool ok = false;
-    if(keys.contains("action")){
-      QString act = JsonValueToString(in_args.toObject().value("action")).toLower();
-      if(act=="dirlist"){
-	ok = true;
-        out->insert("dirlist", sysadm::FS::list_dir(in_args.toObject()));
-      }
-    } //end of "action" key usage
-
-    //If nothing done - return the proper code
-    if(!ok){
-      return RestOutputStruct::BADREQUEST;
-    }
-  }else{  // if(in_args.isArray()){
-    return RestOutputStruct::BADREQUEST;
-  }
-  return RestOutputStruct::OK;
-}
-
 //==== SYSADM -- Network ====
 RestOutputStruct::ExitCode WebSocket::EvaluateSysadmNetworkRequest(const QJsonValue in_args, QJsonObject *out){
   if(in_args.isObject()){
@@ -473,416 +675,6 @@ RestOutputStruct::ExitCode WebSocket::EvaluateSysadmNetworkRequest(const QJsonVa
   return RestOutputStruct::OK;
 }
 
-//==== SYSADM -- LifePreserver ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmLifePreserverRequest(const QJsonValue in_args, QJsonObject *out){
-  if(in_args.isObject()){
-    QStringList keys = in_args.toObject().keys();
-    bool ok = false;
-    if(keys.contains("action")){
-      QString act = JsonValueToString(in_args.toObject().value("action"));
-      if(act=="addreplication"){
-	ok = true;
-        out->insert("addreplication", sysadm::LifePreserver::addReplication(in_args.toObject()));
-      }
-      if(act=="createsnap"){
-	ok = true;
-        out->insert("createsnap", sysadm::LifePreserver::createSnapshot(in_args.toObject()));
-      }
-      if(act=="cronscrub"){
-	ok = true;
-        out->insert("cronscrub", sysadm::LifePreserver::scheduleScrub(in_args.toObject()));
-      }
-      if(act=="cronsnap"){
-	ok = true;
-        out->insert("cronsnap", sysadm::LifePreserver::scheduleSnapshot(in_args.toObject()));
-      }
-      if(act=="initreplication"){
-	ok = true;
-        out->insert("initreplication", sysadm::LifePreserver::initReplication(in_args.toObject()));
-      }
-      if(act=="listcron"){
-	ok = true;
-        out->insert("listcron", sysadm::LifePreserver::listCron());
-      }
-      if(act=="listreplication"){
-	ok = true;
-        out->insert("listreplication", sysadm::LifePreserver::listReplication());
-      }
-      if(act=="listsnap"){
-	ok = true;
-        out->insert("listsnap", sysadm::LifePreserver::listSnap(in_args.toObject()));
-      }
-      if(act=="removereplication"){
-	ok = true;
-        out->insert("removereplication", sysadm::LifePreserver::removeReplication(in_args.toObject()));
-      }
-      if(act=="removesnap"){
-	ok = true;
-        out->insert("removesnap", sysadm::LifePreserver::removeSnapshot(in_args.toObject()));
-      }
-      if(act=="revertsnap"){
-	ok = true;
-        out->insert("revertsnap", sysadm::LifePreserver::revertSnapshot(in_args.toObject()));
-      }
-      if(act=="runreplication"){
-	ok = true;
-        out->insert("runreplication", sysadm::LifePreserver::runReplication(in_args.toObject()));
-      }
-      if(act=="savesettings"){
-	ok = true;
-        out->insert("savesettings", sysadm::LifePreserver::saveSettings(in_args.toObject()));
-      }
-      if(act=="settings"){
-	ok = true;
-        out->insert("settings", sysadm::LifePreserver::settings());
-      }
-
-    } //end of "action" key usage
-
-    //If nothing done - return the proper code
-    if(!ok){
-      return RestOutputStruct::BADREQUEST;
-    }
-  }else{  // if(in_args.isArray()){
-    return RestOutputStruct::BADREQUEST;
-  }
-  return RestOutputStruct::OK;
-}
-
-//==== SYSADM -- SysMgmt ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmSystemMgmtRequest(const QJsonValue in_args, QJsonObject *out){
-  if(in_args.isObject()){
-    QStringList keys = in_args.toObject().keys();
-    bool ok = false;
-    if(keys.contains("action")){
-      QString act = JsonValueToString(in_args.toObject().value("action"));
-      if(act=="batteryinfo"){
-	ok = true;
-        out->insert("batteryinfo", sysadm::SysMgmt::batteryInfo());
-      }
-      else if(act=="cpupercentage"){
-	ok = true;
-        out->insert("cpupercentage", sysadm::SysMgmt::cpuPercentage());
-      }
-      else if(act=="cputemps"){
-	ok = true;
-        out->insert("cputemps", sysadm::SysMgmt::cpuTemps());
-      }
-      else if(act=="externalmounts"){
-	ok = true;
-        out->insert("externalmounts", sysadm::SysMgmt::externalDevicePaths());
-      }
-      else if(act=="halt"){
-	ok = true;
-        out->insert("halt", sysadm::SysMgmt::systemHalt());
-      }
-      else if(act=="killproc"){
-	ok = true;
-        out->insert("killproc", sysadm::SysMgmt::killProc(in_args.toObject()));
-      }
-      else if(act=="memorystats"){
-	ok = true;
-        out->insert("memorystats", sysadm::SysMgmt::memoryStats());
-      }
-      else if(act=="procinfo"){
-	ok = true;
-        out->insert("procinfo", sysadm::SysMgmt::procInfo());
-      }
-      else if(act=="reboot"){
-	ok = true;
-        out->insert("reboot", sysadm::SysMgmt::systemReboot());
-      }
-      else if(act=="getsysctl"){
-	ok = true;
-        out->insert("getsysctl", sysadm::SysMgmt::getSysctl(in_args.toObject()));
-      }
-      else if(act=="setsysctl"){
-	ok = true;
-        out->insert("setsysctl", sysadm::SysMgmt::setSysctl(in_args.toObject()));
-      }
-      else if(act=="sysctllist"){
-	ok = true;
-        out->insert("sysctllist", sysadm::SysMgmt::sysctlList());
-      }
-      else if(act=="systeminfo"){
-	ok = true;
-        out->insert("systeminfo", sysadm::SysMgmt::systemInfo());
-      }
-      else if(act=="deviceinfo"){
-        ok = true;
-        out->insert("deviceinfo", sysadm::SysMgmt::systemDevices());
-      }
-
-    } //end of "action" key usage
-
-    //If nothing done - return the proper code
-    if(!ok){
-      return RestOutputStruct::BADREQUEST;
-    }
-  }else{  // if(in_args.isArray()){
-    return RestOutputStruct::BADREQUEST;
-  }
-  return RestOutputStruct::OK;
-}
-
-//==== SYSADM -- Update ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmUpdateRequest(const QJsonValue in_args, QJsonObject *out){
-  if(in_args.isObject()){
-    QStringList keys = in_args.toObject().keys();
-    bool ok = false;
-    if(keys.contains("action")){
-      QString act = JsonValueToString(in_args.toObject().value("action"));
-      if(act=="checkupdates"){
-	ok = true;
-        bool fastcheck = true;
-        fastcheck = in_args.toObject().value("force").toString().toLower()!="true";
-        out->insert("checkupdates", sysadm::Update::checkUpdates(fastcheck));
-
-      }else if(act=="listbranches"){
-	ok = true;
-        out->insert("listbranches", sysadm::Update::listBranches());
-
-      }else if(act=="startupdate"){
-	ok = true;
-	out->insert("startupdate", sysadm::Update::startUpdate(in_args.toObject()) );
-
-      }else if(act=="stopupdate"){
-	ok = true;
-	out->insert("stopupdate", sysadm::Update::stopUpdate() );
-
-      }else if(act=="applyupdate"){
-	ok = true;
-	out->insert("applyupdate", sysadm::Update::applyUpdates() );
-
-      }else if(act=="listsettings"){
-	ok = true;
-	out->insert("listsettings", sysadm::Update::readSettings() );
-
-      }else if(act=="changesettings"){
-	ok = true;
-	out->insert("changesettings", sysadm::Update::writeSettings(in_args.toObject()) );
-
-      }else if(act=="listlogs"){
-        ok = true;
-        out->insert("listlogs", sysadm::Update::listLogs() );
-
-      }else if(act=="readlogs" && in_args.toObject().contains("logs") ){
-        ok = true;
-        out->insert("readlogs", sysadm::Update::readLog(in_args.toObject()) );
-      }
-
-    } //end of "action" key usage
-
-    //If nothing done - return the proper code
-    if(!ok){
-      return RestOutputStruct::BADREQUEST;
-    }
-  }else{  // if(in_args.isArray()){
-    return RestOutputStruct::BADREQUEST;
-  }
-  return RestOutputStruct::OK;
-}
-
-//==== SYSADM -- iocage ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmIocageRequest(const QJsonValue in_args, QJsonObject *out){
-  if(in_args.isObject()){
-    QStringList keys = in_args.toObject().keys();
-    bool ok = false;
-    if(keys.contains("action")){
-      QString act = JsonValueToString(in_args.toObject().value("action"));
-      QJsonObject retObj;
-      if(act=="activatepool"){  retObj = sysadm::Iocage::activatePool(in_args.toObject());  }
-      else if(act=="deactivatepool"){retObj = sysadm::Iocage::deactivatePool(in_args.toObject()); }
-      else if(act=="activatestatus"){ retObj = sysadm::Iocage::activateStatus(); }
-      /*if(act=="execjail"){
-	ok = true;
-        out->insert("execjail", sysadm::Iocage::execJail(in_args.toObject()));
-      }
-      else if(act=="df"){
-	ok = true;
-        out->insert("df", sysadm::Iocage::df());
-      }
-      else if(act=="destroyjail"){
-	ok = true;
-        out->insert("destroyjail", sysadm::Iocage::destroyJail(in_args.toObject()));
-      }
-      else if(act=="createjail"){
-	ok = true;
-        out->insert("createjail", sysadm::Iocage::createJail(in_args.toObject()));
-      }
-      else if(act=="clonejail"){
-	ok = true;
-        out->insert("clonejail", sysadm::Iocage::cloneJail(in_args.toObject()));
-      }
-      else if(act=="cleanall"){
-	ok = true;
-        out->insert("cleanall", sysadm::Iocage::cleanAll());
-      }
-      else if(act=="cleanjails"){
-	ok = true;
-        out->insert("cleanjails", sysadm::Iocage::cleanJails());
-      }
-      else if(act=="capjail"){
-	ok = true;
-        out->insert("capjail", sysadm::Iocage::capJail(in_args.toObject()));
-      }
-      else if(act=="stopjail"){
-	ok = true;
-        out->insert("stopjail", sysadm::Iocage::stopJail(in_args.toObject()));
-      }
-      else if(act=="startjail"){
-	ok = true;
-        out->insert("startjail", sysadm::Iocage::startJail(in_args.toObject()));
-      }
-      else if(act=="getjailsettings"){
-	ok = true;
-        out->insert("getjailsettings", sysadm::Iocage::getJailSettings(in_args.toObject()));
-      }*/
-
-      //JAILS (GENERIC)
-      else if(act=="listjails"){ retObj = sysadm::Iocage::listJails(); }
-      //TEMPLATES
-      else if(act=="listtemplates"){ retObj = sysadm::Iocage::listTemplates(); }
-      else if(act=="cleantemplates"){ retObj = sysadm::Iocage::cleanTemplates(); }
-      //RELEASES
-      else if(act=="listreleases"){ retObj = sysadm::Iocage::listReleases(); }
-      else if(act=="fetchreleases"){ retObj = sysadm::Iocage::fetchReleases(in_args.toObject()); }
-      else if(act=="cleanreleases"){ retObj = sysadm::Iocage::cleanReleases(); }
-      //PLUGINS
-      else if(act=="listplugins"){  retObj = sysadm::Iocage::listPlugins(); }
-      else if(act=="createplugin"){ retObj = sysadm::Iocage::fetchPlugin(in_args.toObject()); }
-
-      ok = !retObj.keys().isEmpty();
-      if(ok){ out->insert(act,retObj); }
-    } //end of "action" key usage
-
-    //If nothing done - return the proper code
-    if(!ok ){
-      return RestOutputStruct::BADREQUEST;
-    }
-  }else{  // if(in_args.isArray()){
-    return RestOutputStruct::BADREQUEST;
-  }
-  return RestOutputStruct::OK;
-}
-
-//==== SYSADM -- iohyve ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmIohyveRequest(const QJsonValue in_args, QJsonObject *out){
-  if(in_args.isObject()){
-    QStringList keys = in_args.toObject().keys();
-    bool ok = false;
-    if(keys.contains("action")){
-      QString act = JsonValueToString(in_args.toObject().value("action"));
-      //qDebug() << " - iohyve action:" << act;
-      if(act=="adddisk"){
-	ok = true;
-        out->insert("adddisk", sysadm::Iohyve::addDisk(in_args.toObject()));
-      }
-      if(act=="create"){
-	ok = true;
-        out->insert("create", sysadm::Iohyve::createGuest(in_args.toObject()));
-      }
-      if(act=="delete"){
-	ok = true;
-        out->insert("delete", sysadm::Iohyve::deleteGuest(in_args.toObject()));
-      }
-      if(act=="deletedisk"){
-	ok = true;
-        out->insert("deletedisk", sysadm::Iohyve::deleteDisk(in_args.toObject()));
-      }
-      else if(act=="listdisks"){
-	ok = true;
-        out->insert("listdisks", sysadm::Iohyve::listDisks(in_args.toObject()));
-      }
-      else if(act=="listvms"){
-	ok = true;
-        out->insert("listvms", sysadm::Iohyve::listVMs());
-      }
-      else if(act=="listisos"){
-        ok = true;
-	out->insert("listisos", sysadm::Iohyve::listISOs());
-      }
-      else if(act=="fetchiso"){
-	ok = true;
-	//DProcess fetchproc;
-        out->insert("fetchiso", sysadm::Iohyve::fetchISO(in_args.toObject()));
-      }
-      else if(act=="install"){
-	ok = true;
-        out->insert("install", sysadm::Iohyve::installGuest(in_args.toObject()));
-      }
-      else if(act=="issetup"){
-	ok = true;
-        out->insert("issetup", sysadm::Iohyve::isSetup());
-      }
-      else if(act=="renameiso"){
-	ok = true;
-        out->insert("renameiso", sysadm::Iohyve::renameISO(in_args.toObject()));
-      }
-      else if(act=="rmiso"){
-	ok = true;
-        out->insert("rmiso", sysadm::Iohyve::rmISO(in_args.toObject()));
-      }
-      else if(act=="resizedisk"){
-	ok = true;
-        out->insert("resizedisk", sysadm::Iohyve::resizeDisk(in_args.toObject()));
-      }
-      else if(act=="setup"){
-	ok = true;
-        out->insert("setup", sysadm::Iohyve::setupIohyve(in_args.toObject()));
-      }
-      else if(act=="start"){
-	ok = true;
-        out->insert("start", sysadm::Iohyve::startGuest(in_args.toObject()));
-      }
-      else if(act=="stop"){
-	ok = true;
-        out->insert("stop", sysadm::Iohyve::stopGuest(in_args.toObject()));
-      }
-      else if(act=="version"){
-	ok = true;
-        out->insert("version", sysadm::Iohyve::version());
-      }
-      //qDebug() << " - iohyve action finished:" << act << ok;
-    } //end of "action" key usage
-
-    //If nothing done - return the proper code
-    if(!ok){
-      return RestOutputStruct::BADREQUEST;
-    }
-  }else{  // if(in_args.isArray()){
-    return RestOutputStruct::BADREQUEST;
-  }
-  return RestOutputStruct::OK;
-}
-
-// ==== SYSADM ZFS API ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmZfsRequest(const QJsonValue in_args, QJsonObject *out){
-  if( ! in_args.isObject()){
-    return RestOutputStruct::BADREQUEST;
-  }
-  QStringList keys = in_args.toObject().keys();
-  bool ok = false;
-  if(keys.contains("action")) {
-    QString act = JsonValueToString(in_args.toObject().value("action"));
-    if(act=="list_pools"){
-      ok = true;
-      QJsonObject pools = sysadm::ZFS::zpool_list();
-      if(!pools.isEmpty()){ out->insert("list_pools",pools); }
-    }
-    else if(act=="datasets"){
-      ok = true;
-      out->insert("datasets", sysadm::ZFS::zfs_list(in_args.toObject()));
-    }
-  } //end of "action" key usage
-
-  //If nothing done - return the proper code
-  if(!ok){
-    return RestOutputStruct::BADREQUEST;
-  }
-  return RestOutputStruct::OK;
-}
-
 // ==== SYSADM PKG API ====
 RestOutputStruct::ExitCode WebSocket::EvaluateSysadmPkgRequest(const QJsonValue in_args, QJsonObject *out){
   if(!in_args.isObject() || !in_args.toObject().contains("action") ){ return RestOutputStruct::BADREQUEST; }
@@ -987,85 +779,6 @@ RestOutputStruct::ExitCode WebSocket::EvaluateSysadmPkgRequest(const QJsonValue
   return RestOutputStruct::OK;
 }
 
-// ==== SYSADM USER API ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmUserRequest(bool allaccess, QString user, const QJsonValue in_args, QJsonObject *out){
-  bool ok = false;
-  //REQUIRED: "action"
-  QString action =in_args.toObject().value("action").toString().toLower();
-  if(action=="usershow"){
-    ok = sysadm::UserManager::listUsers(out, allaccess, user);
-
-  }else if(action=="useradd" && allaccess){ //requires all access to create new users
-    ok = sysadm::UserManager::addUser(out, in_args.toObject());
-
-  }else if(action=="userdelete" && allaccess){ //requires all access to remove users
-    //REQUIRED: "name"
-    //OPTIONAL: "clean_home"="false" (true by default)
-    QString deluser = in_args.toObject().value("name").toString();
-    if(deluser != user){ //cannot delete the currently-used user
-      bool clean = true;
-      if(in_args.toObject().contains("clean_home")){ clean = (in_args.toObject().value("clean_home").toString().toLower() != "false"); }
-      ok = sysadm::UserManager::removeUser(deluser, clean);
-      if(ok){ out->insert("result","success"); }
-      else{ out->insert("error","Could not delete user"); }
-    }else{
-      out->insert("error","Cannot delete the current user");
-    }
-
-  }else if(action=="usermod"){
-    bool go = true;
-    if(!allaccess){
-      //ensure that the user being acted on is the current user - otherwise deny access
-      go = (in_args.toObject().value("name").toString() == user);
-    }
-    if(go){ ok = sysadm::UserManager::modifyUser(out, in_args.toObject() ); }
-
-  }else if(action=="groupshow"){
-    ok = sysadm::UserManager::listGroups(out, (allaccess ? "" : user) );
-
-  }else if(action=="groupadd" && allaccess){
-    ok = sysadm::UserManager::addGroup(out, in_args.toObject() );
-
-  }else if(action=="groupdelete" && allaccess){
-    //REQUIRED: "name"
-    QString name = in_args.toObject().value("name").toString();
-    if(!name.isEmpty()){
-      ok = sysadm::UserManager::removeGroup(name);
-    }
-    if(ok){ out->insert("result","success"); }
-    else{ out->insert("error","Could not delete group"); }
-
-  }else if(action=="groupmod" && allaccess){
-    ok = sysadm::UserManager::modifyGroup(out, in_args.toObject() );
-
-  }else if(action=="personacrypt_init"){
-    qDebug() << "got PC init request:" << in_args << allaccess << user;
-    bool go = true;
-    if(!allaccess){
-      //ensure that the user being acted on is the current user - otherwise deny access
-      go = (in_args.toObject().value("name").toString() == user);
-    }
-    if(go){ 
-      //REQUIRED: "name", "password","device"
-      QJsonObject obj = in_args.toObject();
-      if(obj.contains("name") && obj.contains("password") && obj.contains("device") ){
-        ok = sysadm::UserManager::InitializePersonaCryptDevice(obj.value("name").toString(), obj.value("password").toString(), obj.value("device").toString() ); 
-        if(ok){ out->insert("result","success"); }
-        else{ out->insert("error","Could not initialize Personacrypt device"); }
-      }
-    }
-
-  }else if(action=="personacrypt_listdevs"){
-    QStringList devs = sysadm::UserManager::getAvailablePersonaCryptDevices();
-    for(int i=0; i<devs.length(); i++){
-      out->insert(devs[i].section(":",0,0), devs[i].section(":",1,-1).simplified()); //<device>:<info>
-    }
-    ok = true;
-  }
-
-  return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
-}
-
 // SERVICE MANAGER (sysadm/services)
 RestOutputStruct::ExitCode WebSocket::EvaluateSysadmServiceRequest(const QJsonValue in_args, QJsonObject *out){
   bool ok = false;
@@ -1268,98 +981,3 @@ RestOutputStruct::ExitCode WebSocket::EvaluateSysadmFirewallRequest(const QJsonV
   }
   return (ok ? RestOutputStruct::OK : RestOutputStruct::BADREQUEST);
 }
-
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmMousedRequest(const QJsonValue in_args, QJsonObject *out){
-  QString action = in_args.toObject().value("action").toString();
-  QJsonObject outobj;
-  if(action == "list_devices"){
-    outobj = sysadm::moused::listDevices();
-  }else if(action == "list_devices_active"){
-    outobj = sysadm::moused::listActiveDevices();
-  }else if(action == "list_device_options"){
-    outobj = sysadm::moused::listOptions();
-  }else if(action == "read_device_options"){
-    outobj = sysadm::moused::readOptions(in_args.toObject());
-  }else if(action == "set_device_options"){
-    outobj = sysadm::moused::setOptions(in_args.toObject());
-  }else if(action == "set_device_active"){
-    outobj = sysadm::moused::enableDevice(in_args.toObject());
-  }else if(action == "set_device_inactive"){
-    outobj = sysadm::moused::disableDevice(in_args.toObject());
-  }else if(action == "get_tap_to_click"){
-    outobj = sysadm::moused::tapToClick();
-  }else if(action == "set_tap_to_click"){
-    outobj = sysadm::moused::setTapToClick(in_args.toObject());
-  }else if(action == "get_synaptics_options"){
-    outobj = sysadm::moused::synapticsSettings();
-  }
-
-  //check return structure for validity
-  if(!outobj.keys().isEmpty()){
-    out->insert(action, outobj);
-    return RestOutputStruct::OK;
-  }else{
-    return RestOutputStruct::BADREQUEST;
-  }
-
-}
-
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmPowerdRequest(const QJsonValue in_args, QJsonObject *out){
-  QString action = in_args.toObject().value("action").toString();
-  QJsonObject outobj;
-   if(action == "list_options"){
-    outobj = sysadm::powerd::listOptions();
-  }else if(action == "read_options"){
-    outobj = sysadm::powerd::readOptions();
-  }else if(action == "set_options"){
-    outobj = sysadm::powerd::setOptions(in_args.toObject());
-  }else if(action == "list_status"){
-    outobj = sysadm::powerd::listStatus();
-  }else if(action == "set_active"){
-    outobj = sysadm::powerd::enableService();
-  }else if(action == "set_inactive"){
-    outobj = sysadm::powerd::disableService();
-  }else if(action == "start"){
-    outobj = sysadm::powerd::startService();
-  }else if(action == "stop"){
-    outobj = sysadm::powerd::stopService();
-  }
-
-  //check return structure for validity
-  if(!outobj.keys().isEmpty()){
-    out->insert(action, outobj);
-    return RestOutputStruct::OK;
-  }else{
-    return RestOutputStruct::BADREQUEST;
-  }
-}
-
-// ==== SYSADM SOURCECTL API ====
-RestOutputStruct::ExitCode WebSocket::EvaluateSysadmSourceCTLRequest(const QJsonValue in_args, QJsonObject *out){
-  QString action = in_args.toObject().value("action").toString();
-  QJsonObject outobj;
-   if(action == "downloadports"){
-    outobj = sysadm::sourcectl::downloadports();
-  }else if(action == "updateports"){
-    outobj = sysadm::sourcectl::updateports();
-  }else if(action == "deleteports"){
-    outobj = sysadm::sourcectl::deleteports();
-  }else if(action == "stopports"){
-     outobj = sysadm::sourcectl::stopports();
-  }else if(action == "downloadsource"){
-    outobj = sysadm::sourcectl::downloadsource();
-  }else if(action == "updatesource"){
-    outobj = sysadm::sourcectl::updatesource();
-  }else if(action == "deletesource"){
-    outobj = sysadm::sourcectl::deletesource();
-  }else if(action == "stopsource"){
-    outobj = sysadm::sourcectl::stopsource();
-  //check return structure for validity
-  if(!outobj.keys().isEmpty()){
-    out->insert(action, outobj);
-    return RestOutputStruct::OK;
-  }else{
-    return RestOutputStruct::BADREQUEST;
-  }
- }
-}
@@ -15,6 +15,8 @@ WebServer::WebServer(){
   //Setup all the various settings
   WSServer = 0;
   TCPServer = 0;
+  LocalServer = 0;
+  IOTHREADS = 0;
   bridgeTimer = new QTimer(this);
     bridgeTimer->setInterval(60000); //1 minute
     connect(bridgeTimer, SIGNAL(timeout()), this, SLOT(checkBridges()) );
@@ -23,6 +25,7 @@ WebServer::WebServer(){
 }
 
 WebServer::~WebServer(){
+  if(IOTHREADS!=0){ delete IOTHREADS; }
   delete AUTH;
 }
 
@@ -36,12 +39,23 @@ bool WebServer::startServer(quint16 port, bool websocket){
   if(websocket && BRIDGE_ONLY){ ok = true; }
   else if(websocket){ ok = setupWebSocket(port); }
   else{ ok = setupTcp(port); }
+  if(ok && IO_Threads!=0 && !(websocket && BRIDGE_ONLY) ){
+    //Spread the client connections over a number of event loops
+    IOTHREADS = new ConnectionThreads(AUTH, IO_Threads);
+  }
+  if(ok && !Local_Socket.isEmpty()){
+    //Not fatal - the network port is still up
+    if(!setupLocal(Local_Socket)){ qWarning() << "Could not listen on the local socket:" << Local_Socket << LocalServer->errorString(); }
+  }
   
   if(ok){ 
     QCoreApplication::processEvents();
     qDebug() << "Server Started:" << QDateTime::currentDateTime().toString(Qt::ISODate);
     qDebug() << " Port:" << (BRIDGE_ONLY ? "(Bridge Only)" : QString::number(port));
+    if(STUB_BACKEND){ qWarning() << "Running with a stub backend (benchmark mode) - API calls do not touch the system"; }
     if(WSServer!=0){ qDebug() << " URL:" << WSServer->serverUrl().toString(); }
+    if(IOTHREADS!=0){ qDebug() << " I/O Threads:" << IOTHREADS->count(); }
+    if(LocalServer!=0 && LocalServer->isListening()){ qDebug() << " Local Socket:" << LocalServer->fullServerName(); }
   }else{ 
     qCritical() << "Could not start server - exiting..."; 
   }
@@ -54,6 +68,7 @@ bool WebServer::startServer(quint16 port, bool websocket){
 
 void WebServer::stopServer(){
   if(bridgeTimer->isActive()){ bridgeTimer->stop(); }
+  if(LocalServer!=0){ LocalServer->close(); }
   if(WSServer!=0){ WSServer->close(); } //note - this will throw the "closed()" signal when done
   else if(TCPServer!=0){ TCPServer->close(); QCoreApplication::exit(0);} //no corresponding signal
 }
@@ -107,21 +122,19 @@ bool WebServer::setupTcp(quint16 port){
   return TCPServer->listen(QHostAddress::Any, port);	
 }
 
+bool WebServer::setupLocal(QString path){
+  LocalServer = new QLocalServer(this);
+  //Anybody on the system may connect - the user ID of the connecting process decides what access it gets
+  LocalServer->setSocketOptions(QLocalServer::WorldAccessOption);
+  connect(LocalServer, SIGNAL(newConnection()), this, SLOT(NewLocalConnection()) );
+  QLocalServer::removeServer(path); //stale socket file from a previous run
+  return LocalServer->listen(path);
+}
+
 //Server Blacklist / DDOS mitigator
 bool WebServer::allowConnection(QHostAddress addr){
-  //Check if this addr is on the blacklist
-  QString key = "blacklist/"+addr.toString();
-  if(!CONFIG->contains(key) ){ return true; } //not in the list
-  //Address on the list - see if the timeout has expired 
-  QDateTime dt = CONFIG->value(key,QDateTime()).toDateTime();
-  if(dt.addSecs(BlackList_BlockMinutes*60) < QDateTime::currentDateTime()){
-    //This entry has timed out - go ahead and allow it
-    CONFIG->remove(key); //make the next connection check for this IP faster again
-    return true;
-  }else{
-    return false; //blacklist block is still in effect
-  }
-  
+  //Check the blacklist and connection rate for this addr (in memory - no settings file lookups)
+  return HOSTLIMITS->allowConnection(addr.toString());
 }
 
 QString WebServer::generateID(){
@@ -144,23 +157,38 @@ void WebServer::NewSocketConnection(){
   if(WSServer!=0){
     if(WSServer->hasPendingConnections()){ 
       QWebSocket *ws = WSServer->nextPendingConnection();
-      if( !allowConnection(ws->peerAddress()) ){ ws->close(); }
+      if( !allowConnection(ws->peerAddress()) ){ ws->close(); ws->deleteLater(); }
+      else if(IOTHREADS!=0){ sock = IOTHREADS->addWebSocket(ws, generateID()); }
       else{ sock = new WebSocket( this, ws, generateID(), AUTH); }
     }
   }else if(TCPServer!=0){
     if(TCPServer->hasPendingConnections()){ 
 	QSslSocket *ss = TCPServer->nextPendingConnection();
-	if( !allowConnection(ss->peerAddress()) ){ ss->close(); }    
+	if( !allowConnection(ss->peerAddress()) ){ ss->close(); ss->deleteLater(); }
+	else if(IOTHREADS!=0){ sock = IOTHREADS->addTcpSocket(ss, generateID()); }
 	else{ sock = new WebSocket( this, ss, generateID(), AUTH); }
     }
   }
   if(sock==0){ return; } //no new connection
   //qDebug() << "New Socket Connection";	
+  //NOTE: the socket might live in one of the I/O threads - this signal gets queued back to the main thread
   connect(sock, SIGNAL(SocketClosed(QString)), this, SLOT(SocketClosed(QString)) );
   //connect(EVENTS, SIGNAL(NewEvent(EventWatcher::EVENT_TYPE, QJsonValue)), sock, SLOT(EventUpdate(EventWatcher::EVENT_TYPE, QJsonValue)) );
   OpenSockets << sock;
 }
 
+void WebServer::NewLocalConnection(){
+  while(LocalServer->hasPendingConnections()){
+    QLocalSocket *ls = LocalServer->nextPendingConnection();
+    WebSocket *sock = 0;
+    //No address to rate-limit/blacklist here (local system only)
+    if(IOTHREADS!=0){ sock = IOTHREADS->addLocalSocket(ls, generateID()); }
+    else{ sock = new WebSocket(this, ls, generateID(), AUTH); }
+    connect(sock, SIGNAL(SocketClosed(QString)), this, SLOT(SocketClosed(QString)) );
+    OpenSockets << sock;
+  }
+}
+
 void WebServer::NewConnectError(QAbstractSocket::SocketError err){         
   qWarning() << "New Connection Error["+QString::number(err)+"]:" << ( (WSServer!=0) ? WSServer->errorString() : TCPServer->errorString());
   QTimer::singleShot(0,this, SLOT(NewSocketConnection()) ); //check for a new connection
@@ -172,7 +200,7 @@ void WebServer::BlackListConnection(QHostAddress addr){
   if(addr!=QHostAddress(QHostAddress::LocalHost) && addr!=QHostAddress(QHostAddress::LocalHostIPv6)  && addr.toString()!="::ffff:127.0.0.1" ){
     //Block this remote host
     LogManager::log(LogManager::HOST,"Blacklisting IP Temporarily: "+addr.toString());
-    CONFIG->setValue("blacklist/"+addr.toString(), QDateTime::currentDateTime());
+    HOSTLIMITS->block(addr.toString()); //gets saved to the settings file in the background
   }
 }
 
@@ -213,7 +241,13 @@ void WebServer::SslErrors(const QList<QSslError> &list){
 void WebServer::SocketClosed(QString ID){
   qDebug() << "Socket Closed:" << ID << QDateTime::currentDateTime().toString(Qt::ISODate);
   for(int i=0; i<OpenSockets.length(); i++){
-    if(OpenSockets[i]->ID()==ID){ delete OpenSockets.takeAt(i); break; }
+    if(OpenSockets[i]->ID()==ID){
+      WebSocket *sock = OpenSockets.takeAt(i);
+      if(IOTHREADS!=0){ IOTHREADS->socketClosed(sock); }
+      //Gets deleted by the thread which owns it (after any requests still running for it are finished)
+      QMetaObject::invokeMethod(sock, "deleteWhenIdle", Qt::QueuedConnection);
+      break;
+    }
   }
   QTimer::singleShot(0,this, SLOT(NewSocketConnection()) ); //check for a new connection
 }
@@ -230,6 +264,7 @@ void WebServer::checkBridges(){
   }
   //Now browse through all the current connections and see if any are already active
   for(int i=0; i<OpenSockets.length(); i++){
+    if(OpenSockets[i]->thread()!=this->thread()){ continue; } //client connection in an I/O thread (checks itself)
     bool active = OpenSockets[i]->isActive();
     if( bridgeKeys.contains( OpenSockets[i]->ID() ) && active){
       bridgeKeys.removeAll( OpenSockets[i]->ID() ); //already running - remove from the temporary list
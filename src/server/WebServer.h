@@ -11,6 +11,7 @@
 #include "WebSocket.h"
 #include "AuthorizationManager.h"
 #include "SslServer.h"
+#include "ConnectionThreads.h"
 
 class WebServer : public QObject{
 	Q_OBJECT
@@ -26,13 +27,16 @@ public slots:
 private:
 	QWebSocketServer *WSServer;
 	SslServer *TCPServer;
+	QLocalServer *LocalServer; //local (unix domain) socket for clients on this system (0: disabled)
 	QList<WebSocket*> OpenSockets;
 	AuthorizationManager *AUTH;
+	ConnectionThreads *IOTHREADS; //I/O threads for the client connections (0: everything runs in the main thread)
 	QTimer *bridgeTimer;	
 
 	//Server Setup functions
 	bool setupWebSocket(quint16 port);
 	bool setupTcp(quint16 port);
+	bool setupLocal(QString path);
 	
 	//Server Blacklist / DDOS mitigator
 	bool allowConnection(QHostAddress addr);
@@ -44,6 +48,7 @@ private slots:
         // Generic Server Slots
 	void NewSocketConnection(); 					//newConnection() signal
 	void NewConnectError(QAbstractSocket::SocketError);	//acceptError() signal
+	void NewLocalConnection();				//newConnection() signal (local socket)
 	//Socket Blacklist function
 	void BlackListConnection(QHostAddress addr);
 
@@ -5,38 +5,36 @@
 // =================================
 #include "WebSocket.h"
 
-#include <QtConcurrent>
 #include <QHostInfo>
 #include <unistd.h>
 
 #define DEBUG 0
 #define IDLETIMEOUTMINS 30
+#define BATCHMAXREQUESTS 64 //max number of requests within a single "rpc/batch" call
+#define TCPREADCHUNK 65536 //max bytes pulled off a TCP/local socket at a time (framer buffer stays bounded)
 
 WebSocket::WebSocket(QObject *parent, QWebSocket *sock, QString ID, AuthorizationManager *auth) : QObject(parent){
   SockID = ID;
   isBridge = false;
   connecting = false;
+  orderedReplies = false;
+  compressReplies = false;
+  cborEncoding = false;
   SockAuthToken.clear(); //nothing set initially
   SOCKET = sock;
   TSOCKET = 0;
+  LSOCKET = 0;
   AUTHSYSTEM = auth;
   SockPeerIP = SOCKET->peerAddress().toString();
   LogManager::log(LogManager::HOST,"New Connection: "+SockPeerIP);
-  idletimer = new QTimer(this);
-    idletimer->setInterval(IDLETIMEOUTMINS*60000); //connection timout for idle sockets
-    idletimer->setSingleShot(true);
-  connect(idletimer, SIGNAL(timeout()), this, SLOT(checkIdle()) );
+  setupTimers(IDLETIMEOUTMINS*60000); //connection timout for idle sockets
   connect(SOCKET, SIGNAL(textMessageReceived(const QString&)), this, SLOT(EvaluateMessage(const QString&)) );
   connect(SOCKET, SIGNAL(binaryMessageReceived(const QByteArray&)), this, SLOT(EvaluateMessage(const QByteArray&)) );
   connect(SOCKET, SIGNAL(aboutToClose()), this, SLOT(SocketClosing()) );
-  connect(EVENTS, SIGNAL(NewEvent(EventWatcher::EVENT_TYPE, QJsonValue)), this, SLOT(EventUpdate(EventWatcher::EVENT_TYPE, QJsonValue)) );
-  connect(this, SIGNAL(SendMessage(QString)), this, SLOT(sendReply(QString)) );
-  idletimer->start();
-  QTimer::singleShot(30000, this, SLOT(checkAuth()));
-  connCheckTimer = new QTimer(this);
-    connCheckTimer->setInterval(60000); //1 minute check for connection validity
-    connect(connCheckTimer, SIGNAL(timeout()), this, SLOT(checkConnection()) );
-    connCheckTimer->start();
+  connect(this, SIGNAL(SendMessage(QByteArray)), this, SLOT(sendReply(QByteArray)) );
+  connect(this, SIGNAL(SendBinaryMessage(QByteArray)), this, SLOT(sendBinaryReply(QByteArray)) );
+  idleTimer.start(idleMSecs);
+  authTimer.start(30000);
 }
 
 WebSocket::WebSocket(QObject *parent, QSslSocket *sock, QString ID, AuthorizationManager *auth) : QObject(parent){
@@ -44,55 +42,89 @@ WebSocket::WebSocket(QObject *parent, QSslSocket *sock, QString ID, Authorizatio
   SockAuthToken.clear(); //nothing set initially
   TSOCKET = sock;
   SOCKET = 0;
+  LSOCKET = 0;
+  isBridge = false;
   connecting = false;
+  orderedReplies = true; //REST replies always go out in request order
+  compressReplies = false;
+  cborEncoding = false;
+  restRequests = 0;
+  incoming.setMaxFrameSize(Request_MaxBytes);
+  incoming.setMaxBufferSize(Request_MaxBytes + TCPREADCHUNK);
   SockPeerIP = TSOCKET->peerAddress().toString();
   LogManager::log(LogManager::HOST,"New Connection: "+SockPeerIP);
   AUTHSYSTEM = auth;
-  idletimer = new QTimer(this);
-    idletimer->setInterval(IDLETIMEOUTMINS*60000); //connection timout for idle sockets
-    idletimer->setSingleShot(true);
-  connect(idletimer, SIGNAL(timeout()), this, SLOT(checkIdle()) );
+  //connection timout for idle sockets (persistent REST connections use the shorter keep-alive timeout)
+  setupTimers( Rest_KeepAliveSecs>0 ? Rest_KeepAliveSecs*1000 : IDLETIMEOUTMINS*60000);
   connect(TSOCKET, SIGNAL(readyRead()), this, SLOT(EvaluateTcpMessage()) );
   connect(TSOCKET, SIGNAL(aboutToClose()), this, SLOT(SocketClosing()) );
   connect(TSOCKET, SIGNAL(encrypted()), this, SLOT(nowEncrypted()) );
   connect(TSOCKET, SIGNAL(peerVerifyError(const QSslError &)), this, SLOT(peerError(const QSslError &)) );
   connect(TSOCKET, SIGNAL(sslErrors(const QList<QSslError> &)), this, SLOT(SslError(const QList<QSslError> &)) );
-  connect(EVENTS, SIGNAL(NewEvent(EventWatcher::EVENT_TYPE, QJsonValue)), this, SLOT(EventUpdate(EventWatcher::EVENT_TYPE, QJsonValue)) );
-  connect(this, SIGNAL(SendMessage(QString)), this, SLOT(sendReply(QString)) );
+  connect(this, SIGNAL(SendMessage(QByteArray)), this, SLOT(sendReply(QByteArray)) );
+  connect(this, SIGNAL(SendFinalMessage(QByteArray)), this, SLOT(sendFinalReply(QByteArray)) );
   //qDebug() << " - Starting Server Encryption Handshake";
    TSOCKET->startServerEncryption();
   //qDebug() << " - Socket Encrypted:" << TSOCKET->isEncrypted();
-  idletimer->start();
-  QTimer::singleShot(30000, this, SLOT(checkAuth()));
-  connCheckTimer = new QTimer(this);
-    connCheckTimer->setInterval(60000); //1 minute check for connection validity
-    connect(connCheckTimer, SIGNAL(timeout()), this, SLOT(checkConnection()) );
-    connCheckTimer->start();
+  idleTimer.start(idleMSecs);
+  authTimer.start(30000);
+}
+
+WebSocket::WebSocket(QObject *parent, QLocalSocket *sock, QString ID, AuthorizationManager *auth) : QObject(parent){
+  SockID = ID;
+  LSOCKET = sock;
+  SOCKET = 0;
+  TSOCKET = 0;
+  isBridge = false;
+  connecting = false;
+  orderedReplies = true; //REST replies always go out in request order
+  compressReplies = false;
+  cborEncoding = false;
+  restRequests = 0;
+  incoming.setMaxFrameSize(Request_MaxBytes);
+  incoming.setMaxBufferSize(Request_MaxBytes + TCPREADCHUNK);
+  AUTHSYSTEM = auth;
+  //No TLS or password: the kernel tells us which user is on the other end of the socket
+  QString user = AuthorizationManager::peerUser(LSOCKET->socketDescriptor());
+  SockPeerIP = "local:"+(user.isEmpty() ? QString("unknown") : user);
+  LogManager::log(LogManager::HOST,"New Connection: "+SockPeerIP);
+  //Group lookups can take a while - log in on the request lane of this connection instead
+  //  (the lane is ordered: any requests from the client wait until the token is set)
+  EXECUTOR->submit(SockID, [this, user](){
+      this->setAuthToken( AUTHSYSTEM->LoginLocal(user) ); //empty if this user is not allowed access (can still use the normal auth calls)
+    }, true);
+  setupTimers(IDLETIMEOUTMINS*60000); //local clients may keep the connection open for events
+  connect(LSOCKET, SIGNAL(readyRead()), this, SLOT(EvaluateTcpMessage()) );
+  connect(LSOCKET, SIGNAL(disconnected()), this, SLOT(SocketClosing()) );
+  connect(this, SIGNAL(SendMessage(QByteArray)), this, SLOT(sendReply(QByteArray)) );
+  connect(this, SIGNAL(SendFinalMessage(QByteArray)), this, SLOT(sendFinalReply(QByteArray)) );
+  idleTimer.start(idleMSecs);
+  authTimer.start(30000);
 }
 
 WebSocket::WebSocket(QObject *parent, QString url, QString ID, AuthorizationManager *auth) : QObject(parent){
   //sets up a bridge connection (websocket only)
   SockID = ID;
   isBridge = true;
+  orderedReplies = false;
+  compressReplies = false;
+  cborEncoding = false;
   SockAuthToken.clear(); //nothing set initially
   SOCKET = new QWebSocket("sysadm-server", QWebSocketProtocol::VersionLatest, this);
   TSOCKET = 0;
+  LSOCKET = 0;
   AUTHSYSTEM = auth;
   SockPeerIP = SOCKET->peerAddress().toString();
   //LogManager::log(LogManager::HOST,"New Bridge Connection: "+SockPeerIP);
-  idletimer = new QTimer(this);
-    idletimer->setInterval(IDLETIMEOUTMINS*60000); //connection timout for idle sockets
-    idletimer->setSingleShot(true);
-  connect(idletimer, SIGNAL(timeout()), this, SLOT(checkIdle()) );
+  setupTimers(IDLETIMEOUTMINS*60000); //connection timout for idle sockets
   connect(SOCKET, SIGNAL(textMessageReceived(const QString&)), this, SLOT(EvaluateMessage(const QString&)) );
   connect(SOCKET, SIGNAL(binaryMessageReceived(const QByteArray&)), this, SLOT(EvaluateMessage(const QByteArray&)) );
   connect(SOCKET, SIGNAL(aboutToClose()), this, SLOT(SocketClosing()) );
-  connect(EVENTS, SIGNAL(NewEvent(EventWatcher::EVENT_TYPE, QJsonValue)), this, SLOT(EventUpdate(EventWatcher::EVENT_TYPE, QJsonValue)) );
-  connect(this, SIGNAL(SendMessage(QString)), this, SLOT(sendReply(QString)) );
+  connect(this, SIGNAL(SendMessage(QByteArray)), this, SLOT(sendReply(QByteArray)) );
   connect(SOCKET, SIGNAL(connected()), this, SLOT(startBridgeAuth()) );
   //connect(SOCKET, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(socketError(QAbstractSocket::SocketError)) );
   connect(SOCKET, SIGNAL(sslErrors(const QList<QSslError>&)), this, SLOT(SslError(const QList<QSslError>&)) );
-  //idletimer->start(); //do not idle out on a bridge connection
+  //idleTimer.start(idleMSecs); //do not idle out on a bridge connection
   //Assemble the URL as needed
   if(!url.startsWith("wss://")){ url.prepend("wss://"); }
   bool hasport = false;
@@ -103,14 +135,13 @@ WebSocket::WebSocket(QObject *parent, QString url, QString ID, AuthorizationMana
   connecting = true;
   SOCKET->setSslConfiguration(QSslConfiguration::defaultConfiguration());
   SOCKET->open(QUrl(url));
-  connCheckTimer = new QTimer(this);
-    connCheckTimer->setInterval(60000); //1 minute check for connection validity
-    connect(connCheckTimer, SIGNAL(timeout()), this, SLOT(checkConnection()) );
-    connCheckTimer->start();
 }
 
 WebSocket::~WebSocket(){
   //qDebug() << "SOCKET Destroyed";
+  EXECUTOR->dropLane(SockID); //discard any requests which have not started yet
+  EVENTS->unsubscribeAll(this); //no more event messages
+  CURSORS->dropOwner(SockID); //close any open result cursors
   if(SOCKET!=0 && SOCKET->isValid()){
     SOCKET->close();
     delete SOCKET;
@@ -119,6 +150,10 @@ WebSocket::~WebSocket(){
     TSOCKET->close();
     delete TSOCKET;
   }
+  if(LSOCKET!=0 && LSOCKET->isValid()){
+    LSOCKET->close();
+    delete LSOCKET;
+  }
 }
 
 
@@ -133,6 +168,16 @@ void WebSocket::closeConnection(){
   if(TSOCKET!=0 && TSOCKET->isValid()){
     TSOCKET->close();
   }
+  if(LSOCKET!=0 && LSOCKET->isValid()){
+    LSOCKET->close();
+  }
+}
+
+void WebSocket::deleteWhenIdle(){
+  //Requests for this connection may still be running on the worker threads (those use this object until they finish)
+  EXECUTOR->dropLane(SockID); //nothing new gets started
+  if(EXECUTOR->isBusy(SockID, true)){ QTimer::singleShot(50, this, SLOT(deleteWhenIdle()) ); } //check again in a moment
+  else{ this->deleteLater(); }
 }
 
 bool WebSocket::isActive(){
@@ -141,6 +186,8 @@ bool WebSocket::isActive(){
     ok = (SOCKET->isValid() || connecting);
   }else if(TSOCKET!=0){
     ok = TSOCKET->isValid();
+  }else if(LSOCKET!=0){
+    ok = LSOCKET->isValid();
   }
   return ok;
 }
@@ -148,23 +195,73 @@ bool WebSocket::isActive(){
 //=======================
 //             PRIVATE
 //=======================
-void WebSocket::sendReply(QString msg){
+void WebSocket::sendReply(QByteArray msg){
   //qDebug() << "Sending Socket Reply:" << msg;
- if(SOCKET!=0 && SOCKET->isValid()){ SOCKET->sendTextMessage(msg); } //Websocket connection
+ if(SOCKET!=0 && SOCKET->isValid()){ SOCKET->sendTextMessage(QString::fromUtf8(msg)); } //Websocket connection (text frames need a QString)
  else if(TSOCKET!=0 && TSOCKET->isValid()){ 
-    //TCP Socket connection
-    TSOCKET->write(msg.toUtf8().data()); 
-    TSOCKET->disconnectFromHost(); //TCP/REST connections are 1 connection per message.
- }
+    //TCP Socket connection (persistent - see sendFinalReply() for the last message)
+    TSOCKET->write(msg); 
+ }else if(LSOCKET!=0 && LSOCKET->isValid()){ LSOCKET->write(msg); } //Local socket connection
+}
+
+void WebSocket::sendBinaryReply(QByteArray msg){
+  //Binary frames are only used for compressed replies and CBOR messages (WebSocket only)
+  if(SOCKET!=0 && SOCKET->isValid()){ SOCKET->sendBinaryMessage(msg); }
+}
+
+void WebSocket::sendFinalReply(QByteArray msg){
+  //Last message on this connection
+  if(TSOCKET!=0 && TSOCKET->isValid()){
+    if(!msg.isEmpty()){ TSOCKET->write(msg); }
+    TSOCKET->disconnectFromHost();
+  }else if(LSOCKET!=0 && LSOCKET->isValid()){
+    if(!msg.isEmpty()){ LSOCKET->write(msg); }
+    LSOCKET->disconnectFromServer();
+  }else if(!msg.isEmpty()){
+    sendReply(msg);
+  }
+}
+
+void WebSocket::queueReply(const RestInputStruct &REQ, QByteArray msg){
+  //Note: This may be called from a request thread - always go through the signals
+  if(REQ.cbor){ this->emit SendBinaryMessage(msg); } //binary encoding (WebSocket only)
+  else if(TSOCKET!=0 && !REQ.keepAlive){ this->emit SendFinalMessage(msg); }
+  else if(LSOCKET!=0 && !REQ.VERB.isEmpty() && !REQ.keepAlive){ this->emit SendFinalMessage(msg); } //local: plain JSON messages keep the connection open
+  else{ this->emit SendMessage(msg); }
+}
+
+void WebSocket::addConnectionHeaders(const RestInputStruct &REQ, QStringList *headers){
+  if( (TSOCKET==0 && LSOCKET==0) || REQ.VERB.isEmpty()){ return; } //not a REST reply
+  if(REQ.keepAlive){
+    *headers << "Connection: keep-alive";
+    *headers << "Keep-Alive: timeout="+QString::number(Rest_KeepAliveSecs);
+  }else{
+    *headers << "Connection: close";
+  }
+}
+
+void WebSocket::sendErrorReply(const RestInputStruct &REQ, RestOutputStruct::ExitCode code){
+  RestOutputStruct out;
+    out.in_struct = REQ;
+    out.CODE = code;
+    if(code==RestOutputStruct::TOOMANYREQUESTS){ out.Header << "Retry-After: 1"; }
+    addConnectionHeaders(REQ, &out.Header);
+  QByteArray msg = out.assembleMessage();
+  if(SOCKET!=0 && !REQ.bridgeID.isEmpty()){
+    //BRIDGE RELAY - alternate format
+    msg = AUTHSYSTEM->encryptString(QString::fromUtf8(msg), BRIDGE[REQ.bridgeID].enc_key).toUtf8();
+    msg.prepend( QString(REQ.bridgeID+"\n").toUtf8() );
+  }
+  queueReply(REQ, msg);
 }
 
-void WebSocket::EvaluateREST(QString msg){
+void WebSocket::EvaluateREST(const QByteArray &msg, bool cbor){
   //Parse the message into it's elements and proceed to the main data evaluation
-  RestInputStruct IN(msg, TSOCKET!=0);	
+  RestInputStruct IN(msg, TSOCKET!=0 || LSOCKET!=0, cbor);	
   if(SOCKET!=0 && !IN.Header.isEmpty() && !IN.bridgeID.isEmpty() ){
     if(BRIDGE.contains(IN.bridgeID)){
       //Bridge-relay message - need to decrypt the message body before it can be parsed
-      IN.Body = AUTHSYSTEM->decryptString(IN.Body, BRIDGE[IN.bridgeID].enc_key);
+      IN.Body = AUTHSYSTEM->decryptString(QString::fromUtf8(IN.Body), BRIDGE[IN.bridgeID].enc_key).toUtf8();
     }
     IN.ParseBodyIntoJson();
   }
@@ -180,6 +277,51 @@ void WebSocket::EvaluateREST(QString msg){
     qDebug() << " - ID:" << IN.id;
     qDebug() << " - Has Args:" << !IN.args.isNull();
   }
+  if(TSOCKET!=0 || LSOCKET!=0){
+    //TCP/REST or local connection: all requests go through a single ordered lane so pipelined requests get answered in order
+    restRequests++;
+    if(Rest_KeepAliveSecs<=0 || (Rest_KeepAliveMax>0 && restRequests>=Rest_KeepAliveMax) ){ IN.keepAlive = false; }
+    bool allowed = HOSTLIMITS->allowRequest(SockPeerIP);
+    //Note: auth/identify requests run on the request thread too (PAM/group lookups can take a while)
+    if( !EXECUTOR->submit(SockID, [this, IN, allowed](){
+	if(!allowed){ this->sendErrorReply(IN, RestOutputStruct::TOOMANYREQUESTS); } //over the rate limit (reply still goes out in order)
+	else{ this->EvaluateRestRequest(IN); }
+      }, true) ){
+      //Too many pipelined requests - reply with a "busy" message and close the connection
+      RestOutputStruct out;
+        out.in_struct = IN;
+        out.in_struct.keepAlive = false;
+        out.CODE = RestOutputStruct::SERVICEUNAVAILABLE;
+        addConnectionHeaders(out.in_struct, &out.Header);
+      this->sendFinalReply(out.assembleMessage());
+    }
+    return;
+  }
+  //qDebug() << "Got Message:" << IN.namesp << IN.name << IN.args << isBridge;
+  if(IN.name.startsWith("auth") || (IN.namesp.toLower()=="rpc" && IN.name.toLower()=="identify") ){
+    //Keep auth/pre-auth system requests in order
+    EvaluateRequest(IN);
+  }else if(isBridge && (IN.name=="response" || (IN.namesp=="events" && IN.name=="bridge") ) ){
+    EvaluateResponse(IN);
+  }else{
+    //Queue the request on the executor lane for this connection (one lane per bridged client)
+    QString lane = SockID;
+    bool ordered = orderedReplies;
+    if(!IN.bridgeID.isEmpty()){
+      lane.append("::::"+IN.bridgeID);
+      ordered = BRIDGE.value(IN.bridgeID).ordered;
+    }
+    //Rate limit: per client address (bridged clients are limited per bridge ID)
+    if( !HOSTLIMITS->allowRequest(IN.bridgeID.isEmpty() ? SockPeerIP : IN.bridgeID) ){
+      sendErrorReply(IN, RestOutputStruct::TOOMANYREQUESTS);
+    }else if( !EXECUTOR->submit(lane, [this, IN](){ this->EvaluateRequest(IN); }, ordered) ){
+      //Too many requests already waiting on this connection - tell the client to back off
+      sendErrorReply(IN, RestOutputStruct::SERVICEUNAVAILABLE);
+    }
+  }
+}
+
+void WebSocket::EvaluateRestRequest(const RestInputStruct &IN){
   //Now check for the REST-specific verbs/actions
   if(IN.VERB == "OPTIONS" || IN.VERB == "HEAD"){
     RestOutputStruct out;	  
@@ -193,17 +335,10 @@ void WebSocket::EvaluateREST(QString msg){
       }
       out.Header << "Accept: text/json";
       out.Header << "Content-Type: text/json; charset=utf-8";
-    this->sendReply(out.assembleMessage());
+      addConnectionHeaders(IN, &out.Header);
+    queueReply(IN, out.assembleMessage());
   }else{
-    //qDebug() << "Got Message:" << IN.namesp << IN.name << IN.args << isBridge;
-    if(IN.name.startsWith("auth") || (IN.namesp.toLower()=="rpc" && IN.name.toLower()=="identify") ){
-      //Keep auth/pre-auth system requests in order
-      EvaluateRequest(IN);
-    }else if(isBridge && (IN.name=="response" || (IN.namesp=="events" && IN.name=="bridge") ) ){
-      EvaluateResponse(IN);
-    }else{
-      QtConcurrent::run(this, &WebSocket::EvaluateRequest, IN);
-    }
+    EvaluateRequest(IN);
   }
 }
 
@@ -215,7 +350,8 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
   QHostAddress host;
     if(SOCKET!=0 && SOCKET->isValid()){ host = SOCKET->peerAddress(); }
     else if(TSOCKET!=0 && TSOCKET->isValid()){ host = TSOCKET->peerAddress(); }
-  QString cur_auth_tok = SockAuthToken;
+    else if(LSOCKET!=0){ host = QHostAddress(QHostAddress::LocalHost); }
+  QString cur_auth_tok = authToken();
   if(!REQ.bridgeID.isEmpty() || isBridge){ //never clear/check the SockAuthToken itself on a bridge - this was assigned by the bridge and not created here
     cur_auth_tok.clear();
     if(BRIDGE.contains(REQ.bridgeID)){ cur_auth_tok = BRIDGE[REQ.bridgeID].auth_tok; }
@@ -230,8 +366,10 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
   }else{
     //First check for a REST authorization (not stand-alone request)
     if(!out.in_struct.auth.isEmpty()){
-      AUTHSYSTEM->clearAuth(SockAuthToken); //new auth requested - clear any old token
-      SockAuthToken = AUTHSYSTEM->LoginUP(host, out.in_struct.auth.section(":",0,0), out.in_struct.auth.section(":",1,1));
+      //Note: This may be running on a request thread - the token itself is guarded by tokenMutex
+      AUTHSYSTEM->clearAuth(authToken()); //new auth requested - clear any old token
+      setAuthToken( AUTHSYSTEM->LoginUP(host, out.in_struct.auth.section(":",0,0), out.in_struct.auth.section(":",1,1)) );
+      if(REQ.bridgeID.isEmpty() && !isBridge){ cur_auth_tok = authToken(); } //use the new login for this request too
     }
   //qDebug() << "Auth Token:" << cur_auth_tok;
     //Now check the body of the message and do what it needs
@@ -241,6 +379,54 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
       QJsonObject obj;
       obj.insert("type", "server");
       obj.insert("hostname",QHostInfo::localHostName() );
+      //Optional: "ordered_replies" : "true"/"false" (process requests one at a time and reply in order)
+      QJsonObject argsO = out.in_struct.args.toObject();
+      if(argsO.contains("ordered_replies")){
+        bool ordered = (JsonValueToString(argsO.value("ordered_replies")).toLower()=="true");
+        //The connection flags/BRIDGE hash belong to the socket thread - never change them from a request thread
+        QString bid = REQ.bridgeID;
+        std::function<void()> setflag = [this, bid, ordered](){
+          if(bid.isEmpty()){ orderedReplies = ordered; }
+          else if(BRIDGE.contains(bid)){ BRIDGE[bid].ordered = ordered; }
+        };
+        if(QThread::currentThread()==this->thread()){ setflag(); }
+        else{ QMetaObject::invokeMethod(this, setflag, Qt::QueuedConnection); }
+        obj.insert("ordered_replies", ordered ? "true" : "false");
+      }else{
+        obj.insert("ordered_replies", (REQ.bridgeID.isEmpty() ? orderedReplies : BRIDGE.value(REQ.bridgeID).ordered) ? "true" : "false");
+      }
+      //Optional: "compression" : "zlib"/"none" (large replies get sent as compressed binary frames)
+      //  Only available on direct WebSocket connections (bridged clients and REST always get plain text)
+      //Optional: "encoding" : "cbor"/"json" (requests/replies/events in binary frames as CBOR - same structure as the JSON messages)
+      //  Only available on direct WebSocket connections
+      bool cbor = cborEncoding;
+      bool comp = compressReplies;
+      if(argsO.contains("encoding")){
+        QString enc = JsonValueToString(argsO.value("encoding")).toLower();
+        cbor = (enc=="cbor" && SOCKET!=0 && !isBridge && REQ.bridgeID.isEmpty());
+      }
+      if(argsO.contains("compression")){
+        QString zip = JsonValueToString(argsO.value("compression")).toLower();
+        comp = (zip=="zlib" && SOCKET!=0 && !isBridge && REQ.bridgeID.isEmpty() && COMPRESSOR->enabled());
+      }
+      if(cbor){ comp = false; } //binary frames are CBOR messages
+      if(cbor!=cborEncoding || comp!=compressReplies){
+        //Same as the ordered flag: only changed on the socket thread
+        std::function<void()> setenc = [this, cbor, comp](){
+          bool changed = (cborEncoding!=cbor);
+          cborEncoding = cbor;
+          compressReplies = comp;
+          if(changed){
+            for(int i=0; i<ForwardEvents.length(); i++){ updateSubscription(ForwardEvents[i]); } //switch event encoding
+          }
+        };
+        if(QThread::currentThread()==this->thread()){ setenc(); }
+        else{ QMetaObject::invokeMethod(this, setenc, Qt::QueuedConnection); }
+      }
+      if(SOCKET!=0 && !isBridge && REQ.bridgeID.isEmpty()){
+        obj.insert("compression", comp ? "zlib" : "none");
+        obj.insert("encoding", cbor ? "cbor" : "json");
+      }
       out.out_args = obj;
       out.CODE = RestOutputStruct::OK;
     }else if(out.in_struct.name.startsWith("auth")){
@@ -286,25 +472,32 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
           //qDebug() << "SSL Test String (encrypted + encoded):" << key;
           //qDebug() << "SSL Test String (encrypted):" << QByteArray::fromBase64(key.toLocal8Bit());
 
-          BRIDGE[REQ.bridgeID].enc_key = newkeys[1]; //keep private key
+          if(QThread::currentThread()==this->thread()){ BRIDGE[REQ.bridgeID].enc_key = newkeys[1]; } //keep private key (bridged clients - socket thread only)
           //BRIDGE[REQ.bridgeID].enc_key = pubkey;
         }
         obj.insert("test_string", QJsonValue(key));
 	out.out_args = obj;
         out.CODE = RestOutputStruct::OK;
-        QString msg = out.assembleMessage();
+        addConnectionHeaders(REQ, &out.Header);
+        QByteArray msg = out.assembleMessage();
         if(SOCKET!=0 && !REQ.bridgeID.isEmpty()){
           //BRIDGE RELAY - alternate format
           //Note that the Stage 1 SSL auth reply is only partially encrypted (specific variables only, not bulk message encryption)
           //Now add the destination ID
-          msg.prepend( REQ.bridgeID+"\n");
+          msg.prepend( QString(REQ.bridgeID+"\n").toUtf8() );
         }
-	this->sendReply(msg);
+	queueReply(REQ, msg);
 	return;
       }
     }else if(out.in_struct.name == "auth_token" && out.in_struct.args.isObject()  && !isBridge){
        cur_auth_tok = JsonValueToString(out.in_struct.args.toObject().value("token"));
     }else if(out.in_struct.name == "auth_clear"){
+       if( (TSOCKET!=0 || LSOCKET!=0) && !REQ.VERB.isEmpty()){
+         //REST: every request needs a reply (keeps pipelined replies lined up)
+         out.CODE = RestOutputStruct::OK;
+         addConnectionHeaders(REQ, &out.Header);
+         queueReply(REQ, out.assembleMessage());
+       }
        return; //don't send a return message after clearing an auth (already done)
     }
 
@@ -316,10 +509,10 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
 	      array.append(AUTHSYSTEM->checkAuthTimeoutSecs(cur_auth_tok));
 	    out.out_args = array;
 	    out.CODE = RestOutputStruct::OK;
-	    if(REQ.bridgeID.isEmpty()){ SockAuthToken = cur_auth_tok; }
+	    if(REQ.bridgeID.isEmpty()){ setAuthToken(cur_auth_tok); }
             else{ BRIDGE[REQ.bridgeID].auth_tok = cur_auth_tok; }
 	  }else{
-	    if(SockAuthToken=="REFUSED"){
+	    if(authToken()=="REFUSED"){
 	      out.CODE = RestOutputStruct::FORBIDDEN;
 	    }
 	    //Bad Authentication - return error
@@ -364,12 +557,13 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
 		if(type==EventWatcher::BADEVENT){ continue; }
 		outargs.insert(out.in_struct.name,QJsonValue(evlist[i]));
 		if(sub==1){
-		  ForwardEvents << type;
+		  if(!ForwardEvents.contains(type)){ ForwardEvents << type; }
 		  EventUpdate(type);
 		}else{
 		  ForwardEvents.removeAll(type);
 		}
                 if(isBridge && !REQ.bridgeID.isEmpty()){ BRIDGE[REQ.bridgeID].sendEvents = ForwardEvents; }
+                updateSubscription(type);
 	      }
 	      out.out_args = outargs;
 	      out.CODE = RestOutputStruct::OK;
@@ -382,7 +576,7 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
 	    out.CODE = RestOutputStruct::UNAUTHORIZED;
 	  }
 	//Other namespace - check whether auth has already been established before continuing
-}else if( isBridge && REQ.bridgeID.isEmpty() && !SockAuthToken.isEmpty() && REQ.namesp=="rpc" && REQ.name=="settings" && REQ.args.toObject().value("action").toString()=="list_ssl_checksums"){
+}else if( isBridge && REQ.bridgeID.isEmpty() && !authToken().isEmpty() && REQ.namesp=="rpc" && REQ.name=="settings" && REQ.args.toObject().value("action").toString()=="list_ssl_checksums"){
   //qDebug() << "Within special bridge section";
 	  out.in_struct.fullaccess = false;
 	  //Pre-set any output fields
@@ -394,10 +588,19 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
 	  //Now provide access to the various subsystems
 	  // First get/set the permissions flag into the input structure
 	  out.in_struct.fullaccess = AUTHSYSTEM->hasFullAccess(cur_auth_tok);
-	  //Pre-set any output fields
-          QJsonObject outargs;
+	  if(out.in_struct.namesp.toLower()=="rpc" && out.in_struct.name.toLower()=="query"){
+	    //Subsystem list is already serialized by the capability registry
+	    out.raw_args = CAPABILITIES->subsystemsJson(out.in_struct.fullaccess);
+	    out.CODE = RestOutputStruct::OK;
+	  }else if(out.in_struct.namesp.toLower()=="rpc" && out.in_struct.name.toLower()=="batch"){
+	    //Multiple backend requests in a single message (auth already checked)
+	    EvaluateBatchRequest(&out);
+	  }else{
+	    //Pre-set any output fields
+            QJsonObject outargs;
 	    out.CODE = EvaluateBackendRequest(out.in_struct, &outargs);
             out.out_args = outargs;
+	  }
 }else{
   //qDebug() << "Within fallback auth error section";
 	  //Error in inputs - assemble the return error message
@@ -409,22 +612,144 @@ void WebSocket::EvaluateRequest(const RestInputStruct &REQ){
       out.Header << "Content-Type: text/json; charset=utf-8";
     }
   }
+  sendResponse(out);
+}
+
+QString WebSocket::authToken(){
+  QMutexLocker lock(&tokenMutex);
+  return SockAuthToken;
+}
+
+void WebSocket::setAuthToken(QString tok){
+  QMutexLocker lock(&tokenMutex);
+  SockAuthToken = tok;
+}
+
+void WebSocket::sendResponse(RestOutputStruct &out){
+  const RestInputStruct &REQ = out.in_struct;
+  addConnectionHeaders(REQ, &out.Header);
   //Return any information
-  QString msg = out.assembleMessage();
+  QByteArray msg = out.assembleMessage();
   if(SOCKET!=0 && !REQ.bridgeID.isEmpty()){
    //BRIDGE RELAY - alternate format
-   msg = AUTHSYSTEM->encryptString(msg, BRIDGE[REQ.bridgeID].enc_key);
+   msg = AUTHSYSTEM->encryptString(QString::fromUtf8(msg), BRIDGE[REQ.bridgeID].enc_key).toUtf8();
    //Now add the destination ID
-   msg.prepend( REQ.bridgeID+"\n");
+   msg.prepend( QString(REQ.bridgeID+"\n").toUtf8() );
   }
-  if(out.CODE == RestOutputStruct::FORBIDDEN && SOCKET!=0 && SOCKET->isValid()){
-    this->sendReply(msg);
-    SOCKET->close(QWebSocketProtocol::CloseCodeNormal, "Too Many Authorization Failures - Try again later");
+  if(compressReplies && !REQ.cbor && SOCKET!=0 && REQ.bridgeID.isEmpty() && COMPRESSOR->compress(REQ.namesp, &msg)){
+    //Large reply - send it as a compressed binary frame
+    this->emit SendBinaryMessage(msg);
+  }else if(out.CODE == RestOutputStruct::FORBIDDEN && SOCKET!=0){
+    //Last reply on this connection - the socket belongs to the socket thread (this may be running on a request thread)
+    bool binary = REQ.cbor;
+    QMetaObject::invokeMethod(this, [this, msg, binary](){
+        if(SOCKET==0 || !SOCKET->isValid()){ return; }
+        if(binary){ this->sendBinaryReply(msg); }
+        else{ this->sendReply(msg); }
+        SOCKET->close(QWebSocketProtocol::CloseCodeNormal, "Too Many Authorization Failures - Try again later");
+      }, Qt::QueuedConnection);
   }else{
-    this->emit SendMessage(msg);
+    queueReply(REQ, msg);
   }
 }
 
+void WebSocket::EvaluateBatchRequest(RestOutputStruct *out){
+  //Input: "args" is an array of requests ({"id","namespace","name","args"}),
+  //   or an object with the array in a "requests" field plus an optional "stream":"true" flag
+  //Output: one combined reply (array of the individual replies, in request order)
+  //   or (stream mode) each reply gets sent as soon as it is ready, followed by a short summary reply
+  QJsonArray list;
+  bool stream = false;
+  if(out->in_struct.args.isArray()){ list = out->in_struct.args.toArray(); }
+  else if(out->in_struct.args.isObject()){
+    QJsonObject argsO = out->in_struct.args.toObject();
+    list = argsO.value("requests").toArray();
+    stream = (JsonValueToString(argsO.value("stream")).toLower()=="true");
+  }
+  if(list.isEmpty() || list.count()>BATCHMAXREQUESTS){ out->CODE = RestOutputStruct::BADREQUEST; return; }
+  if(TSOCKET!=0 || LSOCKET!=0){ stream = false; } //REST: exactly one reply per request
+  QSharedPointer<batch_data> batch(new batch_data());
+    batch->stream = stream;
+    batch->next = batch->running = 0;
+  for(int i=0; i<list.count(); i++){
+    QJsonObject obj = list[i].toObject();
+    RestInputStruct sub = out->in_struct; //same connection/auth/encoding info
+      sub.namesp = obj.value("namespace").toString();
+      sub.name = obj.value("name").toString();
+      sub.id = obj.value("id").toString();
+      sub.args = obj.value("args");
+    batch->requests << sub;
+    batch->replies << QByteArray();
+  }
+  //Spread the requests over the worker pool (helper jobs which do not start in time are just skipped)
+  QString lane = SockID;
+  if(!out->in_struct.bridgeID.isEmpty()){ lane.append("::::"+out->in_struct.bridgeID); }
+  lane.append("::::batch");
+  for(int i=1; i<batch->requests.length(); i++){
+    if( !EXECUTOR->submit(lane, [this, batch](){ this->runBatch(batch); }) ){ break; } //lane full
+  }
+  //Also work on the batch in this thread, then wait for any requests still running elsewhere
+  runBatch(batch);
+  batch->mutex.lock();
+    while(batch->running>0){ batch->done.wait(&batch->mutex); }
+  batch->mutex.unlock();
+  //Assemble the final reply
+  out->CODE = RestOutputStruct::OK;
+  if(stream){
+    QJsonObject obj;
+    obj.insert("requests", QString::number(batch->requests.length()));
+    out->out_args = obj;
+  }else{
+    //Every reply is already serialized - just splice them together
+    QByteArray arr("[");
+    for(int i=0; i<batch->replies.length(); i++){
+      if(i>0){ arr.append(","); }
+      arr.append(batch->replies[i]);
+    }
+    arr.append("]");
+    out->raw_args = arr;
+  }
+}
+
+void WebSocket::runBatch(QSharedPointer<batch_data> batch){
+  batch->mutex.lock();
+  while(batch->next < batch->requests.length()){
+    int num = batch->next;
+    batch->next++;
+    batch->running++;
+    batch->mutex.unlock();
+    //Run this request
+    RestOutputStruct out;
+      out.in_struct = batch->requests[num];
+    QString namesp = out.in_struct.namesp.toLower();
+    QString name = out.in_struct.name.toLower();
+    if(namesp.isEmpty() || name.isEmpty() || namesp=="events" || (namesp=="rpc" && (name=="batch" || name=="identify" || name.startsWith("auth")) ) ){
+      out.CODE = RestOutputStruct::BADREQUEST; //not a backend request
+    }else if(namesp=="rpc" && name=="query"){
+      out.raw_args = CAPABILITIES->subsystemsJson(out.in_struct.fullaccess);
+      out.CODE = RestOutputStruct::OK;
+    }else{
+      QJsonObject outargs;
+      out.CODE = EvaluateBackendRequest(out.in_struct, &outargs);
+      out.out_args = outargs;
+    }
+    QByteArray reply;
+    if(batch->stream){
+      sendResponse(out);
+    }else{
+      //Plain JSON message (gets embedded in the combined reply)
+      out.in_struct.VERB.clear();
+      out.in_struct.cbor = false;
+      reply = out.assembleMessage();
+    }
+    batch->mutex.lock();
+    batch->replies[num] = reply;
+    batch->running--;
+    if(batch->running==0 && batch->next>=batch->requests.length()){ batch->done.wakeAll(); }
+  }
+  batch->mutex.unlock();
+}
+
 void WebSocket::EvaluateResponse(const RestInputStruct& IN){
   //qDebug() << "Evaluate Response:" << IN.id << IN.name << IN.args;
   if(!isBridge){ return; } //this is only valid for bridge connections
@@ -433,7 +758,13 @@ void WebSocket::EvaluateResponse(const RestInputStruct& IN){
     QStringList keys = BRIDGE.keys();
     for(int i=0; i<keys.length(); i++){
       if(bids.contains(keys[i])){ bids.removeAll(keys[i]);  } //already handled
-      else{ AUTHSYSTEM->clearAuth(BRIDGE[keys[i]].auth_tok); BRIDGE.remove(keys[i]); } //no longer available
+      else{
+        //no longer available
+        QList<EventWatcher::EVENT_TYPE> evs = BRIDGE[keys[i]].sendEvents;
+        AUTHSYSTEM->clearAuth(BRIDGE[keys[i]].auth_tok);
+        BRIDGE.remove(keys[i]);
+        for(int j=0; j<evs.length(); j++){ updateSubscription(evs[j]); }
+      }
     }
     //Now add any new bridge ID's to the hash
     for(int i=0; i<bids.length(); i++){
@@ -445,7 +776,7 @@ void WebSocket::EvaluateResponse(const RestInputStruct& IN){
       //Auth Successful - save auth token
       QStringList arr = JsonArrayToStringList(IN.args.toArray());
       if(arr.length()==2){
-        SockAuthToken = arr.first();
+        setAuthToken(arr.first());
       }
     }else if(IN.args.isObject()){
       //Stage 2 auth - encrypt string and return it
@@ -495,7 +826,16 @@ QStringList WebSocket::JsonArrayToStringList(QJsonArray array){
 // =====================
 //       PRIVATE SLOTS
 // =====================
+void WebSocket::setupTimers(int idlemsecs){
+  idleMSecs = idlemsecs;
+  idleTimer.setCallback([this](){ this->checkIdle(); });
+  authTimer.setCallback([this](){ this->checkAuth(); });
+  connCheckTimer.setCallback([this](){ this->checkConnection(); });
+  connCheckTimer.start(60000); //1 minute check for connection validity
+}
+
 void WebSocket::checkConnection(){
+  connCheckTimer.start(60000); //check again later
   if(SOCKET !=0 && !SOCKET->isValid()){
     if(connecting){ SOCKET->abort(); }
     emit SocketClosed(SockID);
@@ -503,6 +843,9 @@ void WebSocket::checkConnection(){
   else if(TSOCKET !=0 && !TSOCKET->isValid() ){
     emit SocketClosed(SockID);
   }
+  else if(LSOCKET !=0 && !LSOCKET->isValid() ){
+    emit SocketClosed(SockID);
+  }
 }
 void WebSocket::checkIdle(){
   if(SOCKET !=0 && SOCKET->isValid()){
@@ -512,19 +855,25 @@ void WebSocket::checkIdle(){
     }
   }
   else if(TSOCKET !=0 && TSOCKET->isValid() ){
+    if(EXECUTOR->isBusy(SockID)){ idleTimer.start(idleMSecs); return; } //still working on a request - not idle
     LogManager::log(LogManager::HOST,"Connection Idle: "+SockPeerIP);
     TSOCKET->close(); //timeout - close the connection to make way for others
   }
+  else if(LSOCKET !=0 && LSOCKET->isValid() ){
+    if(EXECUTOR->isBusy(SockID)){ idleTimer.start(idleMSecs); return; } //still working on a request - not idle
+    LogManager::log(LogManager::HOST,"Connection Idle: "+SockPeerIP);
+    LSOCKET->disconnectFromServer();
+  }
 }
 
 void WebSocket::checkAuth(){
   if(isBridge){
     //Special handling for a bridge connection - since the server is the connection "initiator" instead of receiver
-    if(!SockAuthToken.isEmpty() && SOCKET!=0 && SOCKET->isValid()){
+    if(!authToken().isEmpty() && SOCKET!=0 && SOCKET->isValid()){
       LogManager::log(LogManager::HOST,"Bridge Connection Still Unauthorized: "+SockPeerIP);
       SOCKET->close();
     }
-  }else if(!AUTHSYSTEM->checkAuth(SockAuthToken)){
+  }else if(!AUTHSYSTEM->checkAuth(authToken())){
     //Still not authorized - disconnect
     checkIdle();
   }
@@ -532,84 +881,86 @@ void WebSocket::checkAuth(){
 
 void WebSocket::SocketClosing(){
   LogManager::log(LogManager::HOST,"Connection Closing: "+SockPeerIP);
-  if(idletimer->isActive()){
+  if(idleTimer.isActive()){
     //This means the client deliberately closed the connection - not the idle timer
     //qDebug() << " - Client Closed Connection";
-    idletimer->stop();
+    idleTimer.stop();
   }else{
     //qDebug() << "idleTimer not running";
   }
+  authTimer.stop();
+  connCheckTimer.stop();
   //Stop any current requests
+  EXECUTOR->dropLane(SockID);
+  EVENTS->unsubscribeAll(this);
+  CURSORS->dropOwner(SockID);
 
   //Reset the pointer
   if(SOCKET!=0){ SOCKET = 0;	 }
   if(TSOCKET!=0){ TSOCKET = 0; }
+  if(LSOCKET!=0){ LSOCKET = 0; }
 
   emit SocketClosed(SockID);
 }
 
 void WebSocket::EvaluateMessage(const QByteArray &msg){
   //qDebug() << "New Binary Message:";
-  if(idletimer->isActive()){ idletimer->stop(); }
-  idletimer->start();
-  EvaluateREST( QString(msg) );
+  idleTimer.start(idleMSecs); //O(1) - just moves the timer to a new bucket
+  //Binary frames are CBOR messages once that encoding was negotiated (plain JSON text is still accepted)
+  EvaluateREST(msg, cborEncoding && !msg.startsWith('{') );
   //qDebug() << " - Done with Binary Message";
 }
 
 void WebSocket::EvaluateMessage(const QString &msg){
   //qDebug() << "New Text Message:" << msg;
-  if(idletimer->isActive()){ idletimer->stop(); }
-  idletimer->start();
-  EvaluateREST(msg);
+  idleTimer.start(idleMSecs); //O(1) - just moves the timer to a new bucket
+  EvaluateREST(msg.toUtf8());
   //qDebug() << " - Done with Text Message";
 }
 
-void WebSocket::ParseIncoming(){
-  bool found = false;
-
-  // Check if we have a complete JSON request waiting to be parsed
-  QString JsonRequest;
-  for ( int i = 0; i<incomingbuffer.size(); i++) {
-    if(incomingbuffer[i]!='}'){ continue; } //only look for the end of a JSON block
-    JsonRequest = incomingbuffer.left(i+1);
-    //REST requests will have non-JSON at the top - trim that off
-    JsonRequest = "{"+JsonRequest.section("{",1,-1);
-    //JsonRequest.truncate(i);
-    //qDebug() << "Check JSON:" << JsonRequest;
-    if ( !QJsonDocument::fromJson(JsonRequest.toLocal8Bit()).isNull() )
-    {
-      // We have what looks like a valid JSON request, lets parse it now
-      //qDebug() << "TCP Message" << JsonRequest;
-      EvaluateREST(incomingbuffer.left(i+1)); //send the full message
-      incomingbuffer.remove(0, i);
-      found = true;
-      break;
-    }
+bool WebSocket::ParseIncoming(){
+  //Hand every complete message in the buffer over for evaluation
+  QByteArray frame;
+  JsonFramer::STATUS stat = incoming.nextFrame(&frame);
+  while(stat == JsonFramer::FRAME){
+    EvaluateREST(frame);
+    stat = incoming.nextFrame(&frame);
   }
-  //if(!found){ qDebug() << "Bad Message:" << incomingbuffer; }
-  // If the buffer is larger than 128000 chars and no valid JSON somebody
-  // is screwing with us, lets clear the buffer
-  if ( ! found && incomingbuffer.size() > 128000 ) {
-    incomingbuffer="";
-    return;
+  if(stat == JsonFramer::TOOLARGE){
+    //Request is over the size limit - reply with an error and drop the connection
+    LogManager::log(LogManager::HOST,"Request Too Large ["+SockPeerIP+"]: "+QString::number(incoming.buffered())+" bytes");
+    RestOutputStruct out;
+      if(incoming.isRest()){ out.in_struct.VERB = "POST"; } //send a REST-formatted reply
+      out.CODE = RestOutputStruct::PAYLOADTOOLARGE;
+    incoming.clear();
+    if(TSOCKET!=0 && TSOCKET->isValid()){
+      TSOCKET->write(out.assembleMessage());
+      TSOCKET->disconnectFromHost();
+    }else if(LSOCKET!=0 && LSOCKET->isValid()){
+      LSOCKET->write(out.assembleMessage());
+      LSOCKET->disconnectFromServer();
+    }
+    return false;
   }
-
-  // If we found a valid JSON request, but still have data, check for
-  // a second request waiting in the buffer
-  if ( found && incomingbuffer.size() > 2 )
-    ParseIncoming();
+  return true;
 }
 
 void WebSocket::EvaluateTcpMessage(){
   //Need to read the data from the Tcp socket and turn it into a string
   //qDebug() << "New TCP Message:";
-  if(idletimer->isActive()){ idletimer->stop(); }
-  incomingbuffer.append(QString(TSOCKET->read(128000)));
-
-  // Check for JSON in this incoming data
-  ParseIncoming();
+  idleTimer.stop();
+  //Read in chunks and hand off complete messages in between, so the buffer never holds more than
+  //  one partial message plus one chunk (no matter how much the peer sends at once)
+  QIODevice *dev = (TSOCKET!=0) ? (QIODevice*) TSOCKET : (QIODevice*) LSOCKET;
+  while(dev->bytesAvailable()>0){
+    qint64 room = incoming.room();
+    if(room==0){ break; }
+    incoming.append( dev->read( (room<0 || room>TCPREADCHUNK) ? TCPREADCHUNK : room) );
+    // Check for JSON in this incoming data
+    if(!ParseIncoming()){ break; } //request refused - connection is closing
+  }
 
-  idletimer->start();
+  idleTimer.start(idleMSecs);
   //qDebug() << " - Done with TCP Message";
 }
 
@@ -655,6 +1006,18 @@ void WebSocket::startBridgeAuth(){
   this->sendReply( QJsonDocument(obj).toJson(QJsonDocument::Compact) );
 }
 
+void WebSocket::updateSubscription(EventWatcher::EVENT_TYPE evtype){
+  //Bridge connections stay subscribed while any of the bridged clients wants this type of event
+  bool want = ForwardEvents.contains(evtype);
+  if(isBridge){
+    want = false;
+    QHash<QString, bridge_data>::const_iterator it = BRIDGE.constBegin();
+    for( ; it!=BRIDGE.constEnd() && !want; ++it){ want = it.value().sendEvents.contains(evtype); }
+  }
+  if(want){ EVENTS->subscribe(evtype, this, cborEncoding); }
+  else{ EVENTS->unsubscribe(evtype, this); }
+}
+
 // ======================
 //       PUBLIC SLOTS
 // ======================
@@ -662,16 +1025,15 @@ void WebSocket::EventUpdate(EventWatcher::EVENT_TYPE evtype, QJsonValue msg){
   //qDebug() << "Got Socket Event Update:" << msg;
   if(msg.isNull()){ msg = EVENTS->lastEvent(evtype); }
   if(msg.isNull()){ return; } //nothing to send
+  EventMessage(evtype, EventWatcher::eventMessage(evtype, msg, cborEncoding));
+}
+
+void WebSocket::EventMessage(EventWatcher::EVENT_TYPE evtype, QByteArray msg){
+  //NOTE: "msg" is shared between all the subscribed connections - do not modify it in place
   if( !ForwardEvents.contains(evtype) && !isBridge ){ return; }
-  RestOutputStruct out;
-    out.CODE = RestOutputStruct::OK;
-    out.in_struct.namesp = "events";
-    out.out_args = msg;
-    //out.Header << "Content-Type: text/json; charset=utf-8"; //REST header info
-    out.in_struct.name = EventWatcher::typeToString(evtype);
-  //qDebug() << "Send Event:" << out.assembleMessage();
+  //qDebug() << "Send Event:" << msg;
   if(isBridge){
-    QString raw = out.assembleMessage();
+    QString raw = QString::fromUtf8(msg);
     QStringList conns = BRIDGE.keys();
     for(int i=0; i<conns.length(); i++){
       if( !BRIDGE[conns[i]].sendEvents.contains(evtype) ){ continue; }
@@ -679,10 +1041,11 @@ void WebSocket::EventUpdate(EventWatcher::EVENT_TYPE evtype, QJsonValue msg){
       QString enc_data = AUTHSYSTEM->encryptString(raw, BRIDGE[conns[i]].enc_key);
       //Now add the destination ID
       enc_data.prepend( conns[i]+"\n");
-      this->emit SendMessage(enc_data);
+      this->emit SendMessage(enc_data.toUtf8());
     }
   }else{
     //NON-BRIDGE: Now send the message back through the socket
-    this->emit SendMessage(out.assembleMessage());
+    if(cborEncoding){ this->emit SendBinaryMessage(msg); }
+    else{ this->emit SendMessage(msg); }
   }
 }
@@ -10,11 +10,28 @@
 
 #include "RestStructs.h"
 #include "AuthorizationManager.h"
+#include "JsonFramer.h"
+#include "TimerWheel.h"
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
 
 struct bridge_data{
   QByteArray enc_key;
   QString auth_tok;
   QList<EventWatcher::EVENT_TYPE> sendEvents;
+  bool ordered = false; //client asked for in-order replies
+};
+
+//Shared state for an "rpc/batch" request (worked on by multiple request threads)
+struct batch_data{
+  QList<RestInputStruct> requests;
+  QList<QByteArray> replies; //serialized replies (same order as the requests)
+  bool stream; //send each reply as soon as it is ready
+  int next, running;
+  QMutex mutex;
+  QWaitCondition done;
 };
 
 class WebSocket : public QObject{
@@ -22,6 +39,7 @@ class WebSocket : public QObject{
 public:
 	WebSocket(QObject *parent, QWebSocket*, QString ID, AuthorizationManager *auth);
 	WebSocket(QObject *parent, QSslSocket*, QString ID, AuthorizationManager *auth);
+	WebSocket(QObject *parent, QLocalSocket*, QString ID, AuthorizationManager *auth); //local (unix domain socket) connection - same messages as REST
 	WebSocket(QObject *parent, QString url, QString ID, AuthorizationManager *auth); //sets up a bridge connection (websocket only)
 	~WebSocket();
 
@@ -29,29 +47,59 @@ public:
 	void closeConnection();
 	bool isActive(); //check if the connection is still active/valid
 
+	//Build the backend routing table and register the subsystems with the capability registry (WebBackend.cpp)
+	static void RegisterSubsystems(CapabilityRegistry *reg);
+
 private:
-	QTimer *idletimer, *connCheckTimer;
+	//Connection timers (filed in the shared timer wheel of this thread - no QTimer per connection)
+	WheelTimer idleTimer, authTimer, connCheckTimer; //idle timeout, auth deadline, liveness check
+	int idleMSecs;
 	QWebSocket *SOCKET;
 	QSslSocket *TSOCKET;
+	QLocalSocket *LSOCKET;
 	QString SockID, SockAuthToken, SockPeerIP;
+	QMutex tokenMutex; //SockAuthToken is read by the request threads (only ever changed on the socket thread)
 	AuthorizationManager *AUTHSYSTEM;
 	QList<EventWatcher::EVENT_TYPE> ForwardEvents;
 	bool connecting; //flag for whether the connection is still being established
+	bool orderedReplies; //client asked for replies in the same order as the requests (rpc/identify)
+	bool compressReplies; //client asked for compressed replies (rpc/identify)
+	bool cborEncoding; //client asked for the binary CBOR encoding (rpc/identify)
+	int restRequests; //number of requests received on a persistent REST connection
 
 	//Data handling for bridged connections (1 connection for multiple clients)
 	QHash<QString, bridge_data> BRIDGE; //ID/data
 	bool isBridge;
 
 	// Where we store incoming Tcp data
-	QString incomingbuffer;
-	void ParseIncoming();
+	JsonFramer incoming;
+	bool ParseIncoming(); //returns false if the connection got dropped (request too large)
 
 	//Main connection communications procedure
-	void EvaluateREST(QString); //STAGE 1 response: Text -> Rest/JSON struct
+	void EvaluateREST(const QByteArray&, bool cbor = false); //STAGE 1 response: UTF-8 (or CBOR) bytes -> Rest/JSON struct
 	void EvaluateRequest(const RestInputStruct&); //STAGE 2 response: Parse Rest/JSON (does auth/events)
+	void EvaluateRestRequest(const RestInputStruct&); //STAGE 2 response for TCP/REST connections (REST-only verbs)
 	//Response handling 
 	void EvaluateResponse(const RestInputStruct&);
 
+	// -- Batch requests (rpc/batch)
+	void EvaluateBatchRequest(RestOutputStruct *out);
+	void runBatch(QSharedPointer<batch_data>); //process requests from the batch until none are left
+
+	//Auth token access (safe to use from request threads)
+	QString authToken();
+	void setAuthToken(QString tok);
+
+	//Reply handling (safe to use from request threads)
+	void sendResponse(RestOutputStruct &out); //assemble/encrypt/compress the reply and send it
+	void queueReply(const RestInputStruct&, QByteArray msg); //closes a REST connection after the reply unless keep-alive was requested
+	void addConnectionHeaders(const RestInputStruct&, QStringList *headers); //REST "Connection"/"Keep-Alive" headers
+	void setupTimers(int idlemsecs); //setup the connection timers (shared timer wheel)
+	void sendErrorReply(const RestInputStruct&, RestOutputStruct::ExitCode code); //request was refused before processing (busy/rate limit)
+
+	//Event subscriptions (registered with the EventWatcher)
+	void updateSubscription(EventWatcher::EVENT_TYPE);
+
 	//Simplification functions
 	QString JsonValueToString(QJsonValue);
 	QStringList JsonArrayToStringList(QJsonArray);
@@ -61,50 +109,29 @@ private:
 	RestOutputStruct::ExitCode AvailableSubsystems(bool fullaccess, QJsonObject *out);
 	// -- Main subsystem parser
 	RestOutputStruct::ExitCode EvaluateBackendRequest(const RestInputStruct&, QJsonObject *out);
+	// -- Paged listings ("limit"/"cursor" arguments)
+	RestOutputStruct::ExitCode EvaluateCursorRequest(QString action, RowFactory rows, const RestInputStruct&, QJsonObject *out);
 
 
-	// -- Individual subsystems
+	// -- Individual subsystems which parse their own "action" argument
+	//    (all the other subsystems are action tables registered in RegisterSubsystems())
 	// -- Server Settings Modification API
 	RestOutputStruct::ExitCode EvaluateSysadmSettingsRequest(const QJsonValue in_args, QJsonObject *out);
 	// -- Server Log retrieval system
 	RestOutputStruct::ExitCode EvaluateSysadmLogsRequest(bool allaccess, const QJsonValue in_args, QJsonObject *out);
-	// -- rpc dispatcher API
-	RestOutputStruct::ExitCode EvaluateDispatcherRequest(bool allaccess, const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm beadm API
-	RestOutputStruct::ExitCode EvaluateSysadmBEADMRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm FS API
-	RestOutputStruct::ExitCode EvaluateSysadmFSRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm iocage API
-	RestOutputStruct::ExitCode EvaluateSysadmIocageRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm iohyve API
-	RestOutputStruct::ExitCode EvaluateSysadmIohyveRequest(const QJsonValue in_args, QJsonObject *out);
 	// -- sysadm Network API
 	RestOutputStruct::ExitCode EvaluateSysadmNetworkRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm LifePreserver API
-	RestOutputStruct::ExitCode EvaluateSysadmLifePreserverRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm info API
-	RestOutputStruct::ExitCode EvaluateSysadmSystemMgmtRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm Update API
-	RestOutputStruct::ExitCode EvaluateSysadmUpdateRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm ZFS API
-	RestOutputStruct::ExitCode EvaluateSysadmZfsRequest(const QJsonValue in_args, QJsonObject *out);
 	// -- sysadm PKG API
 	RestOutputStruct::ExitCode EvaluateSysadmPkgRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm User Mgmt API
-	RestOutputStruct::ExitCode EvaluateSysadmUserRequest(bool allaccess, QString user, const QJsonValue in_args, QJsonObject *out);
 	// -- sysadm Service Manager API
 	RestOutputStruct::ExitCode EvaluateSysadmServiceRequest(const QJsonValue in_args, QJsonObject *out);
 	// -- sysadm Firewall Manager API
 	RestOutputStruct::ExitCode EvaluateSysadmFirewallRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm moused API
-	RestOutputStruct::ExitCode EvaluateSysadmMousedRequest(const QJsonValue in_args, QJsonObject *out);
-	// -- sysadm powerd API
-	RestOutputStruct::ExitCode EvaluateSysadmPowerdRequest(const QJsonValue in_args, QJsonObject *out);
-    // -- sysadm sourcectl API
-    RestOutputStruct::ExitCode EvaluateSysadmSourceCTLRequest(const QJsonValue in_args, QJsonObject *out);
 
 private slots:
-	void sendReply(QString msg);
+	void sendReply(QByteArray msg);
+	void sendFinalReply(QByteArray msg); //send the message and then close the TCP/REST connection
+	void sendBinaryReply(QByteArray msg); //compressed or CBOR reply (WebSocket binary frame)
 	void checkConnection(); //see if the current connection is still open/valid
 	void checkIdle(); //see if the currently-connected client is idle
 	void checkAuth(); //see if the currently-connected client has authed yet
@@ -128,11 +155,15 @@ private slots:
 	void startBridgeAuth();
 
 public slots:
+	void deleteWhenIdle(); //delete the connection once none of its requests are still running on the workers
 	void EventUpdate(EventWatcher::EVENT_TYPE, QJsonValue = QJsonValue() );
+	void EventMessage(EventWatcher::EVENT_TYPE, QByteArray); //pre-assembled event message (shared between subscribers)
 
 signals:
 	void SocketClosed(QString); //ID
-	void SendMessage(QString); //Internal - connected to sendReply(QString)
+	void SendMessage(QByteArray); //Internal - connected to sendReply(QByteArray)
+	void SendFinalMessage(QByteArray); //Internal - connected to sendFinalReply(QByteArray)
+	void SendBinaryMessage(QByteArray); //Internal - connected to sendBinaryReply(QByteArray)
 };
 
 #endif
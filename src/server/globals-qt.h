@@ -35,6 +35,8 @@
 #include <QTcpServer>
 #include <QSslSocket>
 #include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
 
 #include <QThread>
 #include <QFileSystemWatcher>
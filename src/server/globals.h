@@ -18,6 +18,20 @@ extern bool WS_MODE;
 extern EventWatcher *EVENTS;
 #include "Dispatcher.h"
 extern Dispatcher *DISPATCHER;
+#include "RequestExecutor.h"
+extern RequestExecutor *EXECUTOR;
+#include "CapabilityRegistry.h"
+extern CapabilityRegistry *CAPABILITIES;
+#include "ReplyCompressor.h"
+extern ReplyCompressor *COMPRESSOR;
+#include "CursorTable.h"
+extern CursorTable *CURSORS;
+#include "ResponseCache.h"
+extern ResponseCache *RESPONSECACHE;
+#include "HostLimiter.h"
+extern HostLimiter *HOSTLIMITS;
+#include "MetricsStore.h"
+extern MetricsStore *METRICS;
 
 //Special defines
 #define BRIDGEPORTNUMBER 12149 //Default port for a sysadm-bridge
@@ -28,6 +42,25 @@ extern Dispatcher *DISPATCHER;
 extern int BlackList_BlockMinutes;
 extern int BlackList_AuthFailsToBlock;
 extern int BlackList_AuthFailResetMinutes;
+extern double Limit_ConnRate; //new connections per second from one address (0: no limit)
+extern int Limit_ConnBurst; //connections from one address which may arrive at once
+extern double Limit_RequestRate; //requests per second from one address (0: no limit)
+extern int Limit_RequestBurst; //requests from one address which may arrive at once
 extern bool BRIDGE_ONLY; //bridge-only mode (no listening on a socket)
+extern QString Local_Socket; //path of the local (unix domain) socket to listen on (empty: none)
+extern int IO_Threads; //number of I/O threads for client connections (0: main thread only, less than 0: one per CPU)
+extern int Request_Workers; //number of request worker threads (0: one per CPU)
+extern int Request_QueueDepth; //max number of waiting requests per connection
+extern int Request_ParallelPerConn; //max number of requests from one connection processed at once
+extern int Request_MaxBytes; //max size of a single request on a raw TCP/REST connection
+extern int Rest_KeepAliveSecs; //idle timeout for persistent REST connections (0: one request per connection)
+extern int Rest_KeepAliveMax; //max number of requests on one persistent REST connection (0: no limit)
+extern int Compress_Threshold; //smallest WebSocket reply to compress in bytes (0: no compression)
+extern int Compress_Level; //zlib compression level for WebSocket replies (1-9)
+extern bool Response_Cache; //cache the results of read-only actions for a few seconds
+extern int CPU_SampleMSecs; //interval of the background CPU usage sampler
+extern bool Metrics_History; //keep a history of the system statistics (sysadm/metrics)
+extern int Dispatch_SyncMSecs; //max delay before queued/started/finished jobs are synced to the dispatcher journal (0: right away)
+extern bool STUB_BACKEND; //benchmark mode ("-stub" CLI flag): no backend/system calls
 
 #endif
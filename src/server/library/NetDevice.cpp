@@ -19,6 +19,15 @@
 
 using namespace sysadm;
 
+#if !defined(__FreeBSD__)
+//No routing sysctl's or media ioctl's outside of FreeBSD: read the kernel's per-interface files instead (Linux)
+static QString linuxNetFile(QString dev, QString file){
+  QFile f("/sys/class/net/"+dev+"/"+file);
+  if(!f.open(QIODevice::ReadOnly)){ return ""; }
+  return QString(f.readAll()).simplified();
+}
+#endif
+
 //====================
 //   STATIC LISTING FUNCTION
 //====================
@@ -90,7 +99,12 @@ QString NetDevice::ipv6AsString(){
   if(sadd==0){ qDebug() << "No socket address found"; return ""; }
   //Now get the IPv6 address in string form
   char straddr[INET6_ADDRSTRLEN];
-  int err = getnameinfo(sadd, sadd->sa_len, straddr, sizeof(straddr),NULL, 0, NI_NUMERICHOST);
+#if defined(__FreeBSD__)
+  socklen_t saddlen = sadd->sa_len;
+#else
+  socklen_t saddlen = sizeof(struct sockaddr_in6); //no sa_len field outside of BSD
+#endif
+  int err = getnameinfo(sadd, saddlen, straddr, sizeof(straddr),NULL, 0, NI_NUMERICHOST);
   if(err!=0){
     qDebug() << "getnameinfo error:" << gai_strerror(err);
     return "";
@@ -133,6 +147,7 @@ QString NetDevice::desc(){
 
 //Fetch the mac address as a QString
 QString NetDevice::macAsString(){
+#if defined(__FreeBSD__)
    int mib[6];
    size_t len;
    char *buf;
@@ -160,10 +175,14 @@ QString NetDevice::macAsString(){
       if(i<5){ mac += ":"; }
    }
    return mac;
+#else
+   return linuxNetFile(name, "address");
+#endif
 }
 
 //Get the status of the device (active, associated, etc...)
 QString NetDevice::mediaStatusAsString(){
+#if defined(__FreeBSD__)
    struct ifmediareq ifm;
    memset(&ifm, 0, sizeof(struct ifmediareq));
 
@@ -184,6 +203,9 @@ QString NetDevice::mediaStatusAsString(){
    }
    close(s); //close the file descriptor
    return status;
+#else
+   return (linuxNetFile(name, "operstate")=="up") ? "active" : "no carrier";
+#endif
 }
 
 QString NetDevice::gatewayAsString(){
@@ -196,6 +218,7 @@ QString NetDevice::gatewayAsString(){
 
 //Check if a device is wireless or not
 bool NetDevice::isWireless(){
+#if defined(__FreeBSD__)
    struct ifmediareq ifm;
    memset(&ifm, 0, sizeof(struct ifmediareq));
 
@@ -206,6 +229,9 @@ bool NetDevice::isWireless(){
   bool iswifi = (IFM_TYPE(ifm.ifm_active) == IFM_IEEE80211);
   close(s); //close the file descriptor
    return iswifi;
+#else
+   return QFile::exists("/sys/class/net/"+name+"/wireless");
+#endif
 }
 
 //Get the parent device (if this is a wireless wlan)
@@ -238,6 +264,7 @@ bool NetDevice::isUp(){
 
 //Determine the number of packets received by the device
 long NetDevice::packetsRx(){
+#if defined(__FreeBSD__)
    int mib[6];
    size_t len;
    char *buf;
@@ -258,10 +285,14 @@ long NetDevice::packetsRx(){
    ifm = (if_msghdr *) buf;
 
    return ifm->ifm_data.ifi_ipackets;
+#else
+   return linuxNetFile(name, "statistics/rx_packets").toLong();
+#endif
 }
 
 //Determine the number of packets transmitted by the device
 long NetDevice::packetsTx(){
+#if defined(__FreeBSD__)
    int mib[6];
    size_t len;
    char *buf;
@@ -282,10 +313,14 @@ long NetDevice::packetsTx(){
    ifm = (if_msghdr *) buf;
 
    return ifm->ifm_data.ifi_opackets;
+#else
+   return linuxNetFile(name, "statistics/tx_packets").toLong();
+#endif
 }
 
 //Determine the number of errors received
 long NetDevice::errorsRx(){
+#if defined(__FreeBSD__)
    int mib[6];
    size_t len;
    char *buf;
@@ -306,10 +341,14 @@ long NetDevice::errorsRx(){
    ifm = (if_msghdr *) buf;
 
    return ifm->ifm_data.ifi_ierrors;
+#else
+   return linuxNetFile(name, "statistics/rx_errors").toLong();
+#endif
 }
 
 //Determine the number of errors transmitted
 long NetDevice::errorsTx(){
+#if defined(__FreeBSD__)
    int mib[6];
    size_t len;
    char *buf;
@@ -330,6 +369,9 @@ long NetDevice::errorsTx(){
    ifm = (if_msghdr *) buf;
 
    return ifm->ifm_data.ifi_oerrors;
+#else
+   return linuxNetFile(name, "statistics/tx_errors").toLong();
+#endif
 }
 
 //=========================
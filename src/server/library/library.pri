@@ -2,8 +2,11 @@
 CONFIG 	+=  c++11
 
 HEADERS	+= 	$${PWD}/sysadm-global.h \
+                $${PWD}/sysadm-rowsource.h \
                 $${PWD}/sysadm-general.h \
+                $${PWD}/sysadm-process.h \
                 $${PWD}/sysadm-beadm.h \
+                $${PWD}/sysadm-cpusampler.h \
                 $${PWD}/sysadm-filesystem.h \
                 $${PWD}/sysadm-iocage.h \
                 $${PWD}/sysadm-iohyve.h \
@@ -12,6 +15,7 @@ HEADERS	+= 	$${PWD}/sysadm-global.h \
                 $${PWD}/sysadm-firewall.h \
                 $${PWD}/sysadm-servicemanager.h\
                 $${PWD}/sysadm-systemmanager.h\
+                $${PWD}/sysadm-systemprobe.h \
                 $${PWD}/sysadm-update.h \
                 $${PWD}/sysadm-users.h \
 		$${PWD}/sysadm-zfs.h \
@@ -23,7 +27,9 @@ HEADERS	+= 	$${PWD}/sysadm-global.h \
 
 SOURCES	+=	$${PWD}/NetDevice.cpp \
                 $${PWD}/sysadm-general.cpp \
+                $${PWD}/sysadm-process.cpp \
                 $${PWD}/sysadm-beadm.cpp \
+                $${PWD}/sysadm-cpusampler.cpp \
                 $${PWD}/sysadm-filesystem.cpp \
                 $${PWD}/sysadm-iocage.cpp \
                 $${PWD}/sysadm-iohyve.cpp \
@@ -32,6 +38,7 @@ SOURCES	+=	$${PWD}/NetDevice.cpp \
                 $${PWD}/sysadm-firewall.cpp \
                 $${PWD}/sysadm-servicemanager.cpp \
                 $${PWD}/sysadm-systemmanager.cpp \
+                $${PWD}/sysadm-systemprobe.cpp \
                 $${PWD}/sysadm-update.cpp \
                 $${PWD}/sysadm-users.cpp \
 		$${PWD}/sysadm-zfs.cpp \
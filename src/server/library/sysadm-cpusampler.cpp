@@ -0,0 +1,139 @@
+//===========================================
+//  PC-BSD source code
+//  Copyright (c) 2015, PC-BSD Software/iXsystems
+//  Available under the 3-clause BSD license
+//  See the LICENSE file for full details
+//===========================================
+#include "sysadm-cpusampler.h"
+#include "sysadm-systemprobe.h"
+
+using namespace sysadm;
+
+#define LONGEST_WINDOW 60000 //msecs of history to keep (longest averaging window)
+
+static int INTERVAL = 1000;
+
+CpuSampler* CpuSampler::instance(){
+  static CpuSampler sampler(INTERVAL); //stopped when the program exits
+  return &sampler;
+}
+
+void CpuSampler::setInterval(int msecs){
+  if(msecs>=10){ INTERVAL = msecs; }
+}
+
+CpuSampler::CpuSampler(int msecs) : QThread(){
+  sampleMSecs = msecs;
+  //Enough slots for the longest window + the one being written right now
+  slots = qMax(4, LONGEST_WINDOW/sampleMSecs + 3);
+  stopping = false;
+  written = 0;
+  QVector<CpuTimes> cpus;
+  SystemProbe::instance()->cpuTimes(&cpus);
+  ncpu = cpus.size();
+  ring = new Slot[slots];
+  for(int i=0; i<slots; i++){
+    ring[i].seq = 0;
+    ring[i].msecs = 0;
+    ring[i].ticks = new QAtomicInteger<quint64>[2*ncpu];
+  }
+  clock.start();
+  if(ncpu<1){ return; } //no CPU counters on this system - nothing to sample
+  sample(); //first sample right away (averages since boot until the next one)
+  setObjectName("sysadm-cpusampler");
+  start();
+}
+
+CpuSampler::~CpuSampler(){
+  stopMutex.lock();
+  stopping = true;
+  stopCond.wakeAll();
+  stopMutex.unlock();
+  wait();
+  for(int i=0; i<slots; i++){ delete[] ring[i].ticks; }
+  delete[] ring;
+}
+
+void CpuSampler::run(){
+  qint64 next = sampleMSecs; //the first sample was taken at startup
+  stopMutex.lock();
+  while(!stopping){
+    //Keep the samples on a fixed schedule (no drift from the time it takes to read them)
+    qint64 wait = next - clock.elapsed();
+    if(wait>0){ stopCond.wait(&stopMutex, wait); continue; }
+    stopMutex.unlock();
+    sample();
+    next += sampleMSecs;
+    if(next < clock.elapsed()){ next = clock.elapsed() + sampleMSecs; } //fell behind (suspended?) - don't try to catch up
+    stopMutex.lock();
+  }
+  stopMutex.unlock();
+}
+
+void CpuSampler::sample(){
+  QVector<CpuTimes> cpus;
+  if(!SystemProbe::instance()->cpuTimes(&cpus)){ return; }
+  quint64 num = written.loadAcquire();
+  Slot &S = ring[num % slots];
+  S.seq.fetchAndAddRelaxed(1); //odd: readers will skip/retry this slot
+  S.msecs.storeRelease(clock.elapsed());
+  for(int i=0; i<ncpu; i++){
+    quint64 total = (i<cpus.size()) ? cpus[i].total() : 0;
+    quint64 idle = (i<cpus.size()) ? cpus[i].idle : 0;
+    S.ticks[2*i].storeRelease(total-idle);
+    S.ticks[2*i+1].storeRelease(total);
+  }
+  S.seq.fetchAndAddRelease(1); //even again: slot complete
+  written.storeRelease(num+1);
+}
+
+bool CpuSampler::readSlot(quint64 index, qint64 *msecs, QVector<quint64> *ticks){
+  Slot &S = ring[index % slots];
+  ticks->resize(2*ncpu);
+  for(int attempt=0; attempt<4; attempt++){
+    quint32 seq = S.seq.loadAcquire();
+    if( (seq & 1)==1 ){ QThread::yieldCurrentThread(); continue; } //being written right now (takes microseconds)
+    //Acquire loads: any value from a newer write also makes that write's sequence bump visible below
+    *msecs = S.msecs.loadAcquire();
+    for(int i=0; i<2*ncpu; i++){ (*ticks)[i] = S.ticks[i].loadAcquire(); }
+    if(S.seq.load()==seq){ return true; }
+  }
+  return false;
+}
+
+bool CpuSampler::busy(int windowMSecs, QVector<double> *cpus, double *total){
+  QVector<quint64> now, before;
+  qint64 tnow = 0, tbefore = 0;
+  for(int attempt=0; attempt<4; attempt++){
+    quint64 num = written.loadAcquire();
+    if(num==0){ return false; }
+    if(!readSlot(num-1, &tnow, &now)){ continue; }
+    if(num==1){
+      before.fill(0, 2*ncpu); //only one sample so far: everything since boot
+    }else{
+      //Walk back to the newest sample which is at least "windowMSecs" old (or the oldest one kept)
+      quint64 oldest = (num > quint64(slots-1)) ? num-(slots-1) : 0; //the slot after that one gets overwritten next
+      quint64 index = num-2;
+      while(index>oldest){
+        qint64 t = ring[index % slots].msecs.loadAcquire();
+        if(tnow - t >= windowMSecs){ break; }
+        index--;
+      }
+      if(!readSlot(index, &tbefore, &before)){ continue; }
+      if(written.loadAcquire() - index >= quint64(slots)){ continue; } //got lapped while reading
+    }
+    //Now turn the tick differences into percentages
+    quint64 allbusy = 0, alltotal = 0;
+    if(cpus!=0){ cpus->resize(ncpu); }
+    for(int i=0; i<ncpu; i++){
+      quint64 dbusy = now[2*i] - before[2*i];
+      quint64 dtotal = now[2*i+1] - before[2*i+1];
+      if(cpus!=0){ (*cpus)[i] = (dtotal>0) ? (100.0*dbusy)/dtotal : 0; }
+      allbusy += dbusy;
+      alltotal += dtotal;
+    }
+    if(total!=0){ *total = (alltotal>0) ? (100.0*allbusy)/alltotal : 0; }
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,61 @@
+//===========================================
+//  PC-BSD source code
+//  Copyright (c) 2015, PC-BSD Software/iXsystems
+//  Available under the 3-clause BSD license
+//  See the LICENSE file for full details
+//===========================================
+#ifndef __PCBSD_LIB_UTILS_CPUSAMPLER_H
+#define __PCBSD_LIB_UTILS_CPUSAMPLER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <QVector>
+
+namespace sysadm{
+
+// == Background CPU sampler ==
+// Reads the per-CPU tick counters (SystemProbe) at a fixed interval into a ring buffer.
+// Readers never block: every slot is guarded by a sequence number (odd while the sampler writes it),
+//  so a reader just copies the slots it needs and retries if one changed underneath it.
+class CpuSampler : public QThread{
+public:
+	static CpuSampler* instance(); //created and started on first use
+	static void setInterval(int msecs); //only has an effect before the first use (default: 1000)
+
+	//Busy percentages over (roughly) the last "windowMSecs" (0: the latest sample interval)
+	// - cpus: busy % per CPU (optional), total: busy % over all CPUs
+	// - Returns false if there are no samples at all (probe not working)
+	bool busy(int windowMSecs, QVector<double> *cpus, double *total);
+	int interval(){ return sampleMSecs; }
+	int maxWindow(){ return (slots-2)*sampleMSecs; } //longest window with full coverage
+
+protected:
+	void run();
+
+private:
+	struct Slot{
+		QAtomicInteger<quint32> seq; //odd: being written
+		QAtomicInteger<qint64> msecs; //sample time (sampler clock)
+		QAtomicInteger<quint64> *ticks; //[busy, total] per CPU
+	};
+	CpuSampler(int msecs);
+	~CpuSampler();
+
+	int sampleMSecs, slots, ncpu;
+	Slot *ring;
+	QAtomicInteger<quint64> written; //number of samples written so far
+	QElapsedTimer clock;
+	QMutex stopMutex;
+	QWaitCondition stopCond;
+	bool stopping;
+
+	void sample();
+	bool readSlot(quint64 index, qint64 *msecs, QVector<quint64> *ticks);
+};
+
+} //end of sysadm namespace
+
+#endif
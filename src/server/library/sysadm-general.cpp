@@ -8,6 +8,7 @@
 //PLEASE: Keep the functions in the same order as listed in pcbsd-general.h
 
 #include "sysadm-global.h"
+#include "sysadm-process.h"
 
 using namespace sysadm;
 
@@ -21,31 +22,13 @@ QString TRUEOS_ETCCONF(PREFIX + "/etc/trueos.conf");  // The default trueos.conf
 
 //Return CLI output (and success/failure)
 QString General::RunCommand(bool &success, QString command, QStringList arguments, QString workdir, QStringList env){
-  QProcess proc;
-    proc.setProcessChannelMode(QProcess::MergedChannels); //need output
-  //First setup the process environment as necessary
-  QProcessEnvironment PE = QProcessEnvironment::systemEnvironment();
-    if(!env.isEmpty()){
-      for(int i=0; i<env.length(); i++){
-    if(!env[i].contains("=")){ continue; }
-        PE.insert(env[i].section("=",0,0), env[i].section("=",1,100));
-      }
-    }
-    proc.setProcessEnvironment(PE);
-  //if a working directory is specified, check it and use it
-  if(!workdir.isEmpty()){
-    proc.setWorkingDirectory(workdir);
-  }
-  //Now run the command (with any optional arguments)
-  if(arguments.isEmpty()){ proc.start(command); }
-  else{ proc.start(command, arguments); }
-  //Wait for the process to finish (but don't block the event loop)
-  while( !proc.waitForFinished(500) ){
-    if(proc.state() != QProcess::Running){ break; } //somehow missed the finished signal    
-    QCoreApplication::processEvents(); 
-  }
-  success = (proc.exitCode()==0); //return success/failure
-  return QString(proc.readAllStandardOutput());
+  CommandOptions opts;
+    opts.workdir = workdir;
+    opts.env = env;
+  //Run the command (only this thread waits - the output is collected by the process runner)
+  CommandResult result = ProcessRunner::run(command, arguments, opts);
+  success = result.success(); //return success/failure
+  return QString(result.output);
 }
 
 QString General::RunCommand(QString command, QStringList arguments, QString workdir, QStringList env){
@@ -63,15 +46,14 @@ bool General::RunQuickCommand(QString command, QStringList arguments,QString wor
 
 QStringList General::gitCMD(QString dir, QString cmd, QStringList args){
   //Run a quick command in the proper dir and return the output
-  QProcess proc;
-  proc.setProcessChannelMode(QProcess::MergedChannels);
-  if( !dir.isEmpty() && QFile::exists(dir) ){ proc.setWorkingDirectory(dir); }
-  if(args.isEmpty()){ proc.start(cmd); }
-  else{ proc.start(cmd, args); }
-  while(!proc.waitForFinished(300)){ QCoreApplication::processEvents(); }
+  CommandOptions opts;
+  if( !dir.isEmpty() && QFile::exists(dir) ){ opts.workdir = dir; }
+  QString output = QString( ProcessRunner::run(cmd, args, opts).output );
   QStringList out;
-  while(proc.canReadLine()){
-    out << QString( proc.readLine() );
+  int from = 0;
+  for(int i=output.indexOf("\n"); i>=0; i=output.indexOf("\n", from)){
+    out << output.mid(from, i+1-from); //complete lines only (newline included)
+    from = i+1;
   }
   return out;
 }
@@ -292,20 +274,30 @@ QString General::getValFromTOConf(QString conf, QString key) {
 //===========================
 //Retrieve a text-based sysctl
 QString General::sysctl(QString var){
+#if defined(__FreeBSD__)
    char result[1000];
    size_t len = sizeof(result);
    if(0!=sysctlbyname(var.toLocal8Bit(), result, &len, NULL, 0)){ return ""; }
    result[len] = '\0';
    //qDebug() << "Sysctl:" << var << len << result;
    return QString(QByteArray(result,len));
+#else
+   Q_UNUSED(var);
+   return ""; //no sysctlbyname() on this system
+#endif
 }
 
 //Retrieve a number-based sysctl
 long long General::sysctlAsInt(QString var){
+#if defined(__FreeBSD__)
    long long result = 0;
    size_t len = sizeof(result);
    if(0!=sysctlbyname(var.toLocal8Bit(), &result, &len, NULL, 0) ){ return 0; }
    return result;
+#else
+   Q_UNUSED(var);
+   return 0;
+#endif
 }
 
 //===========================
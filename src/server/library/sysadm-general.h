@@ -13,7 +13,7 @@ namespace sysadm{
 
 class General{
 public:
-    //Non-event-blocking versions of QProcess::execute() or system()
+    //Versions of QProcess::execute() or system() which only block the calling thread (see sysadm-process.h)
     //Note: environment changes should be listed as such: [<variable>=<value>]
     // - Both success/log of output
     static QString RunCommand(bool &success, QString command, QStringList arguments = QStringList(), QString workdir = "", QStringList env = QStringList() );
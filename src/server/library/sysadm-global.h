@@ -24,13 +24,17 @@
 
 //FreeBSD Includes
 #include <sys/types.h>
+#if defined(__FreeBSD__)
 #include <sys/sysctl.h>
+#endif
 #include <sys/ioctl.h>
 #include <unistd.h>
 
 #include <net/if.h>
+#if defined(__FreeBSD__)
 #include <net/if_dl.h>
 #include <net/if_media.h>
+#endif
 
 #include <ifaddrs.h>
 #include <netinet/in.h>
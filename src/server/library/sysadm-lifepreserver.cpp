@@ -286,56 +286,61 @@ QJsonObject LifePreserver::listReplication() {
 }
 
 // Return a list of snapshots on a particular pool / dataset
+// Rows from the snapshot listing (snapshot : {comment})
+class ListSnapRows : public LineRowSource{
+public:
+  ListSnapRows(QString pool) : LineRowSource("lpreserver", QStringList() << "snapshot" << "list" << pool){
+    inSection = false;
+    sep = QRegExp("\\s+");
+  }
+protected:
+  bool parseLine(const QString &line, QString *key, QJsonValue *row){
+      if ( line.indexOf("-----------------") != -1 ) {
+         if(inSection){ done = true; } //end of the listing
+         inSection = true;
+         return false;
+      }
+
+      if (!inSection)
+         return false;
+
+      if ( line.isEmpty() ){
+         done = true;
+         return false;
+      }
+
+      // Breakdown this snapshot
+      *key = line.section(sep, 0, 0).simplified();
+      QJsonObject values;
+      values.insert("comment", line.section(sep, 1, -1).simplified());
+      *row = values;
+      return true;
+  }
+private:
+  bool inSection;
+  QRegExp sep;
+};
+
 QJsonObject LifePreserver::listSnap(QJsonObject jsin) {
    QJsonObject retObject;
-   QString pool;
 
-   QStringList keys = jsin.keys();
-   if(! keys.contains("pool")){
+   RowSource *rows = listSnapRows(jsin);
+   if(rows==0){
      retObject.insert("error", "Missing pool key");
      return retObject;
    }
+   return RowSource::drain(rows);
+}
 
+RowSource* LifePreserver::listSnapRows(QJsonObject jsin) {
    // Check which pool we are looking at
-   pool = jsin.value("pool").toString();
+   QString pool = jsin.value("pool").toString();
 
    // Make sure we have the pool key
    if ( pool.isEmpty() ) {
-     retObject.insert("error", "Missing pool key");
-     return retObject;
+     return 0;
    }
-
-   QStringList output = General::RunCommand("lpreserver snapshot list " + pool ).split("\n");
-   QList<QStringList> snaps;
-   QStringList snapitems;
-   QRegExp sep("\\s+");
-
-   // Parse the output
-   bool inSection = false;
-   for ( int i = 0; i < output.size(); i++)
-   {
-      if ( output.at(i).indexOf("-----------------") != -1 ) {
-         inSection = true;
-         continue;
-      }
-
-      if (!inSection)
-         continue;
-
-      if ( output.at(i).isEmpty() || output.at(i).indexOf("-----------------") != -1 )
-	  break;
-
-      // Breakdown this snapshot
-      snapitems.clear();
-      snapitems << output.at(i).section(sep, 0, 0).simplified();
-      snapitems << output.at(i).section(sep, 1, -1).simplified();
-
-      QJsonObject values;
-      values.insert("comment", snapitems.at(1));
-      retObject.insert(snapitems.at(0), values);
-  }
-
-  return retObject;
+   return new ListSnapRows(pool);
 }
 
 // Remove a replication task
@@ -9,6 +9,7 @@
 
 #include <QJsonObject>
 #include "sysadm-global.h"
+#include "sysadm-rowsource.h"
 
 namespace sysadm{
 
@@ -20,6 +21,7 @@ public:
 	static QJsonObject listCron(); 
 	static QJsonObject listReplication();
 	static QJsonObject listSnap(QJsonObject jsin);
+	static RowSource* listSnapRows(QJsonObject jsin); //incremental version of listSnap() (0: invalid inputs)
 	static QJsonObject removeReplication(QJsonObject jsin);
 	static QJsonObject removeSnapshot(QJsonObject jsin);
 	static QJsonObject revertSnapshot(QJsonObject jsin);
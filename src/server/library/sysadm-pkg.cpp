@@ -11,6 +11,8 @@
 
 using namespace sysadm;
 
+#define PKG_ROWS_BATCH 64 //packages read from the database at a time for a paged pkg_info listing
+
 // ==================
 //  INLINE FUNCTIONS
 // ==================
@@ -127,35 +129,23 @@ inline QString openDB(QString repo){
   qDebug() << " - done closing";
 }*/
 
-// =================
-//  MAIN FUNCTIONS
-// =================
-QJsonObject PKG::pkg_info(QStringList origins, QString repo, QString category, bool fullresults){
-  QJsonObject retObj;
-  //if(origins.contains("math/R")){ qDebug() << "pkg_info:" << repo << category; }
-  QString dbconn = openDB(repo);
-  if(!dbconn.isEmpty()){
-  QSqlDatabase DB = QSqlDatabase::database(dbconn);
-  if(!DB.isOpen()){ return retObj; } //could not open DB (file missing?)
-  //Now do all the pkg info, one pkg origin at a time
+//Which packages a pkg_info call is about (SQL condition - empty for all of them)
+inline QString pkg_info_filter(QStringList origins, QString category){
   origins.removeAll("");
   origins.removeDuplicates();
-    QString q_string = "SELECT * FROM packages";
-    if(!origins.isEmpty()){
-      q_string.append(" WHERE name IN ('"+origins.join("', '")+"')");
-      //Also keep the ordering of the origins preserved
-      /*q_string.append(" ORDER BY CASE origins ");
-      for(int i=0; i<origins.length(); i++){ q_string.append("WHEN '"+origins[i]+"' THEN '"+QString::number(i+1)+"' "); }
-      q_string.append("END");*/
-    }
-    else if(!category.isEmpty()){ q_string.append(" WHERE origin LIKE '"+category+"/%'"); }
-    //if(origins.contains("math/R")){ qDebug() << "Query:" << q_string; }
-  QSqlQuery query(q_string, DB);
-    while(query.next()){
-	QString id = query.value("id").toString(); //need this pkg id for later
-	QString name = query.value("name").toString(); //need the origin for later
-	//if(origins.contains("math/R")){ qDebug() << "Found origin:" << origin << id; }
-      if(id.isEmpty() || name.isEmpty()){ continue; }
+  if(!origins.isEmpty()){
+    return "name IN ('"+origins.join("', '")+"')";
+    //Also keep the ordering of the origins preserved
+    /*q_string.append(" ORDER BY CASE origins ");
+    for(int i=0; i<origins.length(); i++){ q_string.append("WHEN '"+origins[i]+"' THEN '"+QString::number(i+1)+"' "); }
+    q_string.append("END");*/
+  }
+  else if(!category.isEmpty()){ return "origin LIKE '"+category+"/%'"; }
+  return QString();
+}
+
+//All the information about a single package (query: current row of a "SELECT * FROM packages")
+inline QJsonObject pkg_info_row(QSqlQuery &query, QString id, QString name, QSqlDatabase DB, bool fullresults){
       QJsonObject info;
       //General info
       for(int i=0; i<query.record().count(); i++){
@@ -168,7 +158,7 @@ QJsonObject PKG::pkg_info(QStringList origins, QString repo, QString category, b
 	  tags << q2.value("tag_id").toString(); vals << q2.value("value_id").toString();
       }
       if(!tags.isEmpty()){ annotations_from_ids(tags, vals, &info, DB); }
-      if(!fullresults){ retObj.insert(name,info); continue; } //skip the rest of the info queries
+      if(!fullresults){ return info; } //skip the rest of the info queries
       //OPTIONS
       QSqlQuery q3("SELECT value, option FROM pkg_option INNER JOIN option ON pkg_option.option_id = option.option_id WHERE pkg_option.package_id = '"+id+"'", DB);
       QJsonObject options;
@@ -245,9 +235,32 @@ QJsonObject PKG::pkg_info(QStringList origins, QString repo, QString category, b
       QSqlQuery q15("SELECT require_id FROM pkg_requires WHERE package_id = '"+id+"'", DB);
       tmpList.clear();
        while(q15.next()){ tmpList << q15.value("require_id").toString(); }
-       if(!tmpList.isEmpty()){ info.insert("requires", QJsonArray::fromStringList(requires_from_ids(tmpList, DB)) ); }\
-       //Now insert this information into the main object
-       retObj.insert(name,info);
+       if(!tmpList.isEmpty()){ info.insert("requires", QJsonArray::fromStringList(requires_from_ids(tmpList, DB)) ); }
+  return info;
+}
+
+// =================
+//  MAIN FUNCTIONS
+// =================
+QJsonObject PKG::pkg_info(QStringList origins, QString repo, QString category, bool fullresults){
+  QJsonObject retObj;
+  //if(origins.contains("math/R")){ qDebug() << "pkg_info:" << repo << category; }
+  QString dbconn = openDB(repo);
+  if(!dbconn.isEmpty()){
+  QSqlDatabase DB = QSqlDatabase::database(dbconn);
+  if(!DB.isOpen()){ return retObj; } //could not open DB (file missing?)
+  //Now do all the pkg info, one pkg origin at a time
+    QString q_string = "SELECT * FROM packages";
+    QString filter = pkg_info_filter(origins, category);
+    if(!filter.isEmpty()){ q_string.append(" WHERE "+filter); }
+    //if(origins.contains("math/R")){ qDebug() << "Query:" << q_string; }
+  QSqlQuery query(q_string, DB);
+    while(query.next()){
+	QString id = query.value("id").toString(); //need this pkg id for later
+	QString name = query.value("name").toString(); //need the origin for later
+	//if(origins.contains("math/R")){ qDebug() << "Found origin:" << origin << id; }
+      if(id.isEmpty() || name.isEmpty()){ continue; }
+      retObj.insert(name, pkg_info_row(query, id, name, DB, fullresults));
   } //end loop over pkg matches
   DB.close();
   }//end if dbconn exists (force DB out of scope now)
@@ -256,6 +269,76 @@ QJsonObject PKG::pkg_info(QStringList origins, QString repo, QString category, b
   return retObj;
 }
 
+// Rows from the package database (name : info)
+// Reads a few packages at a time (in package id order, picking up after the last id which was read).
+// Every batch opens its own database connection, since a connection can only be used by the thread
+//  which opened it and the pages of a listing might get read by different threads.
+class PkgInfoRows : public RowSource{
+public:
+  PkgInfoRows(QString filter, QString repo, bool fullresults){
+    FILTER = filter;
+    REPO = repo;
+    FULL = fullresults;
+    lastid = -1;
+    done = false;
+  }
+
+  bool next(QString *key, QJsonValue *row){
+    if(batch.isEmpty() && !done){ readBatch(); }
+    if(batch.isEmpty()){ return false; }
+    QPair<QString, QJsonObject> item = batch.takeFirst();
+    *key = item.first;
+    *row = item.second;
+    return true;
+  }
+
+private:
+  QString FILTER, REPO;
+  bool FULL, done;
+  qlonglong lastid;
+  QList< QPair<QString, QJsonObject> > batch;
+
+  void readBatch(){
+    QString dbconn = openDB(REPO);
+    {
+    QSqlDatabase DB = QSqlDatabase::database(dbconn);
+    int num = 0;
+    if(DB.isOpen()){
+      QString q_string = "SELECT * FROM packages WHERE id > :lastid";
+      if(!FILTER.isEmpty()){ q_string.append(" AND "+FILTER); }
+      q_string.append(" ORDER BY id LIMIT "+QString::number(PKG_ROWS_BATCH));
+      QSqlQuery query(DB);
+      query.prepare(q_string);
+      query.bindValue(":lastid", lastid);
+      if(query.exec()){
+        while(query.next()){
+          num++;
+          lastid = query.value("id").toLongLong();
+          QString id = query.value("id").toString();
+          QString name = query.value("name").toString();
+          if(id.isEmpty() || name.isEmpty()){ continue; }
+          batch << qMakePair(name, pkg_info_row(query, id, name, DB, FULL));
+        }
+      }
+      DB.close();
+    }
+    if(num<PKG_ROWS_BATCH){ done = true; } //last batch (or the database could not be read)
+    }//force DB out of scope now
+    QSqlDatabase::removeDatabase(dbconn);
+  }
+};
+
+RowSource* PKG::pkg_info_rows(QJsonObject jsin){
+  //Same arguments as the pkg_info API call: "pkg_origins" OR "category", "repo", "result"
+  QString repo = "local";
+  if(jsin.contains("repo")){ repo = jsin.value("repo").toString(); }
+  QStringList pkgs;
+  if(jsin.value("pkg_origins").isString()){ pkgs << jsin.value("pkg_origins").toString(); }
+  else if(jsin.value("pkg_origins").isArray()){ pkgs = General::JsonArrayToStringList(jsin.value("pkg_origins").toArray()); }
+  bool fullresults = (jsin.value("result").toString()=="full");
+  return new PkgInfoRows(pkg_info_filter(pkgs, jsin.value("category").toString()), repo, fullresults);
+}
+
 QStringList PKG::pkg_search(QString repo, QString searchterm, QStringList searchexcludes, QString category){
   QString dbconn = openDB(repo);
   QStringList found;
@@ -9,6 +9,7 @@
 
 #include <QJsonObject>
 #include "sysadm-global.h"
+#include "sysadm-rowsource.h"
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlIndex>
@@ -21,6 +22,7 @@ class PKG{
 public:
 	//Information fetch routines
 	static QJsonObject pkg_info(QStringList origins, QString repo, QString category = "", bool fullresults = true);
+	static RowSource* pkg_info_rows(QJsonObject jsin); //incremental version of pkg_info() (API call arguments)
 	static QStringList pkg_search(QString repo, QString searchterm, QStringList searchexcludes, QString category = "");
 	static QJsonArray list_categories(QString repo);
 	static QJsonArray list_repos(bool updated = false);
@@ -0,0 +1,427 @@
+//===========================================
+//  PC-BSD source code
+//  Copyright (c) 2015, PC-BSD Software/iXsystems
+//  Available under the 3-clause BSD license
+//  See the LICENSE file for full details
+//===========================================
+#include "sysadm-process.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QFutureInterface>
+#include <QProcessEnvironment>
+#include <QDebug>
+
+#include <spawn.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace sysadm;
+
+#define KILL_GRACE_MSECS 2000 //time between SIGTERM and SIGKILL for a command which runs past its timeout
+#define EXIT_CHECK_MSECS 100 //how often to look for commands which exited while something else holds their pipe open
+#define READ_CHUNK 65536
+
+namespace{
+
+//A command which has been started and is not finished yet
+struct RunningCommand{
+  pid_t pid;
+  int fd; //read end of the output pipe (-1: closed)
+  bool exited;
+  int status; //waitpid() status (-1: unknown)
+  qint64 maxOutput;
+  qint64 deadline, killAt; //msecs on the runner clock (0: none)
+  QElapsedTimer timer;
+  CommandResult result;
+  QFutureInterface<CommandResult> future;
+  std::function<void(const CommandResult&)> callback;
+};
+
+// == Runner thread ==
+// Watches the output pipes of all the running commands, collects the output and reaps them when done.
+class ProcessReactor : public QThread{
+public:
+  static ProcessReactor* instance(){
+    static ProcessReactor reactor; //started on first use, stopped when the program exits
+    return &reactor;
+  }
+
+  ProcessReactor();
+  ~ProcessReactor();
+  void add(RunningCommand *cmd); //takes ownership
+  qint64 now(){ return clock.elapsed(); }
+
+protected:
+  void run();
+
+private:
+  QMutex mutex;
+  QList<RunningCommand*> incoming; //handed over from other threads
+  bool stopping;
+  int wakeFds[2]; //self-pipe: wakes up the poll() when a new command comes in
+  QElapsedTimer clock;
+  QByteArray chunk; //read buffer
+
+  void wake();
+  void readOutput(RunningCommand *cmd);
+  void finish(RunningCommand *cmd);
+};
+
+ProcessReactor::ProcessReactor() : QThread(){
+  stopping = false;
+  if(pipe2(wakeFds, O_CLOEXEC | O_NONBLOCK)!=0){ wakeFds[0] = wakeFds[1] = -1; }
+  chunk.resize(READ_CHUNK);
+  clock.start();
+  setObjectName("sysadm-process");
+  start();
+}
+
+ProcessReactor::~ProcessReactor(){
+  mutex.lock();
+  stopping = true;
+  mutex.unlock();
+  wake();
+  wait();
+  if(wakeFds[0]>=0){ close(wakeFds[0]); close(wakeFds[1]); }
+}
+
+void ProcessReactor::add(RunningCommand *cmd){
+  mutex.lock();
+  incoming << cmd;
+  mutex.unlock();
+  wake();
+}
+
+void ProcessReactor::wake(){
+  char c = 1;
+  if(wakeFds[1]>=0){ ssize_t junk = write(wakeFds[1], &c, 1); Q_UNUSED(junk); } //pipe full: a wakeup is pending anyway
+}
+
+void ProcessReactor::readOutput(RunningCommand *cmd){
+  //Read everything which is available right now
+  while(cmd->fd>=0){
+    ssize_t num = read(cmd->fd, chunk.data(), chunk.size());
+    if(num>0){
+      qint64 room = (cmd->maxOutput>0) ? cmd->maxOutput - cmd->result.output.size() : num;
+      if(room < num){ cmd->result.truncated = true; } //keep reading (and discarding) so the command never blocks
+      if(room>0){ cmd->result.output.append(chunk.constData(), qMin<qint64>(room, num)); }
+    }else if(num<0 && errno==EINTR){
+      continue;
+    }else if(num<0 && (errno==EAGAIN || errno==EWOULDBLOCK)){
+      return; //nothing more for now
+    }else{
+      //End of the output (or a broken pipe)
+      close(cmd->fd);
+      cmd->fd = -1;
+    }
+  }
+}
+
+void ProcessReactor::finish(RunningCommand *cmd){
+  cmd->result.msecs = cmd->timer.elapsed();
+  if(cmd->status!=-1 && WIFEXITED(cmd->status)){ cmd->result.exitCode = WEXITSTATUS(cmd->status); }
+  if(cmd->callback){ cmd->callback(cmd->result); }
+  cmd->future.reportResult(cmd->result);
+  cmd->future.reportFinished();
+  delete cmd;
+}
+
+void ProcessReactor::run(){
+  QList<RunningCommand*> active;
+  QVector<struct pollfd> fds;
+  QVector<RunningCommand*> owners;
+  while(true){
+    mutex.lock();
+    active.append(incoming);
+    incoming.clear();
+    bool stop = stopping;
+    mutex.unlock();
+    if(stop){ break; }
+    //Watch the wakeup pipe and every open output pipe
+    fds.resize(1);
+    owners.resize(1);
+    fds[0].fd = wakeFds[0];
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    int timeout = -1; //nothing running: sleep until a command comes in
+    qint64 now = clock.elapsed();
+    for(int i=0; i<active.length(); i++){
+      RunningCommand *cmd = active[i];
+      qint64 wait = EXIT_CHECK_MSECS;
+      if(cmd->fd>=0){
+        struct pollfd P;
+          P.fd = cmd->fd;
+          P.events = POLLIN;
+          P.revents = 0;
+        fds << P;
+        owners << cmd;
+      }else{
+        wait = 1; //output closed - the exit is only a moment away
+      }
+      //Wake up in time for the timeout handling
+      if(cmd->killAt>0){ wait = qMin(wait, qMax(qint64(0), cmd->killAt - now)); }
+      else if(cmd->deadline>0 && !cmd->result.timedOut){ wait = qMin(wait, qMax(qint64(0), cmd->deadline - now)); }
+      if(timeout<0 || wait<timeout){ timeout = int(wait); }
+    }
+    if(poll(fds.data(), fds.size(), timeout)<0 && errno!=EINTR){ QThread::msleep(1); } //should never happen - don't spin
+    if(fds[0].revents!=0){
+      char buf[64];
+      while(read(wakeFds[0], buf, sizeof(buf))>0){}
+    }
+    for(int i=1; i<fds.size(); i++){
+      if(fds[i].revents!=0){ readOutput(owners[i]); }
+    }
+    //Reap finished commands and handle the timeouts
+    now = clock.elapsed();
+    for(int i=0; i<active.length(); i++){
+      RunningCommand *cmd = active[i];
+      if(!cmd->exited){
+        int status = 0;
+        pid_t ret = waitpid(cmd->pid, &status, WNOHANG);
+        if(ret==cmd->pid){ cmd->exited = true; cmd->status = status; }
+        else if(ret<0 && errno!=EINTR){ cmd->exited = true; cmd->status = -1; } //reaped somewhere else
+      }
+      if(cmd->exited && cmd->fd>=0){
+        //Something else (a daemon started by the command?) might still hold the pipe open - take what is there and stop
+        readOutput(cmd);
+        if(cmd->fd>=0){ close(cmd->fd); cmd->fd = -1; }
+      }
+      if(!cmd->exited){
+        if(cmd->killAt>0 && now>=cmd->killAt){
+          kill(cmd->pid, SIGKILL);
+          cmd->killAt = 0;
+        }else if(cmd->deadline>0 && !cmd->result.timedOut && now>=cmd->deadline){
+          cmd->result.timedOut = true;
+          kill(cmd->pid, SIGTERM);
+          cmd->killAt = now + KILL_GRACE_MSECS;
+        }
+      }else{
+        finish(cmd);
+        active.removeAt(i);
+        i--;
+      }
+    }
+  }
+  //Shutting down: nobody is waiting for these anymore
+  for(int i=0; i<active.length(); i++){
+    if(active[i]->fd>=0){ close(active[i]->fd); }
+    active[i]->future.reportFinished();
+    delete active[i];
+  }
+}
+
+RunningCommand* newCommand(){
+  RunningCommand *cmd = new RunningCommand();
+    cmd->pid = 0;
+    cmd->fd = -1;
+    cmd->exited = false;
+    cmd->status = -1;
+    cmd->maxOutput = 0;
+    cmd->deadline = cmd->killAt = 0;
+    cmd->timer.start();
+  return cmd;
+}
+
+//Start the program with its output going into a new pipe (returns an error message on failure)
+//The read end of the pipe is left in blocking mode
+QString spawnPiped(QString program, QStringList args, QStringList env, pid_t *pidOut, int *fdOut){
+  if(program.isEmpty()){ return "No command given"; }
+  //Environment: the current one plus any changes
+  QProcessEnvironment PE = QProcessEnvironment::systemEnvironment();
+  for(int i=0; i<env.length(); i++){
+    if(!env[i].contains("=")){ continue; }
+    PE.insert(env[i].section("=",0,0), env[i].section("=",1,100));
+  }
+  QList<QByteArray> argStore, envStore;
+  argStore << program.toLocal8Bit();
+  for(int i=0; i<args.length(); i++){ argStore << args[i].toLocal8Bit(); }
+  QStringList envlist = PE.toStringList();
+  for(int i=0; i<envlist.length(); i++){ envStore << envlist[i].toLocal8Bit(); }
+  QVector<char*> argv, envp;
+  for(int i=0; i<argStore.length(); i++){ argv << argStore[i].data(); }
+  argv << 0;
+  for(int i=0; i<envStore.length(); i++){ envp << envStore[i].data(); }
+  envp << 0;
+  //Output pipe (stdout + stderr), stdin from /dev/null
+  int pipefds[2];
+  if(pipe2(pipefds, O_CLOEXEC)!=0){ return QString("Could not create the output pipe: ")+strerror(errno); }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_adddup2(&actions, pipefds[1], 1);
+  posix_spawn_file_actions_adddup2(&actions, pipefds[1], 2);
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t mask;
+  sigemptyset(&mask); //nothing blocked in the command
+  posix_spawnattr_setsigmask(&attr, &mask);
+  sigset_t defaults;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE); //the server might ignore SIGPIPE - commands should not inherit that
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+  pid_t pid = 0;
+  int err = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  close(pipefds[1]);
+  if(err!=0){
+    close(pipefds[0]);
+    return "Could not start "+program+": "+strerror(err);
+  }
+  *pidOut = pid;
+  *fdOut = pipefds[0];
+  return QString();
+}
+
+//Start the command for the runner thread (non-blocking output pipe)
+QString spawnCommand(RunningCommand *cmd, QString program, QStringList args, QStringList env){
+  QString error = spawnPiped(program, args, env, &cmd->pid, &cmd->fd);
+  if(!error.isEmpty()){ return error; }
+  fcntl(cmd->fd, F_SETFL, O_NONBLOCK);
+  cmd->result.started = true;
+  return QString();
+}
+
+} //end of anonymous namespace
+
+QFuture<CommandResult> ProcessRunner::start(QString command, QStringList arguments, CommandOptions opts, std::function<void(const CommandResult&)> callback){
+  ProcessReactor *reactor = ProcessReactor::instance();
+  RunningCommand *cmd = newCommand();
+    cmd->maxOutput = opts.maxOutput;
+    cmd->callback = callback;
+  cmd->future.reportStarted();
+  QFuture<CommandResult> future = cmd->future.future();
+  //Program + arguments
+  QString program = command;
+  QStringList args = arguments;
+  if(args.isEmpty()){
+    args = splitCommand(command);
+    program = args.isEmpty() ? QString() : args.takeFirst();
+  }
+  if(!opts.workdir.isEmpty()){
+    //No portable "change directory" spawn action - let a tiny shell do that, then replace itself with the command
+    args.prepend(program);
+    args.prepend(opts.workdir);
+    args.prepend("cd \"$0\" && exec \"$@\"");
+    args.prepend("-c");
+    program = "/bin/sh";
+  }
+  QString error = spawnCommand(cmd, program, args, opts.env);
+  if(!error.isEmpty()){
+    //Never started - finish right away
+    cmd->result.output = error.toLocal8Bit();
+    if(callback){ callback(cmd->result); }
+    cmd->future.reportResult(cmd->result);
+    cmd->future.reportFinished();
+    delete cmd;
+    return future;
+  }
+  if(opts.timeoutMSecs>0){ cmd->deadline = reactor->now() + opts.timeoutMSecs; }
+  reactor->add(cmd);
+  return future;
+}
+
+CommandResult ProcessRunner::run(QString command, QStringList arguments, CommandOptions opts){
+  QFuture<CommandResult> future = start(command, arguments, opts);
+  future.waitForFinished(); //plain wait on the result - no event processing
+  return future.result();
+}
+
+QStringList ProcessRunner::splitCommand(QString command){
+  QStringList args;
+  QString arg;
+  int quotes = 0;
+  bool inQuote = false;
+  for(int i=0; i<command.length(); i++){
+    if(command[i]=='"'){
+      quotes++;
+      if(quotes==3){ quotes = 0; arg.append('"'); } //three quotes in a row: literal quote character
+      continue;
+    }
+    if(quotes>0){
+      if(quotes==1){ inQuote = !inQuote; }
+      quotes = 0;
+    }
+    if(!inQuote && command[i].isSpace()){
+      if(!arg.isEmpty()){ args << arg; arg.clear(); }
+    }else{
+      arg.append(command[i]);
+    }
+  }
+  if(!arg.isEmpty()){ args << arg; }
+  return args;
+}
+
+// === CommandReader ===
+CommandReader::CommandReader(QString command, QStringList arguments, QStringList env){
+  pid = 0;
+  fd = -1;
+  bufpos = 0;
+  QString program = command;
+  if(arguments.isEmpty()){
+    arguments = ProcessRunner::splitCommand(command);
+    program = arguments.isEmpty() ? QString() : arguments.takeFirst();
+  }
+  QString error = spawnPiped(program, arguments, env, &pid, &fd);
+  if(!error.isEmpty()){
+    qWarning() << "CommandReader:" << error;
+    pid = 0;
+    fd = -1;
+  }
+}
+
+CommandReader::~CommandReader(){
+  if(pid<=0){ return; }
+  if(fd>=0){
+    //Output not read to the end - stop the command (SIGKILL after the grace period)
+    close(fd);
+    kill(pid, SIGTERM);
+  }
+  //Let the runner thread reap the command (never block the caller on the exit)
+  ProcessReactor *reactor = ProcessReactor::instance();
+  RunningCommand *cmd = newCommand();
+    cmd->pid = pid;
+    cmd->result.started = true;
+    if(fd>=0){ cmd->killAt = reactor->now() + KILL_GRACE_MSECS; }
+  cmd->future.reportStarted();
+  reactor->add(cmd);
+}
+
+bool CommandReader::readLine(QString *line){
+  while(true){
+    int nl = buffer.indexOf('\n', bufpos);
+    if(nl>=0){
+      *line = QString::fromUtf8(buffer.constData()+bufpos, nl-bufpos);
+      bufpos = nl+1;
+      return true;
+    }
+    if(fd<0){
+      //End of the output - last line might not have a newline
+      if(bufpos>=buffer.size()){ return false; }
+      *line = QString::fromUtf8(buffer.constData()+bufpos, buffer.size()-bufpos);
+      bufpos = buffer.size();
+      return true;
+    }
+    //Need more output: drop the lines which were handed out already and read the next chunk
+    buffer.remove(0, bufpos);
+    bufpos = 0;
+    int have = buffer.size();
+    buffer.resize(have + READ_CHUNK);
+    ssize_t num = read(fd, buffer.data()+have, READ_CHUNK);
+    buffer.resize( have + qMax<ssize_t>(0, num) );
+    if(num<0 && errno==EINTR){ continue; }
+    if(num<=0){
+      close(fd);
+      fd = -1;
+    }
+  }
+}
@@ -0,0 +1,76 @@
+//===========================================
+//  PC-BSD source code
+//  Copyright (c) 2015, PC-BSD Software/iXsystems
+//  Available under the 3-clause BSD license
+//  See the LICENSE file for full details
+//===========================================
+#ifndef __PCBSD_LIB_UTILS_PROCESS_H
+#define __PCBSD_LIB_UTILS_PROCESS_H
+
+//Plain Qt/POSIX only (no FreeBSD headers) so the tests/process-bench tool can build it anywhere
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFuture>
+#include <functional>
+#include <sys/types.h>
+
+namespace sysadm{
+
+//Outcome of an external command
+struct CommandResult{
+	bool started; //false: the command could not be run at all
+	bool timedOut; //killed after running past the timeout
+	bool truncated; //output went past the size cap (the rest was discarded)
+	int exitCode; //-1 if the command did not exit normally
+	QByteArray output; //stdout and stderr (merged)
+	qint64 msecs; //run time
+	CommandResult(){ started = timedOut = truncated = false; exitCode = -1; msecs = 0; }
+	bool success() const{ return (started && !timedOut && exitCode==0); }
+};
+
+struct CommandOptions{
+	QString workdir;
+	QStringList env; //changes to the current environment: [<variable>=<value>]
+	int timeoutMSecs; //terminate the command after this long (0: no limit)
+	qint64 maxOutput; //max number of output bytes to keep (0: no limit)
+	CommandOptions(){ timeoutMSecs = 0; maxOutput = 0; }
+};
+
+// == External command runner ==
+// Commands get started with posix_spawn() and all their output pipes are watched by a single
+//  background thread (poll-driven), so nothing has to sit in a QProcess wait loop or pump events.
+class ProcessRunner{
+public:
+	//Start a command in the background (arguments empty: the command string gets split like QProcess does)
+	//The callback (optional) runs in the runner thread once the command is done - keep it short and thread-safe
+	static QFuture<CommandResult> start(QString command, QStringList arguments = QStringList(), CommandOptions opts = CommandOptions(), std::function<void(const CommandResult&)> callback = nullptr);
+	//Run a command and wait for it to finish (only blocks the calling thread - no event processing)
+	static CommandResult run(QString command, QStringList arguments = QStringList(), CommandOptions opts = CommandOptions());
+	//Split a command string into the program and arguments (QProcess rules: "" groups words, """ is a literal quote)
+	static QStringList splitCommand(QString command);
+};
+
+// == Streaming command output ==
+// Runs a command and reads its output one line at a time, straight off the pipe as the lines are
+//  asked for (the command waits while nobody reads), so long listings never sit in memory as a whole.
+// Not thread-safe: only one thread at a time may use a reader (it may move between threads though).
+class CommandReader{
+public:
+	CommandReader(QString command, QStringList arguments = QStringList(), QStringList env = QStringList());
+	~CommandReader(); //stops the command if the output was not read to the end
+
+	bool started() const{ return (pid>0); }
+	//Read the next line of output (without the newline) - returns false at the end of the output
+	bool readLine(QString *line);
+
+private:
+	pid_t pid;
+	int fd; //read end of the output pipe (-1: end of the output)
+	QByteArray buffer;
+	int bufpos; //start of the unread data in the buffer
+};
+
+} //end of sysadm namespace
+
+#endif
@@ -0,0 +1,63 @@
+//===========================================
+//  PC-BSD source code
+//  Copyright (c) 2015, PC-BSD Software/iXsystems
+//  Available under the 3-clause BSD license
+//  See the LICENSE file for full details
+//===========================================
+#ifndef __PCBSD_LIB_UTILS_ROWSOURCE_H
+#define __PCBSD_LIB_UTILS_ROWSOURCE_H
+
+#include "sysadm-global.h"
+#include "sysadm-process.h"
+
+namespace sysadm{
+
+// == Incremental result listing ==
+// Large listings hand out their results one row ("key" : value) at a time, so the
+//  server can send them in pages instead of building the whole object in memory first.
+class RowSource{
+public:
+	virtual ~RowSource(){}
+	//Load the next row - returns false when there are no more rows
+	virtual bool next(QString *key, QJsonValue *row) = 0;
+
+	//Read all the (remaining) rows into a single object (also deletes the source)
+	static QJsonObject drain(RowSource *src){
+	  QJsonObject out;
+	  if(src==0){ return out; }
+	  QString key; QJsonValue row;
+	  while(src->next(&key, &row)){ out.insert(key, row); }
+	  delete src;
+	  return out;
+	}
+};
+
+// == Row source for line-based command output ==
+// Reads the command output one line at a time as rows are asked for and only converts that line (see parseLine())
+class LineRowSource : public RowSource{
+public:
+	LineRowSource(QString command, QStringList arguments = QStringList()) : OUTPUT(command, arguments){
+	  done = false;
+	}
+	virtual ~LineRowSource(){}
+
+	bool next(QString *key, QJsonValue *row){
+	  QString line;
+	  while(!done && OUTPUT.readLine(&line)){
+	    if(parseLine(line, key, row)){ return true; }
+	  }
+	  return false;
+	}
+
+protected:
+	bool done; //set this within parseLine() to stop reading the output
+	//Convert a single line of output into a row (return false to skip the line)
+	virtual bool parseLine(const QString &line, QString *key, QJsonValue *row) = 0;
+
+private:
+	CommandReader OUTPUT;
+};
+
+} //end of namespace
+
+#endif
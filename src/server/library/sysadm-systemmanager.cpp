@@ -6,6 +6,8 @@
 //===========================================
 #include "sysadm-general.h"
 #include "sysadm-systemmanager.h"
+#include "sysadm-systemprobe.h"
+#include "sysadm-cpusampler.h"
 #include "sysadm-global.h"
 //need access to the global DISPATCHER object
 #include "globals.h"
@@ -62,51 +64,39 @@ QJsonObject SysMgmt::batteryInfo(){
   return retObject;
 }
 
-// KPM 1-21-2016
-// This needs to be looked at, I'm not 100% sure it is returning correct busy %
-// We probably want to supply more info as well, such as user,nice,system,interrupt,idle
-QJsonObject SysMgmt::cpuPercentage() {
+// Busy % per CPU from the background sampler (never waits for a new sample)
+// Optional input: "window" = number of seconds to average over (default: the latest sample interval)
+QJsonObject SysMgmt::cpuPercentage(QJsonObject jsin) {
   QJsonObject retObject;
   QString tmp;
-
-  //Calculate the percentage based on the kernel information directly - no extra utilities
-  QStringList result = General::RunCommand("sysctl -n kern.cp_times").split(" ");
-  static QStringList last = QStringList();
-  if(last.isEmpty()){
-    //need two ticks before it works properly
-    sleep(1);
-    last = result;
-    result = General::RunCommand("sysctl -n kern.cp_times").split(" ");
+  CpuSampler *sampler = CpuSampler::instance();
+
+  int window = 0;
+  if(jsin.contains("window")){
+    QJsonValue val = jsin.value("window");
+    window = (val.isString() ? val.toString().toDouble() : val.toDouble()) * 1000;
+    if(window<0 || window>sampler->maxWindow()){
+      retObject.insert("error", "Invalid 'window' (0-"+QString::number(sampler->maxWindow()/1000)+" seconds)");
+      return retObject;
+    }
+  }
+  QVector<double> cpus;
+  double total = 0;
+  if(!sampler->busy(window, &cpus, &total)){ return retObject; }
+  for(int i=0; i<cpus.size(); i++){
+    QJsonObject vals;
+    vals.insert("busy", tmp.setNum(qRound(cpus[i])) );
+    retObject.insert("cpu" + tmp.setNum(i+1), vals);
   }
-  double tot = 0;
-  double roundtot;
-  int cpnum = 0;
-  for(int i=4; i<result.length(); i+=5){
-     //The values come in blocks of 5 per CPU: [user,nice,system,interrupt,idle]
-     cpnum++; //the number of CPU's accounted for (to average out at the end)
-     //qDebug() <<"CPU:" << cpnum;
-     long sum = 0;
-     //Adjust/all the data to correspond to diffs from the previous check
-     for(int j=0; j<5; j++){
-       QString tmp = result[i-j];
-       result[i-j] = QString::number(result[i-j].toLong()-last[i-j].toLong());
-       //need the difference between last run and this one
-       sum += result[i-j].toLong();
-       last[i-j] = tmp; //make sure to keep the original value around for the next run
-     }
-     QJsonObject vals;
-     roundtot = 100.0L - ( (100.0L*result[i].toLong())/sum );
-     tmp.setNum(qRound(roundtot));
-     vals.insert("busy", tmp );
-     tmp.setNum(cpnum);
-     retObject.insert("cpu" + tmp, vals);
-     //Calculate the percentage used for this CPU (100% - IDLE%)
-     tot += 100.0L - ( (100.0L*result[i].toLong())/sum ); //remember IDLE is the last of the five values per CPU
-   }
-
   // Add the total busy %
-  tmp.setNum(qRound(tot/cpnum));
-  retObject.insert("busytotal", tmp);
+  retObject.insert("busytotal", tmp.setNum(qRound(total)));
+  // Add the total busy % over the standard windows (1/10/60 seconds)
+  QJsonObject averages;
+  QList<int> windows; windows << 1 << 10 << 60;
+  for(int i=0; i<windows.length(); i++){
+    if(sampler->busy(windows[i]*1000, 0, &total)){ averages.insert(QString::number(windows[i]), tmp.setNum(qRound(total))); }
+  }
+  retObject.insert("averages", averages);
   return retObject;
 }
 
@@ -215,72 +205,44 @@ QJsonObject SysMgmt::killProc(QJsonObject jsin) {
 // Return information about memory
 QJsonObject SysMgmt::memoryStats() {
   QJsonObject retObject;
-
-  QString tmp;
-  long pageSize;
-  bool ok;
-
-  // Get the page size
-  tmp = General::RunCommand("sysctl -n vm.stats.vm.v_page_size").simplified();
-  tmp.toLong(&ok);
-  if ( ok )
-    pageSize = tmp.toLong();
-  else
+  MemoryInfo mem;
+  if( !SystemProbe::instance()->memory(&mem) )
     return retObject;
 
-  // Get the free size
-  tmp = General::RunCommand("sysctl -n vm.stats.vm.v_free_count").simplified();
-  tmp.toLong(&ok);
-  if ( ok )
-    retObject.insert("free", tmp.setNum((tmp.toLong() * pageSize) / 1024 / 1024));
-
-  // Get the inactive size
-  tmp = General::RunCommand("sysctl -n vm.stats.vm.v_inactive_count").simplified();
-  tmp.toLong(&ok);
-  if ( ok )
-    retObject.insert("inactive", tmp.setNum((tmp.toLong() * pageSize) / 1024 / 1024));
-
-  // Get the cache size
-  tmp = General::RunCommand("sysctl -n vm.stats.vm.v_cache_count").simplified();
-  tmp.toLong(&ok);
-  if ( ok )
-    retObject.insert("cache", tmp.setNum((tmp.toLong() * pageSize) / 1024 / 1024));
-
-  // Get the wired size
-  tmp = General::RunCommand("sysctl -n vm.stats.vm.v_wire_count").simplified();
-  tmp.toLong(&ok);
-  if ( ok )
-    retObject.insert("wired", tmp.setNum((tmp.toLong() * pageSize) / 1024 / 1024));
-
-  // Get the active size
-  tmp = General::RunCommand("sysctl -n vm.stats.vm.v_active_count").simplified();
-  tmp.toLong(&ok);
-  if ( ok )
-    retObject.insert("active", tmp.setNum((tmp.toLong() * pageSize) / 1024 / 1024));
+  QString tmp;
+  // Sizes in MB (skip anything this system does not report)
+  if ( mem.free >= 0 )
+    retObject.insert("free", tmp.setNum(mem.free / 1024 / 1024));
+  if ( mem.inactive >= 0 )
+    retObject.insert("inactive", tmp.setNum(mem.inactive / 1024 / 1024));
+  if ( mem.cache >= 0 )
+    retObject.insert("cache", tmp.setNum(mem.cache / 1024 / 1024));
+  if ( mem.wired >= 0 )
+    retObject.insert("wired", tmp.setNum(mem.wired / 1024 / 1024));
+  if ( mem.active >= 0 )
+    retObject.insert("active", tmp.setNum(mem.active / 1024 / 1024));
 
   return retObject;
 }
 
 // Return a json list of process information
-QJsonObject SysMgmt::procInfo() {
-  QJsonObject retObject;
-  QStringList output;
-  output = General::RunCommand("top -t -n -a all").split("\n");
-  bool inSection = false;
-  for(int i=0; i<output.length(); i++){
-    if (output.at(i).contains("PID") && output.at(i).contains("USERNAME")){
+// Rows from the "top" process listing (PID : info)
+class ProcInfoRows : public LineRowSource{
+public:
+  ProcInfoRows() : LineRowSource("top -t -n -a all"){ inSection = false; }
+protected:
+  bool parseLine(const QString &rawline, QString *key, QJsonValue *row){
+    if (rawline.contains("PID") && rawline.contains("USERNAME")){
       inSection = true;
-      continue;
+      return false;
     }
-    if (!inSection)
-      continue;
-    if ( output.at(i).isEmpty())
-      continue;
+    if (!inSection || rawline.isEmpty())
+      return false;
 
     // Now, lets break down the various elements of process information
     QJsonObject values;
-    QString line = output.at(i).simplified();
-    QString pid = line.section(" ", 0, 0);
+    QString line = rawline.simplified();
+    *key = line.section(" ", 0, 0);
     values.insert("username", line.section(" ", 1, 1));
     values.insert("thr", line.section(" ", 2, 2));
     values.insert("pri", line.section(" ", 3, 3));
@@ -292,11 +254,19 @@ QJsonObject SysMgmt::procInfo() {
     values.insert("time", line.section(" ", 9, 9));
     values.insert("wcpu", line.section(" ", 10, 10));
     values.insert("command", line.section(" ", 11, -1));
-
-    // Add the PID object
-    retObject.insert(pid, values);
+    *row = values;
+    return true;
   }
-  return retObject;
+private:
+  bool inSection;
+};
+
+QJsonObject SysMgmt::procInfo() {
+  return RowSource::drain( procInfoRows() );
+}
+
+RowSource* SysMgmt::procInfoRows() {
+  return new ProcInfoRows();
 }
 
 // Get a sysctl
@@ -341,70 +311,69 @@ QJsonObject SysMgmt::setSysctl(QJsonObject jsin) {
 }
 
 // Return list of sysctls and their values
-QJsonObject SysMgmt::sysctlList() {
-  QJsonObject retObject;
-
+// Rows from the sysctl listing (sysctl : {value, type, description})
+// The details come from a second listing which is read alongside the values: both list the
+//  sysctls in the same order, so the lookup normally only has to read the very next details line.
+class SysctlListRows : public LineRowSource{
+public:
   // This can be cleaned up and not use CLI
-  QStringList output = General::RunCommand("sysctl -aW").split("\n");
-  QStringList details = General::RunCommand("sysctl -aWdt").split("\n");
-
-  QString sysctl, type, description;
-  for(int i=0; i<output.length(); i++){
-    if ( output.at(i).isEmpty()){ continue; }
+  SysctlListRows() : LineRowSource("sysctl -aW"), DETAILS("sysctl -aWdt"){}
+protected:
+  bool parseLine(const QString &line, QString *key, QJsonValue *row){
+    if ( line.isEmpty()){ return false; }
     QJsonObject tmp;
-    sysctl = output.at(i).section(":", 0, 0);
-    tmp.insert("value", output.at(i).section(":", 1, -1).simplified() );
-    retObject.insert(sysctl, tmp);
-  }
-  for(int i=0; i<details.length(); i++){
-    if ( details.at(i).isEmpty() ){ continue; }
-    sysctl = details[i].section(":",0,0);
-    type = details[i].section(":",1,1).simplified();
-    description = details[i].section(":",2,-1).simplified();
-    if(retObject.contains(sysctl)){
-      QJsonObject tmp = retObject.value(sysctl).toObject();
-      tmp.insert("type", type);
+    *key = line.section(":", 0, 0);
+    tmp.insert("value", line.section(":", 1, -1).simplified() );
+    QString details = findDetails(*key);
+    if(!details.isEmpty()){
+      tmp.insert("type", details.section(":",0,0).simplified());
+      QString description = details.section(":",1,-1).simplified();
       if(!description.isEmpty()){ tmp.insert("description", description); }
-      retObject.insert(sysctl, tmp); //replace the sysctl object into the output object
     }
+    *row = tmp;
+    return true;
   }
-  return retObject;
+private:
+  CommandReader DETAILS;
+  QHash<QString, QString> skipped; //details lines which were read past already (sysctl -> "type: description")
+
+  //Details for a sysctl (without the "<sysctl>:" part - empty if there are none)
+  QString findDetails(const QString &key){
+    if(!skipped.isEmpty() && skipped.contains(key)){ return skipped.take(key); }
+    QString dline;
+    while(DETAILS.readLine(&dline)){
+      QString dkey = dline.section(":",0,0);
+      if(dkey==key){ return dline.section(":",1,-1); }
+      if(!dkey.isEmpty()){ skipped.insert(dkey, dline.section(":",1,-1)); } //listed out of order - keep it for later
+    }
+    return QString();
+  }
+};
+
+QJsonObject SysMgmt::sysctlList() {
+  return RowSource::drain( sysctlListRows() );
+}
+
+RowSource* SysMgmt::sysctlListRows() {
+  return new SysctlListRows();
 }
 
 // Return a bunch of various system information
 QJsonObject SysMgmt::systemInfo() {
   QJsonObject retObject;
-
-  QString arch = General::RunCommand("uname -m").simplified();
-  retObject.insert("arch", arch);
-
-  QString sysver = General::RunCommand("freebsd-version").simplified();
-  retObject.insert("systemversion", sysver);
-
-  QString kernver = General::RunCommand("uname -r").simplified();
-  retObject.insert("kernelversion", kernver);
-
-  QString kernident = General::RunCommand("uname -i").simplified();
-  retObject.insert("kernelident", kernident);
-
-  QString host = General::RunCommand("hostname").simplified();
-  retObject.insert("hostname", host);
-
-  QString uptime = General::RunCommand("uptime").simplified().section(" ", 1, 4).simplified().replace(",", "");
-  retObject.insert("uptime", uptime);
-
-  QString cputype = General::RunCommand("sysctl -n hw.model").simplified();
-  retObject.insert("cputype", cputype);
-
-  QString cpucores = General::RunCommand("sysctl -n kern.smp.cpus").simplified();
-  retObject.insert("cpucores", cpucores);
-
-  bool ok;
-  QString tmp;
-  QString totalmem = General::RunCommand("sysctl -n hw.realmem").simplified();
-  totalmem.toLong(&ok);
-  if ( ok ) {
-    retObject.insert("totalmem", tmp.setNum(totalmem.toLong() / 1024 / 1024));
+  SystemInfo info;
+  SystemProbe::instance()->system(&info);
+
+  retObject.insert("arch", info.arch);
+  retObject.insert("systemversion", info.systemVersion);
+  retObject.insert("kernelversion", info.kernelVersion);
+  retObject.insert("kernelident", info.kernelIdent);
+  retObject.insert("hostname", info.hostname);
+  retObject.insert("uptime", SystemProbe::uptimeString(info.uptimeSecs));
+  retObject.insert("cputype", info.cpuModel);
+  retObject.insert("cpucores", QString::number(info.cpuCores));
+  if ( info.totalMem >= 0 ) {
+    retObject.insert("totalmem", QString::number(info.totalMem / 1024 / 1024));
   }
 
   return retObject;
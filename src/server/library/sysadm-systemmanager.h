@@ -9,6 +9,7 @@
 
 #include <QJsonObject>
 #include "sysadm-global.h"
+#include "sysadm-rowsource.h"
 
 
 namespace sysadm{
@@ -16,17 +17,19 @@ namespace sysadm{
 class SysMgmt{
 public:
 	static QJsonObject batteryInfo();
-	static QJsonObject cpuPercentage();
+	static QJsonObject cpuPercentage(QJsonObject jsin = QJsonObject());
 	static QJsonObject cpuTemps();
 	static QJsonObject externalDevicePaths();
 	static QJsonObject killProc(QJsonObject);
 	static QJsonObject memoryStats();
 	static QJsonObject procInfo();
+	static RowSource* procInfoRows(); //incremental version of procInfo()
 
 	//sysctl management
 	static QJsonObject getSysctl(QJsonObject);
 	static QJsonObject setSysctl(QJsonObject);
 	static QJsonObject sysctlList();
+	static RowSource* sysctlListRows(); //incremental version of sysctlList()
 	
 	static QJsonObject systemInfo();
 	static QJsonObject systemReboot();
@@ -0,0 +1,288 @@
+//===========================================
+//  PC-BSD source code
+//  Copyright (c) 2015, PC-BSD Software/iXsystems
+//  Available under the 3-clause BSD license
+//  See the LICENSE file for full details
+//===========================================
+#include "sysadm-systemprobe.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QByteArray>
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#if defined(__FreeBSD__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <ifaddrs.h>
+#endif
+
+using namespace sysadm;
+
+namespace{
+
+//Read a small text file in one go (returns an empty array if it could not be read)
+QByteArray readSmallFile(QString path){
+  QFile file(path);
+  if(!file.open(QIODevice::ReadOnly)){ return QByteArray(); }
+  return file.readAll(); //works for /proc files as well (those report a size of 0)
+}
+
+#if defined(__FreeBSD__)
+// == FreeBSD backend ==
+// Everything comes straight from sysctlbyname()
+
+//Number-based sysctl (handles both the 32-bit and 64-bit values)
+bool sysctlNum(const char *var, qint64 *val){
+  union{ quint32 u32; quint64 u64; } buf;
+  buf.u64 = 0;
+  size_t len = sizeof(buf);
+  if(0!=sysctlbyname(var, &buf, &len, NULL, 0)){ return false; }
+  if(len==sizeof(quint32)){ *val = buf.u32; }
+  else if(len==sizeof(quint64)){ *val = (qint64) buf.u64; }
+  else{ return false; }
+  return true;
+}
+
+//Text-based sysctl
+QString sysctlText(const char *var){
+  size_t len = 0;
+  if(0!=sysctlbyname(var, NULL, &len, NULL, 0) || len==0){ return ""; }
+  QByteArray buf(len, '\0');
+  if(0!=sysctlbyname(var, buf.data(), &len, NULL, 0)){ return ""; }
+  buf.truncate(len);
+  while(buf.endsWith('\0')){ buf.chop(1); }
+  return QString::fromLocal8Bit(buf).simplified();
+}
+
+class SysctlProbe : public SystemProbe{
+public:
+  QString name() const{ return "sysctl"; }
+
+  bool memory(MemoryInfo *info){
+    qint64 pagesize = 0;
+    if(!sysctlNum("vm.stats.vm.v_page_size", &pagesize) || pagesize<=0){ return false; }
+    info->pageSize = pagesize;
+    qint64 num = 0;
+    if(sysctlNum("vm.stats.vm.v_free_count", &num)){ info->free = num*pagesize; }
+    if(sysctlNum("vm.stats.vm.v_inactive_count", &num)){ info->inactive = num*pagesize; }
+    if(sysctlNum("vm.stats.vm.v_cache_count", &num)){ info->cache = num*pagesize; } //removed in FreeBSD 12
+    if(sysctlNum("vm.stats.vm.v_wire_count", &num)){ info->wired = num*pagesize; }
+    if(sysctlNum("vm.stats.vm.v_active_count", &num)){ info->active = num*pagesize; }
+    return true;
+  }
+
+  bool system(SystemInfo *info){
+    info->arch = sysctlText("hw.machine"); //uname -m
+    info->kernelVersion = sysctlText("kern.osrelease"); //uname -r
+    info->kernelIdent = sysctlText("kern.ident"); //uname -i
+    info->hostname = sysctlText("kern.hostname");
+    info->cpuModel = sysctlText("hw.model");
+    //Userland version: freebsd-version(1) is a script with the version baked in
+    QByteArray script = readSmallFile("/bin/freebsd-version");
+    int index = script.indexOf("USERLAND_VERSION=\"");
+    if(index>=0){
+      index += 18;
+      info->systemVersion = QString::fromLocal8Bit( script.mid(index, script.indexOf('"', index)-index) );
+    }
+    if(info->systemVersion.isEmpty()){ info->systemVersion = info->kernelVersion; }
+    qint64 num = 0;
+    if(sysctlNum("kern.smp.cpus", &num)){ info->cpuCores = num; }
+    if(sysctlNum("hw.realmem", &num)){ info->totalMem = num; }
+    struct timespec up;
+    if(0==clock_gettime(CLOCK_UPTIME, &up)){ info->uptimeSecs = up.tv_sec; }
+    return !info->arch.isEmpty();
+  }
+
+  bool cpuTimes(QVector<CpuTimes> *cpus){
+    size_t len = 0;
+    if(0!=sysctlbyname("kern.cp_times", NULL, &len, NULL, 0) || len==0){ return false; }
+    QVector<long> buf(len/sizeof(long));
+    len = buf.size()*sizeof(long);
+    if(0!=sysctlbyname("kern.cp_times", buf.data(), &len, NULL, 0)){ return false; }
+    //The values come in blocks of 5 per CPU: [user,nice,system,interrupt,idle]
+    int num = len/sizeof(long)/5;
+    cpus->resize(num);
+    for(int i=0; i<num; i++){
+      CpuTimes &T = (*cpus)[i];
+      T.user = buf[i*5]; T.nice = buf[i*5+1]; T.system = buf[i*5+2];
+      T.interrupt = buf[i*5+3]; T.idle = buf[i*5+4];
+    }
+    return num>0;
+  }
+
+  bool interfaces(QList<NetCounters> *ifaces){
+    //The link-level entries carry the interface counters
+    struct ifaddrs *list = 0;
+    if(0!=getifaddrs(&list)){ return false; }
+    ifaces->clear();
+    for(struct ifaddrs *ifa = list; ifa!=0; ifa = ifa->ifa_next){
+      if(ifa->ifa_addr==0 || ifa->ifa_addr->sa_family!=AF_LINK || ifa->ifa_data==0){ continue; }
+      const struct if_data *data = (const struct if_data*) ifa->ifa_data;
+      NetCounters N;
+        N.name = QString::fromLocal8Bit(ifa->ifa_name);
+        N.rxBytes = data->ifi_ibytes;
+        N.txBytes = data->ifi_obytes;
+        N.rxPackets = data->ifi_ipackets;
+        N.txPackets = data->ifi_opackets;
+      ifaces->append(N);
+    }
+    freeifaddrs(list);
+    return true;
+  }
+};
+#endif
+
+// == Linux /proc backend ==
+// Stand-in so the probes (and everything built on them) can be tested and benchmarked off FreeBSD
+class ProcProbe : public SystemProbe{
+public:
+  ProcProbe(QString procdir = "/proc"){ root = procdir; }
+  QString name() const{ return "proc"; }
+
+  bool memory(MemoryInfo *info){
+    QList<QByteArray> lines = readSmallFile(root+"/meminfo").split('\n');
+    if(lines.length()<2){ return false; }
+    info->pageSize = sysconf(_SC_PAGESIZE);
+    for(int i=0; i<lines.length(); i++){
+      //Format: "<key>:    <value> kB"
+      int colon = lines[i].indexOf(':');
+      if(colon<0){ continue; }
+      QByteArray key = lines[i].left(colon);
+      qint64 bytes = lines[i].mid(colon+1).simplified().split(' ').first().toLongLong() * 1024;
+      if(key=="MemFree"){ info->free = bytes; }
+      else if(key=="Inactive"){ info->inactive = bytes; }
+      else if(key=="Cached"){ info->cache = bytes; }
+      else if(key=="Unevictable"){ info->wired = bytes; } //closest thing to wired pages
+      else if(key=="Active"){ info->active = bytes; }
+    }
+    return true;
+  }
+
+  bool system(SystemInfo *info){
+    struct utsname name;
+    if(0==uname(&name)){ info->arch = QString::fromLocal8Bit(name.machine); }
+    info->kernelVersion = QString::fromLocal8Bit(readSmallFile(root+"/sys/kernel/osrelease")).simplified();
+    info->kernelIdent = QString::fromLocal8Bit(readSmallFile(root+"/sys/kernel/version")).simplified();
+    info->hostname = QString::fromLocal8Bit(readSmallFile(root+"/sys/kernel/hostname")).simplified();
+    //Distribution version
+    QList<QByteArray> release = readSmallFile("/etc/os-release").split('\n');
+    for(int i=0; i<release.length(); i++){
+      if(release[i].startsWith("PRETTY_NAME=")){ info->systemVersion = QString::fromLocal8Bit(release[i].mid(12)).remove('"').simplified(); }
+    }
+    if(info->systemVersion.isEmpty()){ info->systemVersion = info->kernelVersion; }
+    //CPU model/count
+    QList<QByteArray> cpuinfo = readSmallFile(root+"/cpuinfo").split('\n');
+    for(int i=0; i<cpuinfo.length(); i++){
+      if(cpuinfo[i].startsWith("processor")){ info->cpuCores++; }
+      else if(info->cpuModel.isEmpty() && cpuinfo[i].startsWith("model name")){ info->cpuModel = QString::fromLocal8Bit(cpuinfo[i].mid(cpuinfo[i].indexOf(':')+1)).simplified(); }
+    }
+    if(info->cpuCores<1){ info->cpuCores = sysconf(_SC_NPROCESSORS_ONLN); }
+    //Memory/uptime
+    QList<QByteArray> meminfo = readSmallFile(root+"/meminfo").split('\n');
+    for(int i=0; i<meminfo.length(); i++){
+      if(meminfo[i].startsWith("MemTotal:")){ info->totalMem = meminfo[i].mid(9).simplified().split(' ').first().toLongLong() * 1024; break; }
+    }
+    QByteArray uptime = readSmallFile(root+"/uptime");
+    if(!uptime.isEmpty()){ info->uptimeSecs = uptime.split(' ').first().toDouble(); }
+    return !info->arch.isEmpty();
+  }
+
+  bool cpuTimes(QVector<CpuTimes> *cpus){
+    //Format: "cpu<N> user nice system idle iowait irq softirq ..." (the plain "cpu" line is the total)
+    QList<QByteArray> lines = readSmallFile(root+"/stat").split('\n');
+    cpus->clear();
+    for(int i=0; i<lines.length(); i++){
+      if(!lines[i].startsWith("cpu") || lines[i].length()<4 || lines[i][3]<'0' || lines[i][3]>'9'){ continue; }
+      QList<QByteArray> vals = lines[i].simplified().split(' ');
+      if(vals.length()<8){ continue; }
+      CpuTimes T;
+        T.user = vals[1].toULongLong();
+        T.nice = vals[2].toULongLong();
+        T.system = vals[3].toULongLong();
+        T.idle = vals[4].toULongLong() + vals[5].toULongLong(); //idle + iowait
+        T.interrupt = vals[6].toULongLong() + vals[7].toULongLong(); //irq + softirq
+      cpus->append(T);
+    }
+    return !cpus->isEmpty();
+  }
+
+  bool interfaces(QList<NetCounters> *ifaces){
+    //Format: "<name>: <rx bytes> <rx packets> <6 more rx fields> <tx bytes> <tx packets> ..." (2 header lines)
+    QList<QByteArray> lines = readSmallFile(root+"/net/dev").split('\n');
+    if(lines.length()<3){ return false; }
+    ifaces->clear();
+    for(int i=2; i<lines.length(); i++){
+      int colon = lines[i].indexOf(':');
+      if(colon<0){ continue; }
+      QList<QByteArray> vals = lines[i].mid(colon+1).simplified().split(' ');
+      if(vals.length()<10){ continue; }
+      NetCounters N;
+        N.name = QString::fromLocal8Bit(lines[i].left(colon)).simplified();
+        N.rxBytes = vals[0].toULongLong();
+        N.rxPackets = vals[1].toULongLong();
+        N.txBytes = vals[8].toULongLong();
+        N.txPackets = vals[9].toULongLong();
+      ifaces->append(N);
+    }
+    return true;
+  }
+
+private:
+  QString root;
+};
+
+SystemProbe *PROBE = 0;
+QMutex probeMutex;
+
+} //end of anonymous namespace
+
+SystemProbe* SystemProbe::instance(){
+  QMutexLocker lock(&probeMutex);
+  if(PROBE==0){ PROBE = create(available().first()); }
+  return PROBE;
+}
+
+void SystemProbe::setInstance(SystemProbe *probe){
+  if(probe==0){ return; }
+  QMutexLocker lock(&probeMutex);
+  //Note: the old probe is kept around - callers might still be in the middle of using it
+  PROBE = probe;
+}
+
+SystemProbe* SystemProbe::create(QString name, QString datadir){
+#if defined(__FreeBSD__)
+  if(name=="sysctl"){ return new SysctlProbe(); }
+#endif
+  if(name=="proc"){ return datadir.isEmpty() ? new ProcProbe() : new ProcProbe(datadir); }
+  return 0;
+}
+
+QStringList SystemProbe::available(){
+  QStringList list;
+#if defined(__FreeBSD__)
+  list << "sysctl";
+#endif
+  list << "proc"; //always builds - only gives results where a Linux-style /proc exists
+  return list;
+}
+
+QString SystemProbe::uptimeString(qint64 secs){
+  if(secs<0){ return ""; }
+  qint64 days = secs/86400;
+  qint64 hrs = (secs%86400)/3600;
+  qint64 mins = (secs%3600)/60;
+  QString out = "up";
+  if(days>0){ out.append( QString(" %1 day%2").arg(days).arg(days>1 ? "s" : "") ); }
+  if(hrs>0 && mins>0){ out.append( QString(" %1:%2").arg(hrs).arg(mins, 2, 10, QChar('0')) ); }
+  else if(hrs>0){ out.append( QString(" %1 hr%2").arg(hrs).arg(hrs>1 ? "s" : "") ); }
+  else if(mins>0){ out.append( QString(" %1 min%2").arg(mins).arg(mins>1 ? "s" : "") ); }
+  else if(days==0){ out.append( QString(" %1 sec%2").arg(secs%60).arg(secs%60!=1 ? "s" : "") ); }
+  return out;
+}
@@ -0,0 +1,71 @@
+//===========================================
+//  PC-BSD source code
+//  Copyright (c) 2015, PC-BSD Software/iXsystems
+//  Available under the 3-clause BSD license
+//  See the LICENSE file for full details
+//===========================================
+#ifndef __PCBSD_LIB_UTILS_SYSTEMPROBE_H
+#define __PCBSD_LIB_UTILS_SYSTEMPROBE_H
+
+//Plain Qt/POSIX only (no FreeBSD headers) so the tests/probe-bench tool can build it anywhere
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace sysadm{
+
+//Memory usage (bytes, -1: not available on this system)
+struct MemoryInfo{
+	qint64 pageSize, free, inactive, cache, wired, active;
+	MemoryInfo(){ pageSize = free = inactive = cache = wired = active = -1; }
+};
+
+//Static system information (what "uname", "hostname" and friends would report)
+struct SystemInfo{
+	QString arch, systemVersion, kernelVersion, kernelIdent, hostname, cpuModel;
+	int cpuCores;
+	qint64 uptimeSecs, totalMem; //-1: not available
+	SystemInfo(){ cpuCores = 0; uptimeSecs = totalMem = -1; }
+};
+
+//Accumulated CPU ticks for one CPU (same layout as kern.cp_times)
+struct CpuTimes{
+	quint64 user, nice, system, interrupt, idle;
+	CpuTimes(){ user = nice = system = interrupt = idle = 0; }
+	quint64 total() const{ return user+nice+system+interrupt+idle; }
+};
+
+//Accumulated traffic counters for one network interface
+struct NetCounters{
+	QString name;
+	quint64 rxBytes, txBytes, rxPackets, txPackets;
+	NetCounters(){ rxBytes = txBytes = rxPackets = txPackets = 0; }
+};
+
+// == System information probes ==
+// Reads the system statistics directly from the kernel (no external utilities).
+// Backends: "sysctl" (FreeBSD) and "proc" (Linux /proc stand-in for testing/benchmarking elsewhere)
+class SystemProbe{
+public:
+	virtual ~SystemProbe(){}
+	virtual QString name() const = 0;
+	virtual bool memory(MemoryInfo *info) = 0;
+	virtual bool system(SystemInfo *info) = 0;
+	virtual bool cpuTimes(QVector<CpuTimes> *cpus) = 0; //one entry per CPU
+	virtual bool interfaces(QList<NetCounters> *ifaces) = 0; //one entry per network interface
+
+	//Probe used by the library (the native backend for this system unless replaced)
+	static SystemProbe* instance();
+	static void setInstance(SystemProbe *probe); //takes ownership
+	//Create a backend by name (returns 0 if that backend is not available on this system)
+	// - datadir: where the "proc" backend reads its files (default: /proc - tests hand it canned ones)
+	static SystemProbe* create(QString name, QString datadir = QString());
+	static QStringList available();
+
+	//Format an uptime the same way uptime(1) does ("up 3 days 4:05", "up 12 mins", ...)
+	static QString uptimeString(qint64 secs);
+};
+
+} //end of sysadm namespace
+
+#endif
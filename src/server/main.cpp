@@ -9,6 +9,7 @@
 #include <sys/types.h>
 
 #include "WebServer.h"
+#include "library/sysadm-cpusampler.h"
 
 #define CONFFILE "/usr/local/etc/sysadm.conf"
 #define SETTINGSFILE "/var/db/sysadm.ini"
@@ -19,13 +20,39 @@
 QSettings *CONFIG = new QSettings(SETTINGSFILE, QSettings::IniFormat);
 EventWatcher *EVENTS = new EventWatcher();
 Dispatcher *DISPATCHER = new Dispatcher();
+RequestExecutor *EXECUTOR = new RequestExecutor();
+CapabilityRegistry *CAPABILITIES = new CapabilityRegistry();
+ReplyCompressor *COMPRESSOR = new ReplyCompressor();
+CursorTable *CURSORS = new CursorTable();
+ResponseCache *RESPONSECACHE = new ResponseCache();
+HostLimiter *HOSTLIMITS = new HostLimiter();
+MetricsStore *METRICS = new MetricsStore();
 bool WS_MODE = false;
 
 //Set the defail values for the global config variables
 int BlackList_BlockMinutes = 60;
 int BlackList_AuthFailsToBlock = 5;
 int BlackList_AuthFailResetMinutes = 10;
+double Limit_ConnRate = 10;
+int Limit_ConnBurst = 30;
+double Limit_RequestRate = 50;
+int Limit_RequestBurst = 100;
 bool BRIDGE_ONLY = false;
+int IO_Threads = 0;
+QString Local_Socket;
+int Request_Workers = 0;
+int Request_QueueDepth = 32;
+int Request_ParallelPerConn = 4;
+int Request_MaxBytes = 16*1024*1024;
+int Rest_KeepAliveSecs = 15;
+int Rest_KeepAliveMax = 100;
+int Compress_Threshold = 4096;
+int Compress_Level = 6;
+bool Response_Cache = true;
+int CPU_SampleMSecs = 1000;
+bool Metrics_History = true;
+int Dispatch_SyncMSecs = 50;
+bool STUB_BACKEND = false;
 
 //Create the default logfile
 QFile logfile;
@@ -65,7 +92,8 @@ inline QString ReadFile(QString path){
 void showUsage(){
 qDebug() << "sysadm-binary usage:";
 qDebug() << "Starting the server:";
-qDebug() << "    \"sysadm-binary [-rest] [-port <portnumber>]\"";
+qDebug() << "    \"sysadm-binary [-rest] [-port <portnumber>] [-stub]\"";
+qDebug() << "    (\"-stub\": benchmark mode - API calls just echo their arguments and any local login is accepted. Never use this on a production system!)";
 qDebug() << "CLI flags for configuring the server:";
 qDebug() << "  \"-h\" or \"help\": Show this help text";
 qDebug() << "  \"import_ssl_file <username> <filepath> <nickname> [<email>]\": Loads a .crt or .key file and enables the public key for authorization access later";
@@ -90,6 +118,7 @@ int main( int argc, char ** argv )
     quint16 port = 0;
     for(int i=1; i<argc; i++){
       if( QString(argv[i])=="-rest" ){ websocket = false;}
+      else if( QString(argv[i])=="-stub" ){ STUB_BACKEND = true; }
       else if( QString(argv[i])=="-p" && (i+1<argc) ){ i++; port = QString(argv[i]).toUInt(); }
       else if( QString(argv[i])=="-h" || QString(argv[i]).contains("help") ){ showUsage(); return 0; }
       else if( QString(argv[i]).startsWith("bridge_") ){
@@ -216,8 +245,13 @@ int main( int argc, char ** argv )
 	if(port<=0 || !ok){ port = PORTNUMBER;  }
       }
     }
+    // - local (unix domain) socket
+    QRegExp rg = QRegExp(websocket ? "LOCAL_SOCKET=*" : "LOCAL_SOCKET_REST=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      Local_Socket = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified();
+    }
     // - Blacklist options
-    QRegExp rg = QRegExp("BLACKLIST_BLOCK_MINUTES=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    rg = QRegExp("BLACKLIST_BLOCK_MINUTES=*",Qt::CaseSensitive,QRegExp::Wildcard);
     if(!conf.filter(rg).isEmpty()){
       bool ok = false;
       int tmp = conf.filter(rg).first().section("=",1,1).simplified().toInt(&ok);
@@ -235,10 +269,122 @@ int main( int argc, char ** argv )
       int tmp = conf.filter(rg).first().section("=",1,1).simplified().toInt(&ok);
       if(ok){ BlackList_AuthFailResetMinutes = tmp; }
     }
+    // - Rate limits
+    rg = QRegExp("CONNECTION_RATE_LIMIT=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      double tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toDouble(&ok);
+      if(ok && tmp>=0){ Limit_ConnRate = tmp; }
+    }
+    rg = QRegExp("CONNECTION_RATE_BURST=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>0){ Limit_ConnBurst = tmp; }
+    }
+    rg = QRegExp("REQUEST_RATE_LIMIT=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      double tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toDouble(&ok);
+      if(ok && tmp>=0){ Limit_RequestRate = tmp; }
+    }
+    rg = QRegExp("REQUEST_RATE_BURST=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>0){ Limit_RequestBurst = tmp; }
+    }
     rg = QRegExp("BRIDGE_CONNECTIONS_ONLY=*",Qt::CaseSensitive,QRegExp::Wildcard);
     if(!conf.filter(rg).isEmpty()){
       BRIDGE_ONLY = conf.filter(rg).first().section("=",1,1).simplified().toLower()=="true";
     }
+    // - Connection handling options
+    rg = QRegExp("IO_THREADS=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok){ IO_Threads = tmp; }
+    }
+    // - Request executor options
+    rg = QRegExp("REQUEST_WORKERS=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok){ Request_Workers = tmp; }
+    }
+    rg = QRegExp("REQUEST_QUEUE_DEPTH=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok){ Request_QueueDepth = tmp; }
+    }
+    rg = QRegExp("REQUEST_PARALLEL_PER_CONNECTION=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok){ Request_ParallelPerConn = tmp; }
+    }
+    rg = QRegExp("REQUEST_MAX_SIZE_KB=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>0){ Request_MaxBytes = tmp*1024; }
+    }
+    rg = QRegExp("REST_KEEPALIVE_TIMEOUT=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>=0){ Rest_KeepAliveSecs = tmp; }
+    }
+    rg = QRegExp("REST_KEEPALIVE_MAX_REQUESTS=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>=0){ Rest_KeepAliveMax = tmp; }
+    }
+    rg = QRegExp("COMPRESSION_THRESHOLD=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>=0){ Compress_Threshold = tmp; }
+    }
+    rg = QRegExp("COMPRESSION_LEVEL=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>=1 && tmp<=9){ Compress_Level = tmp; }
+    }
+    rg = QRegExp("RESPONSE_CACHE=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      Response_Cache = (conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toLower()!="false");
+    }
+    rg = QRegExp("CPU_SAMPLE_INTERVAL_MS=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>=100 && tmp<=10000){ CPU_SampleMSecs = tmp; }
+    }
+    rg = QRegExp("METRICS_HISTORY=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      Metrics_History = (conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toLower()!="false");
+    }
+    rg = QRegExp("DISPATCH_QUEUE_SYNC_MS=*",Qt::CaseSensitive,QRegExp::Wildcard);
+    if(!conf.filter(rg).isEmpty()){
+      bool ok = false;
+      int tmp = conf.filter(rg).first().section("=",1,1).section("#",0,0).simplified().toInt(&ok);
+      if(ok && tmp>=0 && tmp<=10000){ Dispatch_SyncMSecs = tmp; }
+    }
+    EXECUTOR->setWorkers(Request_Workers);
+    EXECUTOR->setLaneLimits(Request_QueueDepth, Request_ParallelPerConn);
+    COMPRESSOR->setThreshold(Compress_Threshold);
+    COMPRESSOR->setLevel(Compress_Level);
+    RESPONSECACHE->setEnabled(Response_Cache);
+    HOSTLIMITS->setBlockMinutes(BlackList_BlockMinutes);
+    HOSTLIMITS->setConnectionRate(Limit_ConnRate, Limit_ConnBurst);
+    HOSTLIMITS->setRequestRate(Limit_RequestRate, Limit_RequestBurst);
+    HOSTLIMITS->load(CONFIG);
+    sysadm::CpuSampler::setInterval(CPU_SampleMSecs);
+    METRICS->setEnabled(Metrics_History && !STUB_BACKEND);
 
     //Setup the log file
     LogManager::checkLogDir(); //ensure the logging directory exists
@@ -257,6 +403,15 @@ int main( int argc, char ** argv )
     //Connect the background classes
     QObject::connect(DISPATCHER, SIGNAL(DispatchEvent(QJsonObject)), EVENTS, SLOT(DispatchEvent(QJsonObject)) );
     QObject::connect(DISPATCHER, SIGNAL(DispatchStarting(QString)), EVENTS, SLOT(DispatchStarting(QString)) );
+    QObject::connect(DISPATCHER, SIGNAL(DispatchEvent(QJsonObject)), RESPONSECACHE, SLOT(jobFinished(QJsonObject)) );
+
+    //Start sampling the CPU usage (keeps the history for the "cpupercentage" averages)
+    if(!STUB_BACKEND){ sysadm::CpuSampler::instance(); }
+    METRICS->startSampling();
+
+    //Probe the available subsystems
+    WebSocket::RegisterSubsystems(CAPABILITIES);
+    CAPABILITIES->start();
 
     //Create the daemon
     qDebug() << "Starting the sysadm server...." << (websocket ? "(WebSocket)" : "(TCP)");
@@ -271,15 +426,20 @@ int main( int argc, char ** argv )
       TBACK.start();
       TBACK2.start();
       QTimer::singleShot(0,EVENTS, SLOT(start()) );
+      //Reload any jobs which were still queued when the server last stopped (runs in the dispatcher thread)
+      if(!STUB_BACKEND){ QMetaObject::invokeMethod(DISPATCHER, "start", Qt::QueuedConnection, Q_ARG(QString, DISPATCH_QUEUE)); }
       //Now start the main event loop
       ret = a.exec();
       qDebug() << "Server Stopped:" << QDateTime::currentDateTime().toString(Qt::ISODate);
+      QMetaObject::invokeMethod(DISPATCHER, "stop", Qt::BlockingQueuedConnection); //sync the dispatcher queue file
       //TBACK.stop();
     }else{
       qDebug() << "[FATAL] Server could not be started:" << QDateTime::currentDateTime().toString(Qt::ISODate);
       qDebug() << " - Tried port:" << port;
     }
     //Cleanup any globals
+    METRICS->stopSampling();
+    delete HOSTLIMITS; //writes out any pending blacklist changes
     delete CONFIG;
     logfile.close();
 
@@ -9,10 +9,23 @@ HEADERS	+= globals.h globals-qt.h \
 		WebSocket.h \
 		RestStructs.h \
 		AuthorizationManager.h \ 
+		SessionTable.h \
 		SslServer.h \
 		EventWatcher.h \
 		LogManager.h \
-		Dispatcher.h
+		Dispatcher.h \
+		DispatcherJournal.h \
+		RequestExecutor.h \
+		CapabilityRegistry.h \
+		BackendTable.h \
+		JsonFramer.h \
+		ReplyCompressor.h \
+		CursorTable.h \
+		ResponseCache.h \
+		ConnectionThreads.h \
+		HostLimiter.h \
+		TimerWheel.h \
+		MetricsStore.h
 		
 SOURCES	+= main.cpp \
 		WebServer.cpp \
@@ -20,10 +33,24 @@ SOURCES	+= main.cpp \
 		RestStructs.cpp \
 		WebBackend.cpp \
 		AuthorizationManager.cpp \
+		SessionTable.cpp \
+		SslServer.cpp \
 		EventWatcher.cpp \
 		LogManager.cpp \
 		Dispatcher.cpp \
-		DispatcherParsing.cpp
+		DispatcherParsing.cpp \
+		DispatcherJournal.cpp \
+		RequestExecutor.cpp \
+		CapabilityRegistry.cpp \
+		BackendTable.cpp \
+		JsonFramer.cpp \
+		ReplyCompressor.cpp \
+		CursorTable.cpp \
+		ResponseCache.cpp \
+		ConnectionThreads.cpp \
+		HostLimiter.cpp \
+		TimerWheel.cpp \
+		MetricsStore.cpp
 
 #Now pull in the the subsystem library classes and such
 include("library/library.pri");
@@ -39,7 +66,9 @@ INSTALLS += target scripts
 
 QMAKE_LIBDIR = /usr/local/lib/qt5 /usr/local/lib
 INCLUDEPATH += /usr/local/include
-LIBS += -L/usr/local/lib -lpam -lutil -lssl -lcrypto
+LIBS += -L/usr/local/lib -lssl -lcrypto
+#OpenPAM/login_cap (password logins) - not available on Linux development/benchmark builds
+freebsd:LIBS += -lpam -lutil
 
   #Some conf to redirect intermediate stuff in separate dirs
   UI_DIR=./.build/ui/
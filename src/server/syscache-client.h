@@ -3,31 +3,14 @@
 
 #include <QString>
 #include <QStringList>
-#include <QObject>
-#include <QTextStream>
-#include <QLocalSocket>
-#include <QCoreApplication>
 #include <QDebug>
 
-class SysCacheClient : public QLocalSocket{
-	Q_OBJECT
+class SysCacheClient{
 public:
-	SysCacheClient(QObject *parent=0);
-	~SysCacheClient();
-
 	//Static function to run a request and wait for it to finish before returning
+	// (only blocks the calling thread - no event processing)
 	static QStringList parseInputs(QStringList inputs);
 
-	//input/output variables
-	QStringList userRequest, servRequest, ans;
-
-
-private slots:
-	//Server/Client connections
-	void startRequest();
-	void requestFinished();
-	void connectionError();
-
 };
 
 #endif
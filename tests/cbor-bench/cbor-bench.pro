@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+QT = core network websockets
+
+#Compare the CBOR and JSON message encodings (server message structures, built from the server sources)
+INCLUDEPATH += $${SERVERDIR}
+
+HEADERS	+= $${SERVERDIR}/RestStructs.h
+
+SOURCES	+= main.cpp \
+		$${SERVERDIR}/RestStructs.cpp
+
+TARGET=cbor-bench
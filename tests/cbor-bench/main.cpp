@@ -0,0 +1,143 @@
+// ===============================
+//  PC-BSD REST API Server - CBOR/JSON Encoding Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+
+#include <functional>
+
+#include "RestStructs.h"
+
+//Every result feeds into this so the compiler can not drop the work
+static qint64 sink = 0;
+
+//Reply arguments of roughly the given (JSON) size
+// "list": array of objects (like listjails/listusers), "map": flat key/value object (like sysctllist)
+static QJsonObject makeArgs(int size, bool list){
+  QJsonObject obj;
+  if(list){
+    QJsonArray arr;
+    int entries = qMax(1, size/110);
+    for(int i=0; i<entries; i++){
+      QJsonObject item;
+        item.insert("name", "item"+QString::number(i));
+        item.insert("path", "/usr/local/share/item"+QString::number(i));
+        item.insert("size", QString::number(i*4096));
+        item.insert("enabled", (i%2==0) ? "true" : "false");
+      arr.append(item);
+    }
+    obj.insert("list", arr);
+  }else{
+    int entries = qMax(1, size/48);
+    for(int i=0; i<entries; i++){
+      obj.insert(QString("kern.subsys%1.node%2").arg(i%97).arg(i), QString::number(i*7919));
+    }
+  }
+  return obj;
+}
+
+//The same request in both encodings
+static QByteArray jsonRequest(const QJsonObject &args){
+  QJsonObject obj;
+    obj.insert("namespace", "sysadm");
+    obj.insert("name", "systemmanager");
+    obj.insert("id", "12345");
+    obj.insert("args", args);
+  return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+static QByteArray cborRequest(const QJsonObject &args){
+  QCborMap map;
+    map.insert(QStringLiteral("namespace"), "sysadm");
+    map.insert(QStringLiteral("name"), "systemmanager");
+    map.insert(QStringLiteral("id"), "12345");
+    map.insert(QStringLiteral("args"), QCborValue::fromJsonValue(args));
+  return QCborValue(map).toCbor();
+}
+
+static void runCase(QTextStream &out, QString label, int jsonbytes, int bytes, qint64 msecs, std::function<qint64()> fn){
+  //Short warmup, then run batches until the time is up (the clock only gets checked between batches)
+  for(int i=0; i<16; i++){ sink += fn(); }
+  QElapsedTimer timer;
+  timer.start();
+  qint64 iters = 0;
+  int batch = 1;
+  while(timer.elapsed() < msecs){
+    for(int i=0; i<batch; i++){ sink += fn(); }
+    iters += batch;
+    if(batch<1024){ batch *= 2; }
+  }
+  double ns = timer.nsecsElapsed();
+  out << QString("%1 %2 %3 %4 %5\n").arg(label, -22).arg(jsonbytes, 9).arg(bytes, 9)
+	.arg(ns/iters, 12, 'f', 0).arg( (jsonbytes*double(iters)) / (ns/1e9) / 1e6, 10, 'f', 1);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  qint64 msecs = 300;
+  QList<int> sizes; sizes << 64 << 1024 << 16384 << 262144;
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-t" && i+1<args.length()){ i++; msecs = qMax(10, args[i].toInt()); }
+    else if(args[i]=="-sizes" && i+1<args.length()){
+      i++; sizes.clear();
+      QStringList list = args[i].split(",", QString::SkipEmptyParts);
+      for(int j=0; j<list.length(); j++){ if(list[j].toInt()>0){ sizes << list[j].toInt(); } }
+    }else{
+      qDebug() << "cbor-bench usage:";
+      qDebug() << "  \"-t <msecs>\": Time to spend on each case (default: 300)";
+      qDebug() << "  \"-sizes <bytes>,<bytes>,...\": Argument payload sizes (JSON bytes - default: 64,1024,16384,262144)";
+      return 1;
+    }
+  }
+  QTextStream out(stdout);
+  //"json-bytes": size of the JSON message, "bytes": size of the message in the encoding of this case
+  //"MB/s" is relative to the JSON size for both encodings (same amount of information)
+  out << QString("%1 %2 %3 %4 %5\n").arg("case", -22).arg("json-bytes", 9).arg("bytes", 9).arg("ns/op", 12).arg("MB/s", 10);
+  for(int s=0; s<sizes.length(); s++){
+    for(int shape=0; shape<2; shape++){
+      QString tag = (shape==0) ? "list" : "map";
+      QJsonObject argsObj = makeArgs(sizes[s], shape==0);
+      QByteArray json = jsonRequest(argsObj);
+      QByteArray cbor = cborRequest(argsObj);
+      // - Parsing requests
+      runCase(out, "parse/json/"+tag, json.size(), json.size(), msecs, [&](){
+        RestInputStruct IN(json, false);
+        return (qint64) IN.name.size() + IN.args.isObject();
+      });
+      runCase(out, "parse/cbor/"+tag, json.size(), cbor.size(), msecs, [&](){
+        RestInputStruct IN(cbor, false, true);
+        return (qint64) IN.name.size() + IN.args.isObject();
+      });
+      // - Assembling replies (backend result as a QJsonObject, like most subsystems return it)
+      RestOutputStruct jsonOut;
+        jsonOut.in_struct = RestInputStruct(json, false);
+        jsonOut.CODE = RestOutputStruct::OK;
+        jsonOut.out_args = argsObj;
+      RestOutputStruct cborOut;
+        cborOut.in_struct = RestInputStruct(cbor, false, true);
+        cborOut.CODE = RestOutputStruct::OK;
+        cborOut.out_args = argsObj;
+      QByteArray jsonReply = jsonOut.assembleMessage();
+      QByteArray cborReply = cborOut.assembleMessage();
+      if(RestInputStruct(cborReply, false, true).args != jsonOut.out_args){ out << "FAILED: CBOR reply does not round-trip (" << tag << ")\n"; return 1; }
+      runCase(out, "assemble/json/"+tag, jsonReply.size(), jsonReply.size(), msecs, [&](){ return (qint64) jsonOut.assembleMessage().size(); });
+      runCase(out, "assemble/cbor/"+tag, jsonReply.size(), cborReply.size(), msecs, [&](){ return (qint64) cborOut.assembleMessage().size(); });
+      // - Pre-serialized (cached/paged) JSON results: CBOR replies need to convert them
+      RestOutputStruct jsonRaw = jsonOut;
+        jsonRaw.raw_args = QJsonDocument(argsObj).toJson(QJsonDocument::Compact);
+      RestOutputStruct cborRaw = cborOut;
+        cborRaw.raw_args = jsonRaw.raw_args;
+      runCase(out, "assemble-raw/json/"+tag, jsonReply.size(), jsonRaw.assembleMessage().size(), msecs, [&](){ return (qint64) jsonRaw.assembleMessage().size(); });
+      runCase(out, "assemble-raw/cbor/"+tag, jsonReply.size(), cborRaw.assembleMessage().size(), msecs, [&](){ return (qint64) cborRaw.assembleMessage().size(); });
+    }
+  }
+  if(sink==0){ out << "\n"; } //never true - keeps the results alive
+  return 0;
+}
@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+QT = core
+
+#Crash-recovery check and benchmark for the dispatcher journal, built directly from the server sources
+INCLUDEPATH += $${SERVERDIR}
+
+HEADERS	+= $${SERVERDIR}/DispatcherJournal.h
+
+SOURCES	+= main.cpp \
+		$${SERVERDIR}/DispatcherJournal.cpp
+
+#Plain Qt/POSIX - builds on FreeBSD or Linux
+TARGET=dispatcher-journal
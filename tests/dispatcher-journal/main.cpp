@@ -0,0 +1,185 @@
+// ===============================
+//  PC-BSD REST API Server - Dispatcher Journal Check/Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QStringList>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "DispatcherJournal.h"
+
+static int failures = 0;
+
+static void check(QTextStream &out, bool ok, QString what){
+  if(ok){ return; }
+  failures++;
+  out << "FAILED: " << what << "\n";
+  out.flush();
+}
+
+//Job <i> of the crash-recovery run: queue (i%3), every 5th one starts, every 3rd one finishes
+static QString jobID(int i){ return QString("job_%1").arg(i); }
+static QStringList jobCmds(int i){ return QStringList() << QString("pkg install -y port%1").arg(i) << "echo \"done\""; }
+static QString jobDir(int i){ return (i%7==0) ? "/usr/ports/" : ""; }
+
+//Runs in a forked child, which gets killed in the middle of writing a record
+static void crashChild(QString path, int jobs){
+  DispatcherJournal J;
+  J.setSyncBatch(jobs*10); //never fsync - nothing which made it into write() may get lost when the process dies
+  J.setCompactThreshold(jobs/4); //compact a few times along the way as well
+  if(!J.open(path)){ _exit(2); }
+  for(int i=0; i<jobs; i++){
+    qint64 seq = J.queued(i%3, jobID(i), jobCmds(i), jobDir(i));
+    if(i%5==0){ J.started(seq); }
+    if(i%3==0){ J.finished(seq); }
+  }
+  //Half of the next record, then die
+  QByteArray torn = "{\"op\":\"queued\",\"seq\":999999,\"queue\":1,\"id\":\"torn";
+  int fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_APPEND);
+  if(fd<0 || ::write(fd, torn.constData(), torn.size())!=torn.size()){ _exit(3); }
+  ::kill(::getpid(), SIGKILL);
+  _exit(4); //not reached
+}
+
+static void crashRecovery(QTextStream &out, QString dir){
+  const int jobs = 3000;
+  QString path = dir+"/crash_queue";
+  QFile::remove(path);
+  out << "== crash recovery (" << jobs << " jobs) ==\n";
+  out.flush();
+  pid_t pid = ::fork();
+  if(pid==0){ crashChild(path, jobs); }
+  int status = 0;
+  check(out, pid>0 && ::waitpid(pid, &status, 0)==pid, "fork/wait");
+  check(out, WIFSIGNALED(status) && WTERMSIG(status)==SIGKILL, QString("child did not crash as planned (status %1)").arg(status));
+
+  //Replay: every job which never finished, in queue order, nothing from the torn record
+  DispatcherJournal J;
+  QList<DispatcherJournal::Job> pending;
+  check(out, J.open(path, &pending), "reopen after crash");
+  check(out, J.droppedRecords()==1, QString("torn records dropped: %1 (expected 1)").arg(J.droppedRecords()));
+  int p = 0;
+  for(int i=0; i<jobs; i++){
+    if(i%3==0){ continue; }
+    if(p>=pending.length()){ check(out, false, QString("missing job %1").arg(i)); break; }
+    const DispatcherJournal::Job &job = pending[p];
+    bool same = (job.seq==i+1 && job.queue==i%3 && job.id==jobID(i) && job.cmds==jobCmds(i) && job.workdir==jobDir(i) && job.started==(i%5==0));
+    check(out, same, QString("job %1 replayed as: %2 %3 %4 %5").arg(i).arg(job.seq).arg(job.queue).arg(job.id).arg(job.cmds.join(";")));
+    p++;
+  }
+  check(out, p==pending.length(), QString("unexpected extra jobs: %1").arg(pending.length()-p));
+
+  //New records go into a clean file (the torn record is gone)
+  qint64 seq = J.queued(2, "after_crash", QStringList() << "true");
+  check(out, seq==jobs+1, QString("sequence after replay: %1 (expected %2)").arg(seq).arg(jobs+1));
+  J.close();
+  check(out, J.open(path, &pending), "reopen after the first replay");
+  check(out, J.droppedRecords()==0, "torn record still in the file after the replay");
+  check(out, !pending.isEmpty() && pending.last().id=="after_crash", "job queued after the replay is missing");
+  J.close();
+  out << (failures==0 ? "ok" : "FAILED") << "\n";
+  out.flush();
+}
+
+static void compaction(QTextStream &out, QString dir){
+  //Jobs coming and going must not grow the file without bounds
+  const int jobs = 20000;
+  const int threshold = 1024;
+  QString path = dir+"/compact_queue";
+  QFile::remove(path);
+  out << "== compaction (" << jobs << " finished jobs) ==\n";
+  int before = failures;
+  DispatcherJournal J;
+  J.setCompactThreshold(threshold);
+  check(out, J.open(path), "open");
+  qint64 keep = J.queued(1, "long_running", QStringList() << "sleep 1000");
+  J.started(keep);
+  for(int i=0; i<jobs; i++){
+    qint64 seq = J.queued(i%3, jobID(i), jobCmds(i));
+    J.started(seq);
+    J.finished(seq);
+  }
+  J.close();
+  QFile file(path);
+  int lines = 0;
+  if(file.open(QIODevice::ReadOnly)){ lines = file.readAll().count('\n'); file.close(); }
+  check(out, lines>0 && lines<=threshold+4, QString("records left in the file: %1 (max %2)").arg(lines).arg(threshold+4));
+  QList<DispatcherJournal::Job> pending;
+  check(out, J.open(path, &pending), "reopen");
+  check(out, pending.length()==1 && pending[0].id=="long_running" && pending[0].started, "live job lost by the compaction");
+  J.close();
+  out << (failures==before ? "ok" : "FAILED") << "\n";
+  out.flush();
+}
+
+//Time <jobs> transitions from a fresh journal (including the final fsync)
+static void benchCase(QTextStream &out, QString label, QString path, int jobs, int batch, bool lifecycle){
+  QFile::remove(path);
+  DispatcherJournal J;
+  J.setSyncBatch(batch);
+  if(!J.open(path)){ out << label << ": could not open " << path << "\n"; failures++; return; }
+  QStringList cmds = QStringList() << "pkg install -y sysutils/example" << "pkg clean -y";
+  QElapsedTimer timer;
+  timer.start();
+  for(int i=0; i<jobs; i++){
+    qint64 seq = J.queued(i%3, QString("sysadm_pkg_install-%1").arg(i), cmds);
+    if(lifecycle){ J.started(seq); J.finished(seq); }
+  }
+  J.sync();
+  double ns = timer.nsecsElapsed();
+  J.close();
+  out << QString("%1 %2 %3 %4\n").arg(label, -26).arg(ns/1e6, 10, 'f', 1).arg(ns/jobs/1000.0, 10, 'f', 2).arg(jobs/(ns/1e9), 12, 'f', 0);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  int jobs = 10000;
+  bool runcheck = true;
+  bool runbench = true;
+  QString dir = QDir::tempPath()+"/dispatcher-journal-"+QString::number(::getpid());
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-n" && i+1<args.length()){ i++; jobs = qMax(1, args[i].toInt()); }
+    else if(args[i]=="-dir" && i+1<args.length()){ i++; dir = args[i]; }
+    else if(args[i]=="-check"){ runbench = false; }
+    else if(args[i]=="-bench"){ runcheck = false; }
+    else{
+      qDebug() << "dispatcher-journal usage:";
+      qDebug() << "  \"-n <jobs>\": Number of jobs to enqueue for the benchmark (default: 10000)";
+      qDebug() << "  \"-dir <path>\": Directory for the journal files (default: a new directory in" << QDir::tempPath() << ")";
+      qDebug() << "  \"-check\": Only run the crash-recovery/compaction checks";
+      qDebug() << "  \"-bench\": Only run the benchmark";
+      return 1;
+    }
+  }
+  QDir().mkpath(dir);
+  QTextStream out(stdout);
+  if(runcheck){
+    crashRecovery(out, dir);
+    compaction(out, dir);
+  }
+  if(runbench){
+    out << "== enqueue " << jobs << " jobs (" << dir << ") ==\n";
+    out << QString("%1 %2 %3 %4\n").arg("case", -26).arg("total ms", 10).arg("us/job", 10).arg("jobs/s", 12);
+    benchCase(out, "queued, fsync every job", dir+"/bench_queue", jobs, 1, false);
+    benchCase(out, "queued, fsync per 256", dir+"/bench_queue", jobs, 256, false);
+    benchCase(out, "queued+started+finished", dir+"/bench_queue", jobs, 256, true);
+  }
+  QFile::remove(dir+"/crash_queue");
+  QFile::remove(dir+"/compact_queue");
+  QFile::remove(dir+"/bench_queue");
+  QDir().rmdir(dir); //only if it is empty (never removes anything else from a user-supplied directory)
+  return (failures==0) ? 0 : 1;
+}
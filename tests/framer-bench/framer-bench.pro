@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+QT = core network websockets
+
+#Benchmark the TCP/REST message framer directly from the server sources
+INCLUDEPATH += $${SERVERDIR}
+
+HEADERS	+= $${SERVERDIR}/JsonFramer.h
+
+SOURCES	+= main.cpp \
+		$${SERVERDIR}/JsonFramer.cpp
+
+TARGET=framer-bench
@@ -0,0 +1,143 @@
+// ===============================
+//  PC-BSD REST API Server - Message Framer Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+
+#include <functional>
+
+#include "JsonFramer.h"
+
+//Every result feeds into this so the compiler can not drop the work
+static qint64 sink = 0;
+static int failures = 0;
+
+//JSON request of roughly the given size (nested objects and strings with escapes/braces, like a real request)
+static QByteArray makeJson(int size){
+  QByteArray msg = "{\"namespace\":\"sysadm\",\"name\":\"fs\",\"id\":\"12345\",\"args\":{\"action\":\"write\",\"list\":[";
+  for(int i=0; msg.size() < size-4; i++){
+    if(i>0){ msg.append(","); }
+    msg.append("{\"name\":\"item"+QByteArray::number(i)+"\",\"value\":\"a \\\"quoted\\\" {brace} value\"}");
+  }
+  msg.append("]}}");
+  return msg;
+}
+
+static QByteArray makeRest(const QByteArray &body, bool contentLength){
+  QByteArray msg = "PUT /sysadm/fs HTTP/1.1\r\n";
+  msg.append("Host: 127.0.0.1\r\n");
+  msg.append("Authorization: Basic "+QByteArray("operator:password").toBase64()+"\r\n");
+  msg.append("Connection: keep-alive\r\n");
+  msg.append("Content-Type: application/json\r\n");
+  if(contentLength){ msg.append("Content-Length: "+QByteArray::number(body.size())+"\r\n"); }
+  msg.append("\r\n");
+  msg.append(body);
+  return msg;
+}
+
+//Feed the stream to a framer in chunks (like socket reads) and collect the frames
+static qint64 frameStream(const QByteArray &stream, int chunk, int expected, const QByteArray &first){
+  JsonFramer framer(64*1024*1024);
+  int frames = 0;
+  QByteArray frame;
+  for(int i=0; i<stream.size(); i+=chunk){
+    framer.append( (chunk>=stream.size()) ? stream : stream.mid(i, chunk) );
+    JsonFramer::STATUS stat;
+    while( (stat = framer.nextFrame(&frame)) == JsonFramer::FRAME){
+      if(frames==0 && frame!=first){ failures++; }
+      frames++;
+    }
+    if(stat==JsonFramer::TOOLARGE){ failures++; return 0; }
+  }
+  if(frames!=expected){ failures++; }
+  return frames + frame.size();
+}
+
+//The way WebSocket::ParseIncoming() used to find the end of a message (full JSON parse at every "}")
+static qint64 legacyFrame(const QByteArray &stream){
+  QString buffer = QString::fromUtf8(stream);
+  for(int i=0; i<buffer.size(); i++){
+    if(buffer[i]!='}'){ continue; }
+    QString req = buffer.left(i+1);
+    req = "{"+req.section("{",1,-1);
+    if( !QJsonDocument::fromJson(req.toLocal8Bit()).isNull() ){ return i; }
+  }
+  return 0;
+}
+
+static void runCase(QTextStream &out, QString label, int bytes, qint64 msecs, std::function<qint64()> fn){
+  //Short warmup, then run batches until the time is up (the clock only gets checked between batches)
+  for(int i=0; i<2; i++){ sink += fn(); }
+  QElapsedTimer timer;
+  timer.start();
+  qint64 iters = 0;
+  int batch = 1;
+  while(timer.elapsed() < msecs){
+    for(int i=0; i<batch; i++){ sink += fn(); }
+    iters += batch;
+    if(batch<1024){ batch *= 2; }
+  }
+  double ns = timer.nsecsElapsed();
+  out << QString("%1 %2 %3 %4\n").arg(label, -24).arg(bytes, 9)
+	.arg(ns/iters/1000.0, 12, 'f', 1).arg( (bytes*double(iters)) / (ns/1e9) / 1e6, 10, 'f', 1);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  qint64 msecs = 500;
+  int size = 1024*1024;
+  int legacyMax = 64*1024;
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-t" && i+1<args.length()){ i++; msecs = qMax(10, args[i].toInt()); }
+    else if(args[i]=="-size" && i+1<args.length()){ i++; size = qMax(256, args[i].toInt()); }
+    else if(args[i]=="-legacy" && i+1<args.length()){ i++; legacyMax = args[i].toInt(); }
+    else{
+      qDebug() << "framer-bench usage:";
+      qDebug() << "  \"-t <msecs>\": Time to spend on each case (default: 500)";
+      qDebug() << "  \"-size <bytes>\": Request body size (default: 1048576)";
+      qDebug() << "  \"-legacy <bytes>\": Largest body for the old framing code (quadratic - default: 65536, 0 to skip)";
+      return 1;
+    }
+  }
+  QTextStream out(stdout);
+  out << QString("%1 %2 %3 %4\n").arg("case", -24).arg("bytes", 9).arg("us/op", 12).arg("MB/s", 10);
+  QByteArray json = makeJson(size);
+  QByteArray restCL = makeRest(json, true);
+  QByteArray restScan = makeRest(json, false);
+  // - One large request, all at once and in socket-sized reads
+  runCase(out, "json/whole", json.size(), msecs, [&](){ return frameStream(json, json.size(), 1, json); });
+  runCase(out, "json/64k-reads", json.size(), msecs, [&](){ return frameStream(json, 65536, 1, json); });
+  runCase(out, "json/1k-reads", json.size(), msecs, [&](){ return frameStream(json, 1024, 1, json); });
+  runCase(out, "rest-length/64k-reads", restCL.size(), msecs, [&](){ return frameStream(restCL, 65536, 1, restCL); });
+  runCase(out, "rest-scan/64k-reads", restScan.size(), msecs, [&](){ return frameStream(restScan, 65536, 1, restScan); });
+  // - The same number of bytes as many small pipelined requests
+  QByteArray small = makeJson(1024);
+  QByteArray pipelined;
+  int count = qMax(1, size/small.size());
+  for(int i=0; i<count; i++){ pipelined.append(small); pipelined.append("\n"); }
+  runCase(out, "json-1k-pipelined/64k", pipelined.size(), msecs, [&](){ return frameStream(pipelined, 65536, count, small); });
+  // - Old framing code (smaller bodies only - the time grows with the square of the size)
+  for(int lsize=4096; lsize<=legacyMax && lsize<=size; lsize*=4){
+    QByteArray ljson = makeJson(lsize);
+    runCase(out, "legacy/json", ljson.size(), msecs, [&](){ return legacyFrame(ljson); });
+    runCase(out, "json/whole", ljson.size(), msecs, [&](){ return frameStream(ljson, ljson.size(), 1, ljson); });
+  }
+  // - Refusing an oversized request must not buffer the body
+  JsonFramer framer(1024*1024);
+  framer.append("PUT /sysadm/fs HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n{");
+  QByteArray frame;
+  if(framer.nextFrame(&frame)!=JsonFramer::TOOLARGE){ failures++; out << "FAILED: overflowing Content-Length was not refused\n"; }
+  framer.clear();
+  framer.append("PUT /sysadm/fs HTTP/1.1\r\nContent-Length: 4294967296\r\n\r\n{");
+  if(framer.nextFrame(&frame)!=JsonFramer::TOOLARGE){ failures++; out << "FAILED: 4GB Content-Length was not refused\n"; }
+  if(sink==0){ out << "\n"; } //never true - keeps the results alive
+  if(failures>0){ out << "FAILED: " << failures << " framing errors\n"; return 1; }
+  return 0;
+}
@@ -0,0 +1,15 @@
+include(../tests.pri)
+
+QT = core network websockets
+
+#Timer state of idle connections: per-connection QTimers vs the server timer wheel (server sources)
+INCLUDEPATH += $${SERVERDIR} ../pipeline-bench
+
+HEADERS	+= ../pipeline-bench/AllocCounter.h \
+		$${SERVERDIR}/TimerWheel.h
+
+SOURCES	+= main.cpp \
+		../pipeline-bench/AllocCounter.cpp \
+		$${SERVERDIR}/TimerWheel.cpp
+
+TARGET=idle-bench
@@ -0,0 +1,130 @@
+// ===============================
+//  PC-BSD REST API Server - Idle Connection Timer Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+
+#include <functional>
+
+#include "TimerWheel.h"
+#include "AllocCounter.h"
+
+#define IDLE_MSECS (30*60000) //WebSocket IDLETIMEOUTMINS
+#define AUTH_MSECS 30000
+#define CHECK_MSECS 60000
+
+//Stands in for the WebSocket object both kinds of timers belong to
+class Connection : public QObject{
+public:
+  virtual void messageIn() = 0; //every incoming message restarts the idle countdown
+};
+
+// === Timers every connection used to own (copied from the old WebSocket constructors) ===
+class LegacyConnection : public Connection{
+public:
+  LegacyConnection() : Connection(){
+    idletimer = new QTimer(this);
+      idletimer->setInterval(IDLE_MSECS);
+      idletimer->setSingleShot(true);
+    connect(idletimer, &QTimer::timeout, this, [](){});
+    idletimer->start();
+    QTimer::singleShot(AUTH_MSECS, this, [](){}); //checkAuth()
+    connCheckTimer = new QTimer(this);
+      connCheckTimer->setInterval(CHECK_MSECS);
+    connect(connCheckTimer, &QTimer::timeout, this, [](){});
+    connCheckTimer->start();
+  }
+  void messageIn(){ idletimer->stop(); idletimer->start(); }
+private:
+  QTimer *idletimer, *connCheckTimer;
+};
+
+// === Timers in the thread's timer wheel (WebSocket::setupTimers()) ===
+class WheelConnection : public Connection{
+public:
+  WheelConnection() : Connection(){
+    idleTimer.setCallback([this](){ this->messageIn(); });
+    authTimer.setCallback([this](){ this->messageIn(); });
+    checkTimer.setCallback([this](){ this->messageIn(); });
+    idleTimer.start(IDLE_MSECS);
+    authTimer.start(AUTH_MSECS);
+    checkTimer.start(CHECK_MSECS);
+  }
+  void messageIn(){ idleTimer.start(IDLE_MSECS); }
+private:
+  WheelTimer idleTimer, authTimer, checkTimer;
+};
+
+//Plain connection object without any timers (subtracted from both cases)
+class BareConnection : public Connection{
+public:
+  void messageIn(){}
+};
+
+static void runCase(QTextStream &out, QString label, int num, std::function<Connection*()> make, qint64 baseBytes, qint64 baseAllocs){
+  QList<Connection*> conns;
+  conns.reserve(num); //list growth stays out of the counts
+  //Warmup (first timer in the thread sets up the dispatcher/wheel)
+  delete make();
+  AllocCounter::start();
+  for(int i=0; i<num; i++){ conns << make(); }
+  AllocCounter::stop();
+  qint64 bytes = AllocCounter::bytes() - baseBytes;
+  qint64 allocs = AllocCounter::count() - baseAllocs;
+  //Restart the idle countdown of every connection (one incoming message each)
+  QElapsedTimer timer;
+  timer.start();
+  for(int i=0; i<num; i++){ conns[i]->messageIn(); }
+  double restartNs = double(timer.nsecsElapsed())/num;
+  //Closing all of them
+  timer.restart();
+  qDeleteAll(conns);
+  double closeNs = double(timer.nsecsElapsed())/num;
+  out << QString("%1 %2 %3 %4 %5 %6\n").arg(label, -10).arg(num, 8)
+	.arg(AllocCounter::available() ? QString::number(double(bytes)/num, 'f', 0) : QString("n/a"), 11)
+	.arg(AllocCounter::available() ? QString::number(double(allocs)/num, 'f', 1) : QString("n/a"), 11)
+	.arg(restartNs, 12, 'f', 0).arg(closeNs, 10, 'f', 0);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  QList<int> sizes; sizes << 1000 << 10000 << 50000;
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-n" && i+1<args.length()){
+      i++; sizes.clear();
+      QStringList list = args[i].split(",", QString::SkipEmptyParts);
+      for(int j=0; j<list.length(); j++){ if(list[j].toInt()>0){ sizes << list[j].toInt(); } }
+    }else{
+      qDebug() << "idle-bench usage:";
+      qDebug() << "  \"-n <num>,<num>,...\": Numbers of idle connections (default: 1000,10000,50000)";
+      return 1;
+    }
+  }
+  QTextStream out(stdout);
+  if(!AllocCounter::available()){ out << "Note: allocation counting is not available on this system\n"; }
+  //"bytes/conn" and "allocs/conn": heap used by the timers of one idle connection (the connection object itself is not counted)
+  //"restart-ns": one incoming message (idle countdown restarted), "close-ns": deleting the connection
+  out << QString("%1 %2 %3 %4 %5 %6\n").arg("case", -10).arg("conns", 8).arg("bytes/conn", 11).arg("allocs/conn", 11).arg("restart-ns", 12).arg("close-ns", 10);
+  for(int s=0; s<sizes.length(); s++){
+    //Cost of the bare connection objects
+    QList<Connection*> bare;
+    bare.reserve(sizes[s]);
+    delete new BareConnection();
+    AllocCounter::start();
+    for(int i=0; i<sizes[s]; i++){ bare << new BareConnection(); }
+    AllocCounter::stop();
+    qint64 baseBytes = AllocCounter::bytes();
+    qint64 baseAllocs = AllocCounter::count();
+    qDeleteAll(bare);
+    runCase(out, "before", sizes[s], [](){ return (Connection*) new LegacyConnection(); }, baseBytes, baseAllocs);
+    runCase(out, "after", sizes[s], [](){ return (Connection*) new WheelConnection(); }, baseBytes, baseAllocs);
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+// ===============================
+//  PC-BSD REST API Server - Load Generator
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "LatencyHistogram.h"
+
+#define SUB_COUNT (1<<HIST_SUB_BITS)
+
+LatencyHistogram::LatencyHistogram(){
+  counts.fill(0, (HIST_MAX_BITS-HIST_SUB_BITS+1)*SUB_COUNT);
+  total = maxval = 0;
+  sum = 0;
+}
+
+void LatencyHistogram::record(qint64 usecs){
+  if(usecs<0){ usecs = 0; }
+  counts[bucketFor(usecs)]++;
+  total++;
+  sum += usecs;
+  if(usecs>maxval){ maxval = usecs; }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other){
+  for(int i=0; i<counts.size(); i++){ counts[i] += other.counts[i]; }
+  total += other.total;
+  sum += other.sum;
+  if(other.maxval>maxval){ maxval = other.maxval; }
+}
+
+void LatencyHistogram::clear(){
+  counts.fill(0);
+  total = maxval = 0;
+  sum = 0;
+}
+
+qint64 LatencyHistogram::count() const{
+  return total;
+}
+
+qint64 LatencyHistogram::percentile(double pct) const{
+  if(total==0){ return 0; }
+  qint64 want = qint64(total*pct/100.0 + 0.5); //rank of the sample we are looking for
+  if(want<1){ want = 1; }
+  if(want>total){ want = total; }
+  qint64 seen = 0;
+  for(int i=0; i<counts.size(); i++){
+    seen += counts[i];
+    if(seen>=want){ return qMin(valueFor(i), maxval); }
+  }
+  return maxval;
+}
+
+qint64 LatencyHistogram::max() const{
+  return maxval;
+}
+
+double LatencyHistogram::mean() const{
+  return (total==0) ? 0 : sum/total;
+}
+
+// === PRIVATE ===
+int LatencyHistogram::bucketFor(qint64 usecs){
+  //Small values get a bucket of their own, everything else: power of two + linear step within it
+  if(usecs < SUB_COUNT){ return int(usecs); }
+  int msb = 63;
+  while( ((usecs>>msb) & 1)==0 ){ msb--; }
+  if(msb >= HIST_MAX_BITS){ return (HIST_MAX_BITS-HIST_SUB_BITS+1)*SUB_COUNT - 1; } //clamp into the last bucket
+  int shift = msb - HIST_SUB_BITS;
+  int sub = int(usecs>>shift) & (SUB_COUNT-1);
+  return (shift+1)*SUB_COUNT + sub;
+}
+
+qint64 LatencyHistogram::valueFor(int bucket){
+  if(bucket < SUB_COUNT){ return bucket; }
+  int shift = bucket/SUB_COUNT - 1;
+  qint64 lower = qint64(SUB_COUNT + bucket%SUB_COUNT) << shift;
+  return lower + (qint64(1)<<shift) - 1;
+}
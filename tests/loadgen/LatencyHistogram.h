@@ -0,0 +1,39 @@
+// ===============================
+//  PC-BSD REST API Server - Load Generator
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_LOADGEN_LATENCY_HISTOGRAM_H
+#define _PCBSD_LOADGEN_LATENCY_HISTOGRAM_H
+
+#include <QVector>
+
+#define HIST_SUB_BITS 5 //32 linear steps within each power of two (~3% resolution)
+#define HIST_MAX_BITS 40 //largest value which can be recorded (2^40 usecs - way past any timeout)
+
+// == Log-linear latency histogram (microseconds) ==
+// Fixed memory and O(1) recording no matter how many samples get added,
+//  so the tail percentiles come from every single request (no sampling).
+class LatencyHistogram{
+public:
+	LatencyHistogram();
+
+	void record(qint64 usecs);
+	void merge(const LatencyHistogram &other);
+	void clear();
+
+	qint64 count() const;
+	qint64 percentile(double pct) const; //pct: 0-100 (returns usecs - upper edge of the bucket)
+	qint64 max() const;
+	double mean() const;
+
+private:
+	QVector<qint64> counts;
+	qint64 total, maxval;
+	double sum;
+
+	static int bucketFor(qint64 usecs);
+	static qint64 valueFor(int bucket);
+};
+
+#endif
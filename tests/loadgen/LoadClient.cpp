@@ -0,0 +1,302 @@
+// ===============================
+//  PC-BSD REST API Server - Load Generator
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "LoadClient.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QUrl>
+#include <QTimer>
+#include <QDebug>
+
+#define DEBUG 0
+#define AUTH_ID "loadgen-auth"
+
+LoadClient::LoadClient(TYPE type, QString host, quint16 port, QString user, QString pass, int maxinflight, const QElapsedTimer *clock) : QObject(){
+  ctype = type;
+  this->host = host;
+  this->port = port;
+  this->user = user;
+  this->pass = pass;
+  maxInFlight = qMax(1, maxinflight);
+  this->clock = clock;
+  WSOCKET = 0;
+  TSOCKET = 0;
+  running = authed = closing = closeEach = false;
+  nextID = 1;
+  measureFrom = connectStarted = 0;
+  completed = errors = timeouts = reconnects = 0;
+}
+
+LoadClient::~LoadClient(){
+  stop();
+}
+
+void LoadClient::setCloseEach(bool close){
+  closeEach = (close && ctype==REST);
+  if(closeEach){ maxInFlight = 1; } //the connection is gone after the first reply
+}
+
+LoadClient::TYPE LoadClient::type(){
+  return ctype;
+}
+
+void LoadClient::start(){
+  running = true;
+  if(WSOCKET==0 && TSOCKET==0){ openConnection(); }
+}
+
+void LoadClient::stop(){
+  running = false;
+  authed = false;
+  if(WSOCKET!=0){ WSOCKET->abort(); }
+  if(TSOCKET!=0){ TSOCKET->abort(); }
+}
+
+bool LoadClient::isReady(){
+  return (authed && inFlight() < maxInFlight);
+}
+
+int LoadClient::inFlight(){
+  return pendingWS.count() + pendingREST.count() + retry.count();
+}
+
+void LoadClient::send(const LoadRequest &req, qint64 scheduled){
+  if(ctype==WEBSOCKET){
+    QByteArray id = QByteArray::number(nextID++);
+    pendingWS.insert(id, scheduled);
+    WSOCKET->sendTextMessage( QString::fromUtf8(req.wsPrefix + id + "\"}") );
+  }else{
+    PendingRest P;
+      P.scheduled = scheduled;
+      P.message = (closeEach ? req.restCloseMessage : req.restMessage); //implicitly shared - no copy
+    pendingREST.enqueue(P);
+    TSOCKET->write(P.message);
+  }
+}
+
+void LoadClient::expire(qint64 timeout){
+  qint64 now = clock->nsecsElapsed();
+  if(running && !authed && (WSOCKET!=0 || TSOCKET!=0) && !closing && now-connectStarted > timeout){
+    //Connection/authentication is hanging - start over
+    if(DEBUG){ qDebug() << "Connection attempt timed out"; }
+    if(WSOCKET!=0){ WSOCKET->abort(); }
+    else{ TSOCKET->abort(); }
+    return;
+  }
+  if(ctype==WEBSOCKET){
+    QHash<QByteArray, qint64>::iterator it = pendingWS.begin();
+    while(it!=pendingWS.end()){
+      if(now - it.value() > timeout){
+        if(it.value()>=measureFrom){ timeouts++; }
+        it = pendingWS.erase(it);
+      }else{ ++it; }
+    }
+  }else if(!pendingREST.isEmpty() && pendingREST.head().scheduled>=0 && now-pendingREST.head().scheduled > timeout){
+    //Replies come back in order - everything behind this one is stuck too. Drop the connection and start over.
+    for(int i=0; i<pendingREST.count(); i++){
+      if(pendingREST[i].scheduled>=measureFrom){ timeouts++; }
+    }
+    pendingREST.clear();
+    if(TSOCKET!=0){ TSOCKET->abort(); }
+  }
+}
+
+void LoadClient::resetStats(qint64 from){
+  hist.clear();
+  completed = errors = timeouts = reconnects = 0;
+  measureFrom = from;
+}
+
+LoadRequest LoadClient::makeRequest(QString host, QString namesp, QString name, QByteArray args, int weight, QString basicauth){
+  LoadRequest req;
+  req.label = namesp+"/"+name;
+  req.weight = weight;
+  //WebSocket: {"namespace":<namesp>,"name":<name>,"args":<args>,"id":"<ID>"}
+  QJsonObject obj;
+    obj.insert("namespace", namesp);
+    obj.insert("name", name);
+  req.wsPrefix = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+  req.wsPrefix.chop(1); //closing bracket
+  req.wsPrefix.append(",\"args\":");
+  req.wsPrefix.append(args);
+  req.wsPrefix.append(",\"id\":\"");
+  //REST: the URI carries the namespace/name
+  req.restMessage = restRequest(host, namesp+"/"+name, "{\"args\":"+args+"}");
+  req.restCloseMessage = restRequest(host, namesp+"/"+name, "{\"args\":"+args+"}",
+	"Authorization: Basic "+basicauth.toUtf8().toBase64()+"\r\nConnection: close\r\n");
+  return req;
+}
+
+// === PRIVATE ===
+QByteArray LoadClient::restRequest(QString host, QString path, QByteArray body, QByteArray extraheaders){
+  QByteArray msg = "PUT /"+path.toUtf8()+" HTTP/1.1\r\n";
+  msg.append("Host: "+host.toUtf8()+"\r\n");
+  msg.append(extraheaders);
+  msg.append("Content-Type: application/json\r\n");
+  msg.append("Content-Length: "+QByteArray::number(body.size())+"\r\n");
+  msg.append("\r\n");
+  msg.append(body);
+  return msg;
+}
+
+void LoadClient::openConnection(){
+  connectStarted = clock->nsecsElapsed();
+  closing = false;
+  if(ctype==WEBSOCKET){
+    WSOCKET = new QWebSocket("sysadm-loadgen", QWebSocketProtocol::VersionLatest, this);
+    connect(WSOCKET, SIGNAL(connected()), this, SLOT(wsConnected()) );
+    connect(WSOCKET, SIGNAL(textMessageReceived(const QString&)), this, SLOT(wsMessage(const QString&)) );
+    connect(WSOCKET, SIGNAL(disconnected()), this, SLOT(connectionClosed()) );
+    connect(WSOCKET, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(connectionClosed()) );
+    connect(WSOCKET, SIGNAL(sslErrors(const QList<QSslError>&)), this, SLOT(sslErrors(const QList<QSslError>&)) );
+    WSOCKET->open( QUrl("wss://"+host+":"+QString::number(port)) );
+  }else{
+    TSOCKET = new QSslSocket(this);
+    connect(TSOCKET, SIGNAL(encrypted()), this, SLOT(tcpEncrypted()) );
+    connect(TSOCKET, SIGNAL(readyRead()), this, SLOT(tcpReadyRead()) );
+    connect(TSOCKET, SIGNAL(disconnected()), this, SLOT(connectionClosed()) );
+    connect(TSOCKET, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(connectionClosed()) );
+    connect(TSOCKET, SIGNAL(sslErrors(const QList<QSslError>&)), this, SLOT(sslErrors(const QList<QSslError>&)) );
+    TSOCKET->connectToHostEncrypted(host, port);
+  }
+}
+
+void LoadClient::sendAuth(){
+  QJsonObject args;
+    args.insert("username", user);
+    args.insert("password", pass);
+  if(ctype==WEBSOCKET){
+    QJsonObject obj;
+      obj.insert("namespace", "rpc");
+      obj.insert("name", "auth");
+      obj.insert("id", AUTH_ID);
+      obj.insert("args", args);
+    WSOCKET->sendTextMessage( QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact)) );
+  }else{
+    PendingRest P;
+      P.scheduled = -1;
+      P.message = restRequest(host, "rpc/auth", QJsonDocument(args).toJson(QJsonDocument::Compact));
+    pendingREST.enqueue(P);
+    TSOCKET->write(P.message);
+  }
+}
+
+void LoadClient::finishRequest(qint64 scheduled, bool ok){
+  if(scheduled < measureFrom){ return; } //warmup request
+  if(ok){
+    hist.record( (clock->nsecsElapsed() - scheduled)/1000 );
+    completed++;
+  }else{
+    errors++;
+  }
+}
+
+void LoadClient::parseRestReplies(){
+  //Each reply: status line + headers, blank line, then "Content-Length" bytes of body
+  while(true){
+    int hend = incoming.indexOf("\r\n\r\n");
+    if(hend<0){ return; } //headers not complete yet
+    QString head = QString::fromLatin1(incoming.left(hend));
+    QStringList lines = head.split("\r\n");
+    int length = 0;
+    for(int i=1; i<lines.length(); i++){
+      if(lines[i].startsWith("Content-Length:", Qt::CaseInsensitive)){ length = lines[i].section(":",1,1).simplified().toInt(); }
+      else if(lines[i].startsWith("Connection:", Qt::CaseInsensitive) && lines[i].contains("close", Qt::CaseInsensitive)){ closing = true; }
+    }
+    if(incoming.size() < hend+4+length){ return; } //body not complete yet
+    incoming.remove(0, hend+4+length);
+    bool ok = (lines.first().section(" ",1,1)=="200");
+    if(pendingREST.isEmpty()){ continue; } //not a reply to anything we sent (timed out)
+    PendingRest P = pendingREST.dequeue();
+    if(P.scheduled<0){
+      //Authentication reply
+      if(!ok){ running = false; emit authFailed("Authentication failed: "+lines.first()); return; }
+      authed = !closing;
+      //Send anything which got cut off by the last connection closing
+      for(int i=0; i<retry.length() && authed; i++){
+        pendingREST.enqueue(retry[i]);
+        TSOCKET->write(retry[i].message);
+      }
+      retry.clear();
+    }else{
+      finishRequest(P.scheduled, ok);
+    }
+    if(closing){ authed = false; } //server is about to close the connection - nothing more can go out on it
+  }
+}
+
+// === PRIVATE SLOTS ===
+void LoadClient::wsConnected(){
+  sendAuth();
+}
+
+void LoadClient::wsMessage(const QString &msg){
+  QJsonObject obj = QJsonDocument::fromJson(msg.toUtf8()).object();
+  QByteArray id = obj.value("id").toString().toUtf8();
+  bool ok = (obj.value("name").toString()!="error");
+  if(id==AUTH_ID){
+    if(!ok){ running = false; emit authFailed("Authentication failed: "+QJsonDocument(obj.value("args").toObject()).toJson(QJsonDocument::Compact)); return; }
+    authed = true;
+  }else if(pendingWS.contains(id)){
+    finishRequest(pendingWS.take(id), ok);
+  }else{
+    return; //event or a reply which already timed out
+  }
+  emit readyForMore();
+}
+
+void LoadClient::tcpEncrypted(){
+  if(closeEach){
+    //Every request carries its own login - ready as soon as the TLS handshake is done
+    authed = true;
+    emit readyForMore();
+  }else{
+    sendAuth();
+  }
+}
+
+void LoadClient::tcpReadyRead(){
+  incoming.append(TSOCKET->readAll());
+  parseRestReplies();
+  emit readyForMore();
+}
+
+void LoadClient::connectionClosed(){
+  QObject *sock = sender();
+  if(sock==0 || (sock!=WSOCKET && sock!=TSOCKET) ){ return; } //connection which was already handled
+  //Requests which were still waiting for a reply
+  for(int i=0; i<pendingREST.count(); i++){
+    if(pendingREST[i].scheduled<0){ continue; }
+    if(closing){ retry << pendingREST[i]; } //announced close - try again on the next connection
+    else if(pendingREST[i].scheduled>=measureFrom){ errors++; }
+  }
+  QHash<QByteArray, qint64>::const_iterator it = pendingWS.constBegin();
+  for( ; it!=pendingWS.constEnd(); ++it){
+    if(it.value()>=measureFrom){ errors++; }
+  }
+  pendingWS.clear();
+  pendingREST.clear();
+  incoming.clear();
+  authed = false;
+  sock->deleteLater();
+  WSOCKET = 0;
+  TSOCKET = 0;
+  if(running){
+    if(DEBUG){ qDebug() << "Connection closed - reconnecting"; }
+    reconnects++;
+    QTimer::singleShot(closing ? 0 : 250, this, SLOT(reconnect()) );
+  }
+}
+
+void LoadClient::sslErrors(const QList<QSslError>&){
+  //The server normally uses a self-signed certificate
+  if(WSOCKET!=0 && sender()==WSOCKET){ WSOCKET->ignoreSslErrors(); }
+  else if(TSOCKET!=0 && sender()==TSOCKET){ TSOCKET->ignoreSslErrors(); }
+}
+
+void LoadClient::reconnect(){
+  if(running && WSOCKET==0 && TSOCKET==0){ openConnection(); }
+}
@@ -0,0 +1,102 @@
+// ===============================
+//  PC-BSD REST API Server - Load Generator
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_LOADGEN_CLIENT_H
+#define _PCBSD_LOADGEN_CLIENT_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QWebSocket>
+#include <QSslSocket>
+#include <QSslError>
+
+#include "LatencyHistogram.h"
+
+// == One entry in the request mix ==
+// The messages get assembled once up front - only the request ID changes between WebSocket requests
+struct LoadRequest{
+	QString label; //"namespace/name"
+	QByteArray wsPrefix; //JSON message up to the value of the "id" field
+	QByteArray restMessage; //complete REST request
+	QByteArray restCloseMessage; //same request with "Authorization"/"Connection: close" headers (one request per connection)
+	int weight;
+};
+
+// == Single client connection to the server ==
+// Authenticates right after connecting, then sends whatever requests the runner hands over.
+// Latency gets measured from the time a request was *scheduled* (not sent): a server which
+//  falls behind shows up in the numbers instead of just slowing down the sender.
+class LoadClient : public QObject{
+	Q_OBJECT
+public:
+	enum TYPE{ WEBSOCKET, REST };
+	LoadClient(TYPE type, QString host, quint16 port, QString user, QString pass, int maxinflight, const QElapsedTimer *clock);
+
+	//REST only: open a new connection for every request (Basic auth header + "Connection: close") instead of keeping it open
+	void setCloseEach(bool close);
+	~LoadClient();
+
+	TYPE type();
+	void start(); //connect + authenticate (reconnects automatically until stop() is called)
+	void stop();
+	bool isReady(); //authenticated with room for another request
+	int inFlight();
+	void send(const LoadRequest &req, qint64 scheduled); //scheduled: nsecs on the shared clock
+	void expire(qint64 timeout); //give up on requests which have been waiting longer than this (nsecs)
+	void resetStats(qint64 from); //forget the numbers so far (only count requests scheduled after "from")
+
+	//Assemble a request for the mix (args: JSON text, basicauth: "<user>:<password>" for the one-request-per-connection variant)
+	static LoadRequest makeRequest(QString host, QString namesp, QString name, QByteArray args, int weight, QString basicauth = QString());
+
+	//Statistics
+	LatencyHistogram hist; //successful requests only
+	qint64 completed, errors, timeouts, reconnects;
+
+private:
+	TYPE ctype;
+	QString host, user, pass;
+	quint16 port;
+	int maxInFlight;
+	const QElapsedTimer *clock;
+	QWebSocket *WSOCKET;
+	QSslSocket *TSOCKET;
+	bool running, authed, closing, closeEach;
+	quint64 nextID;
+	qint64 measureFrom, connectStarted;
+	QHash<QByteArray, qint64> pendingWS; //request ID -> scheduled time
+	struct PendingRest{
+	  qint64 scheduled; //-1: authentication request
+	  QByteArray message;
+	};
+	QQueue<PendingRest> pendingREST; //REST replies come back in request order
+	QList<PendingRest> retry; //sent after the server announced it would close the connection - send again
+	QByteArray incoming; //partial REST replies
+
+	static QByteArray restRequest(QString host, QString path, QByteArray body, QByteArray extraheaders = QByteArray());
+
+	void openConnection();
+	void sendAuth();
+	void finishRequest(qint64 scheduled, bool ok);
+	void parseRestReplies();
+
+private slots:
+	void wsConnected();
+	void wsMessage(const QString &msg);
+	void tcpEncrypted();
+	void tcpReadyRead();
+	void connectionClosed();
+	void sslErrors(const QList<QSslError>&);
+	void reconnect();
+
+signals:
+	void readyForMore(); //replies came in - more requests can go out
+	void authFailed(QString msg);
+};
+
+#endif
@@ -0,0 +1,266 @@
+// ===============================
+//  PC-BSD REST API Server - Load Generator
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "LoadRunner.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+#include <QDebug>
+
+#define DEBUG 0
+#define NSECS 1000000000LL
+#define EXPIRE_CHECK_NSECS 100000000LL //check for timed-out requests 10 times a second
+
+LoadRunner::LoadRunner() : QObject(){
+  host = "127.0.0.1";
+  wsPort = 12150;
+  restPort = 12151;
+  wsConns = restConns = 0;
+  inFlight = 1;
+  rate = 0;
+  warmupSecs = 2;
+  durationSecs = 10;
+  timeoutSecs = 10;
+  quiet = false;
+  restClose = false;
+  totalWeight = 0;
+  stage = CONNECTING;
+  stageStart = loadStart = 0;
+  scheduled = dropped = 0;
+  nextClient = 0;
+  lastReport = lastCompleted = lastExpire = 0;
+  tickTimer = new QTimer(this);
+    tickTimer->setTimerType(Qt::PreciseTimer);
+    tickTimer->setInterval(1);
+  connect(tickTimer, SIGNAL(timeout()), this, SLOT(tick()) );
+}
+
+LoadRunner::~LoadRunner(){
+  for(int i=0; i<clients.length(); i++){ delete clients[i]; }
+}
+
+bool LoadRunner::addRequest(QString spec){
+  //Format: "[<weight>*]<namespace>/<name>[:<JSON args>]"
+  QString path = spec.section(":",0,0).simplified();
+  QString args = spec.section(":",1,-1).trimmed();
+  int weight = 1;
+  if(path.contains("*")){
+    bool ok = false;
+    weight = path.section("*",0,0).toInt(&ok);
+    if(!ok || weight<1){ return false; }
+    path = path.section("*",1,-1);
+  }
+  QString namesp = path.section("/",0,0);
+  QString name = path.section("/",1,-1);
+  if(namesp.isEmpty() || name.isEmpty()){ return false; }
+  if(args.isEmpty()){ args = "{}"; }
+  QJsonParseError err;
+  QJsonDocument doc = QJsonDocument::fromJson(args.toUtf8(), &err);
+  if(doc.isNull()){ return false; }
+  mix << LoadClient::makeRequest(host, namesp, name, doc.toJson(QJsonDocument::Compact), weight, user+":"+pass);
+  totalWeight += weight;
+  return true;
+}
+
+bool LoadRunner::loadMix(QString file){
+  QFile F(file);
+  if(!F.open(QIODevice::ReadOnly)){ qWarning() << "Could not read the request mix:" << file; return false; }
+  QTextStream in(&F);
+  int num = 0;
+  while(!in.atEnd()){
+    QString line = in.readLine().trimmed();
+    num++;
+    if(line.isEmpty() || line.startsWith("#")){ continue; }
+    if(!addRequest(line)){ qWarning() << "Invalid request on line" << num << ":" << line; return false; }
+  }
+  return true;
+}
+
+void LoadRunner::start(){
+  if(mix.isEmpty()){ addRequest("sysadm/systemmanager:{\"action\":\"memorystats\"}"); }
+  clock.start();
+  for(int i=0; i<wsConns+restConns; i++){
+    LoadClient *client = 0;
+    if(i<wsConns){ client = new LoadClient(LoadClient::WEBSOCKET, host, wsPort, user, pass, inFlight, &clock); }
+    else{
+      client = new LoadClient(LoadClient::REST, host, restPort, user, pass, inFlight, &clock);
+      client->setCloseEach(restClose);
+    }
+    connect(client, SIGNAL(readyForMore()), this, SLOT(dispatch()) );
+    connect(client, SIGNAL(authFailed(QString)), this, SLOT(clientAuthFailed(QString)) );
+    clients << client;
+    client->start();
+  }
+  QTextStream out(stdout);
+  out << "Connecting to " << host << ": " << wsConns << " WebSocket, " << restConns << " REST connections\n";
+  out << "Request mix:";
+  for(int i=0; i<mix.length(); i++){ out << " " << mix[i].label << "(" << mix[i].weight << ")"; }
+  out << "\n";
+  stage = CONNECTING;
+  stageStart = clock.nsecsElapsed();
+  tickTimer->start();
+}
+
+// === PRIVATE ===
+const LoadRequest& LoadRunner::pickRequest(){
+  if(mix.length()==1){ return mix[0]; }
+  int num = QRandomGenerator::global()->bounded(totalWeight);
+  for(int i=0; i<mix.length(); i++){
+    num -= mix[i].weight;
+    if(num<0){ return mix[i]; }
+  }
+  return mix.last();
+}
+
+LoadClient* LoadRunner::nextReadyClient(){
+  //Round-robin over the clients which have room for another request
+  for(int i=0; i<clients.length(); i++){
+    int num = (nextClient+i) % clients.length();
+    if(clients[num]->isReady()){
+      nextClient = num+1;
+      return clients[num];
+    }
+  }
+  return 0;
+}
+
+void LoadRunner::report(bool final){
+  LatencyHistogram all, ws, rest;
+  qint64 completed = 0, errors = 0, timeouts = 0, reconnects = 0;
+  int waiting = 0;
+  for(int i=0; i<clients.length(); i++){
+    all.merge(clients[i]->hist);
+    if(clients[i]->type()==LoadClient::WEBSOCKET){ ws.merge(clients[i]->hist); }
+    else{ rest.merge(clients[i]->hist); }
+    completed += clients[i]->completed;
+    errors += clients[i]->errors;
+    timeouts += clients[i]->timeouts;
+    reconnects += clients[i]->reconnects;
+    waiting += clients[i]->inFlight();
+  }
+  qint64 now = clock.nsecsElapsed();
+  QTextStream out(stdout);
+  if(!final){
+    //Progress line (numbers for the last second)
+    double secs = (now-lastReport)/double(NSECS);
+    out << QString("[%1s] %2 req/s  errors: %3  timeouts: %4  in flight: %5  backlog: %6\n")
+	.arg( (now-stageStart)/NSECS, 3).arg( (completed-lastCompleted)/secs, 9, 'f', 1)
+	.arg(errors).arg(timeouts).arg(waiting).arg(backlog.count());
+    lastReport = now;
+    lastCompleted = completed;
+    return;
+  }
+  double secs = (now-stageStart)/double(NSECS);
+  out << "\n=== Results ===\n";
+  out << QString("Duration: %1s (after %2s warmup)\n").arg(secs, 0, 'f', 1).arg(warmupSecs);
+  out << QString("Connections: %1 WebSocket, %2 REST (max %3 in flight each)%4\n").arg(wsConns).arg(restConns).arg(inFlight)
+	.arg( (restClose && restConns>0) ? QString(" - REST: new connection for every request") : QString() );
+  out << QString("Target rate: %1\n").arg(rate>0 ? QString::number(rate)+" req/s" : QString("none (closed loop)"));
+  out << QString("Requests: %1 completed, %2 errors, %3 timeouts, %4 dropped, %5 reconnects\n").arg(completed).arg(errors).arg(timeouts).arg(dropped).arg(reconnects);
+  out << QString("Throughput: %1 req/s\n").arg(completed/secs, 0, 'f', 1);
+  QList<LatencyHistogram*> hists; hists << &all;
+  QStringList labels; labels << "all";
+  if(wsConns>0 && restConns>0){ hists << &ws << &rest; labels << "websocket" << "rest"; }
+  out << "Latency (ms):\n";
+  for(int i=0; i<hists.length(); i++){
+    out << QString("  %1  p50 %2  p90 %3  p99 %4  p999 %5  max %6  mean %7\n").arg(labels[i], -9)
+	.arg(hists[i]->percentile(50)/1000.0, 0, 'f', 3).arg(hists[i]->percentile(90)/1000.0, 0, 'f', 3)
+	.arg(hists[i]->percentile(99)/1000.0, 0, 'f', 3).arg(hists[i]->percentile(99.9)/1000.0, 0, 'f', 3)
+	.arg(hists[i]->max()/1000.0, 0, 'f', 3).arg(hists[i]->mean()/1000.0, 0, 'f', 3);
+  }
+}
+
+// === PRIVATE SLOTS ===
+void LoadRunner::tick(){
+  qint64 now = clock.nsecsElapsed();
+  if(now-lastExpire > EXPIRE_CHECK_NSECS){
+    for(int i=0; i<clients.length(); i++){ clients[i]->expire(timeoutSecs*NSECS); }
+    lastExpire = now;
+  }
+  if(stage==CONNECTING){
+    int ready = 0;
+    for(int i=0; i<clients.length(); i++){ if(clients[i]->isReady()){ ready++; } }
+    if(ready==clients.length()){
+      QTextStream(stdout) << QString("Connected and authenticated in %1 ms - warming up for %2s\n").arg( (now-stageStart)/1000000 ).arg(warmupSecs);
+      stage = WARMUP;
+      stageStart = loadStart = now;
+      scheduled = 0;
+    }else if(now-stageStart > timeoutSecs*NSECS){
+      qCritical() << "Could not connect/authenticate all the clients:" << ready << "of" << clients.length() << "ready";
+      tickTimer->stop();
+      QCoreApplication::exit(1);
+      return;
+    }else{
+      return; //keep waiting
+    }
+  }
+  if(stage==WARMUP && now-stageStart >= warmupSecs*NSECS){
+    //Start measuring: only requests scheduled from now on count
+    stage = MEASURING;
+    stageStart = lastReport = now;
+    lastCompleted = 0;
+    dropped = 0;
+    for(int i=0; i<clients.length(); i++){ clients[i]->resetStats(now); }
+  }else if(stage==MEASURING){
+    if(now-stageStart >= durationSecs*NSECS){
+      tickTimer->stop();
+      report(true);
+      for(int i=0; i<clients.length(); i++){ clients[i]->stop(); }
+      QCoreApplication::exit(0);
+      return;
+    }else if(!quiet && now-lastReport >= NSECS){
+      report(false);
+    }
+  }
+  if(rate>0){
+    //Open loop: schedule everything which is due by now
+    qint64 due = qint64( (now-loadStart)/double(NSECS) * rate );
+    while(scheduled < due){
+      backlog.enqueue( loadStart + qint64(scheduled*(NSECS/rate)) );
+      scheduled++;
+    }
+    //Give up on requests which waited too long to even go out
+    qint64 maxBacklog = qMax(qint64(1000), qint64(rate*timeoutSecs));
+    while(backlog.count() > maxBacklog){
+      if(stage==MEASURING && backlog.head()>=stageStart){ dropped++; }
+      backlog.dequeue();
+    }
+  }
+  dispatch();
+}
+
+void LoadRunner::dispatch(){
+  if(stage==CONNECTING){ return; }
+  LoadClient *client = qobject_cast<LoadClient*>(sender()); //got replies (room for more requests)
+  if(rate<=0){
+    //Closed loop: keep the in-flight limit filled
+    if(client!=0){
+      while(client->isReady()){ client->send(pickRequest(), clock.nsecsElapsed()); }
+      return;
+    }
+    client = nextReadyClient();
+    while(client!=0){
+      client->send(pickRequest(), clock.nsecsElapsed());
+      client = nextReadyClient();
+    }
+    return;
+  }
+  //Open loop: work through the backlog (oldest first)
+  if(client==0 || !client->isReady()){ client = nextReadyClient(); }
+  while(client!=0 && !backlog.isEmpty()){
+    client->send(pickRequest(), backlog.dequeue());
+    if(!client->isReady()){ client = nextReadyClient(); }
+  }
+}
+
+void LoadRunner::clientAuthFailed(QString msg){
+  if(!tickTimer->isActive()){ return; } //already shutting down
+  qCritical() << msg;
+  tickTimer->stop();
+  QCoreApplication::exit(1);
+}
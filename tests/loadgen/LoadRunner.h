@@ -0,0 +1,66 @@
+// ===============================
+//  PC-BSD REST API Server - Load Generator
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_LOADGEN_RUNNER_H
+#define _PCBSD_LOADGEN_RUNNER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QQueue>
+#include <QElapsedTimer>
+
+#include "LoadClient.h"
+
+// == Load test driver ==
+// Opens all the connections, waits for them to authenticate, then feeds requests from the mix:
+//  - rate>0: open loop - requests get scheduled at a fixed rate no matter how fast the replies come back
+//	(requests which can not go out right away wait in a backlog - that time counts as latency)
+//  - rate=0: closed loop - every connection keeps its in-flight limit filled (max throughput)
+class LoadRunner : public QObject{
+	Q_OBJECT
+public:
+	LoadRunner();
+	~LoadRunner();
+
+	//Settings (set before start())
+	QString host, user, pass;
+	quint16 wsPort, restPort;
+	int wsConns, restConns; //number of connections of each type
+	int inFlight; //max requests waiting for a reply on each connection
+	double rate; //requests per second over all connections (0: as fast as possible)
+	int warmupSecs, durationSecs, timeoutSecs;
+	bool quiet; //no progress output every second
+	bool restClose; //REST: one request per connection (no keep-alive)
+
+	bool addRequest(QString spec); //"[<weight>*]<namespace>/<name>[:<JSON args>]"
+	bool loadMix(QString file); //one request spec per line (# comments)
+	void start();
+
+private:
+	QList<LoadRequest> mix;
+	int totalWeight;
+	QList<LoadClient*> clients;
+	QElapsedTimer clock;
+	QTimer *tickTimer;
+	enum STAGE{ CONNECTING, WARMUP, MEASURING };
+	STAGE stage;
+	qint64 stageStart, loadStart; //nsecs on the clock
+	qint64 scheduled; //number of requests scheduled since the load started (open loop)
+	QQueue<qint64> backlog; //scheduled times of requests which did not go out yet (open loop)
+	qint64 dropped;
+	int nextClient;
+	qint64 lastReport, lastCompleted, lastExpire;
+
+	const LoadRequest& pickRequest();
+	LoadClient* nextReadyClient();
+	void report(bool final);
+
+private slots:
+	void tick();
+	void dispatch(); //hand out the waiting/closed-loop requests to the clients
+	void clientAuthFailed(QString msg);
+};
+
+#endif
@@ -0,0 +1,15 @@
+include(../tests.pri)
+
+QT = core network websockets
+
+HEADERS	+= LatencyHistogram.h \
+		LoadClient.h \
+		LoadRunner.h
+
+SOURCES	+= main.cpp \
+		LatencyHistogram.cpp \
+		LoadClient.cpp \
+		LoadRunner.cpp
+
+#Plain Qt - builds on FreeBSD or Linux
+TARGET=sysadm-loadgen
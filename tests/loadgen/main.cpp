@@ -0,0 +1,79 @@
+// ===============================
+//  PC-BSD REST API Server - Load Generator
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QProcessEnvironment>
+#include <QStringList>
+#include <QDebug>
+
+#include "LoadRunner.h"
+
+void showUsage(){
+qDebug() << "sysadm-loadgen usage:";
+qDebug() << "    \"sysadm-loadgen [options]\"";
+qDebug() << "Connections:";
+qDebug() << "  \"-host <address>\": Server to connect to (default: 127.0.0.1)";
+qDebug() << "  \"-ws <num>\": Number of WebSocket connections (default: 1 if no REST connections are requested)";
+qDebug() << "  \"-rest <num>\": Number of REST connections (the server needs to be started with \"-rest\")";
+qDebug() << "  \"-rest-close\": REST connections send one request each (login + \"Connection: close\") instead of staying open";
+qDebug() << "  \"-wsport <port>\" / \"-restport <port>\": Server ports (default: 12150 / 12151)";
+qDebug() << "  \"-user <name>\" / \"-pass <password>\": Login (default: $APITESTUSER/$APITESTPASS or \"root\")";
+qDebug() << "     Note: A server started with \"-stub\" accepts any login from the local system";
+qDebug() << "Load:";
+qDebug() << "  \"-rate <req/sec>\": Total request rate over all connections (default: 0 - as fast as possible)";
+qDebug() << "  \"-inflight <num>\": Max requests waiting for a reply on each connection (default: 1)";
+qDebug() << "  \"-t <secs>\": Length of the measurement (default: 10)";
+qDebug() << "  \"-warmup <secs>\": Load before the measurement starts (default: 2)";
+qDebug() << "  \"-timeout <secs>\": Give up on a request/connection after this long (default: 10)";
+qDebug() << "  \"-req \\\"[<weight>*]<namespace>/<name>[:<JSON args>]\\\"\": Add a request to the mix (may be repeated)";
+qDebug() << "     Example: -req '3*sysadm/systemmanager:{\"action\":\"memorystats\"}'";
+qDebug() << "  \"-mix <file>\": Read the request mix from a file (one request per line)";
+qDebug() << "  \"-q\": No progress output every second";
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  LoadRunner runner;
+  QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+  runner.user = env.value("APITESTUSER", "root");
+  runner.pass = env.value("APITESTPASS");
+  bool hasWS = false;
+  QStringList reqs, mixes;
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    QString opt = args[i];
+    bool hasval = (i+1<args.length());
+    if(opt=="-h" || opt.contains("help")){ showUsage(); return 0; }
+    else if(opt=="-q"){ runner.quiet = true; }
+    else if(opt=="-rest-close"){ runner.restClose = true; }
+    else if(!hasval){ qDebug() << "Missing value for option:" << opt; showUsage(); return 1; }
+    else if(opt=="-host"){ i++; runner.host = args[i]; }
+    else if(opt=="-ws"){ i++; runner.wsConns = args[i].toInt(); hasWS = true; }
+    else if(opt=="-rest"){ i++; runner.restConns = args[i].toInt(); }
+    else if(opt=="-wsport"){ i++; runner.wsPort = args[i].toUInt(); }
+    else if(opt=="-restport"){ i++; runner.restPort = args[i].toUInt(); }
+    else if(opt=="-user"){ i++; runner.user = args[i]; }
+    else if(opt=="-pass"){ i++; runner.pass = args[i]; }
+    else if(opt=="-rate"){ i++; runner.rate = args[i].toDouble(); }
+    else if(opt=="-inflight"){ i++; runner.inFlight = qMax(1, args[i].toInt()); }
+    else if(opt=="-t"){ i++; runner.durationSecs = qMax(1, args[i].toInt()); }
+    else if(opt=="-warmup"){ i++; runner.warmupSecs = qMax(0, args[i].toInt()); }
+    else if(opt=="-timeout"){ i++; runner.timeoutSecs = qMax(1, args[i].toInt()); }
+    else if(opt=="-req"){ i++; reqs << args[i]; }
+    else if(opt=="-mix"){ i++; mixes << args[i]; }
+    else{ qDebug() << "Unknown option:" << opt; showUsage(); return 1; }
+  }
+  if(!hasWS && runner.restConns<=0){ runner.wsConns = 1; }
+  if(runner.wsConns + runner.restConns <= 0){ qDebug() << "No connections requested"; return 1; }
+  //Requests get assembled for the final host name
+  for(int i=0; i<mixes.length(); i++){
+    if(!runner.loadMix(mixes[i])){ return 1; }
+  }
+  for(int i=0; i<reqs.length(); i++){
+    if(!runner.addRequest(reqs[i])){ qDebug() << "Invalid request:" << reqs[i]; return 1; }
+  }
+  runner.start();
+  return a.exec();
+}
@@ -0,0 +1,71 @@
+// ===============================
+//  PC-BSD REST API Server - Heap Allocation Counter (benchmarks)
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include "AllocCounter.h"
+
+#include <stdlib.h>
+
+//The C library entry points behind malloc() and friends
+#if defined(__GLIBC__)
+#define ALLOC_COUNTING 1
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+#define REAL_MALLOC __libc_malloc
+#define REAL_CALLOC __libc_calloc
+#define REAL_REALLOC __libc_realloc
+#elif defined(__FreeBSD__)
+#define ALLOC_COUNTING 1
+extern "C" void* __malloc(size_t);
+extern "C" void* __calloc(size_t, size_t);
+extern "C" void* __realloc(void*, size_t);
+#define REAL_MALLOC __malloc
+#define REAL_CALLOC __calloc
+#define REAL_REALLOC __realloc
+#else
+#define ALLOC_COUNTING 0
+#endif
+
+static thread_local bool counting = false;
+static thread_local qint64 allocs = 0;
+static thread_local qint64 allocBytes = 0;
+
+#if ALLOC_COUNTING
+extern "C" void* malloc(size_t size){
+  if(counting){ allocs++; allocBytes += size; }
+  return REAL_MALLOC(size);
+}
+
+extern "C" void* calloc(size_t num, size_t size){
+  if(counting){ allocs++; allocBytes += num*size; }
+  return REAL_CALLOC(num, size);
+}
+
+extern "C" void* realloc(void *ptr, size_t size){
+  if(counting){ allocs++; allocBytes += size; }
+  return REAL_REALLOC(ptr, size);
+}
+#endif
+
+bool AllocCounter::available(){
+  return ALLOC_COUNTING;
+}
+
+void AllocCounter::start(){
+  allocs = allocBytes = 0;
+  counting = true;
+}
+
+void AllocCounter::stop(){
+  counting = false;
+}
+
+qint64 AllocCounter::count(){
+  return allocs;
+}
+
+qint64 AllocCounter::bytes(){
+  return allocBytes;
+}
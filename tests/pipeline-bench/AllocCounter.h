@@ -0,0 +1,24 @@
+// ===============================
+//  PC-BSD REST API Server - Heap Allocation Counter (benchmarks)
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#ifndef _PCBSD_SYSADM_TESTS_ALLOC_COUNTER_H
+#define _PCBSD_SYSADM_TESTS_ALLOC_COUNTER_H
+
+#include <QtGlobal>
+
+// == Counts the heap allocations made by the calling thread ==
+// Wraps malloc/calloc/realloc (Qt containers and operator new both end up there) and
+// forwards to the C library. Only available with glibc and the FreeBSD libc - on any
+// other system available() returns false and the counters stay at zero.
+class AllocCounter{
+public:
+	static bool available();
+	static void start(); //reset the counters and start counting on this thread
+	static void stop();
+	static qint64 count(); //number of allocations since start()
+	static qint64 bytes(); //number of bytes requested since start()
+};
+
+#endif
@@ -0,0 +1,221 @@
+// ===============================
+//  PC-BSD REST API Server - Request/Reply Pipeline Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+
+#include <functional>
+
+#include "RestStructs.h"
+#include "AllocCounter.h"
+
+//Every result feeds into this so the compiler can not drop the work
+static qint64 sink = 0;
+
+// === The QString pipeline the server used to have (copied from the old RestStructs/WebSocket code) ===
+struct LegacyInput{
+  QString VERB, URI, HTTPVERSION, name, namesp, id, auth;
+  QJsonValue args;
+  QStringList Header;
+  QString Body;
+
+  LegacyInput(QString message, bool isRest){
+    HTTPVERSION = "HTTP/1.1";
+    if(!message.startsWith("{") && isRest){
+      Header = message.section("{",0,0).split("\n");
+      Body = "{"+message.section("{",1, -1);
+    }else{
+      Body = message;
+    }
+    if(!Header.isEmpty() && isRest){
+      QString line = Header.takeFirst();
+      VERB = line.section(" ",0,0);
+      URI = line.section(" ",1,1);
+      HTTPVERSION = line.section(" ",2,2);
+      if(!Header.filter("Authorization:").isEmpty()){
+        line = Header.filter("Authorization:").takeFirst().section("Authorization: ",1,50).simplified();
+        if(line.section(" ",0,0).toLower()=="basic"){
+          QByteArray ba;
+          ba.append(line.section(" ",1,1));
+          auth = QByteArray::fromBase64(ba);
+        }
+      }
+    }
+    while(Body.endsWith("\n")){ Body.chop(1); }
+    if(Body.startsWith("{") && Body.endsWith("}") ){
+      QJsonDocument doc = QJsonDocument::fromJson(Body.toUtf8());
+      if(!doc.isNull() && doc.isObject() ){
+        if(doc.object().contains("namespace") ){ namesp = doc.object().value("namespace").toString(); }
+        if(doc.object().contains("name") ){ name = doc.object().value("name").toString(); }
+        if(doc.object().contains("id") ){ id = doc.object().value("id").toString(); }
+        if(doc.object().contains("args") ){ args = doc.object().value("args"); }
+        else{ args = doc.object(); }
+      }
+    }
+    if(!URI.isEmpty()){
+      name = URI.section("/",-1);
+      namesp = URI.section("/",1,1);
+    }
+  }
+};
+
+static QString legacyAssemble(const LegacyInput &in, QJsonValue out_args){
+  if( !in.VERB.isEmpty() ){
+    QStringList headers;
+    QString firstline = in.HTTPVERSION.simplified();
+    QString Body;
+    if(!out_args.isNull()){
+      QJsonObject obj; obj.insert("args", out_args);
+      Body = QJsonDocument(obj).toJson();
+    }
+    firstline.append(" 200 OK");
+    headers << firstline;
+    headers << "Server: SysAdm/1.0";
+    headers << "Date: "+QDateTime::currentDateTime().toString(Qt::ISODate).simplified();
+    headers << QString("Content-Type: text/json; charset=utf-8").simplified();
+    if(!Body.isEmpty()){ headers << "Content-Length: "+QString::number(Body.toUtf8().size()); }
+    headers << "";
+    headers << Body;
+    return headers.join("\r\n");
+  }
+  QJsonObject obj;
+  obj.insert("namespace", in.namesp);
+  obj.insert("name", "response");
+  obj.insert("id", in.id);
+  obj.insert("args", out_args);
+  return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+// === Test data ===
+//A "sysctllist" reply with the given number of entries (FreeBSD has ~10000 sysctl's)
+static QJsonObject makeSysctlList(int entries){
+  QJsonObject obj;
+  for(int i=0; i<entries; i++){
+    obj.insert(QString("kern.subsys%1.node%2.value").arg(i%97).arg(i), QString("some sysctl value %1").arg(i*7919));
+  }
+  return obj;
+}
+
+static QByteArray jsonRequest(){
+  return "{\"namespace\":\"sysadm\",\"name\":\"systemmanager\",\"id\":\"12345\",\"args\":{\"action\":\"sysctllist\"}}";
+}
+
+static QByteArray restRequest(){
+  QByteArray body = "{\"action\":\"sysctllist\"}";
+  QByteArray msg = "PUT /sysadm/systemmanager HTTP/1.1\r\n";
+  msg.append("Host: 127.0.0.1\r\n");
+  msg.append("Authorization: Basic "+QByteArray("operator:password").toBase64()+"\r\n");
+  msg.append("Content-Type: application/json\r\n");
+  msg.append("Content-Length: "+QByteArray::number(body.size())+"\r\n");
+  msg.append("\r\n");
+  msg.append(body);
+  return msg;
+}
+
+// === Timing ===
+static void runCase(QTextStream &out, QString label, int entries, qint64 msecs, std::function<qint64()> fn){
+  //Allocations for a single request (after a warmup)
+  for(int i=0; i<2; i++){ sink += fn(); }
+  AllocCounter::start();
+    qint64 bytes = fn();
+  AllocCounter::stop();
+  sink += bytes;
+  qint64 allocs = AllocCounter::count();
+  qint64 allocKB = AllocCounter::bytes()/1024;
+  //Latency (run batches until the time is up)
+  QElapsedTimer timer;
+  timer.start();
+  qint64 iters = 0;
+  int batch = 1;
+  while(timer.elapsed() < msecs){
+    for(int i=0; i<batch; i++){ sink += fn(); }
+    iters += batch;
+    if(batch<64){ batch *= 2; }
+  }
+  double ns = timer.nsecsElapsed();
+  out << QString("%1 %2 %3 %4 %5 %6\n").arg(label, -18).arg(entries, 8).arg(bytes/1024, 9)
+	.arg(ns/iters/1000.0, 12, 'f', 1)
+	.arg(AllocCounter::available() ? QString::number(allocs) : QString("n/a"), 9)
+	.arg(AllocCounter::available() ? QString::number(allocKB) : QString("n/a"), 11);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  qint64 msecs = 1000;
+  QList<int> sizes; sizes << 100 << 1000 << 10000;
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-t" && i+1<args.length()){ i++; msecs = qMax(10, args[i].toInt()); }
+    else if(args[i]=="-entries" && i+1<args.length()){
+      i++; sizes.clear();
+      QStringList list = args[i].split(",", QString::SkipEmptyParts);
+      for(int j=0; j<list.length(); j++){ if(list[j].toInt()>0){ sizes << list[j].toInt(); } }
+    }else{
+      qDebug() << "pipeline-bench usage:";
+      qDebug() << "  \"-t <msecs>\": Time to spend on each case (default: 1000)";
+      qDebug() << "  \"-entries <num>,<num>,...\": Entries in the sysctllist reply (default: 100,1000,10000)";
+      return 1;
+    }
+  }
+  QTextStream out(stdout);
+  if(!AllocCounter::available()){ out << "Note: allocation counting is not available on this system\n"; }
+  //Each case: request bytes off the socket -> parsed request -> reply (backend result already built) -> bytes for the socket
+  out << QString("%1 %2 %3 %4 %5 %6\n").arg("case", -18).arg("entries", 8).arg("reply-KB", 9).arg("us/request", 12).arg("allocs", 9).arg("alloc-KB", 11);
+  QByteArray json = jsonRequest();
+  QByteArray rest = restRequest();
+  for(int s=0; s<sizes.length(); s++){
+    QJsonValue reply = makeSysctlList(sizes[s]);
+    // - WebSocket text frames (QWebSocket hands over/takes a QString on both ends)
+    runCase(out, "websocket/before", sizes[s], msecs, [&](){
+      LegacyInput IN(QString::fromUtf8(json), false);
+      QString msg = legacyAssemble(IN, reply);
+      return (qint64) msg.toUtf8().size(); //sendTextMessage() encoding
+    });
+    runCase(out, "websocket/after", sizes[s], msecs, [&](){
+      RestInputStruct IN(json, false);
+      RestOutputStruct OUT;
+        OUT.in_struct = IN;
+        OUT.CODE = RestOutputStruct::OK;
+        OUT.out_args = reply;
+      QByteArray msg = OUT.assembleMessage();
+      return (qint64) QString::fromUtf8(msg).toUtf8().size(); //sendReply() -> sendTextMessage()
+    });
+    // - WebSocket binary frames (bytes on both ends)
+    runCase(out, "binary/before", sizes[s], msecs, [&](){
+      LegacyInput IN(QString(json), false);
+      QString msg = legacyAssemble(IN, reply);
+      return (qint64) msg.toUtf8().size();
+    });
+    runCase(out, "binary/after", sizes[s], msecs, [&](){
+      RestInputStruct IN(json, false);
+      RestOutputStruct OUT;
+        OUT.in_struct = IN;
+        OUT.CODE = RestOutputStruct::OK;
+        OUT.out_args = reply;
+      return (qint64) OUT.assembleMessage().size();
+    });
+    // - TCP/REST (raw socket bytes on both ends)
+    runCase(out, "rest/before", sizes[s], msecs, [&](){
+      LegacyInput IN(QString(rest), true);
+      QString msg = legacyAssemble(IN, reply);
+      return (qint64) msg.toUtf8().size(); //TSOCKET->write(msg.toUtf8())
+    });
+    runCase(out, "rest/after", sizes[s], msecs, [&](){
+      RestInputStruct IN(rest, true);
+      RestOutputStruct OUT;
+        OUT.in_struct = IN;
+        OUT.CODE = RestOutputStruct::OK;
+        OUT.out_args = reply;
+        OUT.Header << "Content-Type: text/json; charset=utf-8";
+      return (qint64) OUT.assembleMessage().size();
+    });
+  }
+  if(sink==0){ out << "\n"; } //never true - keeps the results alive
+  return 0;
+}
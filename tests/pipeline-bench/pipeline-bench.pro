@@ -0,0 +1,15 @@
+include(../tests.pri)
+
+QT = core network websockets
+
+#Compare the old QString request/reply pipeline with the UTF-8 byte pipeline (server sources)
+INCLUDEPATH += $${SERVERDIR}
+
+HEADERS	+= AllocCounter.h \
+		$${SERVERDIR}/RestStructs.h
+
+SOURCES	+= main.cpp \
+		AllocCounter.cpp \
+		$${SERVERDIR}/RestStructs.cpp
+
+TARGET=pipeline-bench
@@ -0,0 +1,86 @@
+// ===============================
+//  PC-BSD REST API Server - System Probe Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+
+#include <functional>
+
+#include "sysadm-systemprobe.h"
+
+using namespace sysadm;
+
+//Every result feeds into this so the compiler can not drop the work
+static qint64 sink = 0;
+
+static void runCase(QTextStream &out, QString label, qint64 msecs, std::function<qint64()> fn){
+  //Short warmup, then run batches until the time is up (the clock only gets checked between batches)
+  for(int i=0; i<16; i++){ sink += fn(); }
+  QElapsedTimer timer;
+  timer.start();
+  qint64 iters = 0;
+  int batch = 1;
+  while(timer.elapsed() < msecs){
+    for(int i=0; i<batch; i++){ sink += fn(); }
+    iters += batch;
+    if(batch<1024){ batch *= 2; }
+  }
+  double ns = timer.nsecsElapsed();
+  out << QString("%1 %2 %3\n").arg(label, -22).arg(ns/iters/1000.0, 12, 'f', 2).arg(iters/(ns/1e9), 12, 'f', 0);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  qint64 msecs = 500;
+  QStringList probes = SystemProbe::available();
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-t" && i+1<args.length()){ i++; msecs = qMax(10, args[i].toInt()); }
+    else if(args[i]=="-probe" && i+1<args.length()){ i++; probes = QStringList() << args[i]; }
+    else{
+      qDebug() << "probe-bench usage:";
+      qDebug() << "  \"-t <msecs>\": Time to spend on each case (default: 500)";
+      qDebug() << "  \"-probe <name>\": Only run this backend (available:" << SystemProbe::available().join(", ") << ")";
+      return 1;
+    }
+  }
+  QTextStream out(stdout);
+  for(int p=0; p<probes.length(); p++){
+    SystemProbe *probe = SystemProbe::create(probes[p]);
+    if(probe==0){ qDebug() << "Probe not available on this system:" << probes[p]; return 1; }
+    // - What the probe reports (sanity check)
+    MemoryInfo mem;
+    SystemInfo info;
+    QVector<CpuTimes> cpus;
+    bool okmem = probe->memory(&mem);
+    bool oksys = probe->system(&info);
+    bool okcpu = probe->cpuTimes(&cpus);
+    QList<NetCounters> ifaces;
+    bool oknet = probe->interfaces(&ifaces);
+    out << "== " << probe->name() << " ==\n";
+    out << "memory: " << (okmem ? "ok" : "FAILED") << "  free=" << mem.free/1024/1024 << "MB active=" << mem.active/1024/1024
+	<< "MB inactive=" << mem.inactive/1024/1024 << "MB wired=" << mem.wired/1024/1024 << "MB cache=" << mem.cache/1024/1024 << "MB\n";
+    out << "system: " << (oksys ? "ok" : "FAILED") << "  " << info.arch << " | " << info.systemVersion << " | " << info.kernelVersion
+	<< " | " << info.hostname << " | " << info.cpuModel << " x" << info.cpuCores << " | " << info.totalMem/1024/1024 << "MB | "
+	<< SystemProbe::uptimeString(info.uptimeSecs) << "\n";
+    out << "cpu: " << (okcpu ? "ok" : "FAILED") << "  " << cpus.size() << " CPUs\n";
+    out << "net: " << (oknet ? "ok" : "FAILED");
+    for(int i=0; i<ifaces.length(); i++){ out << "  " << ifaces[i].name << "=" << ifaces[i].rxBytes << "/" << ifaces[i].txBytes; }
+    out << "\n";
+    // - Timings
+    out << QString("%1 %2 %3\n").arg("case", -22).arg("us/op", 12).arg("ops/s", 12);
+    runCase(out, "memory", msecs, [&](){ MemoryInfo M; probe->memory(&M); return M.free; });
+    runCase(out, "system", msecs, [&](){ SystemInfo S; probe->system(&S); return (qint64) S.arch.size(); });
+    runCase(out, "cputimes", msecs, [&](){ QVector<CpuTimes> C; probe->cpuTimes(&C); return (qint64) C.size(); });
+    runCase(out, "interfaces", msecs, [&](){ QList<NetCounters> N; probe->interfaces(&N); return (qint64) N.size(); });
+    delete probe;
+  }
+  if(sink==0){ out << "\n"; } //never true - keeps the results alive
+  return 0;
+}
@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+QT = core
+
+#Benchmark the library system probes directly from the server sources
+INCLUDEPATH += $${LIBDIR}
+
+HEADERS	+= $${LIBDIR}/sysadm-systemprobe.h
+
+SOURCES	+= main.cpp \
+		$${LIBDIR}/sysadm-systemprobe.cpp
+
+#Plain Qt/POSIX - builds on FreeBSD or Linux
+TARGET=probe-bench
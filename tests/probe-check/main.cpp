@@ -0,0 +1,188 @@
+// ===============================
+//  PC-BSD REST API Server - System Probe Parser Check
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QStringList>
+#include <QAtomicInt>
+#include <QThread>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+#include "sysadm-systemprobe.h"
+#include "sysadm-cpusampler.h"
+
+using namespace sysadm;
+
+static int failures = 0;
+
+static void check(QTextStream &out, bool ok, QString what){
+  if(ok){ return; }
+  failures++;
+  out << "FAILED: " << what << "\n";
+  out.flush();
+}
+
+static bool writeFile(QString path, QByteArray contents){
+  QDir().mkpath(path.section("/",0,-2));
+  QFile file(path);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){ return false; }
+  return file.write(contents)==contents.size();
+}
+
+#define MB (1024LL*1024LL)
+
+// === Canned /proc files (layout of a Linux 5.x kernel) ===
+static bool writeProcFiles(QString root){
+  bool ok = writeFile(root+"/meminfo",
+	"MemTotal:       16777216 kB\n"
+	"MemFree:         2097152 kB\n"
+	"MemAvailable:    8388608 kB\n"
+	"Buffers:          131072 kB\n"
+	"Cached:          4194304 kB\n"
+	"SwapCached:            0 kB\n"
+	"Active:          3145728 kB\n"
+	"Inactive:        1048576 kB\n"
+	"Active(anon):    1048576 kB\n"
+	"Inactive(anon):   524288 kB\n"
+	"Unevictable:       65536 kB\n"
+	"Mlocked:           65536 kB\n");
+  ok = ok && writeFile(root+"/stat",
+	"cpu  600 40 90 2700 100 10 10 0 0 0\n"
+	"cpu0 100 20 30 800 50 5 5 0 0 0\n"
+	"cpu1 500 20 60 1900 50 5 5 0 0 0\n"
+	"intr 123456 0 0 0\n"
+	"ctxt 987654\n"
+	"btime 1700000000\n"
+	"processes 4242\n"
+	"procs_running 1\n");
+  ok = ok && writeFile(root+"/net/dev",
+	"Inter-|   Receive                                                |  Transmit\n"
+	" face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+	"    lo:    1000      10    0    0    0     0          0         0     1000      10    0    0    0     0       0          0\n"
+	"  eth0: 123456789  98765    0    0    0     0          0        12 987654321  54321    0    0    0     0       0          0\n"
+	"  eth1:4294967296 3000000000    0    0    0     0          0         0 8589934592 4000000000    0    0    0     0       0          0\n");
+  ok = ok && writeFile(root+"/uptime", "123456.78 234567.89\n");
+  ok = ok && writeFile(root+"/cpuinfo",
+	"processor\t: 0\n"
+	"model name\t: Fake CPU @ 2.00GHz\n"
+	"\n"
+	"processor\t: 1\n"
+	"model name\t: Fake CPU @ 2.00GHz\n");
+  ok = ok && writeFile(root+"/sys/kernel/osrelease", "5.10.0-fake\n");
+  ok = ok && writeFile(root+"/sys/kernel/hostname", "probe-check\n");
+  return ok;
+}
+
+static void procParsers(QTextStream &out, QString root){
+  out << "== proc backend (canned files) == "; out.flush();
+  int before = failures;
+  check(out, writeProcFiles(root), "could not write the canned files in: "+root);
+  SystemProbe *probe = SystemProbe::create("proc", root);
+  // - memory
+  MemoryInfo mem;
+  check(out, probe->memory(&mem), "memory() failed");
+  check(out, mem.free==2048*MB, QString("free: %1 (expected %2)").arg(mem.free).arg(2048*MB));
+  check(out, mem.cache==4096*MB, QString("cache: %1 (expected %2)").arg(mem.cache).arg(4096*MB));
+  check(out, mem.active==3072*MB, QString("active: %1 (expected %2) - Active(anon) mixed up with Active?").arg(mem.active).arg(3072*MB));
+  check(out, mem.inactive==1024*MB, QString("inactive: %1 (expected %2)").arg(mem.inactive).arg(1024*MB));
+  check(out, mem.wired==64*MB, QString("wired: %1 (expected %2)").arg(mem.wired).arg(64*MB));
+  // - CPU ticks (the "cpu" total line is not a CPU)
+  QVector<CpuTimes> cpus;
+  check(out, probe->cpuTimes(&cpus), "cpuTimes() failed");
+  check(out, cpus.size()==2, QString("CPUs: %1 (expected 2)").arg(cpus.size()));
+  if(cpus.size()==2){
+    check(out, cpus[0].user==100 && cpus[0].nice==20 && cpus[0].system==30, "cpu0 user/nice/system");
+    check(out, cpus[0].idle==850, QString("cpu0 idle: %1 (expected 850 - idle+iowait)").arg(cpus[0].idle));
+    check(out, cpus[0].interrupt==10, QString("cpu0 interrupt: %1 (expected 10 - irq+softirq)").arg(cpus[0].interrupt));
+    check(out, cpus[1].total()==2540, QString("cpu1 total: %1 (expected 2540)").arg(cpus[1].total()));
+  }
+  // - interface counters (wide numbers run into the colon)
+  QList<NetCounters> ifaces;
+  check(out, probe->interfaces(&ifaces), "interfaces() failed");
+  check(out, ifaces.length()==3, QString("interfaces: %1 (expected 3)").arg(ifaces.length()));
+  if(ifaces.length()==3){
+    check(out, ifaces[1].name=="eth0" && ifaces[1].rxBytes==123456789 && ifaces[1].rxPackets==98765
+	&& ifaces[1].txBytes==987654321 && ifaces[1].txPackets==54321, "eth0 counters");
+    check(out, ifaces[2].name=="eth1" && ifaces[2].rxBytes==Q_UINT64_C(4294967296) && ifaces[2].rxPackets==Q_UINT64_C(3000000000)
+	&& ifaces[2].txBytes==Q_UINT64_C(8589934592) && ifaces[2].txPackets==Q_UINT64_C(4000000000), "eth1 counters (past 32 bits)");
+  }
+  // - system information
+  SystemInfo info;
+  check(out, probe->system(&info), "system() failed");
+  check(out, info.kernelVersion=="5.10.0-fake", "kernel version: "+info.kernelVersion);
+  check(out, info.hostname=="probe-check", "hostname: "+info.hostname);
+  check(out, info.cpuModel=="Fake CPU @ 2.00GHz" && info.cpuCores==2, QString("CPU model/cores: %1 x%2").arg(info.cpuModel).arg(info.cpuCores));
+  check(out, info.totalMem==16384*MB, QString("total memory: %1 (expected %2)").arg(info.totalMem).arg(16384*MB));
+  check(out, info.uptimeSecs==123456, QString("uptime: %1 (expected 123456)").arg(info.uptimeSecs));
+  delete probe;
+  // - uptime formatting (same output as uptime(1))
+  check(out, SystemProbe::uptimeString(123456)=="up 1 day 10:17", "uptime string: "+SystemProbe::uptimeString(123456));
+  check(out, SystemProbe::uptimeString(90061)=="up 1 day 1:01", "uptime string: "+SystemProbe::uptimeString(90061));
+  check(out, SystemProbe::uptimeString(7200)=="up 2 hrs", "uptime string: "+SystemProbe::uptimeString(7200));
+  check(out, SystemProbe::uptimeString(60)=="up 1 min", "uptime string: "+SystemProbe::uptimeString(60));
+  check(out, SystemProbe::uptimeString(5)=="up 5 secs", "uptime string: "+SystemProbe::uptimeString(5));
+  out << (failures==before ? "ok" : "FAILED") << "\n";
+}
+
+// === Fake probe: CPU ticks advance by the same amount on every read ===
+// cpu0: 25% busy, cpu1: 50% busy (both start out idle since "boot", so the long-term average is different)
+class FakeProbe : public SystemProbe{
+public:
+  QString name() const{ return "fake"; }
+  bool memory(MemoryInfo *info){ info->pageSize = 4096; info->free = 512*MB; return true; }
+  bool system(SystemInfo *info){ info->arch = "fake"; info->cpuCores = 2; return true; }
+  bool interfaces(QList<NetCounters> *ifaces){ ifaces->clear(); return true; }
+  bool cpuTimes(QVector<CpuTimes> *cpus){
+    quint64 n = reads.fetchAndAddOrdered(1)+1;
+    cpus->resize(2);
+    CpuTimes &C0 = (*cpus)[0];
+      C0.user = 10*n; C0.system = 10*n; C0.interrupt = 5*n; C0.idle = 100000+75*n;
+    CpuTimes &C1 = (*cpus)[1];
+      C1.user = 40*n; C1.nice = 10*n; C1.idle = 100000+50*n;
+    return true;
+  }
+private:
+  QAtomicInt reads;
+};
+
+static bool near(double val, double expect){ return qAbs(val-expect) < 0.01; }
+
+static void cpuSampler(QTextStream &out){
+  out << "== CPU sampler (fake probe) == "; out.flush();
+  int before = failures;
+  SystemProbe::setInstance(new FakeProbe()); //needs to be in place before the sampler starts
+  CpuSampler::setInterval(20);
+  CpuSampler *sampler = CpuSampler::instance();
+  QThread::msleep(10*sampler->interval()); //a few samples
+  QVector<double> cpus;
+  double total = -1;
+  check(out, sampler->busy(0, &cpus, &total), "no samples");
+  check(out, cpus.size()==2, QString("CPUs: %1 (expected 2)").arg(cpus.size()));
+  if(cpus.size()==2){
+    check(out, near(cpus[0], 25) && near(cpus[1], 50), QString("latest interval: %1%/%2% (expected 25%/50%)").arg(cpus[0]).arg(cpus[1]));
+  }
+  check(out, near(total, 37.5), QString("latest interval total: %1% (expected 37.5%)").arg(total));
+  //Longer window (reaches back to the oldest sample): same rates
+  total = -1;
+  check(out, sampler->busy(sampler->maxWindow(), 0, &total) && near(total, 37.5), QString("longest window total: %1% (expected 37.5%)").arg(total));
+  out << (failures==before ? "ok" : "FAILED") << "\n";
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  if(a.arguments().length()>1){
+    qDebug() << "probe-check usage: no arguments (exits with an error if any check fails)";
+    return 1;
+  }
+  QTextStream out(stdout);
+  QTemporaryDir dir;
+  if(!dir.isValid()){ out << "FAILED: could not create a temporary directory\n"; return 1; }
+  procParsers(out, dir.path());
+  cpuSampler(out);
+  return (failures==0) ? 0 : 1;
+}
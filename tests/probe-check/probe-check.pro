@@ -0,0 +1,16 @@
+include(../tests.pri)
+
+QT = core
+
+#Parser checks for the library system probes and the CPU sampler, built directly from the server sources
+INCLUDEPATH += $${LIBDIR}
+
+HEADERS	+= $${LIBDIR}/sysadm-systemprobe.h \
+		$${LIBDIR}/sysadm-cpusampler.h
+
+SOURCES	+= main.cpp \
+		$${LIBDIR}/sysadm-systemprobe.cpp \
+		$${LIBDIR}/sysadm-cpusampler.cpp
+
+#Plain Qt/POSIX - builds on FreeBSD or Linux
+TARGET=probe-check
@@ -0,0 +1,122 @@
+// ===============================
+//  PC-BSD REST API Server - Process Runner Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QTextStream>
+#include <QStringList>
+#include <QVector>
+#include <QDebug>
+
+#include <algorithm>
+#include <functional>
+
+#include "sysadm-process.h"
+
+using namespace sysadm;
+
+//The way General::RunCommand() used to do it (QProcess + event-pumping wait loop)
+static QByteArray oldRunCommand(QString command, QStringList arguments, bool &success){
+  QProcess proc;
+    proc.setProcessChannelMode(QProcess::MergedChannels);
+  if(arguments.isEmpty()){ proc.start(command); }
+  else{ proc.start(command, arguments); }
+  while( !proc.waitForFinished(500) ){
+    if(proc.state() != QProcess::Running){ break; }
+    QCoreApplication::processEvents();
+  }
+  success = (proc.exitCode()==0);
+  return proc.readAllStandardOutput();
+}
+
+//Print the latency spread (usecs per command) and the throughput
+static void report(QTextStream &out, QString label, QVector<qint64> usecs, qint64 totalNsecs, int failed){
+  std::sort(usecs.begin(), usecs.end());
+  double mean = 0;
+  for(int i=0; i<usecs.size(); i++){ mean += usecs[i]; }
+  if(!usecs.isEmpty()){ mean = mean/usecs.size(); }
+  auto pct = [&](double p){ return usecs.isEmpty() ? 0 : usecs[ qMin(usecs.size()-1, int(p*usecs.size())) ]; };
+  out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n").arg(label, -16).arg(usecs.size(), 7)
+	.arg(mean, 9, 'f', 0).arg(pct(0.5), 9).arg(pct(0.99), 9).arg(usecs.isEmpty() ? 0 : usecs.last(), 9)
+	.arg(usecs.size() / (totalNsecs/1e9), 9, 'f', 1).arg(failed, 6);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  int count = 200;
+  QList<int> batches; batches << 4 << 16 << 64;
+  QString command = "uname -m";
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-n" && i+1<args.length()){ i++; count = qMax(1, args[i].toInt()); }
+    else if(args[i]=="-c" && i+1<args.length()){
+      i++; batches.clear();
+      QStringList list = args[i].split(",", QString::SkipEmptyParts);
+      for(int j=0; j<list.length(); j++){ if(list[j].toInt()>0){ batches << list[j].toInt(); } }
+    }else if(args[i]=="-cmd" && i+1<args.length()){ i++; command = args[i]; }
+    else{
+      qDebug() << "process-bench usage:";
+      qDebug() << "  \"-n <count>\": Number of commands per case (default: 200)";
+      qDebug() << "  \"-c <num>,<num>,...\": Concurrent batch sizes for the async cases (default: 4,16,64)";
+      qDebug() << "  \"-cmd <command>\": Command to run (default: \"uname -m\")";
+      return 1;
+    }
+  }
+  QTextStream out(stdout);
+  out << "Command: " << command << "\n";
+  out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n").arg("case", -16).arg("runs", 7).arg("mean(us)", 9)
+	.arg("p50(us)", 9).arg("p99(us)", 9).arg("max(us)", 9).arg("runs/s", 9).arg("failed", 6);
+  QElapsedTimer total, one;
+  // - Old QProcess loop, one at a time
+  {
+    QVector<qint64> usecs;
+    int failed = 0;
+    total.start();
+    for(int i=0; i<count; i++){
+      bool ok = false;
+      one.start();
+      oldRunCommand(command, QStringList(), ok);
+      usecs << one.nsecsElapsed()/1000;
+      if(!ok){ failed++; }
+    }
+    report(out, "qprocess-loop", usecs, total.nsecsElapsed(), failed);
+  }
+  // - Runner, synchronous wrapper, one at a time
+  {
+    QVector<qint64> usecs;
+    int failed = 0;
+    total.start();
+    for(int i=0; i<count; i++){
+      one.start();
+      CommandResult res = ProcessRunner::run(command);
+      usecs << one.nsecsElapsed()/1000;
+      if(!res.success()){ failed++; }
+    }
+    report(out, "runner-sync", usecs, total.nsecsElapsed(), failed);
+  }
+  // - Runner, batches of concurrent commands (latency: start to finish of each command)
+  for(int b=0; b<batches.length(); b++){
+    QVector<qint64> usecs;
+    int failed = 0;
+    total.start();
+    for(int done=0; done<count; ){
+      QList< QFuture<CommandResult> > running;
+      for(int i=0; i<batches[b] && done+i<count; i++){
+        running << ProcessRunner::start(command);
+      }
+      for(int i=0; i<running.length(); i++){
+        running[i].waitForFinished();
+        CommandResult res = running[i].result();
+        usecs << res.msecs*1000;
+        if(!res.success()){ failed++; }
+      }
+      done += running.length();
+    }
+    report(out, "runner-async-x"+QString::number(batches[b]), usecs, total.nsecsElapsed(), failed);
+  }
+  return 0;
+}
@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+QT = core
+
+#Benchmark the library process runner directly from the server sources
+INCLUDEPATH += $${LIBDIR}
+
+HEADERS	+= $${LIBDIR}/sysadm-process.h
+
+SOURCES	+= main.cpp \
+		$${LIBDIR}/sysadm-process.cpp
+
+#Plain Qt/POSIX - builds on FreeBSD or Linux
+TARGET=process-bench
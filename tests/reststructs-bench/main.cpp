@@ -0,0 +1,294 @@
+// ===============================
+//  PC-BSD REST API Server - RestStructs Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+
+#include <functional>
+
+#include "RestStructs.h"
+
+//Every result feeds into this so the compiler can not drop the work
+static qint64 sink = 0;
+
+// === The message parsing/assembly before the single-pass rewrite (copied from the old RestStructs.cpp) ===
+// Fills the same structures so both versions get timed on identical messages (CBOR paths left out - not benchmarked here)
+static void legacyParseBody(RestInputStruct &IN){
+  QJsonObject obj;
+  bool valid = false;
+  while(IN.Body.endsWith('\n') || IN.Body.endsWith('\r')){ IN.Body.chop(1); }
+  if(IN.Body.startsWith('{') && IN.Body.endsWith('}') ){
+    QJsonDocument doc = QJsonDocument::fromJson(IN.Body);
+    if(!doc.isNull() && doc.isObject() ){ obj = doc.object(); valid = true; }
+  }
+  if(valid){
+    if(obj.contains("namespace") ){ IN.namesp = obj.value("namespace").toString(); }
+    if(obj.contains("name") ){ IN.name = obj.value("name").toString(); }
+    if(obj.contains("id") ){ IN.id = obj.value("id").toString(); }
+    if(obj.contains("args") ){ IN.args = obj.value("args"); }
+    else{ IN.args = obj; }
+  }
+  if(!IN.URI.isEmpty()){
+    IN.name = IN.URI.section("/",-1);
+    IN.namesp = IN.URI.section("/",1,1);
+  }
+}
+
+static void legacyParse(RestInputStruct &IN, QByteArray message, bool isRest){
+  IN.HTTPVERSION = CurHttpVersion;
+  if(message.isEmpty()){ return; }
+  if(!message.startsWith('{')){
+    if(isRest){
+      int brace = message.indexOf('{');
+      IN.Header = QString::fromUtf8( brace<0 ? message : message.left(brace) ).split("\n");
+      if(brace>=0){ IN.Body = message.mid(brace); }
+    }else{
+      int nl = message.indexOf('\n');
+      IN.bridgeID = QString::fromUtf8( message.left(nl) );
+      IN.Header << IN.bridgeID;
+      if(nl>=0){ IN.Body = message.mid(nl+1); }
+    }
+  }else{
+    IN.Body = message;
+  }
+  if(!IN.Header.isEmpty() && isRest){
+    QString line = IN.Header.takeFirst();
+    IN.VERB = line.section(" ",0,0);
+    IN.URI = line.section(" ",1,1);
+    IN.HTTPVERSION = line.section(" ",2,2);
+    QStringList conn = IN.Header.filter(QRegExp("^Connection:", Qt::CaseInsensitive));
+    QString connval = conn.isEmpty() ? QString() : conn.first().section(":",1,-1).simplified().toLower();
+    if(IN.HTTPVERSION.simplified()=="HTTP/1.1"){ IN.keepAlive = !connval.contains("close"); }
+    else{ IN.keepAlive = connval.contains("keep-alive"); }
+    if(!IN.Header.filter("Authorization:").isEmpty()){
+      line = IN.Header.filter("Authorization:").takeFirst().section("Authorization: ",1,50).simplified();
+      if(line.section(" ",0,0).toLower()=="basic"){
+	QByteArray ba;
+	ba.append(line.section(" ",1,1));
+	IN.auth = QByteArray::fromBase64(ba);
+      }
+    }
+  }
+  if(IN.Header.isEmpty() || isRest){ legacyParseBody(IN); }
+}
+
+static QByteArray legacyAssemble(RestOutputStruct &OUT){
+  if( !OUT.in_struct.VERB.isEmpty() ){
+    QStringList headers;
+    QString firstline = OUT.in_struct.HTTPVERSION.simplified();
+    if(firstline.isEmpty()){ firstline = CurHttpVersion.simplified(); }
+    QByteArray Body;
+    if(!OUT.raw_args.isEmpty()){
+      Body.reserve(OUT.raw_args.size()+10);
+      Body.append("{\"args\":");
+      Body.append(OUT.raw_args);
+      Body.append("}");
+    }else if(!OUT.out_args.isNull()){
+      QJsonObject obj; obj.insert("args", OUT.out_args);
+      Body = QJsonDocument(obj).toJson();
+    }
+    switch(OUT.CODE){
+      case RestOutputStruct::PROCESSING:
+        firstline.append(" 102 Processing"); break;
+      case RestOutputStruct::OK:
+        firstline.append(" 200 OK"); break;
+      case RestOutputStruct::CREATED:
+        firstline.append(" 201 Created"); break;
+      case RestOutputStruct::ACCEPTED:
+        firstline.append(" 202 Accepted"); break;
+      case RestOutputStruct::NOCONTENT:
+        firstline.append(" 204 No Content"); break;
+      case RestOutputStruct::RESETCONTENT:
+        firstline.append(" 205 Reset Content"); break;
+      case RestOutputStruct::PARTIALCONTENT:
+        firstline.append(" 206 Partial Content"); break;
+      case RestOutputStruct::BADREQUEST:
+        firstline.append(" 400 Bad Request"); break;
+      case RestOutputStruct::UNAUTHORIZED:
+        firstline.append(" 401 Unauthorized"); break;
+      case RestOutputStruct::FORBIDDEN:
+        firstline.append(" 403 Forbidden"); break;
+      case RestOutputStruct::NOTFOUND:
+        firstline.append(" 404 Not Found"); break;
+      case RestOutputStruct::SERVICEUNAVAILABLE:
+        firstline.append(" 503 Service Unavailable"); break;
+      case RestOutputStruct::PAYLOADTOOLARGE:
+        firstline.append(" 413 Payload Too Large"); break;
+      case RestOutputStruct::TOOMANYREQUESTS:
+        firstline.append(" 429 Too Many Requests"); break;
+    }
+    headers << firstline;
+    headers << "Server: SysAdm/1.0";
+    headers << "Date: "+QDateTime::currentDateTime().toString(Qt::ISODate).simplified();
+    for(int i=0; i<OUT.Header.size(); ++i){ headers << OUT.Header.at(i).simplified(); }
+    if(!Body.isEmpty()){ headers << "Content-Length: "+QString::number(Body.size()); }
+    headers << "";
+    QByteArray msg = headers.join("\r\n").toUtf8();
+    msg.reserve(msg.size()+2+Body.size());
+    msg.append("\r\n");
+    msg.append(Body);
+    return msg;
+  }
+  //WebSocket JSON (only OK replies get timed)
+  QJsonObject obj;
+  obj.insert("namespace", OUT.in_struct.namesp);
+  obj.insert("name", OUT.in_struct.id.isEmpty() ? OUT.in_struct.name : QString("response"));
+  obj.insert("id", OUT.in_struct.id);
+  if(OUT.CODE==RestOutputStruct::OK && !OUT.raw_args.isEmpty()){
+    QByteArray msg = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    msg.chop(1);
+    msg.append(",\"args\":");
+    msg.append(OUT.raw_args);
+    msg.append("}");
+    return msg;
+  }
+  obj.insert("args", OUT.out_args);
+  return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+// === Test data ===
+//JSON arguments object of roughly the given size (list entries like a typical backend reply)
+static QByteArray makeArgs(int size){
+  QJsonObject obj;
+    obj.insert("action", "memorystats");
+  QJsonArray list;
+  int entries = qMax(0, (size-30)/46);
+  for(int i=0; i<entries; i++){
+    QJsonObject item;
+      item.insert("name", "item"+QString::number(i));
+      item.insert("value", "0123456789abcdef");
+    list.append(item);
+  }
+  if(!list.isEmpty()){ obj.insert("list", list); }
+  return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+static QByteArray makeJsonMessage(const QByteArray &args){
+  return "{\"namespace\":\"sysadm\",\"name\":\"systemmanager\",\"id\":\"12345\",\"args\":"+args+"}";
+}
+
+static QByteArray makeRestMessage(const QByteArray &args){
+  QByteArray body = "{\"args\":"+args+"}";
+  QByteArray msg = "PUT /sysadm/systemmanager HTTP/1.1\r\n";
+  msg.append("Host: 127.0.0.1\r\n");
+  msg.append("User-Agent: reststructs-bench\r\n");
+  msg.append("Accept: application/json\r\n");
+  msg.append("Authorization: Basic "+QByteArray("operator:password").toBase64()+"\r\n");
+  msg.append("Connection: keep-alive\r\n");
+  msg.append("Content-Type: application/json\r\n");
+  msg.append("Content-Length: "+QByteArray::number(body.size())+"\r\n");
+  msg.append("\r\n");
+  msg.append(body);
+  return msg;
+}
+
+static double timeCase(qint64 msecs, std::function<qint64()> fn){
+  //Short warmup, then run batches until the time is up (the clock only gets checked between batches)
+  for(int i=0; i<16; i++){ sink += fn(); }
+  QElapsedTimer timer;
+  timer.start();
+  qint64 iters = 0;
+  int batch = 1;
+  while(timer.elapsed() < msecs){
+    for(int i=0; i<batch; i++){ sink += fn(); }
+    iters += batch;
+    if(batch<1024){ batch *= 2; }
+  }
+  return double(timer.nsecsElapsed())/iters;
+}
+
+//One line per case: the old code ("before") and the current RestStructs.cpp ("after") on the same message
+static void runCase(QTextStream &out, QString label, int bytes, qint64 msecs, std::function<qint64()> before, std::function<qint64()> after){
+  double beforeNs = timeCase(msecs, before);
+  double afterNs = timeCase(msecs, after);
+  out << QString("%1 %2 %3 %4 %5 %6\n").arg(label, -24).arg(bytes, 9)
+	.arg(beforeNs, 12, 'f', 0).arg(afterNs, 12, 'f', 0).arg(beforeNs/afterNs, 8, 'f', 2)
+	.arg( bytes / afterNs * 1e3, 10, 'f', 1);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  qint64 msecs = 300;
+  QList<int> sizes; sizes << 64 << 1024 << 16384 << 262144;
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-t" && i+1<args.length()){ i++; msecs = qMax(10, args[i].toInt()); }
+    else if(args[i]=="-sizes" && i+1<args.length()){
+      i++; sizes.clear();
+      QStringList list = args[i].split(",", QString::SkipEmptyParts);
+      for(int j=0; j<list.length(); j++){ if(list[j].toInt()>0){ sizes << list[j].toInt(); } }
+    }else{
+      qDebug() << "reststructs-bench usage:";
+      qDebug() << "  \"-t <msecs>\": Time to spend on each case (default: 300)";
+      qDebug() << "  \"-sizes <bytes>,<bytes>,...\": Argument payload sizes (default: 64,1024,16384,262144)";
+      return 1;
+    }
+  }
+  QTextStream out(stdout);
+  //"speedup": before/after time per operation, "MB/s": throughput of the current code
+  out << QString("%1 %2 %3 %4 %5 %6\n").arg("case", -24).arg("bytes", 9).arg("before-ns", 12).arg("after-ns", 12).arg("speedup", 8).arg("MB/s", 10);
+  for(int s=0; s<sizes.length(); s++){
+    QByteArray argsJson = makeArgs(sizes[s]);
+    QByteArray json = makeJsonMessage(argsJson);
+    QByteArray rest = makeRestMessage(argsJson);
+    QByteArray bridge = "bridge-client-0123456789\n"+json; //bridge-relayed message (body already decrypted)
+    // - Parsing
+    runCase(out, "parse/websocket-json", json.size(), msecs, [&](){
+      RestInputStruct IN; legacyParse(IN, json, false);
+      return (qint64) IN.name.size();
+    }, [&](){
+      RestInputStruct IN(json, false);
+      return (qint64) IN.name.size();
+    });
+    runCase(out, "parse/rest", rest.size(), msecs, [&](){
+      RestInputStruct IN; legacyParse(IN, rest, true);
+      return (qint64) IN.auth.size() + IN.keepAlive;
+    }, [&](){
+      RestInputStruct IN(rest, true);
+      return (qint64) IN.auth.size() + IN.keepAlive;
+    });
+    runCase(out, "parse/bridge", bridge.size(), msecs, [&](){
+      RestInputStruct IN; legacyParse(IN, bridge, false);
+      legacyParseBody(IN);
+      return (qint64) IN.bridgeID.size() + IN.name.size();
+    }, [&](){
+      RestInputStruct IN(bridge, false);
+      IN.ParseBodyIntoJson();
+      return (qint64) IN.bridgeID.size() + IN.name.size();
+    });
+    // - Assembling the replies
+    RestOutputStruct jsonOut;
+      jsonOut.in_struct = RestInputStruct(json, false);
+      jsonOut.CODE = RestOutputStruct::OK;
+      jsonOut.out_args = jsonOut.in_struct.args;
+    runCase(out, "assemble/websocket-json", argsJson.size(), msecs,
+	[&](){ return (qint64) legacyAssemble(jsonOut).size(); }, [&](){ return (qint64) jsonOut.assembleMessage().size(); });
+    RestOutputStruct jsonRawOut = jsonOut;
+      jsonRawOut.raw_args = argsJson;
+    runCase(out, "assemble/websocket-raw", argsJson.size(), msecs,
+	[&](){ return (qint64) legacyAssemble(jsonRawOut).size(); }, [&](){ return (qint64) jsonRawOut.assembleMessage().size(); });
+    RestOutputStruct restOut;
+      restOut.in_struct = RestInputStruct(rest, true);
+      restOut.CODE = RestOutputStruct::OK;
+      restOut.out_args = restOut.in_struct.args;
+      restOut.Header << "Content-Type: text/json; charset=utf-8" << "Connection: keep-alive" << "Keep-Alive: timeout=15";
+    runCase(out, "assemble/rest", argsJson.size(), msecs,
+	[&](){ return (qint64) legacyAssemble(restOut).size(); }, [&](){ return (qint64) restOut.assembleMessage().size(); });
+    RestOutputStruct restRawOut = restOut;
+      restRawOut.raw_args = argsJson;
+    runCase(out, "assemble/rest-raw", argsJson.size(), msecs,
+	[&](){ return (qint64) legacyAssemble(restRawOut).size(); }, [&](){ return (qint64) restRawOut.assembleMessage().size(); });
+    RestOutputStruct restErr;
+      restErr.in_struct = RestInputStruct(rest, true);
+      restErr.CODE = RestOutputStruct::NOTFOUND;
+    runCase(out, "assemble/rest-error", 0, msecs,
+	[&](){ return (qint64) legacyAssemble(restErr).size(); }, [&](){ return (qint64) restErr.assembleMessage().size(); });
+  if(sink==0){ out << "\n"; } //never true - keeps the results alive
+  return 0;
+}
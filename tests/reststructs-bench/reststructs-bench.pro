@@ -0,0 +1,13 @@
+include(../tests.pri)
+
+QT = core network websockets
+
+#Benchmark the server's message structures directly from the server sources
+INCLUDEPATH += $${SERVERDIR}
+
+HEADERS	+= $${SERVERDIR}/RestStructs.h
+
+SOURCES	+= main.cpp \
+		$${SERVERDIR}/RestStructs.cpp
+
+TARGET=reststructs-bench
@@ -0,0 +1,135 @@
+// ===============================
+//  PC-BSD REST API Server - Session Table Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <QDebug>
+
+#include <functional>
+
+#include "SessionTable.h"
+
+#define AUTHCHARS QString("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789")
+#define TOKENLENGTH 20
+
+//Every result feeds into this so the compiler can not drop the work
+static QAtomicInteger<qint64> sink(0);
+
+//Same token format as the server (does not need to be unpredictable here)
+static QString makeToken(quint32 *seed){
+  QString tok;
+  for(int i=0; i<TOKENLENGTH; i++){
+    *seed = (*seed)*1103515245 + 12345;
+    tok.append( AUTHCHARS.at( ((*seed)>>16) % AUTHCHARS.length() ) );
+  }
+  return tok;
+}
+
+//Request thread running one copy of a benchmark case
+class CaseThread : public QThread{
+public:
+	std::function<void()> job;
+protected:
+	void run(){ job(); }
+};
+
+//Runs one copy of the case per thread, and reports the per-call cost seen by each request thread
+static void runCase(QTextStream &out, QString label, int sessions, int threads, qint64 msecs, std::function<qint64(int, qint64)> fn){
+  QVector<qint64> iters(threads, 0);
+  QVector<double> nsecs(threads, 0);
+  QList<CaseThread*> list;
+  for(int t=0; t<threads; t++){
+    list << new CaseThread();
+    list[t]->job = [&, t](){
+      for(qint64 i=0; i<16; i++){ sink += fn(t, i); } //warmup
+      QElapsedTimer timer;
+      timer.start();
+      qint64 num = 0;
+      int batch = 1;
+      while(timer.elapsed() < msecs){
+        for(int i=0; i<batch; i++){ sink += fn(t, num+i); }
+        num += batch;
+        if(batch<1024){ batch *= 2; }
+      }
+      nsecs[t] = timer.nsecsElapsed();
+      iters[t] = num;
+    };
+  }
+  for(int t=0; t<threads; t++){ list[t]->start(); }
+  for(int t=0; t<threads; t++){ list[t]->wait(); delete list[t]; }
+  qint64 total = 0;
+  double ns = 0;
+  for(int t=0; t<threads; t++){ total += iters[t]; ns += nsecs[t]; }
+  out << QString("%1 %2 %3 %4 %5\n").arg(label, -16).arg(sessions, 9).arg(threads, 8)
+	.arg(ns/total, 10, 'f', 0).arg(total/(ns/threads/1e9), 14, 'f', 0);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  qint64 msecs = 300;
+  QList<int> counts; counts << 10 << 100 << 1000 << 10000;
+  QList<int> threads; threads << 1 << 8;
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-t" && i+1<args.length()){ i++; msecs = qMax(10, args[i].toInt()); }
+    else if( (args[i]=="-n" || args[i]=="-c") && i+1<args.length()){
+      QList<int> *list = (args[i]=="-n") ? &counts : &threads;
+      i++; list->clear();
+      QStringList nums = args[i].split(",", QString::SkipEmptyParts);
+      for(int j=0; j<nums.length(); j++){ if(nums[j].toInt()>0){ *list << nums[j].toInt(); } }
+    }else{
+      qDebug() << "session-bench usage:";
+      qDebug() << "  \"-t <msecs>\": Time to spend on each case (default: 300)";
+      qDebug() << "  \"-n <sessions>,<sessions>,...\": Numbers of live sessions (default: 10,100,1000,10000)";
+      qDebug() << "  \"-c <threads>,<threads>,...\": Numbers of concurrent request threads (default: 1,8)";
+      return 1;
+    }
+  }
+  QTextStream out(stdout);
+  out << QString("%1 %2 %3 %4 %5\n").arg("case", -16).arg("sessions", 9).arg("threads", 8).arg("ns/op", 10).arg("ops/s/thread", 14);
+  for(int n=0; n<counts.length(); n++){
+    //Fill the table with live sessions (15 minute timeout, like the server)
+    SessionTable table(900);
+    QVector<QString> tokens;
+    quint32 seed = 42;
+    while(tokens.size() < counts[n]){
+      QString tok = makeToken(&seed);
+      if(table.insert(tok, "user"+QString::number(tokens.size()%50), tokens.size()%2==0)){ tokens << tok; }
+    }
+    QVector<QString> missing;
+    for(int i=0; i<1024; i++){ missing << makeToken(&seed); }
+    for(int c=0; c<threads.length(); c++){
+      int T = threads[c];
+      //What every API request does: validate/bump the token, then check the access level and user
+      runCase(out, "touch", tokens.size(), T, msecs, [&](int t, qint64 i){
+        return (qint64) table.touch(tokens[(i*7919 + t*104729) % tokens.size()]);
+      });
+      runCase(out, "lookup", tokens.size(), T, msecs, [&](int t, qint64 i){
+        AuthSession S;
+        table.lookup(tokens[(i*7919 + t*104729) % tokens.size()], &S);
+        return (qint64) S.user.size() + S.isOperator;
+      });
+      runCase(out, "touch/invalid", tokens.size(), T, msecs, [&](int t, qint64 i){
+        return (qint64) table.touch(missing[(i + t) % missing.size()]);
+      });
+    }
+    //Login/logout churn and the periodic sweep (nothing expires here - this is the cost of an idle sweep)
+    runCase(out, "insert+remove", tokens.size(), 1, msecs, [&](int, qint64){
+      QString tok = makeToken(&seed);
+      bool ok = table.insert(tok, "user", false);
+      table.remove(tok);
+      return (qint64) ok;
+    });
+    runCase(out, "expire", tokens.size(), 1, msecs, [&](int, qint64){ return (qint64) table.expire(); });
+    if(table.count()!=tokens.size()){ out << "FAILED: session count changed: " << table.count() << "\n"; return 1; }
+  }
+  if(sink.load()==0){ out << "\n"; } //never true - keeps the results alive
+  return 0;
+}
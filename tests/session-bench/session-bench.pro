@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+QT = core network websockets
+
+#Benchmark the auth session table directly from the server sources
+INCLUDEPATH += $${SERVERDIR}
+
+HEADERS	+= $${SERVERDIR}/SessionTable.h
+
+SOURCES	+= main.cpp \
+		$${SERVERDIR}/SessionTable.cpp
+
+#Plain Qt/POSIX - builds on FreeBSD or Linux
+TARGET=session-bench
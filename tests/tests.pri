@@ -0,0 +1,20 @@
+#Shared settings for the test/benchmark tools (included by every tool project)
+TEMPLATE	= app
+LANGUAGE	= C++
+
+CONFIG	+= qt warn_off release console c++11
+CONFIG	-= app_bundle
+
+#Most of the tools get built directly from the server sources
+SERVERDIR = $$PWD/../src/server
+LIBDIR = $${SERVERDIR}/library
+
+QMAKE_LIBDIR = /usr/local/lib/qt5 /usr/local/lib
+INCLUDEPATH += /usr/local/include
+
+  #Some conf to redirect intermediate stuff in separate dirs
+  UI_DIR=./.build/ui/
+  MOC_DIR=./.build/moc/
+  OBJECTS_DIR=./.build/obj
+  RCC_DIR=./.build/rcc
+  QMAKE_DISTCLEAN += -r ./.build
@@ -0,0 +1,16 @@
+#Test/benchmark tools - not installed (build them all with "qmake && make" in this directory)
+TEMPLATE = subdirs
+CONFIG += recursive
+
+SUBDIRS+= loadgen \
+	reststructs-bench \
+	cbor-bench \
+	pipeline-bench \
+	framer-bench \
+	session-bench \
+	tls-bench \
+	idle-bench \
+	process-bench \
+	probe-bench \
+	probe-check \
+	dispatcher-journal
@@ -0,0 +1,165 @@
+// ===============================
+//  PC-BSD REST API Server - TLS Connection Rate Benchmark
+// Available under the 3-clause BSD License
+// Written by: Ken Moore <ken@pcbsd.org> 2015-2016
+// =================================
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+
+#include <functional>
+
+#include "SslServer.h"
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <unistd.h>
+
+// === The way SslServer used to set up every connection (copied from the old SslServer.h) ===
+// Certificate and key files get read/parsed for each socket
+class LegacySslServer : public QTcpServer{
+public:
+  LegacySslServer(QString certfile, QString keyfile) : QTcpServer(){ cert = certfile; key = keyfile; }
+  QSslSocket* nextPendingConnection(){ return pending.isEmpty() ? 0 : pending.dequeue(); }
+protected:
+  void incomingConnection(qintptr socketDescriptor){
+    QSslSocket *serverSocket = new QSslSocket(this);
+    serverSocket->setSslConfiguration(QSslConfiguration::defaultConfiguration());
+    serverSocket->setProtocol(SSLVERSION);
+    serverSocket->setPrivateKey(key);
+    serverSocket->setLocalCertificate(cert);
+    if(serverSocket->setSocketDescriptor(socketDescriptor)){ pending.enqueue(serverSocket); }
+    else{ delete serverSocket; }
+  }
+private:
+  QString cert, key;
+  QQueue<QSslSocket*> pending;
+};
+
+// === Client: one connection after the other (blocking OpenSSL) ===
+class ClientThread : public QThread{
+public:
+  quint16 port;
+  int count;
+  bool resume; //offer the session from the previous connection
+  bool tls12; //no TLS 1.3 (session IDs/TLS 1.2 tickets instead of TLS 1.3 tickets)
+  int done, failed, resumed;
+  qint64 nsecs;
+
+  ClientThread() : QThread(){ port = 0; count = 0; resume = tls12 = false; done = failed = resumed = 0; nsecs = 0; }
+
+protected:
+  void run(){
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, 0);
+    if(tls12){ SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION); }
+    SSL_SESSION *session = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for(int i=0; i<count; i++){
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      struct sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if(fd<0 || ::connect(fd, (struct sockaddr*) &addr, sizeof(addr))!=0){
+        if(fd>=0){ close(fd); }
+        failed++;
+        continue;
+      }
+      SSL *ssl = SSL_new(ctx);
+      SSL_set_fd(ssl, fd);
+      if(resume && session!=0){ SSL_set_session(ssl, session); }
+      char c = 0;
+      //The server sends one byte once its side of the handshake is done (TLS 1.3 tickets come in before it)
+      if(SSL_connect(ssl)==1 && SSL_read(ssl, &c, 1)==1){
+        done++;
+        if(SSL_session_reused(ssl)){ resumed++; }
+        if(resume){
+          if(session!=0){ SSL_SESSION_free(session); }
+          session = SSL_get1_session(ssl);
+        }
+      }else{
+        failed++;
+        ERR_clear_error();
+      }
+      SSL_shutdown(ssl);
+      SSL_free(ssl);
+      close(fd);
+    }
+    nsecs = timer.nsecsElapsed();
+    if(session!=0){ SSL_SESSION_free(session); }
+    SSL_CTX_free(ctx);
+  }
+};
+
+//Accept connections on the server and run the handshakes until the client is done
+static void runCase(QTextStream &out, QString label, QTcpServer *server, std::function<QSslSocket*()> next, int count, bool resume, bool tls12){
+  QObject::connect(server, &QTcpServer::newConnection, [next](){
+    QSslSocket *sock = 0;
+    while( (sock = next()) != 0 ){
+      QObject::connect(sock, &QSslSocket::encrypted, [sock](){ sock->write("k"); });
+      QObject::connect(sock, &QSslSocket::disconnected, sock, &QObject::deleteLater);
+      sock->startServerEncryption(); //what WebSocket does for every new REST connection
+    }
+  });
+  server->listen(QHostAddress::LocalHost, 0);
+  ClientThread client;
+    client.port = server->serverPort();
+    client.count = count;
+    client.resume = resume;
+    client.tls12 = tls12;
+  QEventLoop loop;
+  QObject::connect(&client, &QThread::finished, &loop, &QEventLoop::quit);
+  client.start();
+  loop.exec();
+  server->close();
+  double secs = client.nsecs/1e9;
+  out << QString("%1 %2 %3 %4 %5 %6\n").arg(label, -22).arg(client.done, 7).arg(client.failed, 7).arg(client.resumed, 8)
+	.arg( (secs>0) ? client.done/secs : 0.0, 10, 'f', 0).arg( (client.done>0) ? client.nsecs/1e6/client.done : 0.0, 12, 'f', 3);
+  out.flush();
+}
+
+int main( int argc, char ** argv ){
+  QCoreApplication a(argc, argv);
+  QString cert, key;
+  int count = 500;
+  bool tls12 = false;
+  QStringList args = a.arguments();
+  for(int i=1; i<args.length(); i++){
+    if(args[i]=="-cert" && i+1<args.length()){ i++; cert = args[i]; }
+    else if(args[i]=="-key" && i+1<args.length()){ i++; key = args[i]; }
+    else if(args[i]=="-n" && i+1<args.length()){ i++; count = qMax(1, args[i].toInt()); }
+    else if(args[i]=="-tls12"){ tls12 = true; }
+    else{ cert.clear(); break; }
+  }
+  if(cert.isEmpty() || key.isEmpty()){
+    qDebug() << "tls-bench usage:";
+    qDebug() << "  \"-cert <file>\": PEM certificate for the server (required)";
+    qDebug() << "  \"-key <file>\": PEM RSA key for the server (required)";
+    qDebug() << "  \"-n <num>\": Connections per case (default: 500)";
+    qDebug() << "  \"-tls12\": Client stops at TLS 1.2 (session IDs/TLS 1.2 tickets)";
+    return 1;
+  }
+  QTextStream out(stdout);
+  //"resumed": handshakes which picked up the previous session instead of doing a full handshake
+  out << QString("%1 %2 %3 %4 %5 %6\n").arg("case", -22).arg("conns", 7).arg("failed", 7).arg("resumed", 8).arg("conns/s", 10).arg("ms/conn", 12);
+  for(int resume=0; resume<2; resume++){
+    QString mode = resume ? "resume" : "full";
+    LegacySslServer *legacy = new LegacySslServer(cert, key);
+    runCase(out, "before/"+mode, legacy, [legacy](){ return legacy->nextPendingConnection(); }, count, resume, tls12);
+    delete legacy;
+    SslServer *cached = new SslServer(0, cert, key);
+    runCase(out, "after/"+mode, cached, [cached](){ return cached->nextPendingConnection(); }, count, resume, tls12);
+    delete cached;
+  }
+  return 0;
+}
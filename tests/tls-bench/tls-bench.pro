@@ -0,0 +1,16 @@
+include(../tests.pri)
+
+QT = core network websockets
+
+#Benchmark the REST server TLS handshake path (SslServer) directly from the server sources
+INCLUDEPATH += $${SERVERDIR}
+
+HEADERS	+= $${SERVERDIR}/SslServer.h
+
+SOURCES	+= main.cpp \
+		$${SERVERDIR}/SslServer.cpp
+
+#The test client talks to OpenSSL directly (to see if the session got resumed)
+LIBS += -L/usr/local/lib -lssl -lcrypto
+
+TARGET=tls-bench